@@ -17,6 +17,7 @@
 #include "control_parameters.h"
 #include "delay_table_akima.h"
 #include "uvw_model.h"
+#include "correlator_node_scheduler.h"
 
 typedef std::pair<std::string, std::string> stream_key;
 
@@ -42,7 +43,7 @@ public:
 
   void start_input_node(int rank, const std::string &station, const std::string &datastream);
   void start_output_node(int rank, int32_t buffer_size);
-  void start_correlator_node(int rank);
+  void start_correlator_node(int rank, int n_lanes = 1);
   void start_log_node(int rank);
   void start_log_node(int rank, char *filename);
 
@@ -110,6 +111,7 @@ public:
   void correlator_node_set_all(Mask_parameters &mask);
   void correlator_node_set_all(std::set<std::string> &sources);
 
+  /// A correlator node requested a time slice (ready), or got one
   void set_correlator_node_ready(size_t correlator_rank, bool ready=true);
 
   void send(Delay_table &delay_table, int station, int to_rank);
@@ -151,14 +153,17 @@ protected:
 
   // Map from the correlator node number to the MPI_rank
   std::vector<int> correlator_node_rank;
+  // Map from the correlator node number to the lane within its MPI_rank
+  std::vector<int> correlator_node_lane;
 
   Time integration_time_;
   int n_sources_in_current_scan;
 #ifdef SFXC_DETERMINISTIC
-  /// Status of the correlation node
-  std::vector<bool> correlator_node_ready;
+  /// Number of time slices the correlation node requested
+  std::vector<int> correlator_node_ready;
 #else
-  std::queue<int> ready_correlator_nodes;
+  /// Picks the correlator node for the next time slice
+  Correlator_node_scheduler correlator_node_scheduler;
 #endif
 };
 
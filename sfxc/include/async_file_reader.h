@@ -0,0 +1,123 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Sequential file reader that keeps several large reads in flight
+ */
+#ifndef ASYNC_FILE_READER_H
+#define ASYNC_FILE_READER_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "mutex.h"
+
+class Async_io_backend;
+
+/*****************************************
+*
+* @class Async_file_reader
+* @desc Reads a file sequentially in large
+* aligned blocks and keeps up to depth reads
+* in flight ahead of the read position, such
+* that RAID arrays see a deep queue. The file
+* is opened with O_DIRECT if the file system
+* supports it, which avoids polluting the page
+* cache with recordings that are read once.
+*
+* The reads are submitted through io_uring if
+* the kernel supports it, otherwise a small
+* pool of threads does blocking preads.
+*
+* read() copies from the completed blocks
+* directly into the buffer of the caller;
+* only the thread calling read() may use the
+* reader, except for set_read_ahead().
+******************************************/
+class Async_file_reader {
+public:
+  static const int DEFAULT_DEPTH = 4;
+  static const size_t DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
+  /// Alignment of the offsets and buffers for O_DIRECT
+  static const size_t ALIGNMENT = 4096;
+  static const int MAX_DEPTH = 64;
+
+  Async_file_reader(int depth = DEFAULT_DEPTH,
+                    size_t block_size = DEFAULT_BLOCK_SIZE);
+  ~Async_file_reader();
+
+  /// Open filename for reading, closes the current file
+  bool open(const std::string &filename);
+  void close();
+  bool is_open() const { return fd_ >= 0; }
+
+  /// Copy at most nbytes to out, or skip them if out is NULL. Returns
+  /// the number of bytes, which is only less than nbytes at the end of
+  /// the file or on a read error.
+  size_t read(char *out, size_t nbytes);
+
+  /// True when all data of the file has been read
+  bool eof() const;
+  uint64_t size() const { return file_size_; }
+  uint64_t position() const { return position_; }
+
+  /// Change the number of reads in flight and their size, takes effect
+  /// for the next reads that are submitted. Can be called from any thread.
+  void set_read_ahead(int depth, size_t block_size);
+
+  /// "io_uring" or "threads"
+  const char *backend_name() const;
+
+  struct Request {
+    char *buffer;
+    size_t capacity;
+    int fd;
+    uint64_t offset;
+    size_t length;
+    // Number of bytes at the start of buffer that were read before, a
+    // short read is continued after them
+    size_t filled;
+    // Number of bytes read, or -errno
+    long result;
+    bool done;
+    struct iovec iov;
+  };
+
+private:
+  void fill();
+  Request *wait_for_head();
+  Request *get_request(size_t length);
+  void recycle(Request *request);
+  void cancel_all();
+  bool reopen_buffered();
+
+  std::string filename_;
+  int fd_;
+  bool direct_;
+  uint64_t file_size_;
+  // Position of the next byte returned by read()
+  uint64_t position_;
+  // File offset of the next read that is submitted
+  uint64_t next_offset_;
+  bool error_;
+
+  int depth_;
+  size_t block_size_;
+  Mutex settings_mutex_;
+  int new_depth_;
+  size_t new_block_size_;
+
+  // The reads in flight, in file order
+  std::deque<Request *> in_flight_;
+  std::vector<Request *> free_requests_;
+  Async_io_backend *backend_;
+};
+
+#endif // ASYNC_FILE_READER_H
@@ -0,0 +1,40 @@
+/* Copyright (c) 2009 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the kernels that convert whole bytes of 1 and 2 bit samples to
+ *     floating point and count the samples at each level for the sampler
+ *     statistics
+ *
+ * The fastest kernels supported by the CPU are selected at run time. When
+ * sfxc is built without IPP, the selection follows sfxc_math (including
+ * the SFXC_MATH_ISA environment variable).
+ */
+#ifndef BIT2FLOAT_KERNELS_H
+#define BIT2FLOAT_KERNELS_H
+
+#include <stdint.h>
+#include "utils.h"
+
+struct Bit2float_kernels {
+  // Convert nbytes bytes from input to 8 / bits_per_sample samples each,
+  // levels[i] is incremented for every sample with value i.
+  void (*unpack_1bit)(const unsigned char *input, int nbytes,
+                      FLOAT *output, int64_t *levels);
+  void (*unpack_2bit)(const unsigned char *input, int nbytes,
+                      FLOAT *output, int64_t *levels);
+};
+
+// Returns the fastest kernels supported by the CPU
+Bit2float_kernels bit2float_kernels();
+
+// Implemented in bit2float_kernels_avx2.cc
+#if defined(__x86_64__) || defined(__i386__)
+void bit2float_init_avx2(Bit2float_kernels &kernels);
+#endif
+
+// Sample values, shared by all implementations
+extern const FLOAT bit2float_value_1bit[2];
+extern const FLOAT bit2float_value_2bit[4];
+
+#endif // BIT2FLOAT_KERNELS_H
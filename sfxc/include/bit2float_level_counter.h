@@ -0,0 +1,72 @@
+/* Copyright (c) 2009 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the counters of the sampler levels used by the bit2float kernels
+ *
+ * This file is included inside an anonymous namespace by
+ * bit2float_kernels.cc and bit2float_kernels_avx2.cc, which are compiled
+ * for different instruction sets and must therefore not share inline code.
+ */
+#ifndef BIT2FLOAT_LEVEL_COUNTER_H
+#define BIT2FLOAT_LEVEL_COUNTER_H
+
+// Without the popcnt instruction __builtin_popcountll is a library call
+#ifdef __POPCNT__
+inline int popcount64(uint64_t x) {
+  return __builtin_popcountll(x);
+}
+#else
+inline int popcount64(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+}
+#endif
+
+// The counters count the samples at each level in 64 bit words of input
+// using population counts; the totals are added to levels[] when the
+// counter goes out of scope. Unused bytes in a word must be zero.
+class Level_counter_1bit {
+public:
+  Level_counter_1bit(int64_t *levels)
+    : levels_(levels), nsamples_(0), n1_(0) {}
+  ~Level_counter_1bit() {
+    levels_[0] += nsamples_ - n1_;
+    levels_[1] += n1_;
+  }
+  void add(uint64_t word, int nbytes) {
+    n1_ += popcount64(word);
+    nsamples_ += 8 * nbytes;
+  }
+private:
+  int64_t *levels_;
+  int64_t nsamples_, n1_;
+};
+
+class Level_counter_2bit {
+public:
+  Level_counter_2bit(int64_t *levels)
+    : levels_(levels), nsamples_(0), n1_(0), n2_(0), n3_(0) {}
+  ~Level_counter_2bit() {
+    levels_[0] += nsamples_ - n1_ - n2_ - n3_;
+    levels_[1] += n1_;
+    levels_[2] += n2_;
+    levels_[3] += n3_;
+  }
+  void add(uint64_t word, int nbytes) {
+    const uint64_t mask = 0x5555555555555555ULL;
+    uint64_t low = word & mask, high = (word >> 1) & mask;
+    int both = popcount64(low & high);
+    n1_ += popcount64(low) - both;
+    n2_ += popcount64(high) - both;
+    n3_ += both;
+    nsamples_ += 4 * nbytes;
+  }
+private:
+  int64_t *levels_;
+  int64_t nsamples_, n1_, n2_, n3_;
+};
+
+#endif // BIT2FLOAT_LEVEL_COUNTER_H
@@ -14,6 +14,7 @@
 #include "delay_table_akima.h"
 #include "control_parameters.h"
 #include "bit_statistics.h"
+#include "bit2float_kernels.h"
 
 class Bit2float_worker;
 typedef shared_ptr<Bit2float_worker> Bit2float_worker_sptr;
@@ -35,6 +36,7 @@ public:
 
   // Invalid data
   typedef Correlator_node_types::Invalid            Invalid;
+  typedef Correlator_node_types::Invalid_list_ptr   Invalid_list_ptr;
 
   Bit2float_worker(int stream_nr, bit_statistics_ptr statistics_);
   ~Bit2float_worker() {
@@ -52,14 +54,22 @@ public:
   bool has_work();
   /// Set the input
   void connect_to(Input_buffer_ptr new_Input_buffer);
+  /// Notified when an output buffer returns to the memory pool
+  void set_notifier(Notifier *notifier);
   /// Get the output
   const char *name() {
     return "Bit2float_worker";
   }
 
   Output_queue_ptr get_output_buffer();
+  /// Placement of the output buffers, should follow the consumer
+  Memory_placement_ptr get_output_placement();
 
-  void set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &delays);
+  /// Queue the parameters of a time slice, they are applied once the
+  /// current time slice is converted. The sampler statistics and the
+  /// invalid samples of the slice are collected in statistics and invalid.
+  void set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &delays,
+                          bit_statistics_ptr statistics_, Invalid_list_ptr invalid_);
 
   // Convert input bitstream to floating point
   int bit2float(FLOAT *output, int start, int nbits, uint64_t *read);
@@ -70,7 +80,7 @@ public:
   /// Write state for debug purposes
   void get_state(std::ostream &out);
   
-  // Obtain the list of invalid samples
+  // Obtain the list of invalid samples of the current time slice
   std::vector<Invalid> *get_invalid();
 
   static Bit2float_worker_sptr new_sptr(int stream_nr_, bit_statistics_ptr statistics_);
@@ -85,11 +95,15 @@ private:
 
   Input_buffer_ptr    input_buffer_;
   Output_queue_ptr    output_buffer_;
+  /// Placement of the output buffers, follows the delay correction
+  Memory_placement_ptr output_placement_;
   Output_memory_pool   memory_pool_;
 
   /// The lookup tables for the bit2float conversion
   FLOAT lookup_table[256][4];
   FLOAT lookup_table_1bit[256][8];
+  /// Converts the bulk of the data
+  Bit2float_kernels kernels;
   bit_statistics_ptr statistics;
   int tsys_count;
   int tsys_freq;
@@ -129,11 +143,13 @@ private:
     int fft_size_correlation;
     int delay_in_samples;
     Time stream_start;
+    bit_statistics_ptr statistics;
+    Invalid_list_ptr invalid;
   };
 
   Threadsafe_queue<Bit2float_parameters> queue_;
 
   /// List of all invalid samples in the time slice
-  std::vector<Invalid> invalid;
+  Invalid_list_ptr invalid;
 };
 #endif // INTEGER_DELAY_CORRECTION_PER_CHANNEL_H
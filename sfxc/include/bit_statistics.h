@@ -27,6 +27,8 @@ public:
   ~bit_statistics();
   void reset_statistics(int bits_per_sample_, uint64_t sample_rate_, uint64_t base_sample_rate_);
   void inc_counter(unsigned char word, bool);
+  // The number of samples at each level, for use by the bit2float kernels
+  int64_t *level_counters(bool on);
   void inc_invalid(int n);
   int64_t *get_statistics();
   int64_t *get_tsys();
@@ -37,6 +39,8 @@ private:
   int64_t nInvalid;
   std::vector<int64_t> data_counts_on;
   std::vector<int64_t> data_counts_off;
+  std::vector<int64_t> level_counts_on;
+  std::vector<int64_t> level_counts_off;
   std::vector<int64_t> statistics;
   std::vector<int64_t> tsys;
 };
@@ -49,6 +53,11 @@ bit_statistics::inc_counter(unsigned char word, bool on){
     data_counts_off[(unsigned int)word]++;
 }
 
+inline int64_t *
+bit_statistics::level_counters(bool on){
+  return (on ? &level_counts_on[0] : &level_counts_off[0]);
+}
+
 inline void 
 bit_statistics::inc_invalid(int n){
   nInvalid+=n;
@@ -16,7 +16,8 @@ typedef std::pair<std::string, std::string> stream_key;
 class Input_node_parameters {
 public:
   Input_node_parameters()
-      : track_bit_rate(0), data_modulation(0) {}
+      : track_bit_rate(0), data_modulation(0), read_ahead_depth(4),
+        read_ahead_block_size(4 * 1024 * 1024) {}
 
   class Channel_parameters {
   public:
@@ -61,6 +62,9 @@ public:
   Time overlap_time;
   // Abort the correlation if the input stream contains no valid data
   bool exit_on_empty_datastream;
+  // Number of reads in flight and their size when reading from disk
+  int32_t read_ahead_depth;
+  int32_t read_ahead_block_size;
 };
 
 std::ostream &operator<<(std::ostream &out, const Input_node_parameters &param);
@@ -120,7 +124,9 @@ public:
     fft_size_dedispersion(0), integration_nr(-1), slice_nr(-1), sample_rate(0),
     channel_freq(0), bandwidth(0), sideband('n'), frequency_nr(-1), normalize(false),
     polarisation('n'), multi_phase_center(false), pulsar_binning(false),
-    window(SFXC_WINDOW_RECT) {}
+    window(SFXC_WINDOW_RECT), correlation_threads(1), delay_threads(1),
+    bit2float_threads(1), pipeline_depth(1), lane(0),
+    fft_planning(SFXC_FFT_ESTIMATE) {}
 
   bool operator==(const Correlation_parameters& other) const;
 
@@ -181,6 +187,13 @@ public:
   int32_t n_phase_centers;   // The number of phase centers in the current scan
   int32_t multi_phase_center;
   int32_t pulsar_binning;
+  int32_t correlation_threads;  // Number of threads used in the correlation core
+  int32_t delay_threads;        // Number of threads used for the delay correction
+  int32_t bit2float_threads;    // Number of threads used for the bit to float conversion
+  int32_t pipeline_depth;       // Number of time slices a correlator node has in flight
+  int32_t lane;                 // Channel slot of the correlator node that gets the slice
+  int32_t fft_planning;         // Planning rigor used for new FFTW plans
+  std::string fft_wisdom_file;  // FFTW wisdom file shared by the correlator nodes
   Pulsar_parameters *pulsar_parameters;
   Mask_parameters *mask_parameters;
 };
@@ -233,6 +246,15 @@ public:
   int job_nr() const;
   int subjob_nr() const;
   int output_buffer_size() const;
+  int correlation_threads() const;
+  int delay_threads() const;
+  int bit2float_threads() const;
+  int correlator_node_channels() const;
+  int correlator_node_pipeline_depth() const;
+  int fft_planning() const;
+  std::string get_fft_wisdom_file() const;
+  /// The CPU affinity map of the threads, see cpu_affinity.h
+  std::string cpu_map() const;
 
   std::string sideband(int i) const;
   std::string reference_station() const;
@@ -252,6 +274,8 @@ public:
 			     const std::string &mode_name) const;
   int tsys_freq(const std::string &station) const;
   bool exit_on_empty_datastream() const;
+  int read_ahead_depth() const;
+  int read_ahead_block_size() const;
   
   Time reader_offset(const std::string &s) const{
     return reader_offsets.find(s)->second;
@@ -260,8 +284,12 @@ public:
   void set_reader_offset(const std::string &s, const Time t);
 
   std::string get_delay_table_name(const std::string &station_name) const;
-  void generate_delay_table(const std::string &station_name,
-                            const std::string &filename) const;
+  /// Generates the missing delay tables of the stations in parallel, or
+  /// takes them from the delay cache
+  void generate_delay_tables(const std::vector<std::string> &stations) const;
+  /// Name of the delay table in the cache, depends on the vex input of
+  /// generate_delay_model. Empty if the cache is disabled
+  std::string delay_cache_name(const std::string &station_name) const;
   std::string channel(int i) const;
 
   int message_level() const;
@@ -289,6 +317,8 @@ public:
 
   // Takes cross polarisation into account
   int number_correlation_cores_per_timeslice(const std::string &mode) const;
+  /// Minimal number of correlator nodes (MPI ranks) for a job
+  int number_correlator_nodes(const std::string &mode) const;
 
   // Return the Frequency channels from the VEX file, filtered by the ctrl file
   size_t number_frequency_channels() const;
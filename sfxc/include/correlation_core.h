@@ -10,6 +10,7 @@
 #include "uvw_model.h"
 #include "bit_statistics.h"
 #include "timer.h"
+#include "worker_pool.h"
 #include <fstream>
 
 class Correlation_core : public Tasklet {
@@ -39,6 +40,10 @@ public:
 
   void connect_to(size_t stream, bit_statistics_ptr statistics_, Input_buffer_ptr buffer);
   void connect_to(size_t stream, std::vector<Invalid> *invalid_);
+  /// Set the sampler statistics and the invalid samples of a stream for
+  /// the time slice that is correlated next
+  void set_slice_statistics(size_t stream, bit_statistics_ptr statistics_,
+                            std::vector<Invalid> *invalid_);
 
   virtual void set_parameters(const Correlation_parameters &parameters,
                               std::vector<Delay_table_akima> &delays,
@@ -61,8 +66,23 @@ public:
   void get_state(std::ostream &out);
 
 protected:
+  /// Processes a range of frequencies of one integration step
+  class Integration_job : public Worker_pool::Job {
+  public:
+    Integration_job(Correlation_core &core, std::vector<Complex_buffer> &integration_buffer,
+                    int nbuffer, int stride)
+      : core(core), integration_buffer(integration_buffer), nbuffer(nbuffer), stride(stride) {}
+    void execute(int part, int nparts);
+  private:
+    Correlation_core &core;
+    std::vector<Complex_buffer> &integration_buffer;
+    int nbuffer, stride;
+  };
+
   virtual void integration_initialise();
   void integration_step(std::vector<Complex_buffer> &integration_buffer, int nbuffer, int stride);
+  void integration_step_block(std::vector<Complex_buffer> &integration_buffer, int nbuffer, int stride,
+                              size_t begin, size_t end);
   void integration_normalize(std::vector<Complex_buffer> &integration_buffer);
   void integration_write(std::vector<Complex_buffer> &integration_buffer, int phase_center, int source, int bin, double binweight = 1.);
   void tsys_write();
@@ -78,6 +98,9 @@ protected:
   size_t number_input_streams();
   int station_stream(int);
   int station_number(int);
+  /// Number of frequency points and of ffts of an integration step that are
+  /// processed together, such that they fit in CORRELATION_BLOCK_BYTES
+  void block_size(int nbuffer, size_t &block, size_t &buffers_per_block);
 
   void create_window();
   void create_weights();
@@ -115,6 +138,9 @@ protected:
 
   Timer fft_timer;
 
+  /// Threads among which the frequency range of integration_step is divided
+  Worker_pool thread_pool;
+
   SFXC_FFT fft_f2t, fft_t2f;
   Complex_buffer temp_buffer;
   Real_buffer real_buffer;
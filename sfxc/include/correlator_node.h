@@ -11,7 +11,7 @@
 #define CORRELATOR_NODE_H
 #include "node.h"
 #include "multiple_data_readers_controller.h"
-#include "single_data_writer_controller.h"
+#include "multiple_data_writers_controller.h"
 #include "control_parameters.h"
 #include "correlator_node_tasklet.h"
 #include "uvw_model.h"
@@ -41,6 +41,13 @@ private:
  * time slice. After the slice is processed the node will send a message
  * to the controller node saying it is available for a next job.
  *
+ * A correlator node can correlate several channels of a time slice
+ * concurrently, each in its own lane with its own tasklet. For the other
+ * nodes every lane is a correlator node of its own, with number
+ * nr_corr_node + lane. The input streams of the lanes are interleaved:
+ * stream i of lane l is data reader i * n_lanes + l, the output of lane
+ * l is data writer l.
+ *
  * \ingroup Node
  **/
 class Correlator_node : public Node {
@@ -52,7 +59,7 @@ public:
     END_NODE
   };
 
-  Correlator_node(int rank, int nr_corr_node, bool psr_binning, bool phased_array);
+  Correlator_node(int rank, int nr_corr_node, int n_lanes, bool psr_binning, bool phased_array);
   ~Correlator_node();
 
   /// The the main_loop of the correlator node.
@@ -87,14 +94,18 @@ private:
   /// Main loop just processes mpi messages 
   void main_loop();
 
-  /// Everything related to the actual correlation is implemented in the tasklet
-  Correlator_node_tasklet          tasklet;
+  /// Delay and uvw tables, shared by the lanes
+  Correlator_node_tables           tables;
+  /// Everything related to the actual correlation is implemented in the
+  /// tasklets, one per lane
+  std::vector<Correlator_node_tasklet *> tasklets;
   Correlator_node_controller       correlator_node_ctrl;
 
   /// The correlator node is connected to each of the input nodes.
   Multiple_data_readers_controller data_readers_ctrl;
 
-  Single_data_writer_controller    data_writer_ctrl;
+  /// One connection to the output node per lane
+  Multiple_data_writers_controller data_writer_ctrl;
 
   // Contains all timing/binning parameters relating to any pulsar in the current experiment
   Pulsar_parameters pulsar_parameters; 
@@ -11,6 +11,8 @@
 #include "utils.h"
 #include "timer.h"
 #include "thread.h"
+#include "worker_pool.h"
+#include "notifier.h"
 #include "correlator_node_types.h"
 #include "control_parameters.h"
 #include "bit2float_worker.h"
@@ -20,6 +22,7 @@ public:
   typedef Correlator_node_types::Channel_circular_input_buffer      Channel_circular_input_buffer;
   typedef Correlator_node_types::Channel_circular_input_buffer_ptr  Channel_circular_input_buffer_ptr;
   typedef Correlator_node_types::Invalid                            Invalid;
+  typedef Correlator_node_types::Invalid_list_ptr                   Invalid_list_ptr;
 
   Correlator_node_bit2float_tasklet();
   virtual ~Correlator_node_bit2float_tasklet();
@@ -53,6 +56,13 @@ public:
   *****************************************************************************/
   Bit2float_worker::Output_queue_ptr get_output_buffer(int nr_stream);
 
+  /*****************************************************************************
+  * @desc Retreive the placement of the output buffers for the specified station.
+  * @param int nr_stream The identifier of the stream.
+  * assert( nr_stream < number_inputs() )
+  *****************************************************************************/
+  Memory_placement_ptr get_output_placement(int nr_stream);
+
   /*****************************************************************************
   * @desc Retreive the list of invalid samples for the specified station.
   * @param int nr_stream The identifier of the stream.
@@ -62,11 +72,28 @@ public:
 
 
   /*****************************************************************************
-  * @desc Initialize the stream with the given parameters.
+  * @desc Queue the parameters of the next time slice, the workers start on
+  * it as soon as they finished the current one.
   * @param const Correlator_node_parameters &params
+  * @param statistics, invalid Per stream, receive the sampler statistics
+  * and the invalid samples of the time slice
   *****************************************************************************/
   void set_parameters(const Correlation_parameters &params, 
-                      std::vector<Delay_table_akima> &delays);
+                      std::vector<Delay_table_akima> &delays,
+                      std::vector<bit_statistics_ptr> &statistics,
+                      std::vector<Invalid_list_ptr> &invalid);
+
+  /*****************************************************************************
+  * @desc Set the number of threads that run the workers. Every worker is
+  * always processed by the same thread, which keeps its output in order.
+  *****************************************************************************/
+  void set_threads(int nthreads);
+
+  /*****************************************************************************
+  * @desc Notified when one of the workers might have work: data in an input
+  * buffer, a free output buffer or new parameters.
+  *****************************************************************************/
+  Notifier &notifier() { return notifier_; }
 
   /*****************************************************************************
   * @desc Clear all input links
@@ -87,8 +114,25 @@ public:
   void get_state(std::ostream &out);
 
 private:
+  // Processes the workers i with (i % nparts) == part until the tasklet is
+  // stopped or the number of threads changes
+  class Bit2float_job : public Worker_pool::Job {
+  public:
+    Bit2float_job(Correlator_node_bit2float_tasklet &tasklet)
+      : tasklet(tasklet) {}
+    void execute(int part, int nparts);
+  private:
+    Correlator_node_bit2float_tasklet &tasklet;
+  };
+
   std::vector<Bit2float_worker_sptr>    bit2float_workers_;
 
+  Worker_pool pool_;
+  /// Wakes up the threads of the pool when they are idle
+  Notifier notifier_;
+  /// Requested number of threads, applied by do_execute()
+  volatile int nthreads_;
+
   /// Amount of processing time.
   Timer timer_;
 
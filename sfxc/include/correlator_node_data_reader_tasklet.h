@@ -41,6 +41,8 @@ public:
   bool has_work();
 
   bool active();
+  /// True if there is too little space in the input buffer to read
+  bool buffer_full();
   int get_fd();
 
   const char *name() {
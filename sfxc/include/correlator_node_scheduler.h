@@ -0,0 +1,100 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Chooses the correlator node that correlates the next time slice
+ */
+#ifndef CORRELATOR_NODE_SCHEDULER_H
+#define CORRELATOR_NODE_SCHEDULER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <ostream>
+
+/** Keeps track of the time slices the correlator nodes requested and of
+    their throughput, and picks the node for the next (slice, channel).
+
+    Among the nodes with an outstanding request the node that is expected
+    to finish the slice first gets it. The expected time is shortened for
+    a node that correlated the same channel last, its FFT plans, windows
+    and delay splines are still warm, and for a node on the host of the
+    input nodes of the channel, whose data then arrives through shared
+    memory. A slice is held back if a node without a request is expected
+    to finish it STRAGGLER_FACTOR times sooner than the best node with a
+    request, so slow nodes of a heterogeneous cluster get less work.
+
+    The throughput of a node is measured from its requests: once a node
+    has pipeline_depth slices, its next request means that the oldest of
+    them is (almost) done. The work of a slice is in arbitrary units, the
+    manager node uses the number of input streams.
+ **/
+class Correlator_node_scheduler {
+public:
+  /// Relative reduction of the expected time on a node that correlated
+  /// the same channel last
+  static const double WARM_CHANNEL_BONUS;
+  /// Relative reduction of the expected time on a node that shares its
+  /// host with all input nodes of the channel
+  static const double LOCAL_INPUT_BONUS;
+  /// A ready node is not used if another node finishes the slice this
+  /// many times sooner
+  static const double STRAGGLER_FACTOR;
+  /// Weight of a new measurement in the throughput estimate
+  static const double RATE_WEIGHT;
+
+  Correlator_node_scheduler(int pipeline_depth);
+
+  /// Register the next input node, running on host
+  void add_input_node(const std::string &host);
+  /// Register the next correlator node, running on host
+  void add_node(const std::string &host);
+
+  /// The correlator node requested a time slice
+  void request(int node);
+  /// The number of outstanding requests of all correlator nodes
+  int number_requests() const;
+
+  /// Choose the correlator node for the next time slice of channel, which
+  /// gets its data from the given input nodes. Returns -1 if no node
+  /// requested a slice, or if the slice is better held back for a node
+  /// that is expected to request one soon.
+  int select(int channel, const std::vector<int> &inputs, double work);
+  /// The time slice is sent to node
+  void assign(int node, int channel, double work);
+
+  /// Write state for debug purposes
+  void get_state(std::ostream &out);
+
+private:
+  struct Slice {
+    double work;
+    double start;
+  };
+  struct Node_state {
+    std::string host;
+    int requests;
+    int last_channel;
+    /// Work per second, 0 while unknown
+    double rate;
+    /// Time at which the last slice was done
+    double last_done;
+    std::deque<Slice> in_flight;
+  };
+
+  // Expected time at which node finishes work after its current slices
+  double finish_time(const Node_state &node, double rate, double work, double now);
+  // Whether the node is a full slice late with its next request
+  bool overdue(const Node_state &node, double rate, double now);
+  // The median of the known throughputs, 1 if none is known yet
+  double default_rate();
+
+  int pipeline_depth;
+  std::vector<std::string> input_hosts;
+  std::vector<Node_state> nodes;
+};
+
+#endif // CORRELATOR_NODE_SCHEDULER_H
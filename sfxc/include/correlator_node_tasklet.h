@@ -9,8 +9,10 @@
 
 #ifndef CORRELATOR_NODE_TASKLET_H
 #define CORRELATOR_NODE_TASKLET_H
+#include <deque>
 #include <queue>
 #include <set>
+#include "cpu_affinity.h"
 #include "multiple_data_readers_controller.h"
 #include "single_data_writer_controller.h"
 #include "control_parameters.h"
@@ -20,13 +22,55 @@
 #include "correlation_core.h"
 #include "correlation_core_pulsar.h"
 #include "delay_correction.h"
+#include "delay_table_akima.h"
+#include "uvw_model.h"
+#include "mutex.h"
 #include <tasklet/tasklet_manager.h>
 #include "timer.h"
 #include "thread.h"
+#include "worker_pool.h"
+#include "notifier.h"
 
 #include "monitor.h"
 #include "eventor_poll.h"
 
+/**
+ * The delay and uvw tables of a correlator node. They are shared by the
+ * tasklets of all channels (lanes) of the node, the akima splines of an
+ * integration are made once and handed to every lane that correlates it.
+ * The lanes evaluate the copies concurrently, which is safe because
+ * Delay_table_akima only evaluates through its Delay_polynomials.
+ **/
+class Correlator_node_tables {
+public:
+  /// Number of integrations for which the splines are kept
+  static const int N_CACHED_INTEGRATIONS = 4;
+
+  void add_delay_table(Delay_table &table, int sn1, int sn2);
+  void add_uvw_table(Uvw_model &table, int sn1);
+
+  /// The delay splines and uvw coordinates of the streams of a time slice,
+  /// indexed by station stream
+  void get_tables(const Correlation_parameters &parameters,
+                  std::vector<Delay_table_akima> &akima_tables,
+                  std::vector<std::vector<double> > &uvw);
+
+private:
+  struct Splines {
+    Time start, duration;
+    // Indexed by delay table, valid is set once the spline is made
+    std::vector<Delay_table_akima> tables;
+    std::vector<char> valid;
+  };
+  Splines &get_splines(const Time &start, const Time &duration);
+
+  Mutex mutex;
+  std::vector<int>                            delay_index;
+  std::vector<Delay_table>                    delay_tables;
+  std::vector<Uvw_model>                      uvw_tables;
+  std::deque<Splines>                         splines;
+};
+
 /**
  *  The correlation_node_tasklet implements the main loop of the correlation.
  **/
@@ -37,8 +81,7 @@ public:
   typedef shared_ptr<Data_reader>          Data_reader_ptr;
   typedef shared_ptr<Data_writer>          Data_writer_ptr;
   typedef shared_ptr<Delay_correction>     Delay_correction_ptr;
-
-  bool has_requested;
+  typedef Correlator_node_types::Invalid_list_ptr Invalid_list_ptr;
 
   /// The states of the correlator_node.
   enum Status {
@@ -48,7 +91,8 @@ public:
     CORRELATING
   };
 
-  Correlator_node_tasklet(int nr_corr_node, bool psr_binning, bool phased_array);
+  Correlator_node_tasklet(int nr_corr_node, Correlator_node_tables &tables,
+                          bool psr_binning, bool phased_array);
   ~Correlator_node_tasklet();
 
   /// The the main_loop of the correlator node.
@@ -63,16 +107,17 @@ public:
   /// Callback function for adding a data_writer:
   void hook_added_data_writer(size_t writer, Data_writer_ptr data_writer);
 
-  void add_delay_table(Delay_table &table, int sn1, int sn2);
-  void add_uvw_table(Uvw_model &table, int sn1);
-
   void output_node_set_timeslice(int slice_nr, int stream_nr, int band, int accum,
 				 int bytes, int nbins);
 
   void add_new_slice(const Correlation_parameters &parameters);
   void add_source_list(const std::map<std::string, int> &sources);
 
-  void set_parameters(const Correlation_parameters &parameters);
+  /// Hand a time slice to the bit2float and delay correction stages, they
+  /// start on it as soon as they are done with the previous slice
+  void prefetch_slice(const Correlation_parameters &parameters);
+  /// Start the correlation of the oldest prefetched time slice
+  void set_parameters();
 
   int get_correlate_node_number();
 
@@ -99,6 +144,10 @@ class Reader_thread : public Thread {
     Timer timer_reading_;
 
   public:
+    Reader_thread() : done_work_(false), buffer_full_(false) {
+      set_affinity_role(CPU_ROLE_CORRELATOR_READER);
+    }
+
     std::vector< Bit_sample_reader_ptr >& bit_sample_readers() {
       return bit_sample_readers_;
     }
@@ -129,25 +178,37 @@ class Reader_thread : public Thread {
 
   class Listener : public FdEventListener {
       Bit_sample_reader_ptr& reader_;
+      bool& done_work_;
+      bool& buffer_full_;
 
     public:
-      Listener(Bit_sample_reader_ptr& ptr ) : reader_(ptr) {};
+      Listener(Bit_sample_reader_ptr& ptr, bool& done_work, bool& buffer_full )
+        : reader_(ptr), done_work_(done_work), buffer_full_(buffer_full) {};
 
       void on_event(short event) {
-        if ( reader_->has_work() )
+        if ( reader_->has_work() ) {
           reader_->do_task();
+          done_work_ = true;
+        } else if ( reader_->buffer_full() ) {
+          buffer_full_ = true;
+        }
       };
 
       void on_error(short event) {};
     };
 
     Eventor_poll eventsrc_;
+    /// Notified when bit2float frees space in one of the input buffers
+    Notifier space_notifier_;
+    bool done_work_, buffer_full_;
 
     void do_execute() {
       for (unsigned int i=0;i<bit_sample_readers_.size();i++) {
         eventsrc_.add_listener( POLLIN,
                                 bit_sample_readers_[i]->get_fd(),
-                                new Listener( bit_sample_readers_[i] ) );
+                                new Listener( bit_sample_readers_[i],
+                                              done_work_, buffer_full_ ) );
+        bit_sample_readers_[i]->get_output_buffer()->space_notifier = &space_notifier_;
       }
 
       //eventsrc_.randomize();
@@ -167,7 +228,13 @@ class Reader_thread : public Thread {
           } else {
             timer_reading_.resume();
             /// Wait something happens.
+            uint64_t events = space_notifier_.count();
+            done_work_ = buffer_full_ = false;
             eventsrc_.wait_until_any_event();
+            // Data is available but the input buffers are full, wait
+            // until bit2float consumed some of it
+            if ( !done_work_ && buffer_full_ )
+              space_notifier_.wait(events);
             timer_reading_.stop();
           }
         }
@@ -179,6 +246,7 @@ class Reader_thread : public Thread {
     void stop() {
       isrunning_ = false;
       queue_.close();
+      space_notifier_.notify();
     }
 
     void fetch_new_time_slice() {
@@ -212,18 +280,84 @@ class Reader_thread : public Thread {
     }
   };
 
+  /**
+   * Runs the delay correction of all input streams, concurrently with the
+   * correlation core that consumes its output. The streams are divided
+   * among the threads of a Worker_pool.
+   **/
+  class Delay_thread : public Thread {
+  public:
+    Delay_thread(std::vector<Delay_correction_ptr> &delay_modules);
+
+    void do_execute();
+    void stop();
+
+    /// Set the number of threads, applied by do_execute() while the
+    /// delay modules are idle
+    void set_threads(int nthreads);
+    /// Start processing, the delay modules continue with the next time
+    /// slice as soon as they finished the current one
+    void start_slice();
+
+    Timer &timer() {
+      return timer_;
+    }
+
+    /// Notified when a delay module might have work
+    Notifier &notifier() {
+      return notifier_;
+    }
+
+  private:
+    class Delay_job : public Worker_pool::Job {
+    public:
+      Delay_job(std::vector<Delay_correction_ptr> &delay_modules)
+        : delay_modules(delay_modules) {}
+      void execute(int part, int nparts);
+      bool done_work();
+
+      std::vector<char> part_done_work;
+    private:
+      std::vector<Delay_correction_ptr> &delay_modules;
+    };
+
+    std::vector<Delay_correction_ptr> &delay_modules_;
+    Worker_pool pool_;
+    Notifier notifier_;
+    Condition cond_;
+    // Requested number of threads, protected by cond_
+    int nthreads_;
+    // Set once the first time slice arrived
+    bool active_;
+    Timer timer_;
+  };
+
 private:
   Reader_thread reader_thread_;
   Correlator_node_bit2float_tasklet bit2float_thread_;
+  /// Declared before delay_thread_, which keeps a reference to it
+  std::vector< Delay_correction_ptr > delay_modules;
+  Delay_thread delay_thread_;
+  /// Notified when the correlation core might have work
+  Notifier correlation_notifier_;
   /// We need one thread for the integer delay correction
   ThreadPool threadpool_;
   void start_threads();
   void stop_threads();
 
+  /// Load and store the FFTW wisdom shared by the correlator nodes
+  void import_fft_wisdom();
+  void export_fft_wisdom();
+  std::string fft_wisdom_file;
+
   /// Main "usefull" function in which the real correlation computation is
   /// done.
   void correlate();
 
+  /// Request time slices from the manager node until pipeline_depth slices
+  /// are in flight
+  void request_slices();
+
   bool pulsar_binning; // Set to true if pulsar binning is enabled
   bool phased_array; // Set to true if in phased array mode
 
@@ -234,20 +368,39 @@ private:
   int nr_corr_node;
   bool isinitialized_;
 
-  std::vector< Delay_correction_ptr >         delay_modules;
   Correlation_core                            *correlation_core, *correlation_core_normal;
   Correlation_core_pulsar                     *correlation_core_pulsar;
 
   Threadsafe_queue<Correlation_parameters>    integration_slices_queue;
-  std::vector<int>                            delay_index;
-  std::vector<Delay_table>                    delay_tables;
-  std::vector<Uvw_model>                      uvw_tables;
 
-  Timer bit_sample_reader_timer_, bits_to_float_timer_, delay_timer_, correlation_timer_;
+  /// A time slice that is handed to the pipeline. The sampler statistics
+  /// and invalid samples are kept per slice, such that bit2float can fill
+  /// them for the next slice while the correlation core reads the ones of
+  /// the current slice.
+  struct Slice {
+    Correlation_parameters                    parameters;
+    std::vector<Delay_table_akima>            akima_tables;
+    std::vector<std::vector<double> >         uvw;
+    std::vector<bit_statistics_ptr>           statistics;
+    std::vector<Invalid_list_ptr>             invalid;
+  };
+  /// Slices handed to the pipeline that are not yet correlated
+  std::deque<Slice>                           prefetched_slices;
+  /// The slice that is being correlated
+  Slice                                       current_slice;
+  /// Number of time slices a node has in flight, taken from the parameters
+  /// of the slices. The slices in flight share the buffers of the pipeline.
+  int                                         pipeline_depth;
+  /// Requested from the manager node but not yet received, modified by
+  /// add_new_slice() in the thread of the controller
+  int                                         n_requested;
+  /// Delay and uvw tables, shared with the other lanes of the node
+  Correlator_node_tables                      &tables;
+
+  Timer bit_sample_reader_timer_, bits_to_float_timer_, correlation_timer_;
 
 #ifdef RUNTIME_STATISTIC
   QOS_MonitorSpeed reader_state_;
-  QOS_MonitorSpeed delaycorrection_state_;
   QOS_MonitorSpeed correlation_state_;
   QOS_MonitorSpeed dotask_state_;
 #endif //RUNTIME_STATISTIC
@@ -3,6 +3,9 @@
 
 #include <memory_pool.h>
 #include <threadsafe_queue.h>
+#include <spsc_queue.h>
+#include <placed_allocator.h>
+#include <notifier.h>
 #include <vector>
 #include "sfxc_math.h"
 #include "memory_pool_elements.h"
@@ -10,10 +13,15 @@
 
 class Correlator_node_types {
 public:
+  // Page policy of the memory pools between bit2float, the delay
+  // correction and the correlation core, see memory_placement.h
+  static const Page_policy channel_pool_pages = PAGES_TRANSPARENT_HUGE;
+  static const Page_policy delay_pool_pages = PAGES_TRANSPARENT_HUGE;
 
   struct Channel_circular_input_buffer { 
     Channel_circular_input_buffer(size_t size_)
-      : read(0), write(0), data(size_), size(size_){}
+      : read(0), write(0), data(size_), size(size_),
+        data_notifier(NULL), space_notifier(NULL) {}
     // NB: We can correlate 36years worth of data @16gb/s per channel before we get
     // integer overflow, therefore we can be sure that read<=write 
     inline size_t bytes_free() {
@@ -22,11 +30,24 @@ public:
     inline size_t bytes_read() {
       return write - read;
     }
+    // Publish the new indices and wake up the other side
+    inline void set_write(uint64_t write_) {
+      write = write_;
+      if (data_notifier != NULL)
+        data_notifier->notify();
+    }
+    inline void set_read(uint64_t read_) {
+      read = read_;
+      if (space_notifier != NULL)
+        space_notifier->notify();
+    }
     typedef unsigned char      value_type;
     std::vector<value_type> data; // The channel extracted from a mark5 frame
     size_t size; // The size of the data buffer
     uint64_t read;  // The index where the next data byte will be read from
     uint64_t write; // The index where the next data byte will be written to
+    Notifier *data_notifier;  // Notified when data is written, i.e. bit2float
+    Notifier *space_notifier; // Notified when data is read, i.e. the reader
   };
   typedef Channel_circular_input_buffer  *Channel_circular_input_buffer_ptr;
 
@@ -34,25 +55,32 @@ public:
     int start; 
     int n_invalid;
   };
+  typedef shared_ptr< std::vector<Invalid> >              Invalid_list_ptr;
   struct Channel_memory_pool_data {
     Channel_memory_pool_data(): nfft(0) {}
+    void set_placement(const Memory_placement_ptr &placement) {
+      data.set_placement(placement);
+    }
     int nfft;
     Memory_pool_vector_element<FLOAT> data;
   };
   typedef Memory_pool< Channel_memory_pool_data >         Channel_memory_pool;
   typedef Channel_memory_pool::Element                    Channel_memory_pool_element;
-  typedef Threadsafe_queue<Channel_memory_pool_element>   Channel_queue;
+  typedef Spsc_queue<Channel_memory_pool_element>         Channel_queue;
   typedef shared_ptr<Channel_queue>                       Channel_queue_ptr;
 
   struct Delay_memory_pool_data {
     Delay_memory_pool_data(): stride(0) {}
+    void set_placement(const Memory_placement_ptr &placement) {
+      data.set_placement(placement);
+    }
     // The number of elements reserved for each fft, the start of each fft should be propely (16 bytes) alligned
     size_t stride; 
     Memory_pool_vector_element< std::complex<FLOAT> > data;
   };
   typedef Memory_pool< Delay_memory_pool_data >         Delay_memory_pool;
   typedef Delay_memory_pool::Element                    Delay_memory_pool_element;
-  typedef Threadsafe_queue<Delay_memory_pool_element>   Delay_queue;
+  typedef Spsc_queue<Delay_memory_pool_element>         Delay_queue;
   typedef shared_ptr<Delay_queue>                       Delay_queue_ptr;
 };
 #endif // CORRELATOR_NODE_TYPES_H
@@ -14,6 +14,14 @@
 #include <types.h>
 #include <iostream>
 
+#if __cplusplus >= 201103L
+#include <memory>
+using std::shared_ptr;
+#else
+#include <tr1/memory>
+using std::tr1::shared_ptr;
+#endif
+
 /** Virtual class defining the interface for obtaining input.
  **/
 class Data_reader {
@@ -31,6 +39,15 @@ public:
   **/
   size_t get_bytes(size_t nBytes, char *buff);
 
+  /** Returns a pointer to the next nBytes inside the reader, without
+      copying them, and increases the read pointer like get_bytes.
+      region keeps the bytes valid after the reader has moved on.
+
+      \return NULL if the reader can not hand out the bytes in place,
+      the read pointer is then unchanged and get_bytes should be used.
+  **/
+  const char *get_view(size_t nBytes, shared_ptr<void> &region);
+
   /** Returns true if all data is read from the input reader.
   **/
   virtual bool eof() = 0;
@@ -69,11 +86,23 @@ public:
     return -1;
   }
 
+  /** Sets the number of reads in flight and the size of each read, for
+      readers that read ahead. Can be called while another thread reads.
+   **/
+  virtual void set_read_ahead(int depth, size_t block_size) {}
+
 private:
   /** Function that actually writes the data to the output device.
   **/
   virtual size_t do_get_bytes(size_t nBytes, char *buff) = 0;
 
+  /** Readers that keep the data in memory, e.g. a memory mapped file,
+      can return it in place
+  **/
+  virtual const char *do_get_view(size_t nBytes, shared_ptr<void> &region) {
+    return NULL;
+  }
+
   uint64_t _data_counter;
   int data_slice;
 protected:
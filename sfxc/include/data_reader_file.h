@@ -10,9 +10,9 @@
 
 #include <queue>
 #include <vector>
-#include <fstream>
 
 #include "data_reader.h"
+#include "async_file_reader.h"
 
 class Data_reader_file : public Data_reader {
 public:
@@ -23,14 +23,15 @@ public:
   bool eof();
   bool can_read();
 
+  void set_read_ahead(int depth, size_t block_size);
+
 private:
   void init(const std::vector<std::string> &sources);
   bool open_next_file();
   size_t do_get_bytes(size_t nBytes, char *out);
 
   std::queue<std::string> filenames;
-  std::ifstream file;
-  std::streampos file_end;
+  Async_file_reader file;
 };
 
 #endif // DATA_READER_FILE_H
@@ -0,0 +1,61 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data reader for recordings that are mapped into memory
+ */
+#ifndef DATA_READER_MMAP_H
+#define DATA_READER_MMAP_H
+
+#include <queue>
+#include <vector>
+#include <string>
+
+#include "data_reader.h"
+
+/*****************************************
+*
+* @class Data_reader_mmap
+* @desc Reads "mmap://" data sources: files
+* that are mapped into memory in large
+* windows instead of read(). Data that is
+* requested with get_view() is not copied,
+* the frames refer to the mapping and keep
+* the window mapped until they are released.
+*
+* Recordings that are correlated more than
+* once are served from the page cache.
+******************************************/
+class Data_reader_mmap : public Data_reader {
+public:
+  /// Size of the part of the file that is mapped at once
+  static const size_t WINDOW_SIZE = 256 * 1024 * 1024;
+
+  Data_reader_mmap(const std::vector<std::string> &sources);
+  ~Data_reader_mmap();
+
+  bool eof();
+  bool can_read();
+
+private:
+  bool open_next_file();
+  void close_file();
+  // Map the window that contains the current position
+  bool map_window(size_t nbytes);
+  size_t do_get_bytes(size_t nbytes, char *out);
+  const char *do_get_view(size_t nbytes, shared_ptr<void> &region);
+
+  std::queue<std::string> filenames;
+  int fd;
+  uint64_t file_size;
+  uint64_t position;
+
+  shared_ptr<void> window;
+  uint64_t window_offset;
+  size_t window_length;
+};
+
+#endif // DATA_READER_MMAP_H
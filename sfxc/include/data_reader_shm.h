@@ -0,0 +1,38 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data_reader for a shared memory ring from a process on the same host
+ */
+#ifndef DATA_READER_SHM_H
+#define DATA_READER_SHM_H
+
+#include "data_reader.h"
+#include "shared_memory_ring.h"
+
+/** Specialisation of Data_reader that reads from a Shared_memory_ring,
+    used instead of a tcp connection if the writer runs on the same host.
+ **/
+class Data_reader_shm : public Data_reader {
+public:
+  Data_reader_shm(Shared_memory_ring::Ptr ring);
+  ~Data_reader_shm();
+
+  bool eof();
+  bool can_read();
+
+  /// Readable while there is data in the ring, like a socket
+  int get_fd() {
+    return ring->get_fd();
+  }
+
+private:
+  size_t do_get_bytes(size_t nBytes, char *out);
+
+  Shared_memory_ring::Ptr ring;
+};
+
+#endif // DATA_READER_SHM_H
@@ -24,6 +24,7 @@
 #include "data_reader.h"
 #include "udp_packet.h"
 #include "thread.h"
+#include "cpu_affinity.h"
 
 template<class T>
 class Ring_buffer {
@@ -112,6 +113,7 @@ class Reading_thread : public Thread {
       packet_duplicated_ = 0;
       packet_base_ = 0;
       packet_outoforder_=0;
+      set_affinity_role(CPU_ROLE_INPUT_READER);
     }
     void do_execute();
   };
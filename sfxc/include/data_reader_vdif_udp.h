@@ -0,0 +1,141 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data reader for VDIF frames that are streamed over UDP (e-VLBI)
+ */
+#ifndef DATA_READER_VDIF_UDP_H
+#define DATA_READER_VDIF_UDP_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "data_reader.h"
+#include "thread.h"
+#include "condition.h"
+#include "Test_unit.h"
+
+/*****************************************
+*
+* @class Data_reader_vdif_udp
+* @desc Reads "udp://[address]:port" data
+* sources: one VDIF frame per datagram,
+* optionally preceded by a 64 bit packet
+* sequence number (PSN) as sent by jive5ab.
+*
+* A capture thread receives the packets in
+* batches with recvmmsg() directly into
+* frame sized slots. The slots are handed
+* out in sequence number order, such that
+* packets that arrive out of order are put
+* back in order. Without a PSN the sequence
+* number follows from the VDIF header.
+*
+* A lost frame of a single threaded stream
+* is replaced by a frame with the invalid
+* bit set, which the VDIF reader turns into
+* an invalid block. Frames of multi threaded
+* streams are skipped, the input reader
+* inserts invalid blocks for the gap.
+******************************************/
+class Data_reader_vdif_udp : public Data_reader {
+public:
+  /// Number of frames that are buffered
+  static const int NR_SLOTS = 8192;
+  /// Number of packets that are received with one recvmmsg call
+  static const int BATCH_SIZE = 64;
+  /// Number of frames a packet can be late before it is considered lost
+  static const int REORDER_WINDOW = 256;
+  /// Requested size of the socket receive buffer
+  static const int DEFAULT_RCVBUF = 128 * 1024 * 1024;
+
+  Data_reader_vdif_udp(const std::string &url);
+  ~Data_reader_vdif_udp();
+
+  bool eof();
+  bool can_read();
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Data_reader_vdif_udp> {
+  public:
+    void tests();
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  size_t do_get_bytes(size_t nBytes, char *buff);
+
+  // Hand out the frame at read_seq_, waits for it if needed. Returns
+  // false if no frame arrived for a while or the reader is stopped.
+  bool next_frame();
+  void release_frame();
+  void make_invalid_frame(uint64_t seq);
+  void log_statistics();
+
+  bool open_socket(const std::string &url);
+  // Main loop of the capture thread
+  void capture();
+  // Find the frame size from the first packet
+  bool detect_format();
+  // Called by the capture thread with the lock held
+  bool sequence_number(uint64_t psn, const char *frame, uint64_t &seq);
+  void place_packet(uint64_t seq, int slot);
+
+  class Capture_thread : public Thread {
+  public:
+    Capture_thread(Data_reader_vdif_udp &reader);
+    void do_execute();
+  private:
+    Data_reader_vdif_udp &reader_;
+  };
+  friend class Capture_thread;
+
+  int socket_;
+  bool has_psn_;
+  size_t frame_size_;
+
+  // Protects everything below
+  Condition condition_;
+  std::vector<char> buffer_;
+  std::vector<int> free_slots_;
+  // Slot of every sequence number in [read_seq_, read_seq_ + NR_SLOTS)
+  std::vector<int> slot_of_seq_;
+  bool started_;
+  // Set when the reader is destroyed or the socket failed
+  bool stopped_;
+  // Next sequence number that is handed out
+  uint64_t read_seq_;
+  // One past the highest sequence number that was received
+  uint64_t max_seq_;
+  // Number of consecutive packets outside of the window
+  int out_of_window_;
+
+  // Deriving the sequence number from the VDIF header
+  bool multi_thread_;
+  uint32_t first_thread_, first_second_;
+  uint32_t max_frame_nr_, frames_per_second_;
+  uint64_t arrival_seq_;
+
+  // Statistics
+  uint64_t packets_received_, packets_lost_, packets_late_;
+  uint64_t packets_duplicated_, packets_invalid_;
+  uint64_t reported_errors_;
+
+  // The frame that is handed out, either a slot or invalid_frame_
+  const char *frame_;
+  int frame_slot_;
+  size_t frame_pos_;
+  std::vector<char> invalid_frame_;
+  // Header of the last frame that was received, for the invalid frames
+  std::vector<char> last_header_;
+  uint64_t last_seq_;
+  uint32_t last_logged_second_;
+
+  Capture_thread capture_thread_;
+};
+
+#endif // DATA_READER_VDIF_UDP_H
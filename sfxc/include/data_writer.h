@@ -13,6 +13,9 @@
 #include <types.h>
 #include <stddef.h> // defines size_t
 #include <string>
+#include <sys/uio.h> // defines struct iovec
+
+#include "Test_unit.h"
 
 #if __cplusplus >= 201103L
 #include <memory>
@@ -34,6 +37,12 @@ public:
   **/
   size_t put_bytes(size_t nBytes, const char *buff);
 
+  /** Writes the iovcnt buffers of iov to the output device, in order. Writers
+      to a socket do this with as few system calls as possible.
+      \return the total number of bytes written.
+  **/
+  size_t put_iovec(const struct iovec *iov, int iovcnt);
+
   /** Returns the number of bytes written
    **/
   uint64_t data_counter();
@@ -69,10 +78,28 @@ public:
   bool is_active();
   void set_stream_nr(int nr);
   int get_stream_nr();
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Data_writer> {
+  public:
+    void tests();
+    static size_t writev_all(int fd, const struct iovec *iov, int iovcnt) {
+      return Data_writer::writev_all(fd, iov, iovcnt);
+    }
+  };
+#endif // ENABLE_TEST_UNIT
+protected:
+  /** Writes the buffers to a file descriptor with writev(), continues after
+      partial writes. Returns the number of bytes written.
+  **/
+  static size_t writev_all(int fd, const struct iovec *iov, int iovcnt);
 private:
   /** Function that actually writes the data to the output device.
   **/
   virtual size_t do_put_bytes(size_t nBytes, const char *buff) = 0;
+  /** Writes a list of buffers, by default with do_put_bytes() for each.
+  **/
+  virtual size_t do_put_iovec(const struct iovec *iov, int iovcnt);
 
   uint64_t _data_counter;
   int data_slice;
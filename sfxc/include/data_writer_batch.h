@@ -0,0 +1,67 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Batches small headers and references to payload data, which are
+ *     written to a Data_writer in one go
+ */
+#ifndef DATA_WRITER_BATCH_H
+#define DATA_WRITER_BATCH_H
+
+#include <vector>
+#include <sys/uio.h>
+
+#include "data_writer.h"
+
+/** Collects the output of a stream of small writes, e.g. the headers of
+    the input node to correlator node protocol interleaved with blocks of
+    samples, and writes it with a single Data_writer::put_iovec() call.
+    Small buffers are copied, adjacent ones end up in the same iovec. The
+    payload is referenced and has to stay valid until flush().
+ **/
+class Data_writer_batch {
+public:
+  Data_writer_batch();
+
+  /// Append n bytes, the data is copied
+  void put_bytes(size_t n, const void *buff);
+  /// Append n bytes without copying them
+  void put_reference(size_t n, const char *buff);
+
+  /// The number of bytes appended since the last flush
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /// Write everything that was appended and empty the batch, returns the
+  /// number of bytes written
+  size_t flush(Data_writer &writer);
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Data_writer_batch> {
+  public:
+    void tests();
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  // A segment either points to the payload, or to copies_ at offset
+  // when data is NULL (copies_ may be reallocated while appending)
+  struct Segment {
+    const char *data;
+    size_t offset, size;
+  };
+
+  std::vector<char> copies_;
+  std::vector<Segment> segments_;
+  std::vector<struct iovec> iov_;
+  size_t size_;
+};
+
+#endif // DATA_WRITER_BATCH_H
@@ -0,0 +1,33 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data_writer to a shared memory ring for a process on the same host
+ */
+#ifndef DATA_WRITER_SHM_H
+#define DATA_WRITER_SHM_H
+
+#include "data_writer.h"
+#include "shared_memory_ring.h"
+
+/** Specialisation of Data_writer that writes to a Shared_memory_ring,
+    used instead of a tcp connection if the reader runs on the same host.
+ **/
+class Data_writer_shm : public Data_writer {
+public:
+  Data_writer_shm(Shared_memory_ring::Ptr ring);
+  ~Data_writer_shm();
+
+  bool can_write();
+
+private:
+  size_t do_put_bytes(size_t nBytes, const char *buff);
+  size_t do_put_iovec(const struct iovec *iov, int iovcnt);
+
+  Shared_memory_ring::Ptr ring;
+};
+
+#endif // DATA_WRITER_SHM_H
@@ -35,6 +35,7 @@ public:
 
 protected:
   size_t do_put_bytes(size_t nBytes, char const*buff);
+  size_t do_put_iovec(const struct iovec *iov, int iovcnt);
   int m_socket;
 };
 
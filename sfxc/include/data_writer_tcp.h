@@ -30,6 +30,7 @@ public:
 
 private:
   size_t do_put_bytes(size_t nBytes, const char *buff);
+  size_t do_put_iovec(const struct iovec *iov, int iovcnt);
 
   int socket;
 };
@@ -27,6 +27,10 @@
 #endif
 class Delay_correction {
 public:
+  /// Largest change of the fringe phase over an FFT, in turns, for which
+  /// the delay and fringe correction are done in the frequency domain
+  static const double MAX_FRINGE_DRIFT;
+
   typedef Correlator_node_types::Channel_queue       Input_buffer;
   typedef Correlator_node_types::Channel_queue_ptr   Input_buffer_ptr;
   typedef Input_buffer::value_type                   Input_buffer_element;
@@ -41,12 +45,20 @@ public:
 
   /// Get the output
   Output_buffer_ptr get_output_buffer();
-
-  /// Set the input
-  void connect_to(Input_buffer_ptr new_input_buffer);
-
-  void set_parameters(const Correlation_parameters &parameters,
-                      Delay_table_akima &delays);
+  /// Placement of the output buffers, should follow the correlation core
+  Memory_placement_ptr get_output_placement();
+
+  /// Set the input, the buffers of the input are moved to the NUMA
+  /// node of the thread that runs the delay correction
+  void connect_to(Input_buffer_ptr new_input_buffer,
+                  Memory_placement_ptr new_input_placement = Memory_placement_ptr());
+  /// Notified when an output buffer returns to the memory pool
+  void set_notifier(Notifier *notifier);
+
+  /// Queue the parameters of a time slice, they are applied as soon as
+  /// the current time slice is done
+  void set_new_parameters(const Correlation_parameters &parameters,
+                          Delay_table_akima &delays);
   /// Do one delay step
   void do_task();
   bool has_work();
@@ -56,10 +68,16 @@ public:
   /// Write state for debug purposes
   void get_state(std::ostream &out);
 private:
-  void fractional_bit_shift(FLOAT *input,
+  // Apply the next parameters from the queue
+  void set_parameters();
+  void fractional_bit_shift(std::complex<FLOAT> *spectrum,
                             int integer_shift,
                             double fractional_delay);
-  void fringe_stopping(FLOAT output[]);
+  // fft is the index of the FFT in the current input buffer
+  void fringe_stopping(const std::complex<FLOAT> *spectrum,
+                       FLOAT output[], int fft);
+  void frequency_domain_correction(std::complex<FLOAT> *spectrum, int fft);
+  bool use_frequency_domain_correction();
   // access functions to the correlation parameters
   size_t fft_size();
   size_t fft_rot_size();
@@ -69,14 +87,12 @@ private:
   uint64_t bandwidth();
   int sideband();
   int64_t channel_freq();
-  double get_delay(Time time);
-  double get_phase(Time time);
-  double get_amplitude(Time time);
   void create_window();
   void create_flip();
 
 private:
   Input_buffer_ptr    input_buffer;
+  Memory_placement_ptr input_placement;
 
   Time             current_time;
   Correlation_parameters correlation_parameters;
@@ -87,16 +103,21 @@ private:
   double LO_offset;
   double start_phase;
   double extra_delay;
+  // Correct the delay and fringe in the spectrum of the correlation FFT
+  bool frequency_domain;
 
   int n_ffts_per_integration, current_fft, total_ffts;
   size_t tbuf_start, tbuf_end;
   Delay_table_akima   delay_table;
+  // The delay model evaluated for the FFTs of the current input buffer
+  std::vector<double> edge_delays, edge_phases, mid_delays, mid_amplitudes;
 
   Memory_pool_vector_element< std::complex<FLOAT> > frequency_buffer;
   Memory_pool_vector_element<FLOAT> time_buffer;
   Memory_pool_vector_element<FLOAT> temp_buffer;
   Memory_pool_vector_element< std::complex<FLOAT> > temp_fft_buffer;
   int temp_fft_offset;
+  int temp_fft_stride; // Distance between the FFTs in temp_fft_buffer
   int output_offset;
   Memory_pool_vector_element<FLOAT> window;
   Memory_pool_vector_element<FLOAT> flip;
@@ -104,11 +125,17 @@ private:
   Timer delay_timer;
 
   Output_buffer_ptr   output_buffer;
+  Memory_placement_ptr output_placement;
   Output_memory_pool  output_memory_pool;
 
+  struct Delay_parameters {
+    Correlation_parameters parameters;
+    Delay_table_akima delays;
+  };
+  Threadsafe_queue<Delay_parameters> queue_;
+
   Time fft_length;
   SFXC_FFT        fft_t2f, fft_f2t, fft_t2f_cor;
-  Memory_pool_vector_element< std::complex<FLOAT> >  exp_array;
 };
 
 inline size_t Delay_correction::fft_size() {
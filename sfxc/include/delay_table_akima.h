@@ -15,15 +15,90 @@
 #include <pthread.h>
 #include <types.h>
 #include <vector>
+#include <algorithm>
 
 // GSL includes
 #include <gsl/gsl_spline.h>
 #include <gsl/gsl_errno.h>
 #include "correlator_time.h"
 #include "utils.h"
+#include "Test_unit.h"
 
 class MPI_Transfer;
 
+// Piecewise cubic polynomials that reproduce an Akima spline. The
+// coefficients of all segments are stored in separate arrays, and on a
+// uniform grid the segment follows from the time without a search. The
+// evaluation doesn't modify the object and is therefore thread safe,
+// unlike a gsl_spline with a gsl_interp_accel.
+class Delay_polynomial {
+public:
+  Delay_polynomial();
+
+  // Converts the spline, offset + rate * t is added to the result
+  void init(const gsl_spline *spline, double offset = 0, double rate = 0);
+
+  // t in seconds, on the same axis as the knots of the spline
+  double eval(double t) const;
+  // Evaluates n points t0, t0 + step, ...
+  void eval(double t0, double step, int n, double *result) const;
+  // The first and second derivative
+  double deriv(double t) const;
+  double deriv2(double t) const;
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Delay_polynomial> {
+  public:
+    void tests();
+  private:
+    // The largest relative difference with the spline on the grid x, at
+    // the knots, just inside the segment edges and in between
+    double max_error(const std::vector<double> &x, const std::vector<double> &y,
+                     double offset, double rate);
+  };
+#endif // ENABLE_TEST_UNIT
+private:
+  int segment(double t) const;
+
+  double t_begin, inv_dt;
+  bool uniform;
+  int n_segments;
+  std::vector<double> knots, c0, c1, c2, c3;
+};
+
+inline int
+Delay_polynomial::segment(double t) const {
+  int i;
+  if (uniform) {
+    i = (int)((t - t_begin) * inv_dt);
+  } else {
+    i = (int)(std::upper_bound(knots.begin(), knots.begin() + n_segments, t) -
+              knots.begin()) - 1;
+  }
+  return std::min(std::max(i, 0), n_segments - 1);
+}
+
+inline double
+Delay_polynomial::eval(double t) const {
+  int i = segment(t);
+  double dt = t - knots[i];
+  return c0[i] + dt * (c1[i] + dt * (c2[i] + dt * c3[i]));
+}
+
+inline double
+Delay_polynomial::deriv(double t) const {
+  int i = segment(t);
+  double dt = t - knots[i];
+  return c1[i] + dt * (2 * c2[i] + dt * 3 * c3[i]);
+}
+
+inline double
+Delay_polynomial::deriv2(double t) const {
+  int i = segment(t);
+  double dt = t - knots[i];
+  return 2 * c2[i] + dt * 6 * c3[i];
+}
+
 class Delay_table_akima {
 friend class Delay_table;
 public:
@@ -45,6 +120,13 @@ public:
   double accel(const Time &time, int phase_center=0);
   double phase(const Time &time, int phase_center=0);
   double amplitude(const Time &time, int phase_center=0);
+  // Evaluate at the n times start, start + step, ...
+  void delay(const Time &start, const Time &step, int n, double *result,
+             int phase_center=0);
+  void phase(const Time &start, const Time &step, int n, double *result,
+             int phase_center=0);
+  void amplitude(const Time &start, const Time &step, int n, double *result,
+                 int phase_center=0);
   Time scan_begin, interval_begin, interval_end; // FIXME make private again
 private:
   void free_reference();
@@ -55,12 +137,13 @@ private:
   std::vector<std::string> sources;
 
   // GSL splining objects
-  std::vector<gsl_interp_accel *> acc;
   std::vector<gsl_spline *> splineakima;
-  std::vector<gsl_interp_accel *> acc_ph;
   std::vector<gsl_spline *> splineakima_ph;
-  std::vector<gsl_interp_accel *> acc_amp;
   std::vector<gsl_spline *> splineakima_amp;
+  // The same splines as polynomials, the clock is included in the delay.
+  // The copies of a table share them, all evaluation goes through the
+  // polynomials such that the copies can be used from several threads.
+  std::vector<Delay_polynomial> poly_delay, poly_phase, poly_amp;
   // Mutexes
   pthread_mutex_t *mutex;
   int *ref_count;
@@ -54,6 +54,10 @@ public:
 
   virtual void set_parameters(const Input_node_parameters &param) = 0;
 
+  void set_read_ahead(int depth, size_t block_size) {
+    data_reader_->set_read_ahead(depth, block_size);
+  }
+
   virtual TRANSPORT_TYPE get_transport_type() const = 0;
 
 protected:
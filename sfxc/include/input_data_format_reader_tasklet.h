@@ -95,13 +95,14 @@ private:
   void allocate_element();
   /// Push the input_element_ to the output buffer
   void push_element();
-  /// Randomize data in the mark5a block
-  void randomize_block();
+  /// Flag the current block as invalid, its data is not used
+  void invalidate_block();
   /// Used for data modulation (see p.6 of Mark4 memo 230A, Whitney 2005)
   void demodulate(Input_element &data);
   void gen_demodulation_sequence(int sequence_length);
   std::vector<unsigned char> demodulation_sequence; // contains the pseudo-random sequence
-  void push_random_blocks(int nblocks, int channel);
+  /// Push nblocks invalid blocks for channel
+  void push_invalid_blocks(int nblocks, int channel);
 
 private:
   /// Data stream to read from
@@ -9,24 +9,193 @@
  *     - The declaration of the Input_node_data_writer object. This is object
  *       is used to stream data to the correlation nodes. The object is not
  *       thread safe an thus can only use one client.
+ *     - The Input_node_data_slice, a time slice of one channel, and the
+ *       Input_node_data_sender which sends the slices to one correlator node.
  */
 #ifndef INPUT_NODE_DATA_WRITER_H_INCLUDED
 #define INPUT_NODE_DATA_WRITER_H_INCLUDED
 
+#include <deque>
+
 #include "data_writer.h"
+#include "data_writer_batch.h"
 #include "utils.h"
 #include "thread.h"
 #include "timer.h"
 #include "rttimer.h"
+#include "notifier.h"
+#include "threadsafe_queue.h"
 #include "input_node_types.h"
 #include "control_parameters.h"
 
-/// Forward declaration
+/// Forward declarations
 class Input_node_data_writer;
+class Input_node_data_slice;
+class Input_node_data_sender;
 
-/// A smart pointer to this object
+/// Smart pointers to these objects
 typedef shared_ptr<Input_node_data_writer> Input_node_data_writer_sptr;
+typedef shared_ptr<Input_node_data_slice>  Input_node_data_slice_sptr;
+typedef shared_ptr<Input_node_data_sender> Input_node_data_sender_sptr;
+
+/// The delays of a time interval, shared by all slices of the interval
+typedef shared_ptr< std::vector<Delay> >  Delay_table_ptr;
+
+/*******************************************************************************
+ * @class Input_node_data_slice
+ * @desc  A time slice of one channel that is streamed to a correlator node.
+ * The Input_node_data_writer of the channel opens the slice and pushes the
+ * input blocks it needs, these are the reference counted blocks of the
+ * channel extractor, shared by all slices that overlap. The
+ * Input_node_data_sender of the correlator node formats and sends them.
+ * At most MAX_BLOCKS blocks are queued, the channel only stalls when its
+ * correlator node does not keep up for that long. A slice that waits for
+ * its turn only stalls the channel when no other slice of the channel can
+ * take the block, otherwise it could hold up the slice in front of it on
+ * the same sender. Until then it takes the blocks it shares with the other
+ * slices, at most the overlap with them beyond MAX_BLOCKS.
+ ******************************************************************************/
+class Input_node_data_slice {
+public:
+  typedef Input_node_types::Channel_buffer_element  Input_buffer_element;
+  typedef Threadsafe_queue<Input_buffer_element>    Block_queue;
+
+  /// The number of input blocks that can be queued for the correlator node
+  static const int MAX_BLOCKS = 256;
+
+  Input_node_data_slice(Data_writer_sptr writer, Time slice_start,
+                        Time slice_stop, int64_t slice_samples,
+                        Notifier *channel_notifier);
+
+  /// Called by the channel: the slice starts at start_time with the given
+  /// delays, after this the blocks can be pushed
+  void open(Time start_time, Delay_table_ptr delays, uint64_t sample_rate,
+            int bits_per_sample, bool last_in_interval);
+  /// Whether the slice (still) needs the block, only called after open()
+  bool wants(const Input_buffer_element &block) const;
+  bool full() {
+    return blocks_.size() >= MAX_BLOCKS;
+  }
+  /// Whether the sender started on the slice
+  bool active() const {
+    return __atomic_load_n(&active_, __ATOMIC_ACQUIRE);
+  }
+  void push(const Input_buffer_element &block) {
+    blocks_.push(block);
+  }
+
+  /// Called by the sender: the blocks queue notifies the sender
+  void set_notifier(Notifier *notifier) {
+    blocks_.set_notifier(notifier);
+  }
+  /// Called by the sender: true if there is a block to send
+  bool has_work();
+  /// Send the next block, returns the number of bytes of data sent
+  uint64_t do_task();
+
+  /// Set once all data of the slice is sent
+  bool finished() const {
+    return __atomic_load_n(&finished_, __ATOMIC_ACQUIRE);
+  }
+
+  Data_writer_sptr writer() const {
+    return writer_;
+  }
+  Time slice_stop() const {
+    return slice_stop_;
+  }
+  /// The end of the data of the slice, without delay
+  Time end_time() const {
+    return end_time_;
+  }
+  bool last_in_interval() const {
+    return last_in_interval_;
+  }
+  size_t queued_blocks() {
+    return blocks_.size();
+  }
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Input_node_data_slice> {
+  public:
+    void tests();
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  // The write functions append to batch_, flush() sends it to the
+  // correlator node once per input block
+  void write_invalid(int nInvalid);
+  void write_delay(int8_t delay);
+  void write_data(const Input_buffer_element &block, int ndata, int byte_offset);
+  void write_end_of_stream();
+  void flush();
+  int64_t write_initial_invalid_data(int64_t byte_offset);
+  int get_next_delay_pos(Time start_time);
+  // Release the block in front and let the channel know there is space
+  void pop_block();
 
+  Data_writer_sptr writer_;
+  Time             slice_start_;
+  Time             slice_stop_;
+  int64_t          slice_size_;
+  Notifier        *channel_notifier_;
+  Block_queue      blocks_;
+  Data_writer_batch batch_;
+
+  // Set by open()
+  Delay_table_ptr  delays_;
+  Time             current_time_;
+  Time             end_time_;
+  Time             byte_length_;
+  Time             first_needed_, last_needed_;
+  int              bits_per_sample_;
+  bool             last_in_interval_;
+
+  // Sender state
+  bool             active_;
+  bool             sync_stream_;
+  int              delay_index_;
+  bool             finished_;
+};
+
+/*******************************************************************************
+ * @class Input_node_data_sender
+ * @desc  Sends the slices of all channels that are destined for one
+ * correlator node, in the order in which they were assigned. Every correlator
+ * node has its own sender thread, such that a slow node does not hold up the
+ * others.
+ ******************************************************************************/
+class Input_node_data_sender : public Thread {
+public:
+  Input_node_data_sender(Data_writer_sptr writer);
+  virtual ~Input_node_data_sender();
+
+  void do_execute();
+
+  /// Queue a slice, called before the channel opens it
+  void add_slice(Input_node_data_slice_sptr slice);
+
+  const char *name() {
+    return __PRETTY_FUNCTION__;
+  }
+  /// Write state for debug purposes
+  void get_state(std::ostream &out);
+private:
+  Data_writer_sptr writer_;
+  Threadsafe_queue<Input_node_data_slice_sptr> slices_;
+  Notifier notifier_;
+  uint64_t total_data_written_;
+};
+
+/*******************************************************************************
+ * @class Input_node_data_writer
+ * @desc  Distributes the input blocks of one channel over its time slices.
+ * The slices are opened as soon as they are assigned, so that consecutive
+ * slices are streamed to their correlator nodes concurrently. Blocks that an
+ * unopened slice may need are kept in a history, the rest of the input is
+ * released as soon as the open slices are done with it.
+ ******************************************************************************/
 class Input_node_data_writer : public Thread 
 {
 public:
@@ -34,18 +203,6 @@ public:
   typedef Input_node_types::Channel_buffer_element  Input_buffer_element;
   typedef shared_ptr<Input_buffer>                  Input_buffer_ptr;
 
-  // The writer can, in principle, occur multiple times in the writer_queue
-  // so we store the slice size in a separate integer and set
-  // set_size_dataslice(slice_size) when we start writing
-  struct Writer_struct {
-    Writer_struct():active(false) {}
-    Data_writer_sptr writer;
-    Time	    slice_start;
-    Time	    slice_stop;
-    int64_t         slice_size;
-    bool            active;
-  };
-  typedef Threadsafe_queue< Writer_struct >      Data_writer_queue;
   Input_node_data_writer();
   virtual ~Input_node_data_writer();
 
@@ -54,11 +211,13 @@ public:
   /// Set the input
   void connect_to(Input_buffer_ptr new_input_buffer);
 
-  void add_timeslice(Data_writer_sptr data_writer, Time slice_start,
+  /// Queue a time slice of this channel on the sender of the data writer
+  void add_timeslice(Input_node_data_sender_sptr sender,
+                     Data_writer_sptr data_writer, Time slice_start,
 		     Time slice_stop, int64_t slice_samples);
 
-	/// return the amount of data sent...
-  uint64_t do_task();
+  /// Take the block in front of the input and hand it to the slices
+  void do_task();
 
 
   /// The queue storing all the intervals
@@ -88,17 +247,32 @@ public:
   /// Write state for debug purposes
   void get_state(std::ostream &out);
 private:
+  /// Open the next assigned slice, returns false if there is none or its
+  /// delays did not arrive yet
+  bool open_next_slice();
+  /// Remove the slices that are completely sent
+  bool retire_slices();
+  /// Whether a slice that is not opened yet may need the block
+  bool needed_later(const Input_buffer_element &block);
+  void trim_history();
+  Time block_length(const Input_buffer_element &block) {
+    return byte_length * (double)block.channel_data.data().size();
+  }
+
   Input_buffer_ptr    input_buffer_;
-  Data_writer_queue   data_writers_;
-  int                 delay_index;
-  int                 input_index;
+  /// Notified when the input, the slices, the intervals or the delays
+  /// change, do_execute() sleeps on it when there is no work
+  Notifier            notifier_;
+  /// Slices that are assigned but not opened yet
+  Threadsafe_queue<Input_node_data_slice_sptr> pending_slices_;
+  /// The opened slices, in time order
+  std::deque<Input_node_data_slice_sptr> slices_;
+  /// The last input blocks, for slices that are not opened yet
+  std::deque<Input_buffer_element> history_;
 
   uint64_t sample_rate;
   int bits_per_sample;
-  Time channel_offset;
   Time overlap_time;
-  int frames_to_buffer;
-  bool sync_stream;
   int stream_nr;
   uint8_t station_number;
   uint8_t frequency_number;
@@ -108,42 +282,27 @@ private:
 
   /// The queue storing all the delays
   Threadsafe_queue<Delay_memory_pool_element> delays_;
-  std::vector<Delay> cur_delay;
-
-  int get_next_delay_pos(Time start_time);
-
-  void write_invalid(Data_writer_sptr writer, int nInvalid);
-  void write_delay(Data_writer_sptr writer, int8_t delay);
-  void write_data(Data_writer_sptr writer, int ndata, int byte_offset);
-  void write_invalid_blocks(Data_writer_sptr writer, int byte_offset, int n_bytes, 
-                            int invalid_samples_per_block, int block_size);
-  void write_end_of_stream(Data_writer_sptr writer);
-
-  int64_t write_initial_invalid_data(Writer_struct &data_writer, int64_t byte_offset);
-  uint64_t total_data_written_;
-  int block_size;
-
-  uint64_t data_written_in_slice_;
-  uint64_t size_of_slice_;
+  Delay_table_ptr cur_delay;
+  /// The smallest delay in cur_delay, in bytes
+  int32_t min_delay_bytes_;
 
   /// The currently processed interval
   Time_interval current_interval_;
 
+  /// The start of the next slice
   Time _current_time;
   Time byte_length;
 
-  double last_duration_;
-  RTTimer timer_waiting_;
-  RTTimer timer_other_;
-  RTTimer timer_writing_;
   int interval;
 
-  void do_phasecal(void);
+  void do_phasecal(Input_buffer_element &input_element);
   void write_phasecal(Time);
   std::vector<int32_t> phasecal;
   Time phasecal_time;
   size_t phasecal_count;
   Time phasecal_integration_time;
+  /// The ends of the intervals for which the phasecal still has to be sent
+  std::deque<Time> phasecal_flush_times_;
 };
 
 inline Time
@@ -11,6 +11,8 @@
 #ifndef INPUT_NODE_DATA_WRITER_TASKLET_H_INCLUDED
 #define INPUT_NODE_DATA_WRITER_TASKLET_H_INCLUDED
 
+#include <map>
+
 #include "utils.h"
 #include "timer.h"
 #include "input_node_types.h"
@@ -22,10 +24,11 @@
  * @class Input_node_data_writer
  * @desc  Get from a list of input queues the data to stream to the different
  *        correlation cores.
- * This class is far from perfect but as transitional step is it rather usefull
- * The data writing is then threaded. An improved version should probably
- * maintain a dependency tracker and use multiple thread to stream to different
- * location in parallel.
+ * Every channel has a thread that hands its input blocks to the time slices
+ * of the channel, every correlator node has a thread that sends the slices
+ * assigned to it. Hence the consecutive slices of a channel are streamed to
+ * their correlator nodes in parallel, and a slow correlator node only holds
+ * up the channels that feed it once their queues for it are full.
  ******************************************************************************/
 class Input_node_data_writer_tasklet {
 public:
@@ -68,6 +71,8 @@ public:
 
   /*****************************************************************************
   * @desc Add a pair of (data_writer, size_slice) to a given channel-queue.
+  * The slice is sent by the sender thread of the writer, which is started
+  * the first time the writer is used.
   * @param int nr_stream The identifier of the stream.
   * @param Data_writer_sptr wr The writer on which to stream the data
   * @param int64_t size the amount of samples to send to the given writer
@@ -116,6 +121,8 @@ public:
 private:
   /// Writers that will stream the data.
   std::vector<Input_node_data_writer_sptr>    data_writers_;
+  /// The senders, one for every correlator node connection
+  std::map<Data_writer *, Input_node_data_sender_sptr> senders_;
   ThreadPool data_writer_thread_pool;
 
   /// Amount of processing time.
@@ -21,6 +21,7 @@ using std::tr1::shared_ptr;
 #endif
 
 #include <threadsafe_queue.h>
+#include <spsc_queue.h>
 #include "memory_pool.h"
 #include "correlator_time.h"
 
@@ -71,7 +72,37 @@ public:
   struct Memory_pool_data {
     typedef unsigned char      value_type;
 
+    Memory_pool_data() : view(NULL), view_size(0) {}
+
     std::vector<value_type> data;
+    // If view is set the block consists of view_size bytes owned by the
+    // data reader (e.g. a memory mapped file) instead of data, region
+    // keeps them valid. Views are read-only.
+    const value_type *view;
+    size_t view_size;
+    shared_ptr<void> region;
+
+    size_t size() const { return (view != NULL) ? view_size : data.size(); }
+    const value_type *begin() const { return (view != NULL) ? view : &data[0]; }
+
+    void set_view(const value_type *begin, size_t size,
+                  const shared_ptr<void> &owner) {
+      view = begin;
+      view_size = size;
+      region = owner;
+    }
+    void clear_view() {
+      view = NULL;
+      view_size = 0;
+      region.reset();
+    }
+    /// Copy the view into data, such that the block can be modified
+    void copy_view() {
+      if (view == NULL)
+        return;
+      data.assign(view, view + view_size);
+      clear_view();
+    }
   };
   typedef Memory_pool< Memory_pool_data > Data_memory_pool;
   typedef Data_memory_pool::Element       Data_memory_pool_element;
@@ -88,7 +119,7 @@ public:
   // Memory pool for Mark5 frames
   struct Input_data_frame {
     Input_data_frame()
-      : channel(-1), mask(-1) {}
+      : channel(-1), mask(-1), all_invalid(false) {}
      Data_memory_pool_element  buffer;
 
     // List of blocks to be flagged as invalid
@@ -100,8 +131,26 @@ public:
     // Track mask (flags dead tracks)
     uint64_t mask;
     int seqno;
+    // The whole frame is invalid (e.g. missing data), the contents of
+    // buffer are not used
+    bool all_invalid;
+
+    /// Flag the whole frame as invalid. The buffer keeps the nominal size
+    /// of a frame, the channel extractors and the data writer derive the
+    /// number of samples from it, but it is not filled.
+    void invalidate(size_t size) {
+      if (buffer->size() != size) {
+        buffer->clear_view();
+        buffer->data.resize(size);
+      }
+      all_invalid = true;
+      invalid.resize(1);
+      invalid[0].invalid_begin = 0;
+      invalid[0].nr_invalid = size;
+    }
   };
-  /// Buffer for mark5 data frames
+  /// Buffer for mark5 data frames, the channel extractor threads all
+  /// consume from it so it can not be a Spsc_queue
   typedef Threadsafe_queue<Input_data_frame>        Input_buffer;
   typedef shared_ptr<Input_buffer>                  Input_buffer_ptr;
 
@@ -118,7 +167,7 @@ public:
     bool processed;
   };
   typedef Channel_buffer_element_                  Channel_buffer_element;
-  typedef Threadsafe_queue<Channel_buffer_element> Channel_buffer;
+  typedef Spsc_queue<Channel_buffer_element>       Channel_buffer;
   typedef shared_ptr<Channel_buffer>               Channel_buffer_ptr;
 
   Input_node_types() {}
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "align_malloc.h"
+#include "memory_placement.h"
 
 
 /// Use this class if you want to allocate large number of element
@@ -29,39 +30,54 @@ public:
   Memory_pool_vector_element() {
     size_ = 0;
     buffer_ = NULL;
+    placed_ = false;
+    bound_node_ = NUMA_NODE_ANY;
   }
 
   ~Memory_pool_vector_element() {
     // DEBUG_MSG("Deleting array element of size " << size());
-    if (buffer_ != NULL) {
-      aligned_free(buffer_);
-    }
+    free_buffer(buffer_);
   }
 
-  Memory_pool_vector_element(const Memory_pool_vector_element<T> &other):buffer_(NULL), size_(0){
+  Memory_pool_vector_element(const Memory_pool_vector_element<T> &other)
+    : buffer_(NULL), size_(0), placed_(false), bound_node_(NUMA_NODE_ANY) {
     if(other.size_ != 0){
       resize(other.size_);
       memcpy(buffer_, other.buffer_, sizeof(T)*size_);
     }
   }
 
+  /// Allocate the buffer according to placement from now on, the
+  /// placement is typically shared by all elements of a memory pool
+  void set_placement(const Memory_placement_ptr &placement) {
+    placement_ = placement;
+  }
+
   void resize(size_t size) {
     if ( size != size_ ) {
       if ( buffer_ == NULL ) {
         // aligned_malloc insure that the allocated data
         // is nicely aligned.
-        buffer_ = static_cast<T*>( aligned_malloc( sizeof(T)*size ) );
+        buffer_ = allocate_buffer(size);
         size_ = size;
       } else {
         T* oldbuffer = buffer_;
-        buffer_ = static_cast<T*>( aligned_malloc( sizeof(T)*size ) );
+        bool old_placed = placed_;
+        buffer_ = allocate_buffer(size);
         size_t min_size = std::min(size_,size);
         size_ = size;
 
         memcpy(buffer_, oldbuffer, sizeof(T)*min_size);
 
-        aligned_free(oldbuffer);
+        if (old_placed)
+          placed_free(oldbuffer);
+        else
+          aligned_free(oldbuffer);
       }
+    } else if ( placed_ && (placement_->numa_node != bound_node_) ) {
+      // The NUMA node was set after the buffer was allocated
+      bound_node_ = placement_->numa_node;
+      placed_rebind(buffer_, bound_node_);
     }
   }
 
@@ -82,11 +98,42 @@ public:
     return buffer_;
   }
 private:
+  T* allocate_buffer(size_t size) {
+    if ( (placement_ == Memory_placement_ptr()) ||
+         ((placement_->pages == PAGES_DEFAULT) &&
+          (placement_->numa_node == NUMA_NODE_ANY)) ) {
+      placed_ = false;
+      return static_cast<T*>( aligned_malloc( sizeof(T)*size ) );
+    }
+    bound_node_ = placement_->numa_node;
+    T* buffer = static_cast<T*>( placed_malloc( sizeof(T)*size, *placement_ ) );
+    if (buffer == NULL) {
+      // Could not map the memory, use the ordinary allocation
+      placed_ = false;
+      return static_cast<T*>( aligned_malloc( sizeof(T)*size ) );
+    }
+    placed_ = true;
+    return buffer;
+  }
+
+  void free_buffer(T* buffer) {
+    if (buffer == NULL)
+      return;
+    if (placed_)
+      placed_free(buffer);
+    else
+      aligned_free(buffer);
+  }
 
   // We cannot use a std::vector because we cannot control that
   // the data are properly aligned to be used with fftw_xx or SSE
   T* buffer_;
   size_t size_;
+  // Where the buffer is allocated, NULL for aligned_malloc
+  Memory_placement_ptr placement_;
+  // Whether buffer_ comes from placed_malloc and the node it is bound to
+  bool placed_;
+  int bound_node_;
 };
 
 /// Use this class if you want to allocate large number of element
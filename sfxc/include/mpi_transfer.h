@@ -79,6 +79,14 @@ public:
 				  std::vector<uint64_t>& params,
 				  std::string& hostname,
 				  const int srcrank);
+
+  /// Pass the name of a Shared_memory_ring to a node on the same host
+  static void send_connect_shm_msg(const uint32_t info[4],
+				   const std::string& name,
+				   const int dstrank, const int tag);
+  static void recv_connect_shm_msg(uint32_t info[4],
+				   std::string& name,
+				   const int srcrank, const int tag);
 };
 
 #endif /*MPI_TRANSFER_H_*/
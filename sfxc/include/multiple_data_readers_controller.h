@@ -15,6 +15,7 @@
 #include "data_writer.h"
 #include "data_reader2buffer.h"
 #include "data_reader_buffer.h"
+#include "shared_memory_ring.h"
 
 #include "memory_pool.h"
 #include "memory_pool_elements.h"
@@ -67,6 +68,10 @@ public:
 private:
   void add_data_reader(unsigned int i, shared_ptr<Data_reader> reader);
 
+  /** Connect to the data writer of info through a Shared_memory_ring,
+   *  returns false if the writer should connect with tcp instead. **/
+  bool connect_shared_memory(const uint32_t info[4]);
+
   // These are pointers, because a resize of the vector will
   // copy construct all the elements and then destroy the old
   // elements and we can't copy construct the extra threads.
@@ -14,6 +14,7 @@
 #include "tcp_connection.h"
 #include "data_writer.h"
 #include "buffer2data_writer.h"
+#include "shared_memory_ring.h"
 
 #include "memory_pool.h"
 #include "memory_pool_elements.h"
@@ -41,6 +42,10 @@ public:
 private:
   void add_data_writer(unsigned int i, Data_writer_ptr writer);
 
+  /** Connect to the data reader of info through a Shared_memory_ring,
+   *  returns false if the reader should connect with tcp instead. **/
+  bool connect_shared_memory(const uint32_t info[4]);
+
   std::vector<Data_writer_ptr> data_writers;
 
   TCP_Connection tcp_connection;
@@ -66,6 +66,18 @@ public:
    **/
   MESSAGE_RESULT check_and_process_message();
 
+  /** Non-blocking check for a message and process it, sleeps if there was
+   * none. The sleep doubles from MIN_POLL_INTERVAL up to MAX_POLL_INTERVAL
+   * [usec] while the node stays idle and is reset by the next message, such
+   * that bursts of messages are handled without delay. A blocking MPI_Probe
+   * would busy wait in most MPI implementations.
+   **/
+  void poll_messages();
+
+  static const int MIN_POLL_INTERVAL = 10;
+  /// Upper bound on the latency of a message for a polling node
+  static const int MAX_POLL_INTERVAL = 100;
+
   /**
      Produce an error message (either to std::cerr or to a specialised "Log-node")
    **/
@@ -116,6 +128,8 @@ private:
 
   bool assertion_raised;
   STATE state_;
+  // Current sleep of poll_messages() in usec
+  int poll_interval;
 };
 
 #endif // NODE_H
@@ -16,6 +16,7 @@
 #include "output_header.h"
 
 #include <memory_pool.h>
+#include <notifier.h>
 
 #include <fstream>
 #include <map>
@@ -181,6 +182,9 @@ private:
   Input_stream_order_map           input_streams_order;
   // One input stream for every correlate node
   std::vector<Input_stream *>         input_streams;
+  // Notified when data from a correlator node arrives in the buffers of
+  // the input streams
+  Notifier                            input_notifier;
 
   int32_t curr_slice, number_of_time_slices, curr_stream, curr_slice_size;
   int32_t curr_band;
@@ -1,6 +1,7 @@
 #ifndef SFXC_FFT_H
 #define SFXC_FFT_H
 #include <complex>
+#include <string>
 #include "config.h"
 
 // The sfxc fft wrapper class
@@ -14,6 +15,12 @@ public:
   virtual void ifft(const std::complex<float_type> *in, std::complex<float_type> *out) = 0;
   virtual void rfft(const float_type *in, std::complex<float_type> *out) = 0;
   virtual void irfft(const std::complex<float_type> *in, float_type *out) = 0;
+  // Perform howmany transforms with a single call; transform i reads from
+  // in + i * idist and writes to out + i * odist
+  virtual void rfft_many(const float_type *in, std::complex<float_type> *out,
+                         int howmany, int idist, int odist) = 0;
+  virtual void ifft_many(const std::complex<float_type> *in, std::complex<float_type> *out,
+                         int howmany, int idist, int odist) = 0;
 public:
   int size;
 };
@@ -30,6 +37,13 @@ public:
   void ifft(const std::complex<double> *in, std::complex<double> *out);
   void rfft(const double *in, std::complex<double> *out);
   void irfft(const std::complex<double> *in, double *out);
+  void rfft_many(const double *in, std::complex<double> *out, int howmany, int idist, int odist);
+  void ifft_many(const std::complex<double> *in, std::complex<double> *out, int howmany, int idist, int odist);
+
+  // IPP has no planning, these exist for compatibility with the FFTW version
+  static void set_planning_rigor(int rigor) {}
+  static bool import_wisdom(const std::string &filename) { return true; }
+  static bool export_wisdom(const std::string &filename) { return true; }
 private:
   void alloc();
   void alloc_r2c();
@@ -53,10 +67,22 @@ public:
   void ifft(const std::complex<double> *in, std::complex<double> *out);
   void rfft(const double *in, std::complex<double> *out);
   void irfft(const std::complex<double> *in, double *out);
+  void rfft_many(const double *in, std::complex<double> *out, int howmany, int idist, int odist);
+  void ifft_many(const std::complex<double> *in, std::complex<double> *out, int howmany, int idist, int odist);
+
+  // Planning rigor (SFXC_FFT_ESTIMATE, SFXC_FFT_MEASURE or SFXC_FFT_PATIENT)
+  // used for plans that are not yet in the plan cache
+  static void set_planning_rigor(int rigor);
+  // Load FFTW wisdom, returns false if the file could not be read
+  static bool import_wisdom(const std::string &filename);
+  // Merge the wisdom gathered by this process into the wisdom file. The file
+  // is replaced atomically, such that it can be shared between processes.
+  static bool export_wisdom(const std::string &filename);
 private:
   void free_buffers(); 
   fftw_plan alloc(int sign, bool inplace);
   fftw_plan alloc_r2c(int sign);
+  fftw_plan alloc_many(int type, int howmany, int idist, int odist);
 public:
   int size;
 private:
@@ -66,6 +92,18 @@ private:
   bool plan_forward_I_set, plan_backward_I_set;
   fftw_plan  plan_forward_r2c, plan_backward_r2c;
   bool plan_forward_r2c_set, plan_backward_r2c_set;
+  // The batched plans that were used last
+  struct Batched_plan {
+    Batched_plan() : set(false) {}
+    bool matches(int howmany_, int idist_, int odist_, bool inplace_) const {
+      return set && (howmany == howmany_) && (idist == idist_) &&
+             (odist == odist_) && (inplace == inplace_);
+    }
+    fftw_plan plan;
+    bool set, inplace;
+    int howmany, idist, odist;
+  };
+  Batched_plan plan_forward_r2c_many, plan_backward_many;
 };
 #endif // USE_IPP
 #endif // SFXC_FFT_H
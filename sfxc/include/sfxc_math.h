@@ -96,8 +96,68 @@
   extern inline void sfxc_add_product_c(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len){
     ippsAddProduct_64fc((const Ipp64fc*) s1, (const Ipp64fc*) s2, (Ipp64fc*) dest, len);
   }
+
+  // Phase rotation, see sfxc_math_rotate.h. IPP has no equivalent, the
+  // portable implementation in sfxc_math.cc is used.
+  void sfxc_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale);
+  void sfxc_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale);
+  void sfxc_add_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale);
+  void sfxc_add_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale);
+  void sfxc_rotate_real_c(const std::complex<double> *src, double *dest, int len, double phi, double delta, double scale);
+  void sfxc_rotate_real_fc(const std::complex<float> *src, float *dest, int len, double phi, double delta, double scale);
 #else // USE FFTW
   #include <string.h>
+
+  // Without IPP the vector functions are implemented in sfxc_math.cc. At
+  // startup the fastest implementation supported by the CPU is selected
+  // (scalar, SSE4, AVX2 or AVX-512), it can be overridden by setting the
+  // environment variable SFXC_MATH_ISA to "scalar", "sse4", "avx2" or
+  // "avx512".
+  enum Sfxc_math_isa {
+    SFXC_MATH_SCALAR = 0,
+    SFXC_MATH_SSE4,
+    SFXC_MATH_AVX2,
+    SFXC_MATH_AVX512,
+    SFXC_MATH_N_ISA
+  };
+
+  struct Sfxc_math_kernels {
+    void (*mul)(const double *s1, const double *s2, double *dest, int len);
+    void (*mul_f)(const float *s1, const float *s2, float *dest, int len);
+    void (*mul_c)(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len);
+    void (*mul_fc)(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len);
+    void (*mul_c_I)(const std::complex<double> *s1, std::complex<double> *s2dest, int len);
+    void (*mul_fc_I)(const std::complex<float> *s1, std::complex<float> *s2dest, int len);
+    void (*mul_f_c_I)(const double *s1, std::complex<double> *s2dest, int len);
+    void (*mul_f_fc_I)(const float *s1, std::complex<float> *s2dest, int len);
+    void (*conj_c)(const std::complex<double> *s1, std::complex<double> *dest, int len);
+    void (*conj_fc)(const std::complex<float> *s1, std::complex<float> *dest, int len);
+    void (*add)(const double *src1, const double *src2, double *dest, int len);
+    void (*add_f)(const float *src1, const float *src2, float *dest, int len);
+    void (*add_I)(const double *src1, double *srcdest, int len);
+    void (*add_f_I)(const float *src1, float *srcdest, int len);
+    void (*add_product_c)(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len);
+    void (*add_product_fc)(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len);
+    void (*rotate_c)(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale);
+    void (*rotate_fc)(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale);
+    void (*add_rotate_c)(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale);
+    void (*add_rotate_fc)(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale);
+    void (*rotate_real_c)(const std::complex<double> *src, double *dest, int len, double phi, double delta, double scale);
+    void (*rotate_real_fc)(const std::complex<float> *src, float *dest, int len, double phi, double delta, double scale);
+  };
+
+  // The kernels currently in use
+  extern Sfxc_math_kernels sfxc_math_kernels;
+
+  // Returns the best instruction set supported by the CPU
+  Sfxc_math_isa sfxc_math_best_isa();
+  // Select the kernels for the given instruction set, returns false if it
+  // is not supported by the CPU (the selection is then left unchanged).
+  // Must not be called while other threads use the kernels.
+  bool sfxc_math_select(Sfxc_math_isa isa);
+  Sfxc_math_isa sfxc_math_current_isa();
+  const char *sfxc_math_isa_name(Sfxc_math_isa isa);
+
   extern inline void sfxc_zero(double *p, size_t len){
     memset(p, 0, len * sizeof(double));
   }
@@ -115,109 +175,103 @@
   }
 
   extern inline void sfxc_mul_c(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = s1[i] * s2[i];
-    }
+    sfxc_math_kernels.mul_c(s1, s2, dest, len);
   }
 
-   extern inline void sfxc_mul_fc(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = s1[i] * s2[i];
-    }
+  extern inline void sfxc_mul_fc(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len){
+    sfxc_math_kernels.mul_fc(s1, s2, dest, len);
   }
 
   extern inline void sfxc_mul(const double *s1, const double *s2, double *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = s1[i] * s2[i];
-    }
+    sfxc_math_kernels.mul(s1, s2, dest, len);
   }
 
-   extern inline void sfxc_mul_f(const float *s1, const float *s2, float *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = s1[i] * s2[i];
-    }
+  extern inline void sfxc_mul_f(const float *s1, const float *s2, float *dest, int len){
+    sfxc_math_kernels.mul_f(s1, s2, dest, len);
   }
 
   extern inline void sfxc_mul_c_I(const std::complex<double> *s1, std::complex<double>  *s2dest, int len){
-    for(int i = 0; i < len; i++){
-      s2dest[i] = s1[i] * s2dest[i];
-    }
-   }
+    sfxc_math_kernels.mul_c_I(s1, s2dest, len);
+  }
 
   extern inline void sfxc_mul_fc_I(const std::complex<float> *s1, std::complex<float> *s2dest, int len){
-    for(int i = 0; i < len; i++){
-      s2dest[i] = s1[i] * s2dest[i];
-    }
-  } 
+    sfxc_math_kernels.mul_fc_I(s1, s2dest, len);
+  }
 
   extern inline void sfxc_mul_f_c_I(const double *s1, std::complex<double>  *s2dest, int len){
-    for(int i = 0; i < len; i++){
-      s2dest[i] = s1[i] * s2dest[i];
-    }
-  } 
+    sfxc_math_kernels.mul_f_c_I(s1, s2dest, len);
+  }
 
   extern inline void sfxc_mul_f_fc_I(const float *s1, std::complex<float> *s2dest, int len){
-    for(int i = 0; i < len; i++){
-      s2dest[i] = s1[i] * s2dest[i];
-    }
-  } 
+    sfxc_math_kernels.mul_f_fc_I(s1, s2dest, len);
+  }
 
   extern inline void sfxc_conj_fc(const std::complex<float> *s1, std::complex<float> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = conj(s1[i]);
-    }
+    sfxc_math_kernels.conj_fc(s1, dest, len);
   }
+
   extern inline void sfxc_conj_c(const std::complex<double> *s1, std::complex<double> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = conj(s1[i]);
-    }
+    sfxc_math_kernels.conj_c(s1, dest, len);
   }
 
   extern inline void sfxc_add_f(const float *src1, const float *src2, float *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = src1[i] + src2[i];
-    }
+    sfxc_math_kernels.add_f(src1, src2, dest, len);
   }
 
   extern inline void sfxc_add_f_I(const float *src1, float *srcdest, int len){
-    for(int i = 0; i < len; i++){
-      srcdest[i] += src1[i];
-    }
+    sfxc_math_kernels.add_f_I(src1, srcdest, len);
   }
 
   extern inline void sfxc_add(const double *src1, const double *src2, double *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] = src1[i] + src2[i];
-    }
+    sfxc_math_kernels.add(src1, src2, dest, len);
   }
 
   extern inline void sfxc_add_I(const double *src1, double *srcdest, int len){
-    for(int i = 0; i < len; i++){
-      srcdest[i] += src1[i];
-    }
+    sfxc_math_kernels.add_I(src1, srcdest, len);
   }
 
   extern inline void sfxc_add_fc_I(const std::complex<float> *src, std::complex<float> *srcdest, int len){
-    for(int i = 0; i < len; i++){
-      srcdest[i] += src[i];
-    }
+    sfxc_math_kernels.add_f_I((const float *) src, (float *) srcdest, 2 * len);
   }
 
   extern inline void sfxc_add_c_I(const std::complex<double> *src, std::complex<double> *srcdest, int len){
-    for(int i = 0; i < len; i++){
-      srcdest[i] += src[i];
-    }
+    sfxc_math_kernels.add_I((const double *) src, (double *) srcdest, 2 * len);
   }
 
   extern inline void sfxc_add_product_fc(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] += s1[i] * s2[i];
-    }
+    sfxc_math_kernels.add_product_fc(s1, s2, dest, len);
   }
+
   extern inline void sfxc_add_product_c(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len){
-    for(int i = 0; i < len; i++){
-      dest[i] += s1[i] * s2[i];
-    }
+    sfxc_math_kernels.add_product_c(s1, s2, dest, len);
+  }
+
+  // Phase rotation: element i of src is multiplied by
+  // scale * exp(j * (phi + i * delta)), see sfxc_math_rotate.h
+  extern inline void sfxc_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.rotate_c(src, dest, len, phi, delta, scale);
+  }
+
+  extern inline void sfxc_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.rotate_fc(src, dest, len, phi, delta, scale);
+  }
+
+  // The rotated src is added to dest
+  extern inline void sfxc_add_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.add_rotate_c(src, dest, len, phi, delta, scale);
+  }
+
+  extern inline void sfxc_add_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.add_rotate_fc(src, dest, len, phi, delta, scale);
+  }
+
+  // Only the real part of the rotated src is stored
+  extern inline void sfxc_rotate_real_c(const std::complex<double> *src, double *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.rotate_real_c(src, dest, len, phi, delta, scale);
+  }
+
+  extern inline void sfxc_rotate_real_fc(const std::complex<float> *src, float *dest, int len, double phi, double delta, double scale){
+    sfxc_math_kernels.rotate_real_fc(src, dest, len, phi, delta, scale);
   }
 #endif
 #endif // SFXC_MATH_H
@@ -0,0 +1,125 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the phase rotator used by the fringe stopping, the fractional bit
+ *     shift and the uv shift
+ *
+ * The rotator multiplies element i of a complex vector with
+ *   scale * exp(j * (phi + i * delta)).
+ * Instead of a single sin/cos recurrence, whose dependency chain stalls
+ * the FPU, two registers of independent phasors are advanced per step
+ * (4 phasors for SSE4 up to 16 for AVX-512 in single precision). The
+ * phasors are recomputed exactly every SFXC_ROTATE_ANCHOR elements, which
+ * bounds the error of the recurrence.
+ *
+ * The kernels use the same traits class V as sfxc_math_simd.h, this
+ * file is included there and by sfxc_math.cc with Scalar_traits below.
+ */
+#ifndef SFXC_MATH_ROTATE_H
+#define SFXC_MATH_ROTATE_H
+
+// Included inside a namespace by the SIMD implementations, the standard
+// headers come from sfxc_math.h
+#include "sfxc_math.h"
+
+#define SFXC_ROTATE_ANCHOR 512
+
+enum Sfxc_rotate_mode {
+  SFXC_ROTATE,       // dest[i] = src[i] * rotation
+  SFXC_ADD_ROTATE,   // dest[i] += src[i] * rotation
+  SFXC_ROTATE_REAL   // dest[i] = real(src[i] * rotation), dest is real
+};
+
+// One complex number per register, for the scalar kernels
+template<class T>
+struct Scalar_traits {
+  struct reg { T re, im; };
+  static const int width = 2;
+
+  static reg load(const T *p) { reg r = {p[0], p[1]}; return r; }
+  static void store(T *p, reg a) { p[0] = a.re; p[1] = a.im; }
+  static reg add(reg a, reg b) { reg r = {a.re + b.re, a.im + b.im}; return r; }
+  static reg cmul(reg a, reg b) {
+    reg r = {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+    return r;
+  }
+};
+
+template<int MODE, class T>
+inline void rotate_store(T *dest, int i, T re, T im) {
+  if (MODE == SFXC_ROTATE) {
+    dest[2 * i] = re;
+    dest[2 * i + 1] = im;
+  } else if (MODE == SFXC_ADD_ROTATE) {
+    dest[2 * i] += re;
+    dest[2 * i + 1] += im;
+  } else {
+    dest[i] = re;
+  }
+}
+
+// src and dest point to interleaved complex numbers (dest to reals for
+// SFXC_ROTATE_REAL), src and dest may be the same array
+template<class V, int MODE, class T>
+void simd_rotate(const T *src, T *dest, int len,
+                 double phi, double delta, double scale) {
+  const int per_reg = V::width / 2;   // complex numbers per register
+  const int n_lanes = 2 * per_reg;    // phasors advanced per step
+
+  // Phase offsets of the lanes and the step of all lanes
+  std::complex<double> offset[n_lanes];
+  const std::complex<double> rot(cos(delta), sin(delta));
+  offset[0] = scale;
+  for (int j = 1; j < n_lanes; j++)
+    offset[j] = offset[j - 1] * rot;
+  T buf[2 * V::width];
+  for (int j = 0; j < per_reg; j++) {
+    buf[2 * j] = cos(n_lanes * delta);
+    buf[2 * j + 1] = sin(n_lanes * delta);
+  }
+  const typename V::reg step = V::load(buf);
+
+  int i = 0;
+  const int n_vector = len - len % n_lanes;
+  while (i < n_vector) {
+    // Exact phasors at the start of each block
+    const double phase = phi + i * delta;
+    const std::complex<double> anchor(cos(phase), sin(phase));
+    for (int j = 0; j < n_lanes; j++) {
+      std::complex<double> p = anchor * offset[j];
+      buf[2 * j] = p.real();
+      buf[2 * j + 1] = p.imag();
+    }
+    typename V::reg p0 = V::load(buf), p1 = V::load(buf + V::width);
+
+    const int end = (i + SFXC_ROTATE_ANCHOR < n_vector ? i + SFXC_ROTATE_ANCHOR : n_vector);
+    for (; i < end; i += n_lanes) {
+      typename V::reg r0 = V::cmul(V::load(src + 2 * i), p0);
+      typename V::reg r1 = V::cmul(V::load(src + 2 * i + V::width), p1);
+      p0 = V::cmul(p0, step);
+      p1 = V::cmul(p1, step);
+      if (MODE == SFXC_ROTATE) {
+        V::store(dest + 2 * i, r0);
+        V::store(dest + 2 * i + V::width, r1);
+      } else if (MODE == SFXC_ADD_ROTATE) {
+        V::store(dest + 2 * i, V::add(V::load(dest + 2 * i), r0));
+        V::store(dest + 2 * i + V::width,
+                 V::add(V::load(dest + 2 * i + V::width), r1));
+      } else {
+        V::store(buf, r0);
+        V::store(buf + V::width, r1);
+        for (int j = 0; j < n_lanes; j++)
+          dest[i + j] = buf[2 * j];
+      }
+    }
+  }
+  for (; i < len; i++) {
+    const double phase = phi + i * delta;
+    const T c = scale * cos(phase), s = scale * sin(phase);
+    const T re = src[2 * i], im = src[2 * i + 1];
+    rotate_store<MODE>(dest, i, re * c - im * s, re * s + im * c);
+  }
+}
+
+#endif // SFXC_MATH_ROTATE_H
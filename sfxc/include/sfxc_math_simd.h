@@ -0,0 +1,201 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the SIMD implementation of the vector functions in sfxc_math.h
+ *
+ * This file is included by sfxc_math_sse4.cc, sfxc_math_avx2.cc and
+ * sfxc_math_avx512.cc after the target instruction set has been selected.
+ * The kernels are written in terms of a traits class V that provides, for
+ * either float or double:
+ *   - reg           the vector register type
+ *   - width         the number of reals in a register
+ *   - load, store   unaligned load and store
+ *   - add, mul      element wise operations
+ *   - cmul          multiplication of interleaved complex numbers
+ *   - conj          negation of the odd (imaginary) elements
+ *   - dup           load width/2 reals and duplicate each of them
+ * The phase rotator kernels are in sfxc_math_rotate.h.
+ * Complex numbers are processed as interleaved (real, imag) pairs.
+ */
+#ifndef SFXC_MATH_SIMD_H
+#define SFXC_MATH_SIMD_H
+
+#include "sfxc_math_rotate.h"
+
+template<class V, class T>
+void simd_mul(const T *s1, const T *s2, T *dest, int len) {
+  int i = 0;
+  for (; i + V::width <= len; i += V::width)
+    V::store(dest + i, V::mul(V::load(s1 + i), V::load(s2 + i)));
+  for (; i < len; i++)
+    dest[i] = s1[i] * s2[i];
+}
+
+template<class V, class T>
+void simd_add(const T *s1, const T *s2, T *dest, int len) {
+  int i = 0;
+  for (; i + V::width <= len; i += V::width)
+    V::store(dest + i, V::add(V::load(s1 + i), V::load(s2 + i)));
+  for (; i < len; i++)
+    dest[i] = s1[i] + s2[i];
+}
+
+template<class V, class T>
+void simd_add_I(const T *s1, T *srcdest, int len) {
+  simd_add<V>(s1, srcdest, srcdest, len);
+}
+
+template<class V, class T>
+void simd_cmul(const T *s1, const T *s2, T *dest, int len) {
+  const int n = 2 * len;
+  int i = 0;
+  for (; i + V::width <= n; i += V::width)
+    V::store(dest + i, V::cmul(V::load(s1 + i), V::load(s2 + i)));
+  for (; i < n; i += 2) {
+    T re = s1[i] * s2[i] - s1[i + 1] * s2[i + 1];
+    T im = s1[i] * s2[i + 1] + s1[i + 1] * s2[i];
+    dest[i] = re;
+    dest[i + 1] = im;
+  }
+}
+
+template<class V, class T>
+void simd_add_product(const T *s1, const T *s2, T *dest, int len) {
+  const int n = 2 * len;
+  int i = 0;
+  for (; i + V::width <= n; i += V::width)
+    V::store(dest + i, V::add(V::load(dest + i),
+                              V::cmul(V::load(s1 + i), V::load(s2 + i))));
+  for (; i < n; i += 2) {
+    dest[i] += s1[i] * s2[i] - s1[i + 1] * s2[i + 1];
+    dest[i + 1] += s1[i] * s2[i + 1] + s1[i + 1] * s2[i];
+  }
+}
+
+template<class V, class T>
+void simd_conj(const T *s1, T *dest, int len) {
+  const int n = 2 * len;
+  int i = 0;
+  for (; i + V::width <= n; i += V::width)
+    V::store(dest + i, V::conj(V::load(s1 + i)));
+  for (; i < n; i += 2) {
+    dest[i] = s1[i];
+    dest[i + 1] = -s1[i + 1];
+  }
+}
+
+// Multiply the complex array s2dest with the real array s1
+template<class V, class T>
+void simd_mul_real_I(const T *s1, T *s2dest, int len) {
+  const int n = 2 * len;
+  int i = 0;
+  for (; i + V::width <= n; i += V::width)
+    V::store(s2dest + i, V::mul(V::dup(s1 + i / 2), V::load(s2dest + i)));
+  for (; i < n; i += 2) {
+    s2dest[i] *= s1[i / 2];
+    s2dest[i + 1] *= s1[i / 2];
+  }
+}
+
+// Wrappers with the signatures of Sfxc_math_kernels
+template<class F, class D>
+class Simd_kernels {
+public:
+  typedef std::complex<float>  fc;
+  typedef std::complex<double> c;
+
+  static void mul(const double *s1, const double *s2, double *dest, int len) {
+    simd_mul<D>(s1, s2, dest, len);
+  }
+  static void mul_f(const float *s1, const float *s2, float *dest, int len) {
+    simd_mul<F>(s1, s2, dest, len);
+  }
+  static void mul_c(const c *s1, const c *s2, c *dest, int len) {
+    simd_cmul<D>((const double *)s1, (const double *)s2, (double *)dest, len);
+  }
+  static void mul_fc(const fc *s1, const fc *s2, fc *dest, int len) {
+    simd_cmul<F>((const float *)s1, (const float *)s2, (float *)dest, len);
+  }
+  static void mul_c_I(const c *s1, c *s2dest, int len) {
+    simd_cmul<D>((const double *)s1, (const double *)s2dest, (double *)s2dest, len);
+  }
+  static void mul_fc_I(const fc *s1, fc *s2dest, int len) {
+    simd_cmul<F>((const float *)s1, (const float *)s2dest, (float *)s2dest, len);
+  }
+  static void mul_f_c_I(const double *s1, c *s2dest, int len) {
+    simd_mul_real_I<D>(s1, (double *)s2dest, len);
+  }
+  static void mul_f_fc_I(const float *s1, fc *s2dest, int len) {
+    simd_mul_real_I<F>(s1, (float *)s2dest, len);
+  }
+  static void conj_c(const c *s1, c *dest, int len) {
+    simd_conj<D>((const double *)s1, (double *)dest, len);
+  }
+  static void conj_fc(const fc *s1, fc *dest, int len) {
+    simd_conj<F>((const float *)s1, (float *)dest, len);
+  }
+  static void add(const double *s1, const double *s2, double *dest, int len) {
+    simd_add<D>(s1, s2, dest, len);
+  }
+  static void add_f(const float *s1, const float *s2, float *dest, int len) {
+    simd_add<F>(s1, s2, dest, len);
+  }
+  static void add_I(const double *s1, double *srcdest, int len) {
+    simd_add_I<D>(s1, srcdest, len);
+  }
+  static void add_f_I(const float *s1, float *srcdest, int len) {
+    simd_add_I<F>(s1, srcdest, len);
+  }
+  static void add_product_c(const c *s1, const c *s2, c *dest, int len) {
+    simd_add_product<D>((const double *)s1, (const double *)s2, (double *)dest, len);
+  }
+  static void add_product_fc(const fc *s1, const fc *s2, fc *dest, int len) {
+    simd_add_product<F>((const float *)s1, (const float *)s2, (float *)dest, len);
+  }
+  static void rotate_c(const c *src, c *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<D, SFXC_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+  }
+  static void rotate_fc(const fc *src, fc *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<F, SFXC_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+  }
+  static void add_rotate_c(const c *src, c *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<D, SFXC_ADD_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+  }
+  static void add_rotate_fc(const fc *src, fc *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<F, SFXC_ADD_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+  }
+  static void rotate_real_c(const c *src, double *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<D, SFXC_ROTATE_REAL>((const double *)src, dest, len, phi, delta, scale);
+  }
+  static void rotate_real_fc(const fc *src, float *dest, int len, double phi, double delta, double scale) {
+    simd_rotate<F, SFXC_ROTATE_REAL>((const float *)src, dest, len, phi, delta, scale);
+  }
+
+  static void fill(Sfxc_math_kernels &kernels) {
+    kernels.mul = mul;
+    kernels.mul_f = mul_f;
+    kernels.mul_c = mul_c;
+    kernels.mul_fc = mul_fc;
+    kernels.mul_c_I = mul_c_I;
+    kernels.mul_fc_I = mul_fc_I;
+    kernels.mul_f_c_I = mul_f_c_I;
+    kernels.mul_f_fc_I = mul_f_fc_I;
+    kernels.conj_c = conj_c;
+    kernels.conj_fc = conj_fc;
+    kernels.add = add;
+    kernels.add_f = add_f;
+    kernels.add_I = add_I;
+    kernels.add_f_I = add_f_I;
+    kernels.add_product_c = add_product_c;
+    kernels.add_product_fc = add_product_fc;
+    kernels.rotate_c = rotate_c;
+    kernels.rotate_fc = rotate_fc;
+    kernels.add_rotate_c = add_rotate_c;
+    kernels.add_rotate_fc = add_rotate_fc;
+    kernels.rotate_real_c = rotate_real_c;
+    kernels.rotate_real_fc = rotate_real_fc;
+  }
+};
+
+#endif // SFXC_MATH_SIMD_H
@@ -186,6 +186,25 @@ enum MPI_TAG {
    **/
   MPI_TAG_ADD_TCP_READER_CONNECTED_FROM,
 
+  /** Attach a data writer to the shared memory ring of a data reader
+   * on the same host, instead of MPI_TAG_ADD_TCP_WRITER_CONNECTED_FROM.
+   * - uint32_t[4]: writer rank, writer stream, reader rank, reader stream
+   * - char[]: name of the ring
+   **/
+  MPI_TAG_ADD_SHM_WRITER_CONNECTED_FROM,
+
+  /** Attach a data reader to the shared memory ring of a data writer
+   * on the same host, instead of MPI_TAG_ADD_TCP_READER_CONNECTED_FROM.
+   * - uint32_t[4]: writer rank, writer stream, reader rank, reader stream
+   * - char[]: name of the ring
+   **/
+  MPI_TAG_ADD_SHM_READER_CONNECTED_FROM,
+
+  /** Reply to MPI_TAG_ADD_SHM_*_CONNECTED_FROM
+   * - int32_t: 1 if the ring is attached, 0 to fall back to tcp
+   **/
+  MPI_TAG_SHM_CONNECTION_ACK,
+
 
   // Node specific commands
   //-------------------------------------------------------------------------//
@@ -364,6 +383,15 @@ inline const char * const do_print_MPI_TAG(MPI_TAG tag) {
 	case MPI_TAG_ADD_TCP_READER_CONNECTED_FROM:{
 	    return "MPI_TAG_ADD_TCP_READER_CONNECTED_FROM";
 		}
+  case MPI_TAG_ADD_SHM_WRITER_CONNECTED_FROM: {
+      return "MPI_TAG_ADD_SHM_WRITER_CONNECTED_FROM";
+    }
+  case MPI_TAG_ADD_SHM_READER_CONNECTED_FROM: {
+      return "MPI_TAG_ADD_SHM_READER_CONNECTED_FROM";
+    }
+  case MPI_TAG_SHM_CONNECTION_ACK: {
+      return "MPI_TAG_SHM_CONNECTION_ACK";
+    }
 
   case MPI_TAG_ADD_DATA_WRITER_FILE2: {
       return "MPI_TAG_ADD_DATA_WRITER_FILE";
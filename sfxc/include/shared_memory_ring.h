@@ -0,0 +1,120 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - A byte ring buffer in shared memory between two processes on the
+ *     same host
+ */
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "Test_unit.h"
+
+#if __cplusplus >= 201103L
+#include <memory>
+using std::shared_ptr;
+#else
+#include <tr1/memory>
+using std::tr1::shared_ptr;
+#endif
+
+struct Shared_memory_ring_header;
+
+/*****************************************
+*
+* @class Shared_memory_ring
+* @desc A single producer, single consumer
+* byte stream between two processes on the
+* same host. The data is copied once into a
+* ring buffer in a shared mapping, instead of
+* going through the loopback TCP stack.
+*
+* One process creates the ring and passes the
+* name to the other, which opens it. After the
+* ring is opened the files are removed, the
+* mapping stays valid until both sides close
+* it. Each process only uses one side of the
+* ring: either write() or read().
+*
+* Every side has a doorbell (a fifo) to wake
+* up the other side when it waits for data or
+* for space. The data doorbell is readable as
+* long as there is data in the ring, such that
+* the reader can poll on it like on a socket.
+******************************************/
+class Shared_memory_ring {
+public:
+  typedef shared_ptr<Shared_memory_ring> Ptr;
+
+  /// Default size of the ring, similar to the socket buffers
+  static const size_t DEFAULT_SIZE = 4 * 1024 * 1024;
+
+  /// Create a new ring of at least size bytes. Returns a NULL pointer
+  /// if the shared memory could not be set up.
+  static Ptr create(size_t size = DEFAULT_SIZE);
+  /// Open the ring created by another process. Returns a NULL pointer
+  /// if the ring does not exist, e.g. the process runs on another host.
+  static Ptr open(const std::string &name);
+
+  ~Shared_memory_ring();
+
+  const std::string &name() const { return name_; }
+
+  /// Write n bytes, blocks while the ring is full. Returns less than n
+  /// bytes only if the reader closed the ring.
+  size_t write(const char *buff, size_t n);
+  /// Write the buffers of iov, the reader is woken up once at the end
+  size_t write(const struct iovec *iov, int iovcnt);
+  /// Returns true if at least one byte can be written
+  bool can_write();
+  /// The writer is done, the reader gets end of file once the ring is empty
+  void close_writer();
+
+  /// Read at most n bytes, blocks while the ring is empty. Returns 0 at
+  /// end of file. If buff is NULL the data is skipped.
+  size_t read(char *buff, size_t n);
+  /// Returns true if at least one byte can be read or at end of file
+  bool can_read();
+  bool eof();
+  void close_reader();
+
+  /// Readable if can_read() would return true
+  int get_fd() const { return data_fd_; }
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Shared_memory_ring> {
+  public:
+    void tests();
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  Shared_memory_ring();
+
+  bool map(int fd, size_t length, bool initialise);
+  size_t available();
+  size_t space();
+  bool wait_for_space();
+  // Make the written data visible to the reader
+  void publish();
+
+  std::string name_;
+  bool owner_;
+  Shared_memory_ring_header *header_;
+  char *data_;
+  size_t length_;
+  uint64_t mask_;
+  // Position of the side this process uses
+  uint64_t position_;
+  int data_fd_, space_fd_;
+};
+
+#endif // SHARED_MEMORY_RING_H
@@ -165,6 +165,9 @@ void pause_sfxc_for_gdb(void);
     #define SFXC_ADD_PRODUCT_FC     sfxc_add_product_c 
     #define SFXC_MUL_F              sfxc_mul
     #define SFXC_MUL_FC             sfxc_mul_c
+    #define SFXC_ROTATE_FC          sfxc_rotate_c
+    #define SFXC_ADD_ROTATE_FC      sfxc_add_rotate_c
+    #define SFXC_ROTATE_REAL_FC     sfxc_rotate_real_c
   #else // !USE_DOUBLE
     #define FLOAT                   float
     #define SFXC_ZERO_F             sfxc_zero_f
@@ -179,6 +182,9 @@ void pause_sfxc_for_gdb(void);
     #define SFXC_ADD_PRODUCT_FC     sfxc_add_product_fc 
     #define SFXC_MUL_F              sfxc_mul_f
     #define SFXC_MUL_FC             sfxc_mul_fc
+    #define SFXC_ROTATE_FC          sfxc_rotate_fc
+    #define SFXC_ADD_ROTATE_FC      sfxc_add_rotate_fc
+    #define SFXC_ROTATE_REAL_FC     sfxc_rotate_real_fc
   #endif
   #define SFXC_FFT_FLOAT          sfxc_fft_ipp_float
 #else
@@ -198,6 +204,9 @@ void pause_sfxc_for_gdb(void);
     #define SFXC_ADD_PRODUCT_FC     sfxc_add_product_c 
     #define SFXC_MUL_F              sfxc_mul
     #define SFXC_MUL_FC             sfxc_mul_c
+    #define SFXC_ROTATE_FC          sfxc_rotate_c
+    #define SFXC_ADD_ROTATE_FC      sfxc_add_rotate_c
+    #define SFXC_ROTATE_REAL_FC     sfxc_rotate_real_c
   #else // !USE_DOUBLE
     #define FLOAT                   float
     #define FFTW_COMPLEX            fftwf_complex
@@ -213,6 +222,9 @@ void pause_sfxc_for_gdb(void);
     #define SFXC_ADD_PRODUCT_FC     sfxc_add_product_fc 
     #define SFXC_MUL_F              sfxc_mul_f
     #define SFXC_MUL_FC             sfxc_mul_fc
+    #define SFXC_ROTATE_FC          sfxc_rotate_fc
+    #define SFXC_ADD_ROTATE_FC      sfxc_add_rotate_fc
+    #define SFXC_ROTATE_REAL_FC     sfxc_rotate_real_fc
   #endif
   #define SFXC_FFT_FLOAT          sfxc_fft_fftw_float
 #endif
@@ -227,6 +239,11 @@ void pause_sfxc_for_gdb(void);
 
 #define SFXC_NTAPS 8
 
+// FFT planning rigor
+#define SFXC_FFT_ESTIMATE      0   // Use a heuristic to select the plan
+#define SFXC_FFT_MEASURE       1   // Time a number of candidate plans
+#define SFXC_FFT_PATIENT       2   // Time a larger number of candidate plans
+
 #ifdef PRINT_PROGRESS
 inline void getusec(unsigned long long &utime) {
   struct timeval tv;
@@ -14,6 +14,8 @@
 #ifndef CONDITION_H
 #define CONDITION_H
 
+#include <errno.h>
+#include <time.h>
 #include "mutex.h"
 
 /**************************************
@@ -44,6 +46,31 @@ public:
     pthread_cond_wait( &condition_, &mutex_ );
   }
 
+  /************************************
+  * Same as wait(), but returns false if
+  * nobody signalled within msec
+  * milliseconds.
+  *************************************/
+  inline bool timed_wait(int msec) {
+    return timed_wait_usec((long)msec * 1000);
+  }
+
+  /************************************
+  * Same as timed_wait(), with the
+  * timeout in microseconds.
+  *************************************/
+  inline bool timed_wait_usec(long usec) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += usec / 1000000;
+    ts.tv_nsec += (usec % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait( &condition_, &mutex_, &ts ) != ETIMEDOUT;
+  }
+
   /************************************
   * Signal one of the waiters that the
   * condition may have changed.
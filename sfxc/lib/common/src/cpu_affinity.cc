@@ -0,0 +1,284 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - pinning of the sfxc threads to CPUs, by the role of the thread
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "cpu_affinity.h"
+#include "raiimutex.h"
+#include "mutex.h"
+
+namespace {
+
+const char *roles[] = {
+  CPU_ROLE_INPUT_READER, CPU_ROLE_CHANNEL_EXTRACTOR, CPU_ROLE_DATA_WRITER,
+  CPU_ROLE_CORRELATOR_READER, CPU_ROLE_BIT2FLOAT, CPU_ROLE_DELAY,
+  CPU_ROLE_CORRELATION
+};
+
+struct Pinned_thread {
+  std::string role;
+  long tid;
+  std::string cpus;
+  bool ok;
+};
+
+Mutex affinity_mutex;
+// The CPUs of every role for this rank and the precedence of the entry
+// that set it (0 for all ranks, 1 for a specific rank)
+std::map<std::string, std::pair<std::set<int>, int> > cpu_map;
+std::vector<Pinned_thread> pinned_threads;
+
+bool parse_int(const std::string &str, int &value) {
+  if (str.empty())
+    return false;
+  char *end;
+  long v = strtol(str.c_str(), &end, 10);
+  if ((*end != '\0') || (v < 0))
+    return false;
+  value = v;
+  return true;
+}
+
+// Parse "n" or "n-m"
+bool parse_range(const std::string &str, int &first, int &last) {
+  size_t dash = str.find('-');
+  if (dash == std::string::npos) {
+    if (!parse_int(str, first))
+      return false;
+    last = first;
+    return true;
+  }
+  return (parse_int(str.substr(0, dash), first) &&
+          parse_int(str.substr(dash + 1), last) && (first <= last));
+}
+
+// Parse a cpu list in the format of the kernel, e.g. "0-3,8,10-11"
+bool parse_cpu_list(const std::string &str, std::set<int> &cpus) {
+  std::stringstream in(str);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    int first, last;
+    if (!parse_range(range, first, last))
+      return false;
+    for (int cpu = first; cpu <= last; cpu++)
+      cpus.insert(cpu);
+  }
+  return true;
+}
+
+bool read_cpu_list(const std::string &filename, std::set<int> &cpus) {
+  std::ifstream in(filename.c_str());
+  std::string line;
+  if (!std::getline(in, line))
+    return false;
+  return parse_cpu_list(line, cpus);
+}
+
+bool parse_cpus(const std::string &str, std::set<int> &cpus, std::string &error) {
+  std::stringstream in(str);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.compare(0, 5, "node:") == 0) {
+      std::string filename =
+        "/sys/devices/system/node/node" + item.substr(5) + "/cpulist";
+      if (!read_cpu_list(filename, cpus)) {
+        error = "Could not read the CPUs of NUMA node " + item.substr(5);
+        return false;
+      }
+    } else if (item.compare(0, 4, "nic:") == 0) {
+      std::string filename =
+        "/sys/class/net/" + item.substr(4) + "/device/local_cpulist";
+      if (!read_cpu_list(filename, cpus)) {
+        error = "Could not read the CPUs of network interface " + item.substr(4);
+        return false;
+      }
+    } else {
+      int first, last;
+      if (!parse_range(item, first, last)) {
+        error = "Invalid CPU range \"" + item + "\"";
+        return false;
+      }
+      for (int cpu = first; cpu <= last; cpu++)
+        cpus.insert(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    error = "Empty CPU list";
+    return false;
+  }
+  return true;
+}
+
+std::string cpus_to_string(const std::set<int> &cpus) {
+  std::stringstream out;
+  std::set<int>::const_iterator it = cpus.begin();
+  while (it != cpus.end()) {
+    int first = *it, last = *it;
+    for (++it; (it != cpus.end()) && (*it == last + 1); ++it)
+      last = *it;
+    if (out.tellp() > 0)
+      out << ",";
+    out << first;
+    if (last != first)
+      out << "-" << last;
+  }
+  return out.str();
+}
+
+bool is_role(const std::string &role) {
+  for (size_t i = 0; i < sizeof(roles) / sizeof(roles[0]); i++) {
+    if (role == roles[i])
+      return true;
+  }
+  return false;
+}
+
+long current_thread_id() {
+#if defined(__linux__) && defined(SYS_gettid)
+  return syscall(SYS_gettid);
+#else
+  return (long)pthread_self();
+#endif
+}
+
+} // namespace
+
+bool Cpu_affinity::set_map(const std::string &map, int rank, std::string &error) {
+  std::map<std::string, std::pair<std::set<int>, int> > new_map;
+
+  // Entries are separated by ';' or white space
+  std::string entries = map;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i] == ';')
+      entries[i] = ' ';
+  }
+  std::stringstream in(entries);
+  std::string entry;
+  while (in >> entry) {
+    size_t equals = entry.find('=');
+    if (equals == std::string::npos) {
+      error = "Expected [ranks:]role=cpus in \"" + entry + "\"";
+      return false;
+    }
+    std::string role = entry.substr(0, equals);
+    int precedence = 0;
+    bool applies = true;
+    size_t colon = role.find(':');
+    if (colon != std::string::npos) {
+      int first, last;
+      if (!parse_range(role.substr(0, colon), first, last)) {
+        error = "Invalid rank range in \"" + entry + "\"";
+        return false;
+      }
+      applies = ((rank >= first) && (rank <= last));
+      precedence = 1;
+      role = role.substr(colon + 1);
+    }
+    if (!is_role(role)) {
+      error = "Unknown thread role \"" + role + "\"";
+      return false;
+    }
+
+    // The CPU lists of node: and nic: are those of the local host, they
+    // can only be resolved on the rank itself
+    std::string cpus_str = entry.substr(equals + 1);
+    std::set<int> cpus;
+    if (rank < 0) {
+      if (cpus_str.empty()) {
+        error = "Empty CPU list in \"" + entry + "\"";
+        return false;
+      }
+      continue;
+    }
+    if (!applies)
+      continue;
+    if (!parse_cpus(cpus_str, cpus, error)) {
+      error += " in \"" + entry + "\"";
+      return false;
+    }
+    if ((new_map.find(role) == new_map.end()) ||
+        (new_map[role].second <= precedence))
+      new_map[role] = std::make_pair(cpus, precedence);
+  }
+
+  if (rank >= 0) {
+    RAIIMutex lock(affinity_mutex);
+    cpu_map = new_map;
+  }
+  return true;
+}
+
+void Cpu_affinity::pin_current_thread(const std::string &role) {
+  RAIIMutex lock(affinity_mutex);
+  std::map<std::string, std::pair<std::set<int>, int> >::iterator it =
+    cpu_map.find(role);
+  if (it == cpu_map.end())
+    return;
+
+  Pinned_thread thread;
+  thread.role = role;
+  thread.tid = current_thread_id();
+  thread.cpus = cpus_to_string(it->second.first);
+  thread.ok = false;
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  const std::set<int> &cpus = it->second.first;
+  for (std::set<int>::const_iterator cpu = cpus.begin(); cpu != cpus.end(); cpu++) {
+    if (*cpu < CPU_SETSIZE)
+      CPU_SET(*cpu, &cpuset);
+  }
+  // Fails if none of the CPUs is available to the process, the thread
+  // then keeps the affinity it inherited
+  thread.ok = (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0);
+#endif
+  if (!thread.ok)
+    std::cerr << "Could not pin " << role << " thread to CPUs " << thread.cpus << std::endl;
+  pinned_threads.push_back(thread);
+}
+
+void Cpu_affinity::unpin_current_thread() {
+  RAIIMutex lock(affinity_mutex);
+  long tid = current_thread_id();
+  for (size_t i = 0; i < pinned_threads.size(); i++) {
+    if (pinned_threads[i].tid == tid) {
+      pinned_threads.erase(pinned_threads.begin() + i);
+      return;
+    }
+  }
+}
+
+void Cpu_affinity::get_state(std::ostream &out, const std::string &indent) {
+  RAIIMutex lock(affinity_mutex);
+  // Only the threads that are still running
+  out << indent << "\"cpu_affinity\": [";
+  for (size_t i = 0; i < pinned_threads.size(); i++) {
+    const Pinned_thread &thread = pinned_threads[i];
+    out << (i == 0 ? "\n" : ",\n")
+        << indent << indent << "{ \"role\": \"" << thread.role << "\""
+        << ", \"thread\": " << thread.tid
+        << ", \"cpus\": \"" << thread.cpus << "\""
+        << ", \"pinned\": " << (thread.ok ? "true" : "false") << " }";
+  }
+  if (!pinned_threads.empty())
+    out << "\n" << indent;
+  out << "]";
+}
@@ -0,0 +1,85 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - pinning of the sfxc threads to CPUs, by the role of the thread
+ */
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <string>
+#include <iostream>
+
+/*****************************************
+*
+* @class Cpu_affinity
+* @desc Every long running thread in sfxc
+* has a role (e.g. "bit2float"). The cpu
+* map assigns a set of CPUs to a role, a
+* thread with that role is pinned to the
+* set when it starts. Threads whose role is
+* not in the map are not pinned.
+*
+* The map is a list of entries separated by
+* ';' or white space:
+*     [ranks:]role=cpus
+* ranks is a rank or a range of ranks
+* (e.g. 3 or 3-8), entries without ranks
+* apply to all ranks but entries for a
+* specific rank take precedence. cpus is a
+* comma separated list of:
+*     n, n-m     CPU numbers
+*     node:n     the CPUs of NUMA node n
+*     nic:name   the CPUs close to network
+*                interface name
+* For example:
+*   "correlator_reader=0;1-4:bit2float=nic:eth2;correlation=node:1"
+******************************************/
+class Cpu_affinity {
+public:
+  /// Use the entries of map that apply to rank. Returns false, and the
+  /// reason in error, if map can not be parsed. With rank < 0 the map is
+  /// only checked.
+  static bool set_map(const std::string &map, int rank, std::string &error);
+
+  /// Pin the calling thread to the CPUs of role
+  static void pin_current_thread(const std::string &role);
+
+  /// Forget the calling thread, called when a pinned thread exits
+  static void unpin_current_thread();
+
+  /// Pins the calling thread for the lifetime of the object, also when
+  /// the thread is cancelled
+  class Pin {
+  public:
+    Pin(const std::string &role) : pinned_(!role.empty()) {
+      if (pinned_)
+        pin_current_thread(role);
+    }
+    ~Pin() {
+      if (pinned_)
+        unpin_current_thread();
+    }
+  private:
+    Pin(const Pin &);
+    Pin &operator=(const Pin &);
+    bool pinned_;
+  };
+
+  /// Write a JSON list of the threads that were pinned
+  static void get_state(std::ostream &out, const std::string &indent);
+};
+
+// The roles of the sfxc threads
+#define CPU_ROLE_INPUT_READER       "input_reader"
+#define CPU_ROLE_CHANNEL_EXTRACTOR  "channel_extractor"
+#define CPU_ROLE_DATA_WRITER        "data_writer"
+#define CPU_ROLE_CORRELATOR_READER  "correlator_reader"
+#define CPU_ROLE_BIT2FLOAT          "bit2float"
+#define CPU_ROLE_DELAY              "delay"
+#define CPU_ROLE_CORRELATION        "correlation"
+
+#endif // CPU_AFFINITY_H
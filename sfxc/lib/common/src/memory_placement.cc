@@ -0,0 +1,159 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - allocation of large buffers on huge pages and on a given NUMA node
+ *
+ * The NUMA binding uses the mbind and getcpu system calls directly, such
+ * that sfxc does not depend on libnuma.
+ */
+#include <iostream>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "memory_placement.h"
+#include "exception_common.h"
+
+namespace {
+
+const size_t HEADER_SIZE = 64;
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const size_t MAGIC = 0x5fc0a110;
+
+// Stored in front of every buffer from placed_malloc
+struct Header {
+  void *base;
+  size_t length;
+  size_t magic;
+};
+
+// From linux/mempolicy.h
+const int SFXC_MPOL_PREFERRED = 1;
+const unsigned SFXC_MPOL_MF_MOVE = 1 << 1;
+
+void bind_to_node(void *addr, size_t length, int numa_node, unsigned flags) {
+#if defined(__linux__) && defined(SYS_mbind)
+  if ((numa_node < 0) || (numa_node >= (int)(8 * sizeof(unsigned long))))
+    return;
+  unsigned long nodemask = 1UL << numa_node;
+  // The binding is only a performance hint, errors (e.g. a kernel
+  // without NUMA support) are ignored
+  syscall(SYS_mbind, addr, length, SFXC_MPOL_PREFERRED, &nodemask,
+          8 * sizeof(nodemask), flags);
+#endif
+}
+
+// Map length bytes, aligned to a huge page if align_huge is set
+void *map_pages(size_t length, bool align_huge, void **base, size_t *base_length) {
+  if (!align_huge) {
+    void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      return NULL;
+    *base = p;
+    *base_length = length;
+    return p;
+  }
+  // Transparent huge pages are only used for 2MB aligned ranges, map a
+  // bit more and release the unaligned head and tail
+  size_t map_length = length + HUGE_PAGE_SIZE;
+  char *p = (char *)mmap(NULL, map_length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == (char *)MAP_FAILED)
+    return NULL;
+  char *aligned = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+  if (aligned != p)
+    munmap(p, aligned - p);
+  size_t tail = (p + map_length) - (aligned + length);
+  if (tail > 0)
+    munmap(aligned + length, tail);
+  *base = aligned;
+  *base_length = length;
+  return aligned;
+}
+
+} // namespace
+
+void Memory_placement::follow_current_thread() {
+  if (numa_node != NUMA_NODE_ANY)
+    return;
+  int node = current_numa_node();
+  if (node != NUMA_NODE_ANY)
+    __sync_bool_compare_and_swap(&numa_node, NUMA_NODE_ANY, node);
+}
+
+void *placed_malloc(size_t n, const Memory_placement &placement) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t length = n + HEADER_SIZE;
+  // Small buffers would waste most of a huge page
+  bool huge = ((placement.pages != PAGES_DEFAULT) && (length >= HUGE_PAGE_SIZE / 2));
+  size_t round = (huge ? HUGE_PAGE_SIZE : page_size);
+  length = (length + round - 1) / round * round;
+
+  void *base = NULL;
+  size_t base_length = 0;
+  char *p = NULL;
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  if (huge && (placement.pages == PAGES_HUGETLB)) {
+    p = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == (char *)MAP_FAILED) {
+      p = NULL;
+    } else {
+      base = p;
+      base_length = length;
+    }
+  }
+#endif
+  if (p == NULL) {
+    p = (char *)map_pages(length, huge, &base, &base_length);
+    if (p == NULL)
+      return NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (huge)
+      madvise(p, length, MADV_HUGEPAGE);
+#endif
+  }
+
+  // Bind before the pages are touched, such that they are allocated on
+  // the right node right away
+  bind_to_node(p, length, placement.numa_node, 0);
+
+  Header *header = (Header *)p;
+  header->base = base;
+  header->length = base_length;
+  header->magic = MAGIC;
+  return p + HEADER_SIZE;
+}
+
+void placed_free(void *p) {
+  if (p == NULL)
+    return;
+  Header *header = (Header *)((char *)p - HEADER_SIZE);
+  MASSERT(header->magic == MAGIC);
+  header->magic = 0;
+  munmap(header->base, header->length);
+}
+
+void placed_rebind(void *p, int numa_node) {
+  if (p == NULL)
+    return;
+  Header *header = (Header *)((char *)p - HEADER_SIZE);
+  bind_to_node(header->base, header->length, numa_node, SFXC_MPOL_MF_MOVE);
+}
+
+int current_numa_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+    return node;
+#endif
+  return NUMA_NODE_ANY;
+}
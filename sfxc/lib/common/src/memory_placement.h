@@ -0,0 +1,76 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - allocation of large buffers on huge pages and on a given NUMA node
+ */
+#ifndef MEMORY_PLACEMENT_H
+#define MEMORY_PLACEMENT_H
+
+#include <stddef.h>
+
+#if __cplusplus >= 201103L
+#include <memory>
+using std::shared_ptr;
+#else
+#include <tr1/memory>
+using std::tr1::shared_ptr;
+#endif
+
+enum Page_policy {
+  // Use aligned_malloc, the placement is left to the C library and kernel
+  PAGES_DEFAULT = 0,
+  // Anonymous mapping, large buffers are advised to use transparent
+  // huge pages
+  PAGES_TRANSPARENT_HUGE,
+  // Anonymous mapping from the reserved huge page pool (MAP_HUGETLB),
+  // falls back to transparent huge pages if no huge pages are available
+  PAGES_HUGETLB
+};
+
+// No NUMA binding, the kernel places the pages on first touch
+#define NUMA_NODE_ANY (-1)
+
+/*****************************************
+*
+* @class Memory_placement
+* @desc Describes where the buffers of a
+* memory pool are allocated. A placement is
+* shared between all elements of a pool,
+* the NUMA node can be set after the pool
+* has been created, e.g. by the thread that
+* consumes the data once it is running.
+* Buffers allocated before the node was set
+* are migrated the next time they are
+* resized.
+******************************************/
+class Memory_placement {
+public:
+  Memory_placement(Page_policy pages = PAGES_DEFAULT, int numa_node = NUMA_NODE_ANY)
+    : pages(pages), numa_node(numa_node) {}
+
+  /// Bind the memory to the NUMA node the calling thread runs on. Only
+  /// the first call has an effect, such that a thread that is moved
+  /// between sockets does not keep migrating the buffers.
+  void follow_current_thread();
+
+  Page_policy pages;
+  volatile int numa_node;
+};
+typedef shared_ptr<Memory_placement> Memory_placement_ptr;
+
+/// Allocate n bytes according to placement, the memory is at least
+/// 64 bytes aligned. Should be freed with placed_free.
+void *placed_malloc(size_t n, const Memory_placement &placement);
+void placed_free(void *p);
+/// Move the pages of a buffer from placed_malloc to numa_node
+void placed_rebind(void *p, int numa_node);
+
+/// The NUMA node of the CPU the calling thread runs on, or
+/// NUMA_NODE_ANY if this can not be determined
+int current_numa_node();
+
+#endif // MEMORY_PLACEMENT_H
@@ -0,0 +1,100 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - Notifier class implementation
+ */
+#include "notifier.h"
+#include "raiimutex.h"
+
+const int Notifier::MAX_WAIT;
+
+Notifier::Notifier() : count_(0), waiters_(0) {}
+
+void Notifier::notify() {
+  // The increment is a full barrier: either the waiter sees the new
+  // count, or its update of waiters_ is visible here
+  __atomic_add_fetch(&count_, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&waiters_, __ATOMIC_SEQ_CST) > 0) {
+    RAIIMutex rc(cond_);
+    cond_.broadcast();
+  }
+}
+
+bool Notifier::wait(uint64_t count, int usec) {
+  RAIIMutex rc(cond_);
+  __atomic_add_fetch(&waiters_, 1, __ATOMIC_SEQ_CST);
+  bool timed_out = false;
+  while (!timed_out && (this->count() == count))
+    timed_out = !cond_.timed_wait_usec(usec);
+  __atomic_sub_fetch(&waiters_, 1, __ATOMIC_SEQ_CST);
+  return this->count() != count;
+}
+
+#ifdef ENABLE_TEST_UNIT
+#include "thread.h"
+
+namespace {
+// Publishes the values 1..n one by one, each time waiting until the
+// consumer has seen the value, using the same count()/wait() pattern
+class Notifier_test_producer : public Thread {
+public:
+  Notifier_test_producer(Notifier &data, Notifier &ack, int &value, int &seen, int n)
+    : data(data), ack(ack), value(value), seen(seen), n(n), timeouts(0) {}
+  void do_execute() {
+    for (int i = 1; i <= n; i++) {
+      __atomic_store_n(&value, i, __ATOMIC_SEQ_CST);
+      data.notify();
+      while (true) {
+        uint64_t events = ack.count();
+        if (__atomic_load_n(&seen, __ATOMIC_SEQ_CST) == i)
+          break;
+        if (!ack.wait(events, 1000000))
+          timeouts++;
+      }
+    }
+  }
+  Notifier &data, &ack;
+  int &value, &seen;
+  int n, timeouts;
+};
+}
+
+void Notifier::Test::tests() {
+  Notifier notifier;
+
+  // An event between count() and wait() is not lost
+  uint64_t events = notifier.count();
+  TEST_EXCEPTION_NTHROW( notifier.notify() );
+  TEST_ASSERT( notifier.count() == events + 1 );
+  TEST_ASSERT( notifier.wait(events, 1000000) );
+
+  // Without an event the wait times out
+  events = notifier.count();
+  TEST_ASSERT( !notifier.wait(events, 1000) );
+
+  // Ping-pong between two threads, both sides wait with a timeout of one
+  // second; a lost wake up shows up as a wait that timed out
+  const int n = 10000;
+  Notifier data, ack;
+  int value = 0, seen = 0, timeouts = 0;
+  Notifier_test_producer producer(data, ack, value, seen, n);
+  producer.start();
+  while (seen < n) {
+    events = data.count();
+    int v = __atomic_load_n(&value, __ATOMIC_SEQ_CST);
+    if (v > seen) {
+      __atomic_store_n(&seen, v, __ATOMIC_SEQ_CST);
+      ack.notify();
+    } else if (!data.wait(events, 1000000)) {
+      timeouts++;
+    }
+  }
+  ::wait(producer);
+  TEST_ASSERT( timeouts == 0 );
+  TEST_ASSERT( producer.timeouts == 0 );
+}
+#endif // ENABLE_TEST_UNIT
@@ -0,0 +1,87 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - Notifier class declaration
+ */
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <stdint.h>
+
+#include "condition.h"
+#include "Test_unit.h"
+
+/*****************************************
+*
+* @class Notifier
+* @desc Wakes up a thread that waits for
+* work as soon as one of its inputs
+* changes state, e.g. an element is
+* pushed on its input queue or returned
+* to its memory pool.
+*
+* The Notifier counts the events. A
+* consumer reads count() before it checks
+* its inputs for work, if it found nothing
+* to do it calls wait() with that count.
+* wait() returns immediately if an event
+* happened in the mean time, so no wake up
+* is lost between the check and the wait.
+*
+* notify() only takes the mutex when a
+* thread is waiting, the producers do not
+* pay for a condition variable while the
+* consumer is busy. Any number of threads
+* can wait on the same Notifier.
+******************************************/
+class Notifier {
+public:
+  /// Upper bound on a single wait in microseconds, in case an input
+  /// changes state without notifying
+  static const int MAX_WAIT = 10000;
+
+  Notifier();
+
+  /************************************
+  * Signal that an input of the
+  * consumer changed state.
+  *************************************/
+  void notify();
+
+  /************************************
+  * The number of events so far.
+  *************************************/
+  uint64_t count() const {
+    return __atomic_load_n(&count_, __ATOMIC_SEQ_CST);
+  }
+
+  /************************************
+  * Wait until the number of events
+  * differs from count, or at most usec
+  * microseconds. Returns true if an
+  * event happened.
+  *************************************/
+  bool wait(uint64_t count, int usec = MAX_WAIT);
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass<Notifier> {
+  public:
+    void tests();
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  Notifier(const Notifier &);
+  Notifier &operator=(const Notifier &);
+
+  Condition cond_;
+  uint64_t count_;
+  // Number of threads in wait(), protected by cond_
+  int waiters_;
+};
+
+#endif // NOTIFIER_H
@@ -7,6 +7,7 @@
 #include "singleton.h"
 #include "thread.h"
 #include "signal_handler.h"
+#include "cpu_affinity.h"
 
 class ThreadException : public Exception {
 public:
@@ -125,6 +126,7 @@ void* Thread::execute(void *param) {
   Signal_handler::install();
   Thread *th = static_cast<Thread*>(param);
   assert( th != NULL );
+  Cpu_affinity::Pin pin(th->affinity_role_);
   try {
     th->isrunning_ = true;
     th->do_execute();
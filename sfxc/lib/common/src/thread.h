@@ -13,6 +13,7 @@
 #define THREAD_HH
 
 #include <vector>
+#include <string>
 #include <pthread.h>
 
 
@@ -63,6 +64,14 @@ protected:
   Thread();
   virtual ~Thread();
 
+  /*****************************************************************************
+  * set the role of the thread (see cpu_affinity.h), the thread is pinned to
+  * the CPUs of the role when it is started.
+  *****************************************************************************/
+  void set_affinity_role(const std::string &role) {
+    affinity_role_ = role;
+  }
+
   // indicate if the thread is running. this variable is changed
   // after a call to the stop function.
   bool isrunning_;
@@ -74,6 +83,7 @@ private:
   friend void wait(Thread&);
 
   pthread_t m_threadid;
+  std::string affinity_role_;
 };
 
 
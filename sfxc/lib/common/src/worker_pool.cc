@@ -0,0 +1,101 @@
+#include "worker_pool.h"
+#include "raiimutex.h"
+#include "exception_common.h"
+#include "cpu_affinity.h"
+
+Worker_pool::Worker_pool()
+  : nthreads_(1), job_(NULL), generation_(0), start_generation_(0),
+    pending_(0), quit_(false) {
+}
+
+Worker_pool::~Worker_pool() {
+  stop_workers();
+}
+
+void Worker_pool::resize(int nthreads) {
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads == nthreads_)
+    return;
+
+  stop_workers();
+
+  nthreads_ = nthreads;
+  start_generation_ = generation_;
+  threads_.resize(nthreads - 1);
+  args_.resize(nthreads - 1);
+  for (int i = 0; i < nthreads - 1; i++) {
+    args_[i].pool = this;
+    args_[i].part = i + 1;
+    CHECK_ZERO( pthread_create(&threads_[i], NULL, worker, &args_[i]) );
+  }
+}
+
+void Worker_pool::run(Job &job) {
+  if (nthreads_ == 1) {
+    job.execute(0, 1);
+    return;
+  }
+
+  {
+    RAIIMutex rc(cond_);
+    job_ = &job;
+    pending_ = nthreads_ - 1;
+    generation_++;
+    cond_.broadcast();
+  }
+
+  job.execute(0, nthreads_);
+
+  RAIIMutex rc(cond_);
+  while (pending_ > 0)
+    cond_.wait();
+  job_ = NULL;
+}
+
+void *Worker_pool::worker(void *arg) {
+  Worker_arg *worker_arg = static_cast<Worker_arg *>(arg);
+  Cpu_affinity::Pin pin(worker_arg->pool->affinity_role_);
+  worker_arg->pool->worker_loop(worker_arg->part);
+  return NULL;
+}
+
+void Worker_pool::worker_loop(int part) {
+  uint64_t seen = start_generation_;
+
+  RAIIMutex rc(cond_);
+  while (true) {
+    while (!quit_ && (generation_ == seen))
+      cond_.wait();
+    if (quit_)
+      break;
+    seen = generation_;
+    Job *job = job_;
+    int nparts = nthreads_;
+
+    cond_.unlock();
+    job->execute(part, nparts);
+    cond_.lock();
+
+    if (--pending_ == 0)
+      cond_.broadcast();
+  }
+}
+
+void Worker_pool::stop_workers() {
+  if (threads_.empty())
+    return;
+
+  {
+    RAIIMutex rc(cond_);
+    quit_ = true;
+    cond_.broadcast();
+  }
+  for (size_t i = 0; i < threads_.size(); i++)
+    pthread_join(threads_[i], NULL);
+
+  threads_.clear();
+  args_.clear();
+  quit_ = false;
+  nthreads_ = 1;
+}
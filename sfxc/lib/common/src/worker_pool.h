@@ -0,0 +1,107 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - common library
+ * This file contains:
+ *   - Worker_pool class declaration
+ */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "condition.h"
+
+/*****************************************
+*
+* @class Worker_pool
+* @desc A fixed set of threads that
+* execute a Job in parallel. The Job is
+* split in as many parts as there are
+* threads in the pool; the thread calling
+* run() processes part 0 itself and run()
+* returns once all parts are finished.
+* A pool of size 1 does not create any
+* thread.
+******************************************/
+class Worker_pool {
+public:
+  class Job {
+  public:
+    virtual ~Job() {}
+
+    /************************************
+    * Process part number "part" out of
+    * "nparts". This function is called
+    * concurrently from all threads in
+    * the pool, each with a different
+    * part.
+    *************************************/
+    virtual void execute(int part, int nparts) = 0;
+  };
+
+  Worker_pool();
+  ~Worker_pool();
+
+  /************************************
+  * Set the number of threads (including
+  * the calling thread) that take part
+  * in run(). Must not be called while
+  * a Job is executing.
+  *************************************/
+  void resize(int nthreads);
+
+  int size() const {
+    return nthreads_;
+  }
+
+  /************************************
+  * Threads created from now on are
+  * pinned to the CPUs of role, see
+  * cpu_affinity.h
+  *************************************/
+  void set_affinity_role(const std::string &role) {
+    affinity_role_ = role;
+  }
+
+  /************************************
+  * Execute the job on all threads of
+  * the pool and wait for completion.
+  *************************************/
+  void run(Job &job);
+
+private:
+  struct Worker_arg {
+    Worker_pool *pool;
+    int part;
+  };
+
+  static void *worker(void *arg);
+  void worker_loop(int part);
+  void stop_workers();
+
+  Condition cond_;
+  std::vector<pthread_t> threads_;
+  std::vector<Worker_arg> args_;
+
+  int nthreads_;
+  Job *job_;
+  // Incremented for every job, workers wait for it to change
+  uint64_t generation_;
+  // Generation at the time the current threads were created
+  uint64_t start_generation_;
+  // Number of parts that are still being processed
+  int pending_;
+  bool quit_;
+  std::string affinity_role_;
+
+  Worker_pool(const Worker_pool &);
+  Worker_pool &operator=(const Worker_pool &);
+};
+
+#endif // WORKER_POOL_H
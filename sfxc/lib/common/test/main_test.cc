@@ -4,6 +4,7 @@
 #include "backtrace.h"
 #include "demangler.h"
 #include "monitor.h"
+#include "notifier.h"
 
 int main(int argc, char** argv) {
   std::cout << "Starting tests" << std::endl;
@@ -12,6 +13,7 @@ int main(int argc, char** argv) {
   Test_manager manager;
   //manager.add_test( new Backtrace::Test() );
   manager.add_test( new QOS_MonitorSpeed::Test() );
+  manager.add_test( new Notifier::Test() );
   manager.do_test();
 #endif //
 
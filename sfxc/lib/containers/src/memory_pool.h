@@ -30,6 +30,7 @@ using std::tr1::shared_ptr;
 
 #include "raiimutex.h"
 #include "condition.h"
+#include "notifier.h"
 
 #include "allocator.h"
 #include "default_allocator.h"
@@ -37,7 +38,9 @@ using std::tr1::shared_ptr;
 #include "utils.h"
 
 #ifdef ENABLE_TEST_UNIT
+#include <unistd.h>
 #include "Test_unit.h"
+#include "thread.h"
 #endif // ENABLE_TEST_UNIT
 
 
@@ -337,6 +340,14 @@ class NoResize_policy : public Resize_policy {
   *************************************/
   unsigned int size();
 
+  /************************************
+  * The notifier is notified whenever
+  * an element returns to the pool, for
+  * producers that do not want to block
+  * in allocate().
+  *************************************/
+  void set_notifier(Notifier *notifier);
+
   /************************************
   * Do not use these they are for
   * for internal use.
@@ -365,6 +376,7 @@ private:
   void release(Element& element);
 
   Condition m_freequeuecond;
+  Notifier *m_notifier;
 
   // queue of the currently free Buffer_elements
   std::stack<T*> m_freequeue;
@@ -446,6 +458,7 @@ template<class T>
 Memory_pool<T>::Memory_pool(unsigned int numelements,
 													  Resize_policy_type type,
 													  AllocatorPtr allocator) :
+	m_notifier(NULL),
 	policy_( Resize_policy::create(type) ),
 	allocator_(allocator)
 {
@@ -466,7 +479,7 @@ template<class T>
 Memory_pool<T>::Memory_pool(unsigned int numelements,
 													  AllocatorPtr allocator,
 														PolicyPtr policy) :
-policy_(policy), allocator_(allocator)
+m_notifier(NULL), policy_(policy), allocator_(allocator)
 {
   mid = sid++;
   for (unsigned int i=0;i<numelements;i++) {
@@ -574,6 +587,14 @@ void Memory_pool<T>::release(Element& element) {
   if ( m_freequeue.size() == 1  ) {
     m_freequeuecond.broadcast();
   }
+  if ( m_notifier != NULL )
+    m_notifier->notify();
+}
+
+template<class T>
+void Memory_pool<T>::set_notifier(Notifier *notifier) {
+  RAIIMutex rc(m_freequeuecond);
+  m_notifier = notifier;
 }
 
 template<class T>
@@ -700,11 +721,45 @@ void Memory_pool<T>::Buffer_element::release() {
 }
 
 #ifdef ENABLE_TEST_UNIT
+template<class T>
+class Memory_pool_test_releaser : public Thread {
+public:
+  Memory_pool_test_releaser(typename Memory_pool<T>::Element &element) : element(element) {}
+  void do_execute() {
+    usleep(10000);
+    element = Memory_pool<T>::Element::None;
+  }
+private:
+  typename Memory_pool<T>::Element &element;
+};
+
 template<class T>
 void Memory_pool<T>::Test::tests() {
   Memory_pool<T> t(1, Default_allocator<int>::create(), Memory_pool<int>::AutomaticResize_policy::create(1));
   Element elem = Element::None;
 
+  // The notifier is notified when an element returns to the pool, this is
+  // tested first as the automatic resize test below blocks
+  Notifier notifier;
+  Memory_pool<T> pool(1);
+  pool.set_notifier(&notifier);
+  uint64_t events = notifier.count();
+  TEST_EXCEPTION_NTHROW( elem = pool.allocate() );
+  TEST_ASSERT( notifier.count() == events );
+  TEST_EXCEPTION_NTHROW( elem = Element::None );
+  TEST_ASSERT( notifier.count() == events + 1 );
+
+  // A producer that waits for a free element on the notifier is woken up
+  // when the element is released in another thread
+  TEST_EXCEPTION_NTHROW( elem = pool.allocate() );
+  Memory_pool_test_releaser<T> releaser(elem);
+  events = notifier.count();
+  releaser.start();
+  bool woken = (pool.number_free_element() > 0) || notifier.wait(events, 1000000);
+  wait(releaser);
+  TEST_ASSERT( woken );
+  TEST_ASSERT( pool.number_free_element() == 1 );
+
   // This part is testing the public interface
   TEST_ASSERT( (elem == Element::None) );
   TEST_ASSERT( t.empty() == false );
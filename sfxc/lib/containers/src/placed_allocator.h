@@ -0,0 +1,40 @@
+#ifndef PLACED_ALLOCATOR_H
+#define PLACED_ALLOCATOR_H
+
+#include "allocator.h"
+#include "memory_placement.h"
+
+/**
+ * Allocator for memory pools whose elements own large buffers. Every
+ * element gets the placement of the pool through T::set_placement(), the
+ * buffers are allocated on huge pages and/or a NUMA node accordingly
+ * when the element is resized.
+ **/
+template<class T>
+class Placed_allocator : public Allocator<T> {
+public:
+  typedef shared_ptr<Placed_allocator<T> > SelfPtr;
+
+  typedef T   Type;
+  typedef T* pType;
+
+  virtual ~Placed_allocator() {}
+
+  virtual pType allocate() {
+    pType element = new T();
+    element->set_placement(placement_);
+    return element;
+  }
+
+  static SelfPtr create(const Memory_placement_ptr &placement) {
+    return SelfPtr( new Placed_allocator(placement) );
+  }
+
+private:
+  Placed_allocator(const Memory_placement_ptr &placement)
+    : placement_(placement) {}
+
+  Memory_placement_ptr placement_;
+};
+
+#endif // PLACED_ALLOCATOR_H
@@ -0,0 +1,396 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file is part of:
+ *   - containers library
+ * This file contains:
+ *   - Declaration and definition of the Spsc_queue
+ */
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <vector>
+#include <stdint.h>
+#include <sched.h>
+
+#include "raiimutex.h"
+#include "condition.h"
+#include "notifier.h"
+#include "exception_common.h"
+#include "threadsafe_queue.h"
+#include "Test_unit.h"
+#ifdef ENABLE_TEST_UNIT
+#include "thread.h"
+#endif // ENABLE_TEST_UNIT
+
+/************************************************
+* @class Spsc_queue
+* @desc A bounded ring buffer with the interface
+* of Threadsafe_queue for links in the pipeline
+* that have exactly one producer and one
+* consumer thread. push() and pop() only use
+* atomic loads and stores of the read and write
+* index; the mutex is only taken when a thread
+* has to wait or when a waiting thread has to be
+* woken up.
+*
+* Semantics:
+*      - push is called by the producer only, it
+*        blocks while the queue is full.
+*      - front, operator[], pop and the other
+*        functions that remove elements are called
+*        by the consumer only, the blocking ones
+*        wait while the queue is empty.
+*      - empty, size and close can be called from
+*        any thread.
+*
+* The wait strategy is BLOCK by default: a
+* waiting thread immediately sleeps on the
+* condition variable. SPIN_THEN_PARK first polls
+* the queue for a while, which avoids the futex
+* round trip when the other side is only slightly
+* behind at the cost of some CPU time.
+*
+* A consumer that watches several inputs
+* instead of blocking on this queue can attach
+* a Notifier, which is notified on every push.
+***********************************************/
+template<class T>
+class Spsc_queue {
+public:
+  typedef T     Type;
+  typedef Type  value_type;
+
+  enum Wait_strategy {
+    BLOCK = 0,
+    SPIN_THEN_PARK
+  };
+
+  /// The capacity is rounded up to a power of two
+  Spsc_queue(size_t capacity = 1024, Wait_strategy strategy = BLOCK)
+    : read_(0), cached_write_(0), write_(0), cached_read_(0),
+      waiting_(0), isclose_(false), strategy_(strategy), notifier_(NULL) {
+    size_t n = 1;
+    while (n < capacity)
+      n *= 2;
+    buffer_.resize(n);
+    mask_ = n - 1;
+  }
+  virtual ~Spsc_queue() { close(); }
+
+  void push( const Type &element ) {
+    if ( isclose() )throw QueueClosedException();
+
+    if ( write_ - cached_read_ > mask_ ) {
+      cached_read_ = load(read_);
+      if ( write_ - cached_read_ > mask_ ) {
+        wait_for_space();
+        cached_read_ = load(read_);
+      }
+    }
+    buffer_[write_ & mask_] = element;
+    store(write_, write_ + 1);
+    wake_up();
+    if ( notifier_ != NULL )
+      notifier_->notify();
+  }
+
+  Type& front() {
+    wait_for_elements(1);
+    return buffer_[read_ & mask_];
+  }
+
+  Type& back() {
+    wait_for_elements(1);
+    return buffer_[(load(write_) - 1) & mask_];
+  }
+
+  Type& operator[](size_t i) {
+    wait_for_elements(i + 1);
+    return buffer_[(read_ + i) & mask_];
+  }
+
+  void pop() {
+    wait_for_elements(1);
+    release_front();
+  }
+
+  Type front_and_pop() {
+    wait_for_elements(1);
+    Type element = buffer_[read_ & mask_];
+    release_front();
+    return element;
+  }
+
+  Type front_and_pop_non_blocking() {
+    if ( !available(1) ) {
+      if ( isclose() )throw QueueClosedException();
+      MTHROW("Trying to pop from an empty queue.");
+    }
+    Type element = buffer_[read_ & mask_];
+    release_front();
+    return element;
+  }
+
+  bool empty() {
+    return size() == 0;
+  }
+
+  size_t size() {
+    uint64_t read = load(read_);
+    return load(write_) - read;
+  }
+
+  /// The number of elements that fit in the queue
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  bool full() {
+    return size() > mask_;
+  }
+
+  /// Notified after every push, set before the producer starts
+  void set_notifier(Notifier *notifier) {
+    notifier_ = notifier;
+  }
+
+  bool isclose(){ return __atomic_load_n(&isclose_, __ATOMIC_ACQUIRE); }
+
+  void close()
+  {
+    RAIIMutex rc(cond_);
+
+    /// the queue is closed
+    __atomic_store_n(&isclose_, true, __ATOMIC_RELEASE);
+
+    /// all the waiting classes now exit.
+    cond_.broadcast();
+    if ( notifier_ != NULL )
+      notifier_->notify();
+  }
+
+#ifdef ENABLE_TEST_UNIT
+  class Test : public Test_aclass< Spsc_queue<T> > {
+  public:
+    void tests();
+  private:
+    // Passes 0..n-1 through a small queue, returns false if an element
+    // arrived out of order
+    bool transfer(Wait_strategy strategy, int n);
+  };
+#endif // ENABLE_TEST_UNIT
+
+private:
+  static uint64_t load(const uint64_t &index) {
+    return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+  }
+  static void store(uint64_t &index, uint64_t value) {
+    __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+  }
+
+  static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+  }
+
+  // Consumer side, true if at least n elements are in the queue
+  bool available(uint64_t n) {
+    if ( cached_write_ - read_ >= n )
+      return true;
+    cached_write_ = load(write_);
+    return cached_write_ - read_ >= n;
+  }
+
+  // Producer side, true if there is room for one more element
+  bool has_space() {
+    return write_ - load(read_) <= mask_;
+  }
+
+  // Remove the front element, the slot is reset such that the
+  // element (e.g. a memory pool element) is released immediately
+  void release_front() {
+    buffer_[read_ & mask_] = Type();
+    store(read_, read_ + 1);
+    wake_up();
+  }
+
+  void wait_for_elements(uint64_t n) {
+    if ( available(n) )
+      return;
+    if ( strategy_ == SPIN_THEN_PARK ) {
+      for (int i = 0; i < SPIN_COUNT; i++) {
+        if ( isclose() )throw QueueClosedException();
+        if ( available(n) )
+          return;
+        if ( (i + 1) % YIELD_INTERVAL == 0 )
+          sched_yield();
+        else
+          cpu_relax();
+      }
+    }
+
+    RAIIMutex rc(cond_);
+    while ( true ) {
+      announce_wait();
+      if ( available(n) )
+        break;
+      if ( isclose() )throw QueueClosedException();
+      cond_.wait();
+      if ( isclose() )throw QueueClosedException();
+    }
+  }
+
+  void wait_for_space() {
+    if ( strategy_ == SPIN_THEN_PARK ) {
+      for (int i = 0; i < SPIN_COUNT; i++) {
+        if ( isclose() )throw QueueClosedException();
+        if ( has_space() )
+          return;
+        if ( (i + 1) % YIELD_INTERVAL == 0 )
+          sched_yield();
+        else
+          cpu_relax();
+      }
+    }
+
+    RAIIMutex rc(cond_);
+    while ( true ) {
+      announce_wait();
+      if ( has_space() )
+        break;
+      if ( isclose() )throw QueueClosedException();
+      cond_.wait();
+    }
+  }
+
+  // The waiter announces itself before it rechecks the queue and the
+  // other side publishes its index before it checks for a waiter, the
+  // full barriers in between guarantee that at least one of them sees
+  // the other and no wake up is lost. The first wake up clears the flag,
+  // such that a burst of pushes while the consumer is being scheduled
+  // results in a single broadcast. Producer and consumer never wait at
+  // the same time, so one flag is sufficient.
+  void announce_wait() {
+    __atomic_store_n(&waiting_, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
+  void wake_up() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ( __atomic_load_n(&waiting_, __ATOMIC_RELAXED) &&
+         __atomic_exchange_n(&waiting_, 0, __ATOMIC_ACQ_REL) ) {
+      RAIIMutex rc(cond_);
+      cond_.broadcast();
+    }
+  }
+
+  // Number of polls before a thread sleeps on the condition variable
+  static const int SPIN_COUNT = 4096;
+  static const int YIELD_INTERVAL = 256;
+  static const int CACHE_LINE = 64;
+
+  std::vector<Type> buffer_;
+  uint64_t mask_;
+
+  // The consumer and producer indices are on separate cache lines,
+  // each side keeps a copy of the index of the other side which is
+  // only refreshed when the queue looks empty (full).
+  char pad0_[CACHE_LINE];
+  uint64_t read_;
+  uint64_t cached_write_;
+  char pad1_[CACHE_LINE - 2 * sizeof(uint64_t)];
+  uint64_t write_;
+  uint64_t cached_read_;
+  char pad2_[CACHE_LINE - 2 * sizeof(uint64_t)];
+
+  int waiting_;
+  bool isclose_;
+  Wait_strategy strategy_;
+  Notifier *notifier_;
+  Condition cond_;
+};
+
+/////////////////// IMPLEMENTATION ///////////////
+#ifdef ENABLE_TEST_UNIT
+class Spsc_queue_test_producer : public Thread {
+public:
+  Spsc_queue_test_producer(Spsc_queue<int> &queue, int n) : queue(queue), n(n) {}
+  void do_execute() {
+    for (int i = 0; i < n; i++)
+      queue.push(i);
+  }
+private:
+  Spsc_queue<int> &queue;
+  int n;
+};
+
+template<class T>
+bool Spsc_queue<T>::Test::transfer(Wait_strategy strategy, int n) {
+  Spsc_queue<int> queue(16, strategy);
+  Spsc_queue_test_producer producer(queue, n);
+  producer.start();
+  bool in_order = true;
+  for (int i = 0; i < n; i++) {
+    if (queue.front_and_pop() != i)
+      in_order = false;
+  }
+  wait(producer);
+  return in_order && queue.empty();
+}
+
+template<class T>
+void Spsc_queue<T>::Test::tests() {
+  Spsc_queue<int> queue(3);
+  int value = -1;
+
+  TEST_ASSERT( queue.capacity() == 4 );
+  TEST_ASSERT( queue.empty() );
+  TEST_EXCEPTION_THROW( queue.front_and_pop_non_blocking() );
+  for (int i = 0; i < 4; i++)
+    queue.push(i);
+  TEST_ASSERT( queue.full() );
+  TEST_ASSERT( queue.size() == 4 );
+  TEST_ASSERT( (queue.front() == 0) && (queue[3] == 3) && (queue.back() == 3) );
+  TEST_EXCEPTION_NTHROW( value = queue.front_and_pop_non_blocking() );
+  TEST_ASSERT( value == 0 );
+
+  // The indices wrap around the ring
+  bool in_order = true;
+  for (int i = 4; i < 100; i++) {
+    queue.push(i);
+    if (queue.front_and_pop() != i - 3)
+      in_order = false;
+  }
+  TEST_ASSERT( in_order );
+  TEST_ASSERT( queue.size() == 3 );
+
+  // Every push and the close notify
+  Notifier notifier;
+  queue.set_notifier(&notifier);
+  uint64_t events = notifier.count();
+  queue.pop();
+  TEST_ASSERT( notifier.count() == events );
+  queue.push(100);
+  TEST_ASSERT( notifier.count() == events + 1 );
+  queue.close();
+  TEST_ASSERT( notifier.count() == events + 2 );
+  TEST_ASSERT( queue.isclose() );
+
+  // The elements still in a closed queue can be read, after that the
+  // queue throws
+  while (!queue.empty())
+    queue.pop();
+  TEST_EXCEPTION_THROW( queue.front() );
+  TEST_EXCEPTION_THROW( queue.push(0) );
+
+  // Producer and consumer in different threads, the producer blocks on
+  // the full queue and the consumer on the empty one
+  TEST_ASSERT( transfer(BLOCK, 1000000) );
+  TEST_ASSERT( transfer(SPIN_THEN_PARK, 1000000) );
+}
+#endif // ENABLE_TEST_UNIT
+
+#endif // SPSC_QUEUE_H
@@ -21,6 +21,7 @@
 #include "mutex.h"
 #include "raiimutex.h"
 #include "condition.h"
+#include "notifier.h"
 #include "exception_common.h"
 #include "allocator.h"
 
@@ -49,6 +50,9 @@ class QueueClosedException : public Exception
 *      - pop_non_blocking is thread-safe and....
 *      - empty is thread-safe non blocking
 *
+* A consumer that watches several inputs can
+* attach a Notifier, which is notified after
+* every push.
 ***********************************************/
 template<class T>
 class Threadsafe_queue {
@@ -56,15 +60,18 @@ public:
   typedef T     Type;
   typedef Type  value_type;
 
-  Threadsafe_queue() { isclose_ = false; }
+  Threadsafe_queue() : m_notifier(NULL) { isclose_ = false; }
   virtual ~Threadsafe_queue() { close(); }
 
   void push( Type element ) {
 		if( isclose_ )throw QueueClosedException();
 
-    RAIIMutex rc(m_queuecond);
-    m_queue.push_back(element);
-    if( m_queue.size() != 0 ) m_queuecond.signal();
+    {
+      RAIIMutex rc(m_queuecond);
+      m_queue.push_back(element);
+      if( m_queue.size() != 0 ) m_queuecond.signal();
+    }
+    if( m_notifier != NULL ) m_notifier->notify();
   }
 
   Type& front() {
@@ -140,6 +147,9 @@ public:
     return m_queue.size();
   }
 
+  /// Notified after every push, set before the producer starts
+  void set_notifier(Notifier *notifier) { m_notifier = notifier; }
+
 	bool isclose(){ return isclose_;  }
 
 	void close()
@@ -163,6 +173,7 @@ class Test : public Test_aclass<Threadsafe_queue> {
 private:
   std::deque<Type> m_queue;
   Condition m_queuecond;
+  Notifier *m_notifier;
 
   bool isclose_;
 };
@@ -1,6 +1,7 @@
 #include "Test_unit.h"
 #include "threadsafe_queue.h"
 #include "memory_pool.h"
+#include "spsc_queue.h"
 
 int main(int argc, char** argv) {
 #ifdef ENABLE_TEST_UNIT
@@ -9,6 +10,8 @@ int main(int argc, char** argv) {
   Threadsafe_queue<int> queue;
   manager.add_test( new Threadsafe_queue<int>::Test() );
 
+  manager.add_test( new Spsc_queue<int>::Test() );
+
   Memory_pool<int> buffer(1);
   manager.add_test( new Memory_pool<int>::Test() );
 
@@ -21,7 +21,11 @@ Abstract_manager_node::
 Abstract_manager_node(int rank, int numtasks,
                       Log_writer *writer,
                       const Control_parameters &param)
-    : Node(rank, writer), control_parameters(param), numtasks(numtasks), pulsar_parameters(*writer) {
+    : Node(rank, writer), control_parameters(param), numtasks(numtasks), pulsar_parameters(*writer)
+#ifndef SFXC_DETERMINISTIC
+    , correlator_node_scheduler(param.correlator_node_pipeline_depth())
+#endif
+{
   integration_time_ = Time(param.integration_time());
   }
 
@@ -75,6 +79,9 @@ start_input_node(int rank, const std::string &station, const std::string &datast
 
   /// receive the connexion parameters for the current input_node
   MPI_Transfer::receive_ip_address(params->ip_port_, params->hostname_, rank);
+#ifndef SFXC_DETERMINISTIC
+  correlator_node_scheduler.add_input_node(params->hostname_);
+#endif
 
   /// wait to receive the the acknowledment showing that hte node
   /// is correctly initialized.
@@ -113,28 +120,41 @@ start_output_node(int rank, int32_t buffer_size) {
 }
 void
 Abstract_manager_node::
-start_correlator_node(int rank) {
-  size_t correlator_node_nr = correlator_node_rank.size();
+start_correlator_node(int rank, int n_lanes) {
+  // Every lane of the correlator node is a correlator node of its own
+  // for the manager, the input nodes and the output node
+  int32_t correlator_node_nr = correlator_node_rank.size();
 #ifdef SFXC_DETERMINISTIC
 
-  correlator_node_ready.resize(correlator_node_nr+1);
-  SFXC_ASSERT(correlator_node_nr < correlator_node_ready.size());
-  set_correlator_node_ready(correlator_node_nr, false);
+  correlator_node_ready.resize(correlator_node_nr+n_lanes, 0);
 #endif
 
-  correlator_node_rank.push_back(rank);
+  for (int lane = 0; lane < n_lanes; lane++) {
+    correlator_node_rank.push_back(rank);
+    correlator_node_lane.push_back(lane);
+  }
 
   // starting a correlator node
+  int32_t msg_corr_node[2] = {correlator_node_nr, n_lanes};
   if(control_parameters.pulsar_binning())
-    MPI_Send(&correlator_node_nr, 1, MPI_INT32, rank,
+    MPI_Send(msg_corr_node, 2, MPI_INT32, rank,
              MPI_TAG_SET_CORRELATOR_NODE_PSR_BINNING, MPI_COMM_WORLD);
   else if(control_parameters.phased_array())
-    MPI_Send(&correlator_node_nr, 1, MPI_INT32, rank,
+    MPI_Send(msg_corr_node, 2, MPI_INT32, rank,
              MPI_TAG_SET_CORRELATOR_NODE_PHASED, MPI_COMM_WORLD);
   else
-    MPI_Send(&correlator_node_nr, 1, MPI_INT32, rank,
+    MPI_Send(msg_corr_node, 2, MPI_INT32, rank,
              MPI_TAG_SET_CORRELATOR_NODE, MPI_COMM_WORLD);
 
+  // The correlator node has no listening ports, only its host is used
+  std::vector<uint64_t> ip_port;
+  std::string hostname;
+  MPI_Transfer::receive_ip_address(ip_port, hostname, rank);
+#ifndef SFXC_DETERMINISTIC
+  for (int lane = 0; lane < n_lanes; lane++)
+    correlator_node_scheduler.add_node(hostname);
+#endif
+
   int msg;
   MPI_Status status;
   MPI_Recv(&msg, 1, MPI_INT32,
@@ -463,6 +483,7 @@ void
 Abstract_manager_node::
 correlator_node_set(Correlation_parameters &parameters,
                     int corr_node_nr) {
+  parameters.lane = correlator_node_lane[corr_node_nr];
   MPI_Transfer::send(parameters,correlator_node_rank[corr_node_nr]);
 }
 
@@ -485,8 +506,10 @@ correlator_node_set_all(Uvw_model &uvw_table, int input_node) {
 void
 Abstract_manager_node::
 correlator_node_set_all(Pulsar_parameters &pulsar) {
+  // Once per MPI rank, the lanes of a correlator node share them
   for (size_t i=0; i<correlator_node_rank.size(); i++) {
-    MPI_Transfer::send(pulsar, correlator_node_rank[i]);
+    if (correlator_node_lane[i] == 0)
+      MPI_Transfer::send(pulsar, correlator_node_rank[i]);
   }
 }
 
@@ -499,8 +522,10 @@ correlator_node_set_all(Mask_parameters &mask) {
 void
 Abstract_manager_node::
 correlator_node_set_all(std::set<std::string> &sources) {
+  // Once per MPI rank, the lanes of a correlator node share them
   for (size_t i=0; i<correlator_node_rank.size(); i++) {
-    MPI_Transfer::send(sources, correlator_node_rank[i]);
+    if (correlator_node_lane[i] == 0)
+      MPI_Transfer::send(sources, correlator_node_rank[i]);
   }
 }
 
@@ -510,11 +535,17 @@ Abstract_manager_node::
 set_correlator_node_ready(size_t correlator_nr, bool ready) {
 #ifdef SFXC_DETERMINISTIC
   SFXC_ASSERT(correlator_nr < correlator_node_ready.size());
-  correlator_node_ready[correlator_nr] = ready;
+  // A correlator node can have several requests outstanding
+  if (ready) {
+    correlator_node_ready[correlator_nr]++;
+  } else {
+    SFXC_ASSERT(correlator_node_ready[correlator_nr] > 0);
+    correlator_node_ready[correlator_nr]--;
+  }
 #else
 
   if (ready) {
-    ready_correlator_nodes.push(correlator_nr);
+    correlator_node_scheduler.request(correlator_nr);
   }
 #endif
 }
@@ -0,0 +1,524 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Sequential file reader that keeps several large reads in flight
+ *
+ * io_uring is used through the system calls directly, such that sfxc
+ * does not depend on liburing.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <iostream>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "async_file_reader.h"
+#include "condition.h"
+#include "raiimutex.h"
+#include "cpu_affinity.h"
+#include "utils.h"
+
+const int Async_file_reader::DEFAULT_DEPTH;
+const size_t Async_file_reader::DEFAULT_BLOCK_SIZE;
+const size_t Async_file_reader::ALIGNMENT;
+const int Async_file_reader::MAX_DEPTH;
+
+typedef Async_file_reader::Request Request;
+
+/// Executes the reads of an Async_file_reader
+class Async_io_backend {
+public:
+  virtual ~Async_io_backend() {}
+  virtual const char *name() const = 0;
+  /// Start reading the request->length - request->filled bytes at
+  /// request->offset + request->filled
+  virtual void submit(Request *request) = 0;
+  /// Wait until request is done
+  virtual void wait(Request *request) = 0;
+};
+
+namespace {
+
+/// Blocking preads on a small pool of threads
+class Thread_io_backend : public Async_io_backend {
+public:
+  static const size_t MAX_THREADS = 8;
+
+  Thread_io_backend() : idle_(0), stop_(false) {}
+
+  ~Thread_io_backend() {
+    {
+      RAIIMutex lock(condition_);
+      stop_ = true;
+      condition_.broadcast();
+    }
+    for (size_t i = 0; i < threads_.size(); i++)
+      pthread_join(threads_[i], NULL);
+  }
+
+  const char *name() const { return "threads"; }
+
+  void submit(Request *request) {
+    RAIIMutex lock(condition_);
+    pending_.push_back(request);
+    // Threads are started on demand, up to one per read in flight
+    if ((idle_ < (int)pending_.size()) && (threads_.size() < MAX_THREADS)) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, execute, this) == 0)
+        threads_.push_back(thread);
+    }
+    condition_.broadcast();
+  }
+
+  void wait(Request *request) {
+    RAIIMutex lock(condition_);
+    while (!request->done)
+      condition_.wait();
+  }
+
+private:
+  static void *execute(void *self) {
+    Cpu_affinity::Pin pin(CPU_ROLE_INPUT_READER);
+    ((Thread_io_backend *)self)->run();
+    return NULL;
+  }
+
+  void run() {
+    RAIIMutex lock(condition_);
+    for (;;) {
+      while (pending_.empty() && !stop_) {
+        idle_++;
+        condition_.wait();
+        idle_--;
+      }
+      if (stop_)
+        return;
+      Request *request = pending_.front();
+      pending_.pop_front();
+
+      condition_.unlock();
+      long result = read_request(request);
+      condition_.lock();
+
+      request->result = result;
+      request->done = true;
+      condition_.broadcast();
+    }
+  }
+
+  static long read_request(Request *request) {
+    char *buffer = request->buffer + request->filled;
+    size_t length = request->length - request->filled;
+    uint64_t offset = request->offset + request->filled;
+    size_t done = 0;
+    while (done < length) {
+      ssize_t result = pread(request->fd, buffer + done, length - done, offset + done);
+      if (result < 0) {
+        if (errno == EINTR)
+          continue;
+        return -errno;
+      }
+      done += result;
+      // A short read is the end of the file, with O_DIRECT a read from
+      // an unaligned offset would fail
+      if ((result == 0) || (done % Async_file_reader::ALIGNMENT != 0))
+        break;
+    }
+    return done;
+  }
+
+  Condition condition_;
+  std::deque<Request *> pending_;
+  std::vector<pthread_t> threads_;
+  int idle_;
+  bool stop_;
+};
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define SFXC_HAVE_IO_URING 1
+
+/// Reads submitted through an io_uring, the completions are reaped by
+/// the thread that waits for a request
+class Uring_io_backend : public Async_io_backend {
+public:
+  static Async_io_backend *create(unsigned entries) {
+    Uring_io_backend *backend = new Uring_io_backend();
+    if (!backend->setup(entries)) {
+      delete backend;
+      return NULL;
+    }
+    return backend;
+  }
+
+  ~Uring_io_backend() {
+    if (sqes_ != NULL)
+      munmap(sqes_, sqes_length_);
+    if ((cq_ring_ != NULL) && (cq_ring_ != sq_ring_))
+      munmap(cq_ring_, cq_length_);
+    if (sq_ring_ != NULL)
+      munmap(sq_ring_, sq_length_);
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  const char *name() const { return "io_uring"; }
+
+  void submit(Request *request) {
+    unsigned tail = *sq_tail_;
+    // The reader never has more reads in flight than there are entries
+    SFXC_ASSERT(tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) < sq_entries_);
+    unsigned index = tail & *sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    request->iov.iov_base = request->buffer + request->filled;
+    request->iov.iov_len = request->length - request->filled;
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = (unsigned long)&request->iov;
+    sqe->len = 1;
+    sqe->off = request->offset + request->filled;
+    sqe->user_data = (unsigned long)request;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    while (enter(1, 0, 0) < 0) {
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        request->result = -errno;
+        request->done = true;
+        return;
+      }
+    }
+  }
+
+  void wait(Request *request) {
+    reap();
+    while (!request->done) {
+      if ((enter(0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR)) {
+        request->result = -errno;
+        request->done = true;
+        return;
+      }
+      reap();
+    }
+  }
+
+private:
+  Uring_io_backend()
+    : fd_(-1), sq_ring_(NULL), cq_ring_(NULL), sqes_(NULL) {}
+
+  bool setup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd_ < 0)
+      return false;
+
+    sq_length_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_length_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+    if (single_mmap)
+      sq_length_ = cq_length_ = std::max(sq_length_, cq_length_);
+
+    void *p = mmap(NULL, sq_length_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (p == MAP_FAILED)
+      return false;
+    sq_ring_ = (char *)p;
+    if (single_mmap) {
+      cq_ring_ = sq_ring_;
+    } else {
+      p = mmap(NULL, cq_length_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (p == MAP_FAILED)
+        return false;
+      cq_ring_ = (char *)p;
+    }
+    sqes_length_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    p = mmap(NULL, sqes_length_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (p == MAP_FAILED)
+      return false;
+    sqes_ = (struct io_uring_sqe *)p;
+
+    sq_head_ = (unsigned *)(sq_ring_ + params.sq_off.head);
+    sq_tail_ = (unsigned *)(sq_ring_ + params.sq_off.tail);
+    sq_mask_ = (unsigned *)(sq_ring_ + params.sq_off.ring_mask);
+    sq_array_ = (unsigned *)(sq_ring_ + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = (unsigned *)(cq_ring_ + params.cq_off.head);
+    cq_tail_ = (unsigned *)(cq_ring_ + params.cq_off.tail);
+    cq_mask_ = (unsigned *)(cq_ring_ + params.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe *)(cq_ring_ + params.cq_off.cqes);
+    return true;
+  }
+
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, NULL, 0);
+  }
+
+  void reap() {
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+      Request *request = (Request *)(unsigned long)cqe->user_data;
+      request->result = cqe->res;
+      request->done = true;
+      head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+  int fd_;
+  char *sq_ring_, *cq_ring_;
+  size_t sq_length_, cq_length_, sqes_length_;
+  struct io_uring_sqe *sqes_;
+  unsigned *sq_head_, *sq_tail_, *sq_mask_, *sq_array_, sq_entries_;
+  unsigned *cq_head_, *cq_tail_, *cq_mask_;
+  struct io_uring_cqe *cqes_;
+};
+#endif // io_uring
+
+size_t round_up(size_t n, size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+Async_file_reader::Async_file_reader(int depth, size_t block_size)
+  : fd_(-1), direct_(false), file_size_(0), position_(0), next_offset_(0),
+    error_(false), depth_(0), block_size_(0), new_depth_(0),
+    new_block_size_(0), backend_(NULL) {
+  set_read_ahead(depth, block_size);
+#ifdef SFXC_HAVE_IO_URING
+  backend_ = Uring_io_backend::create(MAX_DEPTH);
+#endif
+  if (backend_ == NULL)
+    backend_ = new Thread_io_backend();
+}
+
+Async_file_reader::~Async_file_reader() {
+  close();
+  for (size_t i = 0; i < free_requests_.size(); i++) {
+    free(free_requests_[i]->buffer);
+    delete free_requests_[i];
+  }
+  delete backend_;
+}
+
+const char *Async_file_reader::backend_name() const {
+  return backend_->name();
+}
+
+void Async_file_reader::set_read_ahead(int depth, size_t block_size) {
+  RAIIMutex lock(settings_mutex_);
+  new_depth_ = std::max(1, std::min(depth, (int)MAX_DEPTH));
+  new_block_size_ = round_up(std::max(block_size, ALIGNMENT), ALIGNMENT);
+}
+
+bool Async_file_reader::open(const std::string &filename) {
+  close();
+  filename_ = filename;
+  // O_DIRECT is not supported by all file systems, e.g. tmpfs
+  direct_ = true;
+  fd_ = ::open(filename.c_str(), O_RDONLY | O_DIRECT);
+  if (fd_ < 0) {
+    direct_ = false;
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+  }
+  if (fd_ < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    close();
+    return false;
+  }
+  file_size_ = st.st_size;
+  position_ = next_offset_ = 0;
+  error_ = false;
+  if (!direct_)
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return true;
+}
+
+void Async_file_reader::close() {
+  cancel_all();
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+  file_size_ = position_ = next_offset_ = 0;
+}
+
+bool Async_file_reader::eof() const {
+  return (fd_ < 0) || error_ || (position_ >= file_size_);
+}
+
+bool Async_file_reader::reopen_buffered() {
+  cancel_all();
+  ::close(fd_);
+  direct_ = false;
+  fd_ = ::open(filename_.c_str(), O_RDONLY);
+  if (fd_ < 0)
+    return false;
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  next_offset_ = position_ - position_ % ALIGNMENT;
+  return true;
+}
+
+Request *Async_file_reader::get_request(size_t length) {
+  for (size_t i = 0; i < free_requests_.size(); i++) {
+    Request *request = free_requests_[i];
+    if (request->capacity >= length) {
+      free_requests_[i] = free_requests_.back();
+      free_requests_.pop_back();
+      return request;
+    }
+  }
+  Request *request = new Request();
+  request->capacity = std::max(length, block_size_);
+  void *buffer;
+  if (posix_memalign(&buffer, ALIGNMENT, request->capacity) != 0)
+    sfxc_abort("Could not allocate a read buffer");
+  request->buffer = (char *)buffer;
+  return request;
+}
+
+void Async_file_reader::recycle(Request *request) {
+  // Buffers of an old block size are released
+  if ((request->capacity < block_size_) || (free_requests_.size() >= (size_t)depth_)) {
+    free(request->buffer);
+    delete request;
+  } else {
+    free_requests_.push_back(request);
+  }
+}
+
+void Async_file_reader::cancel_all() {
+  while (!in_flight_.empty()) {
+    Request *request = in_flight_.front();
+    backend_->wait(request);
+    in_flight_.pop_front();
+    recycle(request);
+  }
+}
+
+void Async_file_reader::fill() {
+  {
+    RAIIMutex lock(settings_mutex_);
+    depth_ = new_depth_;
+    block_size_ = new_block_size_;
+  }
+  while (!error_ && ((int)in_flight_.size() < depth_) && (next_offset_ < file_size_)) {
+    // With O_DIRECT also the length has to be aligned, the read stops
+    // at the end of the file
+    size_t length = std::min((uint64_t)block_size_, file_size_ - next_offset_);
+    length = round_up(length, ALIGNMENT);
+    Request *request = get_request(length);
+    request->fd = fd_;
+    request->offset = next_offset_;
+    request->length = length;
+    request->filled = 0;
+    request->result = 0;
+    request->done = false;
+    backend_->submit(request);
+    in_flight_.push_back(request);
+    next_offset_ += length;
+  }
+}
+
+Request *Async_file_reader::wait_for_head() {
+  Request *request = in_flight_.front();
+  backend_->wait(request);
+  return request;
+}
+
+size_t Async_file_reader::read(char *out, size_t nbytes) {
+  if ((fd_ < 0) || error_)
+    return 0;
+
+  // Skipping past the reads in flight restarts the read ahead at the
+  // new position instead of reading the data in between
+  if ((out == NULL) && (position_ + nbytes > next_offset_)) {
+    uint64_t target = std::min(position_ + nbytes, file_size_);
+    size_t skipped = target - position_;
+    cancel_all();
+    position_ = target;
+    next_offset_ = target - target % ALIGNMENT;
+    return skipped;
+  }
+
+  size_t done = 0;
+  while (done < nbytes) {
+    fill();
+    if (in_flight_.empty())
+      break;
+    Request *head = wait_for_head();
+    if (head->result < 0) {
+      if (direct_ && (head->result == -EINVAL) && reopen_buffered())
+        continue;
+      std::cerr << RANK_OF_NODE << " : Error reading " << filename_ << ": "
+                << strerror(-head->result) << std::endl;
+      error_ = true;
+      cancel_all();
+      break;
+    }
+
+    // The head is visited again if it holds more than nbytes, its new
+    // bytes are only counted once
+    long n_new = head->result;
+    head->filled += n_new;
+    head->result = 0;
+    uint64_t head_end = head->offset + head->filled;
+    if ((n_new > 0) && (head->filled < head->length) && (head_end < file_size_)) {
+      // A short read, e.g. interrupted by a signal, read the rest
+      head->done = false;
+      backend_->submit(head);
+      continue;
+    }
+    if (position_ < head_end) {
+      size_t n = std::min((uint64_t)(nbytes - done), head_end - position_);
+      if (out != NULL)
+        memcpy(out + done, head->buffer + (position_ - head->offset), n);
+      done += n;
+      position_ += n;
+    }
+    if (position_ >= head_end) {
+      in_flight_.pop_front();
+      // Nothing more could be read before the expected end, the file
+      // was truncated
+      if ((head->filled < head->length) && (head_end < file_size_)) {
+        struct stat st;
+        if ((fstat(fd_, &st) == 0) && ((uint64_t)st.st_size < file_size_))
+          std::cerr << RANK_OF_NODE << " : " << filename_ << " was truncated to "
+                    << st.st_size << " bytes" << std::endl;
+        file_size_ = head_end;
+        cancel_all();
+      }
+      recycle(head);
+    }
+  }
+  return done;
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2009 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the scalar implementation of the bit2float kernels
+ *   - the run time selection of the SIMD implementations
+ */
+#include <string.h>
+#include <algorithm>
+#include "bit2float_kernels.h"
+#include "sfxc_math.h"
+
+const FLOAT bit2float_value_1bit[2] = {-5, 5};
+const FLOAT bit2float_value_2bit[4] = {-7, -2, 2, 7};
+
+namespace {
+
+#include "bit2float_level_counter.h"
+
+// Lookup tables from a byte to its samples
+class Lookup_tables {
+public:
+  Lookup_tables() {
+    for (int i = 0; i < 256; i++) {
+      for (int j = 0; j < 4; j++)
+        table_2bit[i][j] = bit2float_value_2bit[(i >> (2 * j)) & 3];
+      for (int j = 0; j < 8; j++)
+        table_1bit[i][j] = bit2float_value_1bit[(i >> j) & 1];
+    }
+  }
+  FLOAT table_1bit[256][8];
+  FLOAT table_2bit[256][4];
+} tables;
+
+// Load up to 8 bytes, the remaining bytes of the word are zero
+uint64_t load_word(const unsigned char *input, int nbytes) {
+  uint64_t word = 0;
+  memcpy(&word, input, nbytes);
+  return word;
+}
+
+void unpack_1bit(const unsigned char *input, int nbytes,
+                 FLOAT *output, int64_t *levels) {
+  Level_counter_1bit counter(levels);
+  for (int i = 0; i < nbytes; i += 8) {
+    int n = std::min(8, nbytes - i);
+    for (int j = i; j < i + n; j++)
+      memcpy(&output[8 * j], &tables.table_1bit[input[j]][0], 8 * sizeof(FLOAT));
+    counter.add(load_word(&input[i], n), n);
+  }
+}
+
+void unpack_2bit(const unsigned char *input, int nbytes,
+                 FLOAT *output, int64_t *levels) {
+  Level_counter_2bit counter(levels);
+  for (int i = 0; i < nbytes; i += 8) {
+    int n = std::min(8, nbytes - i);
+    for (int j = i; j < i + n; j++)
+      memcpy(&output[4 * j], &tables.table_2bit[input[j]][0], 4 * sizeof(FLOAT));
+    counter.add(load_word(&input[i], n), n);
+  }
+}
+
+bool cpu_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+#ifdef USE_IPP
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return sfxc_math_current_isa() >= SFXC_MATH_AVX2;
+#endif
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+Bit2float_kernels bit2float_kernels() {
+  Bit2float_kernels kernels;
+  kernels.unpack_1bit = unpack_1bit;
+  kernels.unpack_2bit = unpack_2bit;
+#if defined(__x86_64__) || defined(__i386__)
+  if (cpu_has_avx2())
+    bit2float_init_avx2(kernels);
+#endif
+  return kernels;
+}
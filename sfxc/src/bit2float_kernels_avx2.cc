@@ -0,0 +1,78 @@
+/* Copyright (c) 2009 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the AVX2 implementation of the bit2float kernels
+ *
+ * A byte holds 4 samples of 2 bits. The two bytes that make up 8 output
+ * samples are broadcast to all lanes of a register, each lane shifts its
+ * own sample into the lowest bits and a permute uses these as an index
+ * into a register holding the sample values. That is, the lookup table
+ * lives in a register instead of in memory.
+ */
+#include <string.h>
+#include "bit2float_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+// Everything below is compiled for AVX2, it is only called after
+// bit2float_kernels() has verified that the CPU supports it.
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+#include <immintrin.h>
+
+namespace {
+
+#include "bit2float_level_counter.h"
+
+inline void store(float *output, __m256 samples) {
+  _mm256_storeu_ps(output, samples);
+}
+
+inline void store(double *output, __m256 samples) {
+  _mm256_storeu_pd(output, _mm256_cvtps_pd(_mm256_castps256_ps128(samples)));
+  _mm256_storeu_pd(output + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(samples, 1)));
+}
+
+void unpack_2bit(const unsigned char *input, int nbytes,
+                 FLOAT *output, int64_t *levels) {
+  // _mm256_permutevar8x32_ps only uses the lowest 3 bits of the index,
+  // the sample values are repeated such that the third bit does not matter
+  const __m256 values = _mm256_setr_ps(
+    bit2float_value_2bit[0], bit2float_value_2bit[1],
+    bit2float_value_2bit[2], bit2float_value_2bit[3],
+    bit2float_value_2bit[0], bit2float_value_2bit[1],
+    bit2float_value_2bit[2], bit2float_value_2bit[3]);
+  // Two bytes per register, the samples of the second byte start at bit 8
+  const __m256i shift = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+
+  Level_counter_2bit counter(levels);
+  int i = 0;
+  for (; i + 8 <= nbytes; i += 8) {
+    uint64_t word;
+    memcpy(&word, &input[i], sizeof(word));
+    for (int j = 0; j < 4; j++) {
+      int pair = (word >> (16 * j)) & 0xffff;
+      __m256i index = _mm256_srlv_epi32(_mm256_set1_epi32(pair), shift);
+      store(&output[4 * i + 8 * j], _mm256_permutevar8x32_ps(values, index));
+    }
+    counter.add(word, 8);
+  }
+  if (i < nbytes) {
+    uint64_t word = 0;
+    memcpy(&word, &input[i], nbytes - i);
+    for (int j = 0; j < 4 * (nbytes - i); j++)
+      output[4 * i + j] = bit2float_value_2bit[(word >> (2 * j)) & 3];
+    counter.add(word, nbytes - i);
+  }
+}
+
+} // namespace
+
+// The 1 bit samples are converted with a lookup table, one load and store
+// per byte, which is faster than computing them.
+void bit2float_init_avx2(Bit2float_kernels &kernels) {
+  kernels.unpack_2bit = unpack_2bit;
+}
+
+#pragma GCC pop_options
+#endif
@@ -1,34 +1,30 @@
 #include <math.h>
 #include "bit2float_worker.h"
 
-const FLOAT sample_value_ms[] = {
-                                  -7, -2, 2, 7
-                                };
-
-const FLOAT sample_value_m[]  = {
-                                  -5, 5
-                                };
-
 Bit2float_worker::Bit2float_worker(int stream_nr_, bit_statistics_ptr statistics_)
   : output_buffer_(new Output_queue()),
+    output_placement_(new Memory_placement(Types::channel_pool_pages)),
+    memory_pool_(32, Placed_allocator<Output_pool_data>::create(output_placement_)),
+    kernels(bit2float_kernels()), statistics(statistics_),
+    tsys_freq(80),
+    state(IDLE),
+    n_ffts_per_integration(0), current_fft(0),
     fft_size(-1),
     bits_per_sample(-1),
     sample_rate(-1),
-    tsys_freq(80),
-    memory_pool_(32),
     stream_nr(stream_nr_),
-    n_ffts_per_integration(0), current_fft(0), state(IDLE), statistics(statistics_)
+    invalid(new std::vector<Invalid>())
     /**/
 {
   SFXC_ASSERT(!memory_pool_.empty());
   // Lookup tables used in the bit2float conversion
   for (int i=0; i<256; i++) {
-    lookup_table[i][0] = sample_value_ms[i & 3];
-    lookup_table[i][1] = sample_value_ms[(i>>2) & 3];
-    lookup_table[i][2] = sample_value_ms[(i>>4) & 3];
-    lookup_table[i][3] = sample_value_ms[(i>>6) & 3];
+    lookup_table[i][0] = bit2float_value_2bit[i & 3];
+    lookup_table[i][1] = bit2float_value_2bit[(i>>2) & 3];
+    lookup_table[i][2] = bit2float_value_2bit[(i>>4) & 3];
+    lookup_table[i][3] = bit2float_value_2bit[(i>>6) & 3];
     for (int j=0; j<8 ; j++)
-      lookup_table_1bit[i][j] = sample_value_m[(i>>j) & 1];
+      lookup_table_1bit[i][j] = bit2float_value_1bit[(i>>j) & 1];
   }
 }
 
@@ -88,8 +84,14 @@ Bit2float_worker::do_task() {
         invalid_left = inp_data[read++ % inp_size];
         invalid_left |= (inp_data[read++ % inp_size] << 8);
         statistics->inc_invalid(invalid_left);
-        int start = current_fft * fft_size;
-        invalid.push_back((Invalid){start + out_index, invalid_left});
+        int start = current_fft * fft_size + out_index;
+        // Missing data arrives as a run of invalid blocks, which are
+        // merged into a single entry
+        if (!invalid->empty() &&
+            (invalid->back().start + invalid->back().n_invalid == start))
+          invalid->back().n_invalid += invalid_left;
+        else
+          invalid->push_back((Invalid){start, invalid_left});
         state = SEND_INVALID;
         break;
       }
@@ -124,7 +126,7 @@ Bit2float_worker::do_task() {
     case SEND_DATA:
     {
       if (read == write) {
-        input_buffer_->read = read;
+        input_buffer_->set_read(read);
         return samples_written;
       }
 
@@ -182,7 +184,7 @@ Bit2float_worker::do_task() {
       break;
     }
     SFXC_ASSERT(read <= write);
-    input_buffer_->read = read;
+    input_buffer_->set_read(read);
   }
   if (out_index == output_buffer_size) {
     output_buffer_->push(out_element);
@@ -199,7 +201,9 @@ Bit2float_worker::do_task() {
 
 bool
 Bit2float_worker::has_work() {
-  if( queue_.size() > 0) {
+  // The parameters of the next time slice may arrive while the current one
+  // is still being converted
+  if ((current_fft == n_ffts_per_integration) && (queue_.size() > 0)) {
     set_parameters();
   }
 
@@ -225,15 +229,28 @@ connect_to(Input_buffer_ptr buffer) {
   input_buffer_ = buffer;
 }
 
+void
+Bit2float_worker::
+set_notifier(Notifier *notifier) {
+  memory_pool_.set_notifier(notifier);
+}
+
 Bit2float_worker::Output_queue_ptr
 Bit2float_worker::
 get_output_buffer() {
   return output_buffer_;
 }
 
+Memory_placement_ptr
+Bit2float_worker::
+get_output_placement() {
+  return output_placement_;
+}
+
 void
 Bit2float_worker::
-set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &delay_table) {
+set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &delay_table,
+                   bit_statistics_ptr statistics_, Invalid_list_ptr invalid_) {
   int stream_idx = 0;
   while ((stream_idx < parameters.station_streams.size()) &&
          (parameters.station_streams[stream_idx].station_stream != stream_nr))
@@ -260,6 +277,8 @@ set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &
   new_parameters.n_ffts_per_integration =
      (int64_t) new_parameters.sample_rate * parameters.slice_size / 
      ((int64_t) new_parameters.base_sample_rate * parameters.fft_size_delaycor);
+  new_parameters.statistics = statistics_;
+  new_parameters.invalid = invalid_;
 
   queue_.push(new_parameters);
 }
@@ -277,6 +296,7 @@ set_parameters() {
   SFXC_ASSERT(((int64_t)fft_size * 1000000) % sample_rate == 0);
   nfft_max = new_parameters.n_ffts_per_buffer;
   n_ffts_per_integration = new_parameters.n_ffts_per_integration;
+  statistics = new_parameters.statistics;
   statistics->reset_statistics(bits_per_sample, sample_rate, base_sample_rate);
 
   current_fft = 0;
@@ -284,7 +304,8 @@ set_parameters() {
   sample_in_byte = 0;
   cur_delay = -1;
   allocate_element();
-  invalid.resize(0);
+  invalid = new_parameters.invalid;
+  invalid->resize(0);
   if (bits_per_sample == 2) {
     tsys_count = std::floor(new_parameters.delay_in_samples + 0.5);
     // Calculate number of samples within the full cycle.
@@ -340,21 +361,21 @@ Bit2float_worker::bit2float(FLOAT *output, int start, int nsamples, uint64_t *re
     else
       return start + samp_to_write;
 
-    // Write the main bulk of the data
+    // Write the main bulk of the data, in pieces that do not cross the
+    // end of the input buffer or a change of the tsys state
     int nbytes = nsamples / 4;
     while (nbytes > 0) {
       int index = read % dsize;
       int towrite = std::min(nbytes, dsize-index);
-      for (int end = index+towrite; index < end; index++) {
-        memcpy((char*)&output[iout],
-               &lookup_table[(int)input_data[index]][0],
-               4 * sizeof(FLOAT));
-        stats->inc_counter(input_data[index], tsys_on);
-	if (--tsys_count == 0) {
-	  tsys_count = (sample_rate / (2 * tsys_freq)) / 4;
-	  tsys_on = !tsys_on;
-	}
-        iout += 4;
+      if (tsys_count > 0)
+        towrite = std::min(towrite, tsys_count);
+      kernels.unpack_2bit(&input_data[index], towrite, &output[iout],
+                          stats->level_counters(tsys_on));
+      iout += 4 * towrite;
+      tsys_count -= towrite;
+      if (tsys_count == 0) {
+        tsys_count = (sample_rate / (2 * tsys_freq)) / 4;
+        tsys_on = !tsys_on;
       }
       nbytes -= towrite;
       nsamples -= towrite * 4;
@@ -388,13 +409,9 @@ Bit2float_worker::bit2float(FLOAT *output, int start, int nsamples, uint64_t *re
     while (nbytes>0) {
       int index = read % dsize;
       int towrite = std::min(nbytes, dsize-index);
-      for (int end = index+towrite; index < end; index++) {
-        memcpy((char*)&output[iout],
-               &lookup_table_1bit[(int)input_data[index]][0],
-               8 * sizeof(FLOAT));
-        stats->inc_counter(input_data[index], true);
-        iout += 8;
-      }
+      kernels.unpack_1bit(&input_data[index], towrite, &output[iout],
+                          stats->level_counters(true));
+      iout += 8 * towrite;
       nbytes -= towrite;
       nsamples -= towrite * 8;
       read += towrite;
@@ -419,15 +436,15 @@ Bit2float_worker::allocate_element(){
   int nsamples = nfft * fft_size;
   out_element = memory_pool_.allocate();
   
-  if(out_element.data().data.size() != nsamples)
-    out_element.data().data.resize(nsamples);
+  // Also moves the buffer if the NUMA node of the consumer changed
+  out_element.data().data.resize(nsamples);
   out_element.data().nfft = nfft;
   out_index=0;
 }
 
 std::vector<Bit2float_worker::Invalid> *
 Bit2float_worker::get_invalid(){
-  return &invalid;
+  return invalid.get();
 }
 
 void Bit2float_worker::get_state(std::ostream &out) {
@@ -7,6 +7,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <algorithm>
 #include "bit_statistics.h"
 
 const int64_t gcd(int64_t a, int64_t b)
@@ -24,6 +25,8 @@ const int64_t gcd(int64_t a, int64_t b)
 bit_statistics::bit_statistics() : bits_per_sample(-1) {
   data_counts_on.assign(256, 0);
   data_counts_off.assign(256, 0);
+  level_counts_on.assign(4, 0);
+  level_counts_off.assign(4, 0);
   nInvalid = 0;
 }
 
@@ -39,6 +42,8 @@ bit_statistics::reset_statistics(int bits_per_sample_, uint64_t sample_rate_,
   base_sample_rate = base_sample_rate_;
   data_counts_on.assign(256, 0);
   data_counts_off.assign(256, 0);
+  level_counts_on.assign(4, 0);
+  level_counts_off.assign(4, 0);
   nInvalid = 0;
 
   int64_t div = gcd(sample_rate, base_sample_rate);
@@ -72,6 +77,8 @@ bit_statistics::get_statistics() {
       }
     }
   }
+  for (int i = 0; i < (1 << std::min(bits_per_sample, 2)); i++)
+    statistics[i] += level_counts_on[i] + level_counts_off[i];
   statistics[statistics.size()-1] += nInvalid;
   for (size_t i = 0; i < statistics.size(); i++)
     statistics[i] = (base_sample_rate * statistics[i]) / sample_rate;
@@ -97,6 +104,10 @@ bit_statistics::get_tsys() {
       off[(i >> 4) & 3] += data_counts_off[i];
       off[(i >> 6) & 3] += data_counts_off[i];
     }
+    for (int i = 0; i < 4; i++) {
+      on[i] += level_counts_on[i];
+      off[i] += level_counts_off[i];
+    }
     tsys[0] = on[1] + on[2];
     tsys[1] = on[0] + on[3];
     tsys[2] = off[1] + off[2];
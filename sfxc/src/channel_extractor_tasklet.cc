@@ -9,10 +9,13 @@
 #include "channel_extractor_tasklet.h"
 #include "channel_extractor_5.h"
 #include "channel_extractor_dynamic.h"
+#include "cpu_affinity.h"
 
 #include "mark5a_header.h"
 #include "vdif_reader.h"
 
+#include <algorithm>
+
 // Number of threads for paralle processing in the channel extraction phase.
 #ifndef NUM_CHANNEL_EXTRACTOR_THREADS
 #define NUM_CHANNEL_EXTRACTOR_THREADS 0
@@ -31,6 +34,7 @@ Channel_extractor_tasklet(Data_format_reader_ptr reader)
     num_channel_extractor_threads(NUM_CHANNEL_EXTRACTOR_THREADS) {
   init_stats();
   last_duration_=0;
+  set_affinity_role(CPU_ROLE_CHANNEL_EXTRACTOR);
 #ifdef USE_EXTRACTOR_5
   ch_extractor = new Channel_extractor_5();
 #else
@@ -54,6 +58,7 @@ Channel_extractor_tasklet::process(void *self_)
 {
   Channel_extractor_tasklet *self =
     static_cast<Channel_extractor_tasklet *>(self_);
+  Cpu_affinity::Pin pin(CPU_ROLE_CHANNEL_EXTRACTOR);
 
   try {
     while (self->isrunning())
@@ -144,7 +149,9 @@ Channel_extractor_tasklet::do_task() {
   // For mark5b this is N_MK5B_BLOCKS_TO_READ as the input_element also contains
   //   a time in microseconds and not all mark5b blocks start on an integer number
   //   of microseconds
-  int n_input_samples = input_element.buffer->data.size();
+  // A frame that is entirely invalid carries no data
+  int n_input_samples = (input_element.all_invalid ? samples_per_block * N :
+                         input_element.buffer->size());
   if (n_input_samples != samples_per_block * N) {
     DEBUG_MSG(n_input_samples <<" != " << samples_per_block << " * " <<N);
   }
@@ -171,12 +178,12 @@ Channel_extractor_tasklet::do_task() {
       output_positions[subband] =
         (unsigned char *)&(output_elements[subband].channel_data.data().data[0]);
 
-      if ((subband2track[subband] & input_element.mask) != subband2track[subband]){
-        // channel is masked out
+      if (input_element.all_invalid ||
+          ((subband2track[subband] & input_element.mask) != subband2track[subband])){
+        // channel is masked out or there is no data
         output_elements[subband].invalid.resize(1);
         output_elements[subband].invalid[0].invalid_begin = 0;
-        int nbytes = input_element.buffer->data.size();
-        output_elements[subband].invalid[0].nr_invalid = nbytes * fan_out / (8 * N);
+        output_elements[subband].invalid[0].nr_invalid = n_output_bytes;
       }else{
         // Copy the invalid-data members,
         int n_invalid_blocks = input_element.invalid.size();
@@ -199,19 +206,20 @@ Channel_extractor_tasklet::do_task() {
   // Channel extract
   // This is done in a separate class to allow for different optimizations
   //timer_processing_.resume();
-  ch_extractor->extract((unsigned char *) &input_element.buffer->data[0],
-                        output_positions);
+  if (!input_element.all_invalid)
+    ch_extractor->extract((unsigned char *) input_element.buffer->begin(),
+                          output_positions);
 
   //timer_processing_.stop();
 
   if (num_channel_extractor_threads > 0) {
     pthread_mutex_lock(&seqno_lock);
-    data_processed_ += input_element.buffer->data.size();
+    data_processed_ += n_input_samples;
     while (input_element.seqno != seqno)
       pthread_cond_wait(&seqno_cond, &seqno_lock);
     pthread_mutex_unlock(&seqno_lock);
   } else {
-    data_processed_ += input_element.buffer->data.size();
+    data_processed_ += n_input_samples;
   }
 
   { // release the input buffer and put the output buffer
@@ -318,7 +326,12 @@ Channel_extractor_tasklet::get_output_buffer(size_t stream) {
     SFXC_ASSERT(stream < output_buffers_.size());
   }
   if (output_buffers_[stream] == Output_buffer_ptr()) {
-    output_buffers_[stream] = Output_buffer_ptr(new Output_buffer());
+    // Every stream gets its share of the memory pool. A stream whose
+    // reader is that far behind blocks the extractor, as an empty pool
+    // would.
+    SFXC_ASSERT(n_subbands > 0);
+    size_t capacity = std::max(output_memory_pool_.size() / n_subbands, (size_t)64);
+    output_buffers_[stream] = Output_buffer_ptr(new Output_buffer(capacity));
   }
   SFXC_ASSERT(output_buffers_[stream] != Output_buffer_ptr());
   return output_buffers_[stream];
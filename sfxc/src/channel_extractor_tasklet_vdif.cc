@@ -41,7 +41,7 @@ Channel_extractor_tasklet_VDIF::do_task() {
     output_element.invalid[i].nr_invalid = input_element.invalid[i].nr_invalid;
     SFXC_ASSERT(output_element.invalid[i].nr_invalid >= 0);
   }
-  data_processed_ += input_element.buffer->data.size();
+  data_processed_ += input_element.buffer->size();
 
   SFXC_ASSERT(output_buffers_[input_element.channel] != Output_buffer_ptr());
   output_buffers_[input_element.channel]->push(output_element);
@@ -1,14 +1,25 @@
 #include "control_parameters.h"
 #include "output_header.h"
 #include "utils.h"
+#include "cpu_affinity.h"
+#include "async_file_reader.h"
 
 #include <fstream>
+#include <sstream>
 #include <set>
 #include <cstring>
 #include <cctype>
 #include <math.h>
 
 #include <libgen.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
 
 #include <json/json.h>
 #include <algorithm>
@@ -67,6 +78,13 @@ initialise(const char *ctrl_file, const char *vex_file,
   if (ctrl["delay_directory"] == Json::Value()) {
     ctrl["delay_directory"] = "file:///tmp/";
   }
+  if (ctrl["delay_cache_directory"] == Json::Value()) {
+    const char *home = getenv("HOME");
+    if (home != NULL)
+      ctrl["delay_cache_directory"] = std::string("file://") + home + "/.sfxc/delay_cache";
+    else
+      ctrl["delay_cache_directory"] = "";
+  }
 
   // set the subbands
   if (ctrl["channels"] == Json::Value()) {
@@ -216,6 +234,30 @@ initialise(const char *ctrl_file, const char *vex_file,
   if (ctrl["output_buffer_size"] == Json::Value())
     ctrl["output_buffer_size"] = 5000 * 250;
 
+  if (ctrl["read_ahead_depth"] == Json::Value())
+    ctrl["read_ahead_depth"] = 4;
+
+  if (ctrl["read_ahead_block_size"] == Json::Value())
+    ctrl["read_ahead_block_size"] = 4 * 1024 * 1024;
+
+  if (ctrl["correlation_threads"] == Json::Value())
+    ctrl["correlation_threads"] = 1;
+
+  if (ctrl["delay_threads"] == Json::Value())
+    ctrl["delay_threads"] = 1;
+
+  if (ctrl["bit2float_threads"] == Json::Value())
+    ctrl["bit2float_threads"] = 1;
+
+  if (ctrl["correlator_node_channels"] == Json::Value())
+    ctrl["correlator_node_channels"] = 1;
+
+  if (ctrl["correlator_node_pipeline_depth"] == Json::Value())
+    ctrl["correlator_node_pipeline_depth"] = 1;
+
+  if (ctrl["fft_planning"] == Json::Value())
+    ctrl["fft_planning"] = "ESTIMATE";
+
   if (ctrl["start"].asString().compare("now") == 0) {
     char *now;
     time_t t;
@@ -259,6 +301,8 @@ Control_parameters::check_data_source(std::ostream &writer,
     std::string filename = create_path((*source_it).asString());
 
     if (filename.find("file://")  != 0 &&
+	filename.find("mmap://") != 0 &&
+	filename.find("udp://") != 0 &&
 	filename.find("mk5://") != 0) {
       ok = false;
       writer << "Ctrl-file: invalid data source '" << filename << "'"
@@ -399,7 +443,7 @@ Control_parameters::check(std::ostream &writer) const {
       int numproc, minproc;
       MPI_Comm_size(MPI_COMM_WORLD, &numproc);
       std::string mode = get_vex().get_mode(scan(scan(ctrl["start"].asString())));
-      minproc = 3 + number_inputs() + number_correlation_cores_per_timeslice(mode);
+      minproc = 3 + number_inputs() + number_correlator_nodes(mode);
 
       if (numproc < minproc) {
         writer << "#correlator nodes < #freq. channels, use at least "
@@ -460,6 +504,16 @@ Control_parameters::check(std::ostream &writer) const {
     }
   }
 
+  // Check FFTW wisdom file
+  if (ctrl["fft_wisdom_file"] != Json::Value()) {
+    std::string filename = create_path(ctrl["fft_wisdom_file"].asString());
+    if (strncmp(filename.c_str(), "file://", 7) != 0) {
+      ok = false;
+      writer << "Ctrl-file: FFTW wisdom file should start with 'file://'"
+	     << std::endl;
+    }
+  }
+
   // Check mask parameters
   if (ctrl["mask"] != Json::Value()) {
     if (ctrl["mask"]["mask"] != Json::Value()) {
@@ -493,6 +547,36 @@ Control_parameters::check(std::ostream &writer) const {
     }
   }
   
+  // Check FFT planning rigor
+  {
+    std::string planning = ctrl["fft_planning"].asString();
+    for(int i = 0; i < planning.size(); i++)
+      planning[i] = toupper(planning[i]);
+    if ((planning != "ESTIMATE") and (planning != "MEASURE") and (planning != "PATIENT")){
+      writer << "Invalid fft_planning " << planning
+             << ", valid choises are : ESTIMATE, MEASURE, and PATIENT" << std::endl;
+      ok = false;
+    }
+  }
+
+  // Check the CPU affinity map
+  if (ctrl["cpu_map"] != Json::Value()) {
+    bool valid = ctrl["cpu_map"].isString();
+    if (ctrl["cpu_map"].isArray()) {
+      valid = true;
+      for (size_t i = 0; i < ctrl["cpu_map"].size(); i++)
+        valid = valid && ctrl["cpu_map"][i].isString();
+    }
+    std::string error;
+    if (!valid) {
+      writer << "Ctrl-file: cpu_map should be a string or a list of strings" << std::endl;
+      ok = false;
+    } else if (!Cpu_affinity::set_map(cpu_map(), -1, error)) {
+      writer << "Ctrl-file: Invalid cpu_map: " << error << std::endl;
+      ok = false;
+    }
+  }
+
   // Check pulsar binning
   if (ctrl["pulsar_binning"].asBool()){
     // use pulsar binning
@@ -561,6 +645,42 @@ Control_parameters::check(std::ostream &writer) const {
     ok = false;
     writer << "Ctrl-file: Invalid output buffer size " << std::endl;
   }
+  if (ctrl["correlation_threads"].asInt() <= 0) {
+    ok = false;
+    writer << "Ctrl-file: Invalid number of correlation threads " << std::endl;
+  }
+  if (ctrl["delay_threads"].asInt() <= 0) {
+    ok = false;
+    writer << "Ctrl-file: Invalid number of delay correction threads " << std::endl;
+  }
+  if (ctrl["bit2float_threads"].asInt() <= 0) {
+    ok = false;
+    writer << "Ctrl-file: Invalid number of bit2float threads " << std::endl;
+  }
+  if (ctrl["correlator_node_channels"].asInt() <= 0) {
+    ok = false;
+    writer << "Ctrl-file: Invalid number of channels per correlator node " << std::endl;
+  }
+  if (ctrl["correlator_node_pipeline_depth"].asInt() <= 0) {
+    ok = false;
+    writer << "Ctrl-file: Invalid correlator node pipeline depth " << std::endl;
+  }
+  if (!ctrl["delay_cache_directory"].asString().empty() &&
+      (strncmp(ctrl["delay_cache_directory"].asString().c_str(), "file://", 7) != 0)) {
+    ok = false;
+    writer << "Ctrl-file: Delay cache directory doesn't start with 'file://'" << std::endl;
+  }
+  if ((ctrl["read_ahead_depth"].asInt() <= 0) ||
+      (ctrl["read_ahead_depth"].asInt() > Async_file_reader::MAX_DEPTH)) {
+    ok = false;
+    writer << "Ctrl-file: read_ahead_depth should be between 1 and "
+           << Async_file_reader::MAX_DEPTH << std::endl;
+  }
+  if (ctrl["read_ahead_block_size"].asInt() < (int)Async_file_reader::ALIGNMENT) {
+    ok = false;
+    writer << "Ctrl-file: read_ahead_block_size should be at least "
+           << Async_file_reader::ALIGNMENT << " bytes" << std::endl;
+  }
 
   return ok;
 }
@@ -683,6 +803,16 @@ Control_parameters::exit_on_empty_datastream() const{
   return ctrl["exit_on_empty_datastream"].asBool();
 }
 
+int
+Control_parameters::read_ahead_depth() const {
+  return ctrl["read_ahead_depth"].asInt();
+}
+
+int
+Control_parameters::read_ahead_block_size() const {
+  return ctrl["read_ahead_block_size"].asInt();
+}
+
 int
 Control_parameters::number_channels() const {
   return ctrl["number_channels"].asInt();
@@ -796,6 +926,63 @@ Control_parameters::output_buffer_size() const {
   return ctrl["output_buffer_size"].asInt();
 }
 
+int
+Control_parameters::correlation_threads() const {
+  return ctrl["correlation_threads"].asInt();
+}
+
+int
+Control_parameters::delay_threads() const {
+  return ctrl["delay_threads"].asInt();
+}
+
+int
+Control_parameters::bit2float_threads() const {
+  return ctrl["bit2float_threads"].asInt();
+}
+
+int
+Control_parameters::correlator_node_channels() const {
+  return ctrl["correlator_node_channels"].asInt();
+}
+
+int
+Control_parameters::correlator_node_pipeline_depth() const {
+  return ctrl["correlator_node_pipeline_depth"].asInt();
+}
+
+int
+Control_parameters::fft_planning() const {
+  std::string planning = ctrl["fft_planning"].asString();
+  for(int i = 0; i < planning.size(); i++)
+    planning[i] = toupper(planning[i]);
+  if (planning == "MEASURE")
+    return SFXC_FFT_MEASURE;
+  else if (planning == "PATIENT")
+    return SFXC_FFT_PATIENT;
+  return SFXC_FFT_ESTIMATE;
+}
+
+std::string
+Control_parameters::cpu_map() const {
+  const Json::Value &map = ctrl["cpu_map"];
+  if (map.isString())
+    return map.asString();
+  std::string result;
+  if (map.isArray()) {
+    for (size_t i = 0; i < map.size(); i++)
+      result += map[i].asString() + ";";
+  }
+  return result;
+}
+
+std::string
+Control_parameters::get_fft_wisdom_file() const {
+  if (ctrl["fft_wisdom_file"] == Json::Value())
+    return std::string();
+  return create_path(ctrl["fft_wisdom_file"].asString());
+}
+
 std::string
 Control_parameters::sideband(int i) const {
   return ctrl["subbands"][i]["sideband"].asString();
@@ -1139,6 +1326,15 @@ Control_parameters::number_stations_in_scan(const std::string& scan) const {
   return n_stations;
 }
 
+int
+Control_parameters::
+number_correlator_nodes(const std::string &mode) const {
+  // Every correlator node correlates up to correlator_node_channels()
+  // channels of a time slice concurrently
+  int n_channels = correlator_node_channels();
+  return (number_correlation_cores_per_timeslice(mode) + n_channels - 1) / n_channels;
+}
+
 int
 Control_parameters::
 number_correlation_cores_per_timeslice(const std::string &mode) const {
@@ -1854,6 +2050,8 @@ get_input_node_parameters(const std::string &mode_name,
   result.overlap_time =  0;
   result.phasecal_integr_time = phasecal_integration_time();
   result.exit_on_empty_datastream = exit_on_empty_datastream();
+  result.read_ahead_depth = read_ahead_depth();
+  result.read_ahead_block_size = read_ahead_block_size();
 
   const Vex::Node &root = vex.get_root_node();
   Vex::Node::const_iterator mode = root["MODE"][mode_name];
@@ -2288,6 +2486,15 @@ get_correlation_parameters(const std::string &scan_name,
   corr_param.fft_size_delaycor = fft_size_delaycor();
   corr_param.fft_size_correlation = fft_size_correlation();
   corr_param.window = window_function();  
+  corr_param.correlation_threads = correlation_threads();
+  corr_param.delay_threads = delay_threads();
+  corr_param.bit2float_threads = bit2float_threads();
+  corr_param.pipeline_depth = correlator_node_pipeline_depth();
+  corr_param.fft_planning = fft_planning();
+  // The correlator nodes open the wisdom file directly, strip "file://"
+  std::string wisdom_file = get_fft_wisdom_file();
+  if (wisdom_file.size() > 7)
+    corr_param.fft_wisdom_file = wisdom_file.substr(7);
   corr_param.sample_rate = sample_rate(mode_name, station_name);
 
   corr_param.sideband = ' ';
@@ -2441,7 +2648,7 @@ get_delay_table_name(const std::string &station_name) const {
 
   if (access(delay_table_name.c_str(), R_OK) == 0)
     return delay_table_name;
-  generate_delay_table(station_name, delay_table_name);
+  generate_delay_tables(std::vector<std::string>(1, station_name));
   if (access(delay_table_name.c_str(), R_OK) == 0)
     return delay_table_name;
   DEBUG_MSG("Tried to create the delay table at " << delay_table_name);
@@ -2449,24 +2656,225 @@ get_delay_table_name(const std::string &station_name) const {
   return std::string("");
 }
 
+namespace {
+
+// Increased when the format of the delay tables changes, such that
+// tables in the cache from an older generate_delay_model are not used
+const char *DELAY_CACHE_VERSION = "1";
+
+uint64_t fnv1a_hash(const std::string &data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < data.size(); i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// The files of calc that generate_delay_model reads from CALC_DIR, or
+// from the working directory if CALC_DIR is not set
+const char *CALC_FILES[] = {"ocean.dat", "tilt.dat", "DE405_le.jpl"};
+
+// Adds the calc directory and the size and modification time of the
+// calc files in it to the key of a cached delay table
+void add_calc_files_to_key(std::ostream &key) {
+  const char *calc_dir = getenv("CALC_DIR");
+  std::string directory;
+  if (calc_dir != NULL) {
+    directory = calc_dir;
+  } else {
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) != NULL)
+      directory = cwd;
+  }
+  key << "CALC_DIR " << directory << "\n";
+  for (size_t i = 0; i < sizeof(CALC_FILES) / sizeof(CALC_FILES[0]); i++) {
+    std::string filename = directory + "/" + CALC_FILES[i];
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0)
+      key << CALC_FILES[i] << " " << (long long)st.st_size << " "
+          << (long long)st.st_mtime << "\n";
+    else
+      key << CALC_FILES[i] << " missing\n";
+  }
+}
+
+// Creates path and its parent directories, returns false on failure
+bool create_directories(const std::string &path) {
+  size_t pos = 0;
+  while (pos != std::string::npos) {
+    pos = path.find('/', pos + 1);
+    std::string dir = path.substr(0, pos);
+    if ((mkdir(dir.c_str(), S_IRWXU) != 0) && (errno != EEXIST))
+      return false;
+  }
+  return true;
+}
+
+// Puts the cached table at filename, as a hard link if possible
+bool install_delay_table(const std::string &cached, const std::string &filename) {
+  if ((link(cached.c_str(), filename.c_str()) == 0) || (errno == EEXIST))
+    return (access(filename.c_str(), R_OK) == 0);
+  std::string tmp_name = filename + ".tmp." + itoa(getpid());
+  {
+    std::ifstream in(cached.c_str(), std::ios::binary);
+    std::ofstream out(tmp_name.c_str(), std::ios::binary);
+    out << in.rdbuf();
+    if (!in.good() || !out.good()) {
+      unlink(tmp_name.c_str());
+      return false;
+    }
+  }
+  return (rename(tmp_name.c_str(), filename.c_str()) == 0);
+}
+
+} // namespace
+
+std::string
+Control_parameters::
+delay_cache_name(const std::string &station_name) const {
+  const std::string &directory = ctrl["delay_cache_directory"].asString();
+  if (directory.size() <= 7)
+    return std::string();
+
+  // Everything generate_delay_model reads from the vex file for this
+  // station and the calc files it uses. The clock offsets are applied by
+  // the correlator and are not part of the table, a new clock search
+  // therefore reuses the tables.
+  const Vex::Node &root = vex.get_root_node();
+  std::stringstream key;
+  key << DELAY_CACHE_VERSION << "\n" << station_name << "\n";
+  add_calc_files_to_key(key);
+  Vex::Node::const_iterator station = root["STATION"][station_name];
+  if (station == root["STATION"]->end())
+    return std::string();
+  key << *station;
+  const char *station_blocks[] = {"SITE", "ANTENNA"};
+  for (size_t i = 0; i < 2; i++) {
+    Vex::Node::const_iterator ref = station[station_blocks[i]];
+    Vex::Node::const_iterator block = root[station_blocks[i]];
+    if ((ref == station->end()) || (block == root.end()))
+      continue;
+    Vex::Node::const_iterator def = block[ref->to_string()];
+    if (def != block->end())
+      key << *def;
+  }
+  const char *blocks[] = {"SOURCE", "EOP", "SCHED"};
+  for (size_t i = 0; i < 3; i++) {
+    if (root[blocks[i]] != root.end())
+      key << *root[blocks[i]];
+  }
+
+  char hash[17];
+  snprintf(hash, sizeof(hash), "%016llx",
+           (unsigned long long)fnv1a_hash(key.str()));
+  return directory.substr(7) + "/" + station_name + "-" + hash + ".del";
+}
+
 void
 Control_parameters::
-generate_delay_table(const std::string &station_name,
-                     const std::string &filename) const {
-  std::string cmd =
-    "generate_delay_model "+vex_filename+" "+station_name+" "+filename;
-  DEBUG_MSG("Creating the delay model: " << cmd);
-  int result = system(cmd.c_str());
-  if (result != 0) {
+generate_delay_tables(const std::vector<std::string> &stations) const {
+  // The tables that have to be generated, and where they are written
+  std::vector<std::string> jobs_station, jobs_output;
+  std::vector<std::string> table_names;
+  for (size_t i = 0; i < stations.size(); i++) {
+    std::string delay_table_name;
+    if (ctrl["delay_directory"].asString().size()==7)
+      delay_table_name = get_exper_name() + "_" + stations[i] + ".del";
+    else
+      delay_table_name = std::string(ctrl["delay_directory"].asString().c_str()+7) +
+        "/" + get_exper_name() + "_" + stations[i] + ".del";
+    table_names.push_back(delay_table_name);
+    if (access(delay_table_name.c_str(), R_OK) == 0)
+      continue;
+
+    std::string cached = delay_cache_name(stations[i]);
+    if (!cached.empty()) {
+      if ((access(cached.c_str(), R_OK) == 0) &&
+          install_delay_table(cached, delay_table_name)) {
+        DEBUG_MSG("Using cached delay table " << cached);
+        continue;
+      }
+      std::string directory = cached.substr(0, cached.rfind('/'));
+      if (!create_directories(directory)) {
+        DEBUG_MSG("Cannot create the delay cache directory " << directory);
+        cached = std::string();
+      }
+    }
+    jobs_station.push_back(stations[i]);
+    jobs_output.push_back(cached.empty() ? delay_table_name : cached);
+  }
+  if (jobs_station.empty())
+    return;
+
+  // Run the generators in parallel, at most one per core. Each writes to a
+  // temporary file that is renamed when it is complete, such that other
+  // jobs using the same cache never see a partial table.
+  long nr_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max_running = (nr_cores > 0 ? nr_cores : 1);
+  std::map<pid_t, size_t> running;
+  std::vector<std::string> tmp_names(jobs_station.size());
+  size_t next = 0;
+  bool ok = true;
+  while ((next < jobs_station.size()) || !running.empty()) {
+    while (ok && (next < jobs_station.size()) && (running.size() < max_running)) {
+      tmp_names[next] = jobs_output[next] + ".tmp." + itoa(getpid());
+      DEBUG_MSG("Creating the delay model: generate_delay_model " << vex_filename
+                << " " << jobs_station[next] << " " << tmp_names[next]);
+      char *argv[] = {
+        (char *)"generate_delay_model", (char *)vex_filename.c_str(),
+        (char *)jobs_station[next].c_str(), (char *)tmp_names[next].c_str(), NULL };
+      pid_t pid;
+      if (posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) != 0) {
+        ok = false;
+        break;
+      }
+      running[pid] = next;
+      next++;
+    }
+    if (running.empty())
+      break;
+
+    // Only the generators are reaped, not other children of the process
+    bool reaped = false;
+    std::map<pid_t, size_t>::iterator it = running.begin();
+    while (it != running.end()) {
+      int status;
+      pid_t pid = waitpid(it->first, &status, WNOHANG);
+      if ((pid == 0) || ((pid < 0) && (errno == EINTR))) {
+        it++;
+        continue;
+      }
+      size_t job = it->second;
+      running.erase(it++);
+      reaped = true;
+      if ((pid < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0) ||
+          (rename(tmp_names[job].c_str(), jobs_output[job].c_str()) != 0)) {
+        unlink(tmp_names[job].c_str());
+        ok = false;
+      }
+    }
+    if (!reaped)
+      usleep(10000);
+  }
+  if (!ok)
     sfxc_abort("Generation of the delay table failed (generate_delay_model)");
+
+  for (size_t i = 0; i < jobs_station.size(); i++) {
+    if (jobs_output[i] == table_names[i])
+      continue;
+    if (!install_delay_table(jobs_output[i], table_names[i])) {
+      LOG_MSG("Cannot copy " << jobs_output[i] << " to " << table_names[i]);
+    }
   }
 }
 
 std::string
 Control_parameters::create_path(const std::string &path) const {
-  if (strncmp(path.c_str(), "file://", 7) == 0) {
+  if ((strncmp(path.c_str(), "file://", 7) == 0) ||
+      (strncmp(path.c_str(), "mmap://", 7) == 0)) {
     if (path[7] != '/') {
-      std::string result = "file://";
+      std::string result = path.substr(0, 7);
       char c_ctrl_filename[ctrl_filename.size()+1];
       strcpy(c_ctrl_filename, ctrl_filename.c_str());
       result += dirname(c_ctrl_filename);
@@ -2497,6 +2905,9 @@ operator<<(std::ostream &out,
   out << "{ \"n_tracks\": " << param.n_tracks << ", "
       <<"\"track_bit_rate\": " << param.track_bit_rate << ", "
       << std::endl;
+  out << " \"read_ahead_depth\": " << param.read_ahead_depth << ", "
+      << "\"read_ahead_block_size\": " << param.read_ahead_block_size << ", "
+      << std::endl;
 
   out << " channels: [";
   for (size_t i=0; i<param.channels.size(); i++) {
@@ -2615,6 +3026,13 @@ std::ostream &operator<<(std::ostream &out,
   out << "  \"fft_size_delaycor\": " << param.fft_size_delaycor << ", " << std::endl;
   out << "  \"fft_size_correlation\": " << param.fft_size_correlation << ", " << std::endl;
   out << "  \"window\": " << param.window << ", " << std::endl;
+  out << "  \"correlation_threads\": " << param.correlation_threads << ", " << std::endl;
+  out << "  \"delay_threads\": " << param.delay_threads << ", " << std::endl;
+  out << "  \"bit2float_threads\": " << param.bit2float_threads << ", " << std::endl;
+  out << "  \"pipeline_depth\": " << param.pipeline_depth << ", " << std::endl;
+  out << "  \"lane\": " << param.lane << ", " << std::endl;
+  out << "  \"fft_planning\": " << param.fft_planning << ", " << std::endl;
+  out << "  \"fft_wisdom_file\": \"" << param.fft_wisdom_file << "\", " << std::endl;
   out << "  \"slice_nr\": " << param.slice_nr << ", " << std::endl;
   out << "  \"sample_rate\": " << param.sample_rate << ", " << std::endl;
   out << "  \"channel_freq\": " << param.channel_freq << ", " << std::endl;
@@ -1,13 +1,22 @@
 #include "correlation_core.h"
 #include "output_header.h"
+#include "cpu_affinity.h"
 #include <utils.h>
 #include <climits>
 #include <complex>
+#include <algorithm>
 #include <set>
 
+// Size of the working set of one frequency block in the correlation
+// kernel; it should fit in the L2 cache of a core.
+#ifndef CORRELATION_BLOCK_BYTES
+#define CORRELATION_BLOCK_BYTES (256 * 1024)
+#endif
+
 Correlation_core::Correlation_core()
   : current_fft(0), total_ffts(0), n_phase_centre_written(0), 
     tsys_written(false) {
+  thread_pool.set_affinity_role(CPU_ROLE_CORRELATION);
 }
 
 Correlation_core::~Correlation_core() {
@@ -90,6 +99,13 @@ void Correlation_core::connect_to(size_t stream, bit_statistics_ptr statistics_,
   statistics[stream] = statistics_;
 }
 
+void Correlation_core::set_slice_statistics(size_t stream, bit_statistics_ptr statistics_,
+                                            std::vector<Invalid> *invalid_) {
+  SFXC_ASSERT(stream < statistics.size());
+  statistics[stream] = statistics_;
+  connect_to(stream, invalid_);
+}
+
 void
 Correlation_core::set_parameters(const Correlation_parameters &parameters,
                                  std::vector<Delay_table_akima> &delays,
@@ -131,6 +147,7 @@ Correlation_core::set_parameters(const Correlation_parameters &parameters,
     input_conj_buffers.resize(number_input_streams());
   }
   n_flagged.resize(baselines.size());
+  thread_pool.resize(parameters.correlation_threads);
 }
 
 void
@@ -243,34 +260,83 @@ void Correlation_core::integration_step(std::vector<Complex_buffer> &integration
 #ifndef DUMMY_CORRELATION
   SFXC_ASSERT(nbuffer * stride <= input_conj_buffers[0].size());
 
-  // Auto correlations
-  for (size_t i = 0; i < number_input_streams(); i++) {
-    for (size_t buf_idx = 0; buf_idx < nbuffer * stride; buf_idx += stride) {
-      // get the complex conjugates of the input
-      SFXC_CONJ_FC(&input_elements[i][buf_idx], &(input_conj_buffers[i])[buf_idx], fft_size() + 1);
-      SFXC_ADD_PRODUCT_FC(/* in1 */ &input_elements[i][buf_idx], 
-			  /* in2 */ &input_conj_buffers[i][buf_idx],
-			  /* out */ &integration_buffer[i][0], fft_size() + 1);
-    }
-  }
+  // Every thread in the pool processes its own range of frequencies
+  Integration_job job(*this, integration_buffer, nbuffer, stride);
+  thread_pool.run(job);
+#endif // DUMMY_CORRELATION
+}
 
-  // Cross correlations
-  for (size_t i = number_input_streams(); i < baselines.size(); i++) {
-    for (size_t buf_idx = 0; buf_idx < nbuffer * stride; buf_idx += stride) {
-      std::pair<size_t, size_t> &baseline = baselines[i];
-      SFXC_ASSERT(baseline.first != baseline.second);
-      if ((i % 2) == 0 || 1) {
-      SFXC_ADD_PRODUCT_FC(/* in1 */ &input_elements[baseline.first][buf_idx], 
-			  /* in2 */ &input_conj_buffers[baseline.second][buf_idx],
-			  /* out */ &integration_buffer[i][0], fft_size() + 1);
-      } else {
-      SFXC_ADD_PRODUCT_FC(/* in1 */ &input_conj_buffers[baseline.first][buf_idx], 
-			  /* in2 */ &input_elements[baseline.second][buf_idx],
-			  /* out */ &integration_buffer[i][0], fft_size() + 1);
+void Correlation_core::Integration_job::execute(int part, int nparts) {
+  const size_t size = core.fft_size() + 1;
+  // Keep the boundaries aligned to 16 points such that two threads
+  // never write to the same cache line
+  size_t begin = (size * part / nparts) & ~(size_t)15;
+  size_t end = (part == nparts - 1) ? size : ((size * (part + 1) / nparts) & ~(size_t)15);
+  if (begin < end)
+    core.integration_step_block(integration_buffer, nbuffer, stride, begin, end);
+}
+
+void Correlation_core::integration_step_block(std::vector<Complex_buffer> &integration_buffer,
+                                              int nbuffer, int stride, size_t begin, size_t end) {
+  // The frequency range is processed in blocks that are small enough
+  // to keep the inputs of all streams in the cache while the baselines
+  // are accumulated. If there are many ffts per step, they are processed
+  // in groups of buffers_per_block.
+  size_t block, buffers_per_block;
+  block_size(nbuffer, block, buffers_per_block);
+  for (size_t chunk = begin; chunk < end; chunk += block) {
+    const size_t n = std::min(block, end - chunk);
+    for (size_t first = 0; first < (size_t)nbuffer; first += buffers_per_block) {
+      const size_t buf_begin = first * stride;
+      const size_t buf_end = std::min(first + buffers_per_block, (size_t)nbuffer) * stride;
+
+      // Auto correlations
+      for (size_t i = 0; i < number_input_streams(); i++) {
+        for (size_t buf_idx = buf_begin; buf_idx < buf_end; buf_idx += stride) {
+          const size_t idx = buf_idx + chunk;
+          // get the complex conjugates of the input
+          SFXC_CONJ_FC(&input_elements[i][idx], &(input_conj_buffers[i])[idx], n);
+          SFXC_ADD_PRODUCT_FC(/* in1 */ &input_elements[i][idx],
+                              /* in2 */ &input_conj_buffers[i][idx],
+                              /* out */ &integration_buffer[i][chunk], n);
+        }
+      }
+
+      // Cross correlations
+      for (size_t i = number_input_streams(); i < baselines.size(); i++) {
+        std::pair<size_t, size_t> &baseline = baselines[i];
+        SFXC_ASSERT(baseline.first != baseline.second);
+        for (size_t buf_idx = buf_begin; buf_idx < buf_end; buf_idx += stride) {
+          const size_t idx = buf_idx + chunk;
+          SFXC_ADD_PRODUCT_FC(/* in1 */ &input_elements[baseline.first][idx],
+                              /* in2 */ &input_conj_buffers[baseline.second][idx],
+                              /* out */ &integration_buffer[i][chunk], n);
+        }
       }
     }
   }
-#endif // DUMMY_CORRELATION
+}
+
+void Correlation_core::block_size(int nbuffer, size_t &block, size_t &buffers_per_block) {
+  // Per frequency point we touch the input and its conjugate for every
+  // stream and every fft of the step, and one accumulator for every
+  // baseline
+  const size_t point = sizeof(std::complex<FLOAT>);
+  const size_t input_bytes = 2 * number_input_streams() * point;
+  const size_t accumulator_bytes = baselines.size() * point;
+  const size_t min_block = 64;
+  buffers_per_block = std::max(nbuffer, 1);
+  block = (CORRELATION_BLOCK_BYTES / (buffers_per_block * input_bytes + accumulator_bytes)) & ~(size_t)15;
+  if (block >= min_block)
+    return;
+
+  // Too many ffts for a reasonable block, process the ffts in groups
+  block = min_block;
+  const size_t bytes_per_point = CORRELATION_BLOCK_BYTES / min_block;
+  if (bytes_per_point > accumulator_bytes + input_bytes)
+    buffers_per_block = (bytes_per_point - accumulator_bytes) / input_bytes;
+  else
+    buffers_per_block = 1;
 }
 
 void Correlation_core::integration_normalize(std::vector<Complex_buffer> &integration_buffer) {
@@ -584,23 +650,8 @@ Correlation_core::uvshift(const Complex_buffer &input_buffer, Complex_buffer &ou
   double phi = base_freq * (ddelay1 * (1 - rate1) - ddelay2 * (1 - rate2));
   phi = 2 * M_PI * sb * (phi - floor(phi));
   double delta = 2 * M_PI * dfreq * (ddelay1 * (1 - rate1) - ddelay2 * (1 - rate2));
-  double temp=sin(delta/2);
-  const double a=2*temp*temp,b=sin(delta);
-  double cos_phi, sin_phi;
-#ifdef HAVE_SINCOS
-  sincos(phi, &sin_phi, &cos_phi);
-#else
-  sin_phi = sin(phi);
-  cos_phi = cos(phi);
-#endif 
-  const int size = input_buffer.size();
-  for (int i = 0; i < size; i++) {
-    output_buffer[i] += amplitude * input_buffer[i] * std::complex<FLOAT>(cos_phi, sin_phi);
-    // Compute sin_phi=sin(phi); cos_phi = cos(phi);
-    temp=sin_phi-(a*sin_phi-b*cos_phi);
-    cos_phi=cos_phi-(a*cos_phi+b*sin_phi);
-    sin_phi=temp;
-  }
+  SFXC_ADD_ROTATE_FC(&input_buffer[0], &output_buffer[0], input_buffer.size(),
+                     phi, delta, amplitude);
 }
 
 void Correlation_core::add_source_list(const std::map<std::string, int> &sources_){
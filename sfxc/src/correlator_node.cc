@@ -10,26 +10,38 @@
 
 #include "correlator_node.h"
 #include "utils.h"
+#include "cpu_affinity.h"
+#include "mpi_transfer.h"
 #ifdef USE_IPP
 #include <ippcore.h>
 #endif
-Correlator_node::Correlator_node(int rank, int nr_corr_node, bool pulsar_binning_, bool phased_array_)
+Correlator_node::Correlator_node(int rank, int nr_corr_node, int n_lanes,
+                                 bool pulsar_binning_, bool phased_array_)
     : Node(rank),
     correlator_node_ctrl(*this),
     data_readers_ctrl(*this),
     data_writer_ctrl(*this),
     status(CORRELATING),
     pulsar_binning(pulsar_binning_),
-    pulsar_parameters(get_log_writer()),
-    tasklet(nr_corr_node, pulsar_binning_, phased_array_) {
+    pulsar_parameters(get_log_writer()) {
   #ifdef USE_IPP
   ippSetNumThreads(1);
   #endif
-  get_log_writer()(1) << "Correlator_node(" << nr_corr_node << ")" << std::endl;
+  get_log_writer()(1) << "Correlator_node(" << nr_corr_node << ", "
+                      << n_lanes << ")" << std::endl;
+  SFXC_ASSERT(n_lanes > 0);
+  for (int lane = 0; lane < n_lanes; lane++) {
+    tasklets.push_back(new Correlator_node_tasklet(nr_corr_node + lane, tables,
+                                                   pulsar_binning_, phased_array_));
+  }
   add_controller(&correlator_node_ctrl);
   add_controller(&data_readers_ctrl);
   add_controller(&data_writer_ctrl);
 
+  // The manager node prefers to give slices to correlator nodes on the
+  // host of the input nodes
+  std::vector<uint64_t> no_ports;
+  MPI_Transfer::send_ip_address(no_ports, RANK_MANAGER_NODE);
 
   int32_t msg;
   MPI_Send(&msg, 1, MPI_INT32,
@@ -39,15 +51,20 @@ Correlator_node::Correlator_node(int rank, int nr_corr_node, bool pulsar_binning
 }
 
 Correlator_node::~Correlator_node() {
+  for (size_t i = 0; i < tasklets.size(); i++)
+    delete tasklets[i];
 }
 
 void Correlator_node::start_threads() {
-  tasklet.start();
+  for (size_t i = 0; i < tasklets.size(); i++)
+    tasklets[i]->start();
 }
 
 void Correlator_node::stop_threads() {
-  tasklet.terminate();
-  wait(tasklet);
+  for (size_t i = 0; i < tasklets.size(); i++)
+    tasklets[i]->terminate();
+  for (size_t i = 0; i < tasklets.size(); i++)
+    wait(*tasklets[i]);
 }
 
 void Correlator_node::start() {
@@ -62,39 +79,41 @@ void Correlator_node::terminate() {
 }
 
 void Correlator_node::main_loop() {
-  while ( status != END_NODE ) {
-    if (check_and_process_waiting_message() == NO_MESSAGE)
-      usleep(100);
-  }
+  while ( status != END_NODE )
+    poll_messages();
   stop_threads();
 }
 
 void Correlator_node::add_delay_table(Delay_table &table, int sn1, int sn2) {
-  tasklet.add_delay_table(table, sn1, sn2);
+  tables.add_delay_table(table, sn1, sn2);
 }
 
 void Correlator_node::add_uvw_table(Uvw_model &table, int sn) {
-  tasklet.add_uvw_table(table, sn);
+  tables.add_uvw_table(table, sn);
 }
 
-void Correlator_node::hook_added_data_reader(size_t stream_nr) {
-  tasklet.hook_added_data_reader(stream_nr, data_readers_ctrl.get_data_reader(stream_nr));
+void Correlator_node::hook_added_data_reader(size_t reader) {
+  size_t lane = reader % tasklets.size();
+  tasklets[lane]->hook_added_data_reader(reader / tasklets.size(),
+                                         data_readers_ctrl.get_data_reader(reader));
 }
 
 
 void Correlator_node::hook_added_data_writer(size_t i) {
-  SFXC_ASSERT(i == 0);
-  tasklet.hook_added_data_writer(i, data_writer_ctrl.get_data_writer(0));
+  SFXC_ASSERT(i < tasklets.size());
+  tasklets[i]->hook_added_data_writer(0, data_writer_ctrl.get_data_writer(i));
 }
 
 void
 Correlator_node::add_source_list(const std::map<std::string, int> &sources) {
-  tasklet.add_source_list(sources);
+  for (size_t i = 0; i < tasklets.size(); i++)
+    tasklets[i]->add_source_list(sources);
 }
 
 void
 Correlator_node::receive_parameters(const Correlation_parameters &parameters) {
-  tasklet.add_new_slice(parameters);
+  SFXC_ASSERT((size_t)parameters.lane < tasklets.size());
+  tasklets[parameters.lane]->add_new_slice(parameters);
 }
 
 void Correlator_node::get_state(std::ostream &out) {
@@ -103,6 +122,18 @@ void Correlator_node::get_state(std::ostream &out) {
       << "\t\"host\": \"" << HOSTNAME_OF_NODE << "\",\n"
       << "\t\"id\": \"" << ID_OF_NODE << "\",\n"
       << "\t\"now\": \"" << Time::now() << "\",\n";
-  tasklet.get_state(out);
+  Cpu_affinity::get_state(out, "\t");
+  out << ",\n";
+  if (tasklets.size() == 1) {
+    tasklets[0]->get_state(out);
+  } else {
+    out << "\t\"lanes\": [\n";
+    for (size_t i = 0; i < tasklets.size(); i++) {
+      out << "\t{\n";
+      tasklets[i]->get_state(out);
+      out << (i + 1 < tasklets.size() ? "\t},\n" : "\t}\n");
+    }
+    out << "\t]\n";
+  }
   out << "}";
 }
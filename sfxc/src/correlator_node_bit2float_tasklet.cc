@@ -1,10 +1,13 @@
 #include <sched.h>
 #include "correlator_node_bit2float_tasklet.h"
 #include "bit_statistics.h"
+#include "cpu_affinity.h"
 
-#define MINIMUM_PROCESSED_SAMPLES 1024
-
-Correlator_node_bit2float_tasklet::Correlator_node_bit2float_tasklet() {}
+Correlator_node_bit2float_tasklet::Correlator_node_bit2float_tasklet()
+  : nthreads_(1) {
+  set_affinity_role(CPU_ROLE_BIT2FLOAT);
+  pool_.set_affinity_role(CPU_ROLE_BIT2FLOAT);
+}
 
 Correlator_node_bit2float_tasklet::~Correlator_node_bit2float_tasklet() {}
 
@@ -16,26 +19,45 @@ void Correlator_node_bit2float_tasklet::empty_input_queue(){
 
 void Correlator_node_bit2float_tasklet::stop(){
   isrunning_=false;
+  notifier_.notify();
 }
 
 void Correlator_node_bit2float_tasklet::do_execute(){
-  int processed_samples;
   data_processed_=0;
 
   timer_.start();
+  Bit2float_job job(*this);
   while ( isrunning_ ){
-    processed_samples=0;
-    for (size_t i=0; i<bit2float_workers_.size(); i++) {
-      if (bit2float_workers_[i]->has_work()) {
-        processed_samples += bit2float_workers_[i]->do_task();
+    // The threads of the pool are only resized while none of them is
+    // running, so a worker never runs on two threads at the same time
+    pool_.resize(nthreads_);
+    pool_.run(job);
+  }
+  timer_.stop();
+}
+
+void Correlator_node_bit2float_tasklet::Bit2float_job::execute(int part, int nparts){
+  std::vector<Bit2float_worker_sptr> &workers = tasklet.bit2float_workers_;
+  while ( tasklet.isrunning_ && (tasklet.nthreads_ == nparts) ){
+    // Read the event count before looking for work, such that an event
+    // during the loop below is not missed
+    uint64_t events = tasklet.notifier_.count();
+    bool done_work = false;
+    for (size_t i=part; i<workers.size(); i+=nparts) {
+      if (workers[i]->has_work()) {
+        workers[i]->do_task();
+        done_work = true;
       }
     }
-    if ( processed_samples < MINIMUM_PROCESSED_SAMPLES ){
-      //sched_yield();
-      usleep(1000);
-    }
+    if ( !done_work )
+      tasklet.notifier_.wait(events);
   }
-  timer_.stop();
+}
+
+void Correlator_node_bit2float_tasklet::set_threads(int nthreads){
+  SFXC_ASSERT(nthreads > 0);
+  nthreads_ = nthreads;
+  notifier_.notify();
 }
 size_t Correlator_node_bit2float_tasklet::number_channel(){
   return bit2float_workers_.size();
@@ -51,13 +73,18 @@ Correlator_node_bit2float_tasklet::connect_to(int nr_stream, bit_statistics_ptr
   bit2float_workers_[nr_stream] = Bit2float_worker::new_sptr(nr_stream, statistics);
   SFXC_ASSERT( nr_stream < bit2float_workers_.size() );
   bit2float_workers_[nr_stream]->connect_to(buffer);
+  bit2float_workers_[nr_stream]->set_notifier(&notifier_);
+  buffer->data_notifier = &notifier_;
 }
 
 void 
 Correlator_node_bit2float_tasklet::set_parameters(const Correlation_parameters &param,
-                                                  std::vector<Delay_table_akima> &delays){
+                                                  std::vector<Delay_table_akima> &delays,
+                                                  std::vector<bit_statistics_ptr> &statistics,
+                                                  std::vector<Invalid_list_ptr> &invalid){
   for(int i=0; i<bit2float_workers_.size(); i++)
-    bit2float_workers_[i]->set_new_parameters(param, delays[i]);
+    bit2float_workers_[i]->set_new_parameters(param, delays[i], statistics[i], invalid[i]);
+  notifier_.notify();
 }
 
 Bit2float_worker::Output_queue_ptr
@@ -66,6 +93,12 @@ Correlator_node_bit2float_tasklet::get_output_buffer(int nr_stream){
   return bit2float_workers_[nr_stream]->get_output_buffer();
 }
 
+Memory_placement_ptr
+Correlator_node_bit2float_tasklet::get_output_placement(int nr_stream){
+  SFXC_ASSERT( nr_stream < bit2float_workers_.size() );
+  return bit2float_workers_[nr_stream]->get_output_placement();
+}
+
 std::vector<Bit2float_worker::Invalid> *
 Correlator_node_bit2float_tasklet::get_invalid(int nr_stream){
   SFXC_ASSERT( nr_stream < bit2float_workers_.size() );
@@ -104,7 +104,7 @@ Correlator_node_data_reader_tasklet::do_task() {
   }
 
   SFXC_ASSERT(read <= write);
-  input_buffer.write = write;
+  input_buffer.set_write(write);
 }
 
 bool
@@ -115,7 +115,7 @@ Correlator_node_data_reader_tasklet::has_work() {
   if (!reader->can_read())
     return false;
 
-  if(input_buffer.bytes_free() < INPUT_BUFFER_MINIMUM_FREE)
+  if(buffer_full())
     return false;
 
   if (state == IDLE)
@@ -128,6 +128,10 @@ int Correlator_node_data_reader_tasklet::get_fd() {
   return reader->get_fd();
 }
 
+bool Correlator_node_data_reader_tasklet::buffer_full() {
+  return input_buffer.bytes_free() < INPUT_BUFFER_MINIMUM_FREE;
+}
+
 bool Correlator_node_data_reader_tasklet::active() {
   if(state!=IDLE)
     return true;
@@ -0,0 +1,168 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Chooses the correlator node that correlates the next time slice
+ */
+#include <algorithm>
+#include <limits>
+
+#include "correlator_node_scheduler.h"
+#include "sfxc_mpi.h"
+#include "utils.h"
+
+const double Correlator_node_scheduler::WARM_CHANNEL_BONUS = 0.1;
+const double Correlator_node_scheduler::LOCAL_INPUT_BONUS = 0.1;
+const double Correlator_node_scheduler::STRAGGLER_FACTOR = 2.0;
+const double Correlator_node_scheduler::RATE_WEIGHT = 0.25;
+
+Correlator_node_scheduler::Correlator_node_scheduler(int pipeline_depth_)
+  : pipeline_depth(std::max(pipeline_depth_, 1)) {}
+
+void Correlator_node_scheduler::add_input_node(const std::string &host) {
+  input_hosts.push_back(host);
+}
+
+void Correlator_node_scheduler::add_node(const std::string &host) {
+  Node_state node;
+  node.host = host;
+  node.requests = 0;
+  node.last_channel = -1;
+  node.rate = 0;
+  node.last_done = 0;
+  nodes.push_back(node);
+}
+
+void Correlator_node_scheduler::request(int nr) {
+  SFXC_ASSERT((nr >= 0) && (nr < (int)nodes.size()));
+  Node_state &node = nodes[nr];
+  node.requests++;
+
+  // Requests below the pipeline depth fill the pipeline of the node
+  if ((int)node.in_flight.size() < pipeline_depth)
+    return;
+  double now = MPI_Wtime();
+  const Slice &slice = node.in_flight.front();
+  // The node started on the slice when it got it, or when it was done
+  // with the previous one
+  double start = std::max(slice.start, node.last_done);
+  if (now > start) {
+    double rate = slice.work / (now - start);
+    if (node.rate == 0)
+      node.rate = rate;
+    else
+      node.rate = (1 - RATE_WEIGHT) * node.rate + RATE_WEIGHT * rate;
+  }
+  node.last_done = now;
+  node.in_flight.pop_front();
+}
+
+int Correlator_node_scheduler::number_requests() const {
+  int n = 0;
+  for (size_t i = 0; i < nodes.size(); i++)
+    n += nodes[i].requests;
+  return n;
+}
+
+double Correlator_node_scheduler::default_rate() {
+  std::vector<double> rates;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].rate > 0)
+      rates.push_back(nodes[i].rate);
+  }
+  if (rates.empty())
+    return 1;
+  std::nth_element(rates.begin(), rates.begin() + rates.size() / 2, rates.end());
+  return rates[rates.size() / 2];
+}
+
+double Correlator_node_scheduler::finish_time(const Node_state &node, double rate,
+                                              double work, double now) {
+  if (node.in_flight.empty())
+    return now + work / rate;
+  double queued = work;
+  for (size_t i = 0; i < node.in_flight.size(); i++)
+    queued += node.in_flight[i].work;
+  double start = std::max(node.in_flight.front().start, node.last_done);
+  double left = std::max(queued - (now - start) * rate, work);
+  return now + left / rate;
+}
+
+bool Correlator_node_scheduler::overdue(const Node_state &node, double rate, double now) {
+  if (node.in_flight.empty())
+    return true;
+  const Slice &slice = node.in_flight.front();
+  double start = std::max(slice.start, node.last_done);
+  return now > start + 2 * slice.work / rate;
+}
+
+int Correlator_node_scheduler::select(int channel, const std::vector<int> &inputs,
+                                      double work) {
+  const double never = std::numeric_limits<double>::max();
+  double now = MPI_Wtime();
+  double rate_unknown = default_rate();
+  int best = -1;
+  double best_time = never, best_waiting_time = never;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const Node_state &node = nodes[i];
+    double rate = (node.rate > 0 ? node.rate : rate_unknown);
+    if ((node.requests == 0) && overdue(node, rate, now))
+      continue;
+
+    double bonus = 0;
+    if (node.last_channel == channel)
+      bonus += WARM_CHANNEL_BONUS;
+    if (!inputs.empty()) {
+      int n_local = 0;
+      for (size_t j = 0; j < inputs.size(); j++) {
+        if ((inputs[j] < (int)input_hosts.size()) && (input_hosts[inputs[j]] == node.host))
+          n_local++;
+      }
+      bonus += LOCAL_INPUT_BONUS * n_local / inputs.size();
+    }
+    double time = (finish_time(node, rate, work, now) - now) * (1 - bonus);
+
+    if (node.requests > 0) {
+      if (time < best_time) {
+        best = i;
+        best_time = time;
+      }
+    } else {
+      best_waiting_time = std::min(best_waiting_time, time);
+    }
+  }
+
+  if ((best >= 0) && (best_waiting_time != never) &&
+      (best_time > STRAGGLER_FACTOR * best_waiting_time))
+    return -1;
+  return best;
+}
+
+void Correlator_node_scheduler::assign(int nr, int channel, double work) {
+  SFXC_ASSERT((nr >= 0) && (nr < (int)nodes.size()));
+  Node_state &node = nodes[nr];
+  SFXC_ASSERT(node.requests > 0);
+  node.requests--;
+  node.last_channel = channel;
+  Slice slice = {work, MPI_Wtime()};
+  node.in_flight.push_back(slice);
+}
+
+void Correlator_node_scheduler::get_state(std::ostream &out) {
+  out << "\t\"Correlator_node_scheduler\": [\n";
+  for (size_t i = 0; i < nodes.size(); i++) {
+    out << "\t\t{ \"host\": \"" << nodes[i].host << "\""
+        << ", \"requests\": " << nodes[i].requests
+        << ", \"in_flight\": " << nodes[i].in_flight.size()
+        << ", \"last_channel\": " << nodes[i].last_channel
+        << ", \"rate\": " << nodes[i].rate << " }";
+    if (i < nodes.size() - 1)
+      out << ",\n";
+    else
+      out << "\n";
+  }
+  out << "\t],\n";
+}
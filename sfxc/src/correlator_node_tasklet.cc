@@ -15,14 +15,96 @@
 #include "utils.h"
 #include "output_header.h"
 #include "delay_correction.h"
+#include "raiimutex.h"
 
-Correlator_node_tasklet::Correlator_node_tasklet(int nr_corr_node, bool pulsar_binning_, bool phased_array_) :
+const int Correlator_node_tables::N_CACHED_INTEGRATIONS;
+
+void Correlator_node_tables::add_delay_table(Delay_table &table, int sn1, int sn2) {
+  RAIIMutex lock(mutex);
+  SFXC_ASSERT(sn1<=sn2);
+  if(delay_tables.size() <= sn1)
+    delay_tables.resize(sn1+1);
+  if(delay_index.size() <= sn2)
+    delay_index.resize(sn2+1, -1);
+
+  delay_tables[sn1].add_scans(table);
+  delay_index[sn1] = sn1;
+  delay_index[sn2] = sn1;
+  // The splines might cover the new scans
+  splines.clear();
+}
+
+void Correlator_node_tables::add_uvw_table(Uvw_model &table, int sn) {
+  RAIIMutex lock(mutex);
+  if(uvw_tables.size() <= sn){
+    uvw_tables.resize(sn+1);
+  }
+  uvw_tables[sn].add_scans(table);
+}
+
+Correlator_node_tables::Splines &
+Correlator_node_tables::get_splines(const Time &start, const Time &duration) {
+  for (size_t i = 0; i < splines.size(); i++) {
+    if ((splines[i].start == start) && (splines[i].duration == duration))
+      return splines[i];
+  }
+  if (splines.size() >= N_CACHED_INTEGRATIONS)
+    splines.pop_front();
+  splines.push_back(Splines());
+  Splines &result = splines.back();
+  result.start = start;
+  result.duration = duration;
+  result.tables.resize(delay_tables.size());
+  result.valid.resize(delay_tables.size(), 0);
+  return result;
+}
+
+void
+Correlator_node_tables::get_tables(const Correlation_parameters &parameters,
+                                   std::vector<Delay_table_akima> &akima_tables,
+                                   std::vector<std::vector<double> > &uvw) {
+  // NB: The total number of streams in the job is not nessecarily the same 
+  // as the number of streams in the scan
+  RAIIMutex lock(mutex);
+  Time tmid = parameters.integration_start + parameters.integration_time / 2;
+  Splines &cached = get_splines(parameters.integration_start,
+                                parameters.integration_time);
+  akima_tables.resize(delay_index.size());
+  uvw.resize(uvw_tables.size());
+  for(int i=0;i<parameters.station_streams.size();i++){
+    int stream = parameters.station_streams[i].station_stream;
+    int index = delay_index[stream];
+    SFXC_ASSERT(index != -1);
+    if (!cached.valid[index]) {
+      cached.tables[index] =
+        delay_tables[index].create_akima_spline(parameters.integration_start,
+                                                 parameters.integration_time);
+      cached.valid[index] = 1;
+    }
+    akima_tables[stream] = cached.tables[index];
+    if(stream < uvw.size()){
+      uvw[stream].resize(parameters.n_phase_centers*3);
+      for(int j=0;j<parameters.n_phase_centers;j++){
+        double *out = &uvw[stream][3*j];
+        uvw_tables[stream].get_uvw(j, tmid, &out[0], &out[1], &out[2]);
+      }
+    }
+  }
+}
+
+Correlator_node_tasklet::Correlator_node_tasklet(int nr_corr_node,
+                                                 Correlator_node_tables &tables_,
+                                                 bool pulsar_binning_, bool phased_array_) :
+    delay_thread_(delay_modules),
     status(STOPPED),
     isinitialized_(false),
     nr_corr_node(nr_corr_node),
     pulsar_binning(pulsar_binning_),
     phased_array(phased_array_),
-    has_requested(false) {
+    pipeline_depth(1),
+    n_requested(0),
+    tables(tables_) {
+  set_affinity_role(CPU_ROLE_CORRELATION);
   if (phased_array){
     correlation_core_normal = new Correlation_core_phased();
     correlation_core = correlation_core_normal;
@@ -64,17 +146,6 @@ Correlator_node_tasklet::Correlator_node_tasklet(int nr_corr_node, bool pulsar_b
   reader_state_.add_property(compid.str(), "has", monid.str() );
   dotask_state_.add_property(tt.str(), "contains", monid.str() );
 
-  compid.str("");
-  monid.str("");
-  compid << inputid.str() << "_delaycorrection";
-  monid << compid.str() << "_monitor_state";
-  delaycorrection_state_.init(monid.str());
-  delaycorrection_state_.add_property(inputid.str(), "is_a", "correlationnode");
-  delaycorrection_state_.add_property(inputid.str(), "has", compid.str() );
-  delaycorrection_state_.add_property(compid.str(), "is_a", "delaycorrection_component");
-  delaycorrection_state_.add_property(compid.str(), "has", monid.str() );
-  dotask_state_.add_property(tt.str(), "contains", monid.str() );
-
   compid.str("");
   monid.str("");
   compid << inputid.str() << "_integration";
@@ -92,53 +163,69 @@ Correlator_node_tasklet::~Correlator_node_tasklet() {
 #if PRINT_TIMER
   PROGRESS_MSG("Time bit_sample_reader:  " << bit_sample_reader_timer_.measured_time());
   PROGRESS_MSG("Time bits2float:  " << bits_to_float_timer_.measured_time());
-  PROGRESS_MSG("Time delay:       " << delay_timer_.measured_time());
+  PROGRESS_MSG("Time delay:       " << delay_thread_.timer().measured_time());
   PROGRESS_MSG("Time correlation: " << correlation_timer_.measured_time());
 #endif
+  export_fft_wisdom();
 }
 
 void Correlator_node_tasklet::start_threads() {
   threadpool_.register_thread( reader_thread_.start() );
   threadpool_.register_thread( bit2float_thread_.start() );
+  threadpool_.register_thread( delay_thread_.start() );
 }
 
 void Correlator_node_tasklet::stop_threads() {
   reader_thread_.stop();
   bit2float_thread_.stop();
+  delay_thread_.stop();
 
   /// We wait the termination of the threads
   threadpool_.wait_for_all_termination();
 }
 
-void Correlator_node_tasklet::do_execute() {
-  // Request first slice
-  MPI_Send(&nr_corr_node, 1, MPI_INT32,
-           RANK_MANAGER_NODE, MPI_TAG_CORRELATION_OF_TIME_SLICE_ENDED,
-           MPI_COMM_WORLD);
+void Correlator_node_tasklet::import_fft_wisdom() {
+  if (fft_wisdom_file.empty())
+    return;
+  if (!SFXC_FFT::import_wisdom(fft_wisdom_file)) {
+    LOG_MSG("Could not read FFTW wisdom from " << fft_wisdom_file);
+  }
+}
 
-  has_requested = true;
+void Correlator_node_tasklet::export_fft_wisdom() {
+  if (fft_wisdom_file.empty())
+    return;
+  if (!SFXC_FFT::export_wisdom(fft_wisdom_file)) {
+    LOG_MSG("Could not write FFTW wisdom to " << fft_wisdom_file);
+  }
+}
 
+void Correlator_node_tasklet::do_execute() {
   try {
     while (isrunning_) {
+      // Requests the first slice, later keeps the pipeline filled
+      request_slices();
       switch (status) {
       case STOPPED: {
-        // blocking:
-        const Correlation_parameters &parameters = integration_slices_queue.front();
-        set_parameters(parameters);
-        integration_slices_queue.pop();
+        if (prefetched_slices.empty()) {
+          // blocking:
+          const Correlation_parameters &parameters = integration_slices_queue.front();
+          prefetch_slice(parameters);
+          integration_slices_queue.pop();
+        }
+        set_parameters();
         break;
       }
       case CORRELATING: {
         correlate();
-        if (!has_requested && correlation_core->almost_finished()) {
-          int32_t msg = get_correlate_node_number();
-          MPI_Send(&msg, 1, MPI_INT32, RANK_MANAGER_NODE,
-                   MPI_TAG_CORRELATION_OF_TIME_SLICE_ENDED,
-                   MPI_COMM_WORLD);
-
-          has_requested = true;
+        // The front of prefetched_slices is being correlated
+        while (((int)prefetched_slices.size() < pipeline_depth) &&
+               !integration_slices_queue.empty()) {
+          prefetch_slice(integration_slices_queue.front());
+          integration_slices_queue.pop();
         }
         if (correlation_core->finished()) {
+          prefetched_slices.pop_front();
           status = STOPPED;
         }
         break;
@@ -154,29 +241,7 @@ void Correlator_node_tasklet::do_execute() {
 void Correlator_node_tasklet::terminate() {
   isrunning_ = false;
   integration_slices_queue.close();
-}
-
-void Correlator_node_tasklet::add_delay_table(Delay_table &table, int sn1, int sn2) {
-  SFXC_ASSERT(sn1<=sn2);
-  SFXC_ASSERT((size_t)sn1 < delay_modules.size());
-  SFXC_ASSERT((size_t)sn2 < delay_modules.size());
-  SFXC_ASSERT(delay_modules[sn1] != Delay_correction_ptr());
-  SFXC_ASSERT(delay_modules[sn2] != Delay_correction_ptr());
-  if(delay_tables.size() <= sn1)
-    delay_tables.resize(sn1+1);
-  if(delay_index.size() <= sn2)
-    delay_index.resize(sn2+1, -1);
-
-  delay_tables[sn1].add_scans(table);
-  delay_index[sn1] = sn1;
-  delay_index[sn2] = sn1;
-}
-
-void Correlator_node_tasklet::add_uvw_table(Uvw_model &table, int sn) {
-  if(uvw_tables.size() <= sn){
-    uvw_tables.resize(sn+1);
-  }
-  uvw_tables[sn].add_scans(table);
+  correlation_notifier_.notify();
 }
 
 void Correlator_node_tasklet::hook_added_data_reader(size_t stream_nr, Data_reader_ptr data_reader) {
@@ -200,7 +265,11 @@ void Correlator_node_tasklet::hook_added_data_reader(size_t stream_nr, Data_read
     }
     delay_modules[stream_nr] = Delay_correction_ptr(new Delay_correction(stream_nr));
     // Connect the delay_correction to the bits2float_converter
-    delay_modules[stream_nr]->connect_to(bit2float_thread_.get_output_buffer(stream_nr));
+    delay_modules[stream_nr]->connect_to(bit2float_thread_.get_output_buffer(stream_nr),
+                                         bit2float_thread_.get_output_placement(stream_nr));
+    bit2float_thread_.get_output_buffer(stream_nr)->set_notifier(&delay_thread_.notifier());
+    delay_modules[stream_nr]->set_notifier(&delay_thread_.notifier());
+    delay_modules[stream_nr]->get_output_buffer()->set_notifier(&correlation_notifier_);
   }
 
 
@@ -230,19 +299,9 @@ int Correlator_node_tasklet::get_correlate_node_number() {
 void Correlator_node_tasklet::correlate() {
   RT_STAT( dotask_state_.begin_measure() );
   bool done_work=false; 
-  delay_timer_.resume();
-  for (size_t i=0; i<delay_modules.size(); i++) {
-    if (delay_modules[i] != Delay_correction_ptr()) {
-      if (delay_modules[i]->has_work()) {
-        RT_STAT( delaycorrection_state_.begin_measure() );
-        delay_modules[i]->do_task();
-        RT_STAT( delaycorrection_state_.end_measure(1) );
-        done_work=true;
-      }
-    }
-  }
-  delay_timer_.stop();
+  uint64_t events = correlation_notifier_.count();
 
+  // The delay correction is done by delay_thread_
   correlation_timer_.resume();
   if (correlation_core->has_work()) {
     RT_STAT( correlation_state_.begin_measure() );
@@ -257,18 +316,40 @@ void Correlator_node_tasklet::correlate() {
 
   RT_STAT( dotask_state_.end_measure(1) );
 
-  if (!done_work)
-    usleep(1000);
+  // Sleep until one of the delay modules produces output
+  if (!done_work && !correlation_core->finished())
+    correlation_notifier_.wait(events);
+}
 
+void Correlator_node_tasklet::request_slices() {
+  // A slice that is almost correlated no longer counts, this is when a
+  // node with a depth of one asks for its next slice. n_requested is read
+  // before the queue: a slice that arrives in between is counted twice
+  // rather than not at all.
+  int in_flight = __atomic_load_n(&n_requested, __ATOMIC_SEQ_CST);
+  in_flight += integration_slices_queue.size() + prefetched_slices.size();
+  if ((status == CORRELATING) && correlation_core->almost_finished())
+    in_flight--;
+
+  for (; in_flight < pipeline_depth; in_flight++) {
+    __atomic_add_fetch(&n_requested, 1, __ATOMIC_SEQ_CST);
+    int32_t msg = get_correlate_node_number();
+    MPI_Send(&msg, 1, MPI_INT32, RANK_MANAGER_NODE,
+             MPI_TAG_CORRELATION_OF_TIME_SLICE_ENDED,
+             MPI_COMM_WORLD);
+  }
 }
 
 void
 Correlator_node_tasklet::add_new_slice(const Correlation_parameters &parameters) {
 
   integration_slices_queue.push(parameters);
+  __atomic_sub_fetch(&n_requested, 1, __ATOMIC_SEQ_CST);
 
   /// We add the new timeslice to the readers.
   reader_thread_.add_time_slice_to_read(parameters);
+  // Wake up the correlation loop, which hands the slice to the pipeline
+  correlation_notifier_.notify();
 }
 
 void
@@ -277,37 +358,56 @@ Correlator_node_tasklet::add_source_list(const std::map<std::string, int> &sourc
 }
 
 void
-Correlator_node_tasklet::set_parameters(const Correlation_parameters &parameters) {
-  SFXC_ASSERT(status == STOPPED);
-
+Correlator_node_tasklet::prefetch_slice(const Correlation_parameters &parameters) {
   if ( !isinitialized_ ) {
     ///DEBUG_MSG("START THE THREADS !");
     isinitialized_ = true;
     start_threads();
+    fft_wisdom_file = parameters.fft_wisdom_file;
+    import_fft_wisdom();
   }
+  SFXC_FFT::set_planning_rigor(parameters.fft_planning);
+  pipeline_depth = parameters.pipeline_depth;
 
+  prefetched_slices.push_back(Slice());
+  Slice &slice = prefetched_slices.back();
+  slice.parameters = parameters;
 
   // Get delay and UVW tables
-  // NB: The total number of streams in the job is not nessecarily the same 
-  // as the number of streams in the scan
-  Time tmid = parameters.integration_start + parameters.integration_time / 2;
-  std::vector<Delay_table_akima> akima_tables(delay_index.size());
-  std::vector<std::vector<double> > uvw(uvw_tables.size());
-  for(int i=0;i<parameters.station_streams.size();i++){
-    int stream = parameters.station_streams[i].station_stream;
-    int index = delay_index[stream];
-    SFXC_ASSERT(index != -1);
-    akima_tables[stream] = 
-       delay_tables[index].create_akima_spline(parameters.integration_start,
-                                                parameters.integration_time);
-    if(stream < uvw.size()){
-      uvw[stream].resize(parameters.n_phase_centers*3);
-      for(int j=0;j<parameters.n_phase_centers;j++){
-        double *out = &uvw[stream][3*j];
-        uvw_tables[stream].get_uvw(j, tmid, &out[0], &out[1], &out[2]);
-      }
+  tables.get_tables(parameters, slice.akima_tables, slice.uvw);
+
+  size_t nstreams = delay_modules.size();
+  slice.statistics.resize(nstreams);
+  slice.invalid.resize(nstreams);
+  for (size_t i=0; i<nstreams; i++) {
+    slice.statistics[i] = bit_statistics_ptr(new bit_statistics());
+    slice.invalid[i] = Invalid_list_ptr(new std::vector<Correlator_node_types::Invalid>());
+  }
+
+  for (size_t i=0; i<delay_modules.size(); i++) {
+    if (delay_modules[i] != Delay_correction_ptr()) {
+      delay_modules[i]->set_new_parameters(parameters, slice.akima_tables[i]);
+      // The output of the delay correction is consumed by the correlation
+      // core, which runs in this thread
+      delay_modules[i]->get_output_placement()->follow_current_thread();
     }
   }
+  bit2float_thread_.set_threads(parameters.bit2float_threads);
+  bit2float_thread_.set_parameters(parameters, slice.akima_tables,
+                                   slice.statistics, slice.invalid);
+  delay_thread_.set_threads(parameters.delay_threads);
+  delay_thread_.start_slice();
+}
+
+void
+Correlator_node_tasklet::set_parameters() {
+  SFXC_ASSERT(status == STOPPED);
+  SFXC_ASSERT(!prefetched_slices.empty());
+  Slice &slice = prefetched_slices.front();
+  const Correlation_parameters &parameters = slice.parameters;
+  std::vector<Delay_table_akima> &akima_tables = slice.akima_tables;
+  std::vector<std::vector<double> > &uvw = slice.uvw;
+
   int nBins=1;
   if(pulsar_binning){
     Pulsar_parameters *pulsar_parameters = parameters.pulsar_parameters;
@@ -331,12 +431,18 @@ Correlator_node_tasklet::set_parameters(const Correlation_parameters &parameters
 
   for (size_t i=0; i<delay_modules.size(); i++) {
     if (delay_modules[i] != Delay_correction_ptr()) {
-      delay_modules[i]->set_parameters(parameters, akima_tables[i]);
+      correlation_core_normal->set_slice_statistics(i, slice.statistics[i],
+                                                    slice.invalid[i].get());
+      if (pulsar_binning)
+        correlation_core_pulsar->set_slice_statistics(i, slice.statistics[i],
+                                                      slice.invalid[i].get());
     }
   }
-  bit2float_thread_.set_parameters(parameters, akima_tables);
 
-  has_requested=false;
+  // Store the plans that were created for the slices so far, this is a
+  // no-op if no new plans were made
+  export_fft_wisdom();
+
   status = CORRELATING;
 
   // set the output stream
@@ -391,7 +497,9 @@ void Correlator_node_tasklet::get_state(std::ostream &out) {
       << "\t\t\"nr_corr_node\": " << nr_corr_node << ",\n"
       << "\t\t\"pulsar_binning\": " << std::boolalpha << pulsar_binning << ",\n"
       << "\t\t\"phased_array\": " << std::boolalpha << phased_array << ",\n"
-      << "\t\t\"has_requested\": " << std::boolalpha << has_requested << ",\n"
+      << "\t\t\"pipeline_depth\": " << pipeline_depth << ",\n"
+      << "\t\t\"n_requested\": " << __atomic_load_n(&n_requested, __ATOMIC_SEQ_CST) << ",\n"
+      << "\t\t\"n_prefetched_slices\": " << prefetched_slices.size() << ",\n"
       << "\t\t\"isrunning\": " << std::boolalpha << isrunning_ << ",\n"
       << "\t\t\"n_integration_slices\": " << integration_slices_queue.size() << ",\n"
       << "\t\t\"state\": ";
@@ -424,3 +532,78 @@ void Correlator_node_tasklet::get_state(std::ostream &out) {
   out << "\t],\n";
   correlation_core->get_state(out);
 }
+
+Correlator_node_tasklet::Delay_thread::
+Delay_thread(std::vector<Delay_correction_ptr> &delay_modules)
+  : delay_modules_(delay_modules), nthreads_(1), active_(false) {
+  set_affinity_role(CPU_ROLE_DELAY);
+  pool_.set_affinity_role(CPU_ROLE_DELAY);
+}
+
+void Correlator_node_tasklet::Delay_thread::do_execute() {
+  Delay_job job(delay_modules_);
+
+  while (true) {
+    uint64_t events = notifier_.count();
+    {
+      RAIIMutex rc(cond_);
+      while (isrunning_ && !active_)
+        cond_.wait();
+      if (!isrunning_)
+        break;
+      // The pool only runs in this thread, it is idle here
+      pool_.resize(nthreads_);
+    }
+
+    job.part_done_work.resize(pool_.size());
+    timer_.resume();
+    pool_.run(job);
+    timer_.stop();
+
+    // Sleep until new input arrives or an output buffer is released
+    if (!job.done_work())
+      notifier_.wait(events);
+  }
+}
+
+void Correlator_node_tasklet::Delay_thread::stop() {
+  RAIIMutex rc(cond_);
+  isrunning_ = false;
+  cond_.broadcast();
+  notifier_.notify();
+}
+
+void Correlator_node_tasklet::Delay_thread::set_threads(int nthreads) {
+  RAIIMutex rc(cond_);
+  nthreads_ = nthreads;
+}
+
+void Correlator_node_tasklet::Delay_thread::start_slice() {
+  RAIIMutex rc(cond_);
+  active_ = true;
+  cond_.broadcast();
+  notifier_.notify();
+}
+
+void Correlator_node_tasklet::Delay_thread::Delay_job::execute(int part, int nparts) {
+  // Each thread handles a fixed subset of the streams, such that a
+  // Delay_correction object is only ever used by one thread at a time
+  bool done = false;
+  for (size_t i = part; i < delay_modules.size(); i += nparts) {
+    if (delay_modules[i] != Delay_correction_ptr()) {
+      if (delay_modules[i]->has_work()) {
+        delay_modules[i]->do_task();
+        done = true;
+      }
+    }
+  }
+  part_done_work[part] = done;
+}
+
+bool Correlator_node_tasklet::Delay_thread::Delay_job::done_work() {
+  for (size_t i = 0; i < part_done_work.size(); i++) {
+    if (part_done_work[i])
+      return true;
+  }
+  return false;
+}
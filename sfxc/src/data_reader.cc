@@ -31,6 +31,18 @@ Data_reader::get_bytes(size_t nBytes, char *buff) {
   return result;
 }
 
+const char *
+Data_reader::get_view(size_t nBytes, shared_ptr<void> &region) {
+  SFXC_ASSERT((data_slice==-1) || (nBytes <= (size_t)data_slice));
+
+  const char *result = do_get_view(nBytes, region);
+  if (result == NULL)
+    return NULL;
+  _data_counter += nBytes;
+  if (data_slice != -1) data_slice -= nBytes;
+  return result;
+}
+
 uint64_t
 Data_reader::data_counter() {
   return _data_counter;
@@ -13,11 +13,17 @@
 
 #include "data_reader_factory.h"
 #include "data_reader_file.h"
+#include "data_reader_mmap.h"
+#include "data_reader_vdif_udp.h"
 #include "data_reader_mk5.h"
 
 Data_reader* Data_reader_factory::get_reader(const std::vector<std::string>& sources) {
   if (sources[0].find("file://") == 0)
     return new Data_reader_file(sources);
+  if (sources[0].find("mmap://") == 0)
+    return new Data_reader_mmap(sources);
+  if (sources[0].find("udp://") == 0)
+    return new Data_reader_vdif_udp(sources[0]);
   if (sources[0].find("mk5://") == 0)
     return new Data_reader_mk5(sources[0]);
 
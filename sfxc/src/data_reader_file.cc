@@ -13,12 +13,12 @@
 #include <iostream>
 
 Data_reader_file::Data_reader_file(const std::vector<std::string> &sources) :
-  Data_reader(), file_end(0) {
+  Data_reader() {
   init(sources);
 }
 
 Data_reader_file::Data_reader_file(const std::string &source) :
-  Data_reader(), file_end(0) {
+  Data_reader() {
   std::vector<std::string> sources(1, source);
   init(sources);
 }
@@ -39,18 +39,12 @@ Data_reader_file::init(const std::vector<std::string> &sources)
 bool
 Data_reader_file::open_next_file(){
   bool opened_file = false;
-  if (file.is_open())
-    file.close();
+  file.close();
 
   while ((!opened_file) && (filenames.size() > 0)) {
-    file.open(filenames.front().c_str(), std::ios::in | std::ios::binary);
-    if (file.is_open()) { 
+    if (file.open(filenames.front())) {
       opened_file = true;
-      file.seekg(0, std::ios::end);
-      file_end = file.tellg();
-      file.seekg(0, std::ios::beg);
     } else {
-      file_end = 0;
       std::cerr << RANK_OF_NODE << " : Warning : Cannot open " <<  filenames.front() << "\n";
     }
     filenames.pop();
@@ -64,36 +58,28 @@ Data_reader_file::~Data_reader_file() {
 
 size_t
 Data_reader_file::do_get_bytes(size_t nbytes, char *out) {
-  // If EOF is reached through a seek, the EOF bit won't be set
-  std::streampos pos = file.tellg();
-  if (!file.good() || pos >= file_end) {
+  if (file.eof()) {
     if (!open_next_file())
       return -1;
   }
 
-  if (out == NULL) {
-    std::streampos pos = file.tellg();
-    size_t nbytes_to_read = std::min((size_t)(file_end - pos), nbytes);
-    file.seekg(nbytes_to_read, std::ios::cur);
-
-    return file.tellg() - pos;
-  }
-
-  file.read(out, nbytes);
-
-  if (file.eof()) {
-    nbytes = file.gcount();
+  // A short read means the end of the file, continue with the next one
+  nbytes = file.read(out, nbytes);
+  if (file.eof() && (filenames.size() > 0))
     open_next_file();
-  }
 
   return nbytes;
 }
 
 bool Data_reader_file::eof() {
-  return file.eof() || !file.good();
+  return file.eof() && filenames.empty();
 }
 
 bool Data_reader_file::can_read() {
   DEBUG_MSG("Data_reader_file: can read not implemented");
   return true;
 }
+
+void Data_reader_file::set_read_ahead(int depth, size_t block_size) {
+  file.set_read_ahead(depth, block_size);
+}
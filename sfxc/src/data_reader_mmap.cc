@@ -0,0 +1,165 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data reader for recordings that are mapped into memory
+ */
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "data_reader_mmap.h"
+#include "utils.h"
+
+const size_t Data_reader_mmap::WINDOW_SIZE;
+
+namespace {
+
+// Unmaps a window when the last frame that refers to it is released
+struct Munmap_window {
+  Munmap_window(size_t length_) : length(length_) {}
+  void operator()(void *p) const {
+    munmap(p, length);
+  }
+  size_t length;
+};
+
+} // namespace
+
+Data_reader_mmap::Data_reader_mmap(const std::vector<std::string> &sources)
+  : Data_reader(), fd(-1), file_size(0), position(0),
+    window_offset(0), window_length(0) {
+  for (size_t i = 0; i < sources.size(); i++) {
+    SFXC_ASSERT(sources[i].compare(0, 7, "mmap://") == 0);
+    filenames.push(sources[i].substr(7));
+  }
+  if (!open_next_file())
+    sfxc_abort("Could not open any input files");
+  is_seekable_ = true;
+}
+
+Data_reader_mmap::~Data_reader_mmap() {
+  close_file();
+}
+
+void
+Data_reader_mmap::close_file() {
+  // Frames that still refer to the window keep it mapped
+  window.reset();
+  window_offset = 0;
+  window_length = 0;
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+  file_size = 0;
+  position = 0;
+}
+
+bool
+Data_reader_mmap::open_next_file() {
+  close_file();
+  while ((fd < 0) && (filenames.size() > 0)) {
+    const std::string &filename = filenames.front();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if ((fd >= 0) && (fstat(fd, &st) == 0)) {
+      file_size = st.st_size;
+    } else {
+      std::cerr << RANK_OF_NODE << " : Warning : Cannot open " << filename << "\n";
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+    filenames.pop();
+  }
+  return (fd >= 0);
+}
+
+bool
+Data_reader_mmap::map_window(size_t nbytes) {
+  if ((position >= window_offset) &&
+      (position + nbytes <= window_offset + window_length))
+    return true;
+
+  // Windows start at a page boundary and overlap, such that a frame is
+  // always contiguous in one window
+  static const long page_size = sysconf(_SC_PAGESIZE);
+  uint64_t offset = position - position % page_size;
+  size_t length = std::max((uint64_t)WINDOW_SIZE, position + nbytes - offset);
+  length = std::min((uint64_t)length, file_size - offset);
+  void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+  if (p == MAP_FAILED) {
+    std::cerr << RANK_OF_NODE << " : Warning : mmap failed: "
+              << strerror(errno) << "\n";
+    return false;
+  }
+  madvise(p, length, MADV_SEQUENTIAL);
+  madvise(p, length, MADV_WILLNEED);
+
+  window = shared_ptr<void>(p, Munmap_window(length));
+  window_offset = offset;
+  window_length = length;
+  return true;
+}
+
+size_t
+Data_reader_mmap::do_get_bytes(size_t nbytes, char *out) {
+  if (position >= file_size) {
+    if (!open_next_file())
+      return -1;
+  }
+
+  nbytes = std::min((uint64_t)nbytes, file_size - position);
+  if (out != NULL) {
+    size_t done = 0;
+    while (done < nbytes) {
+      size_t chunk = std::min((size_t)WINDOW_SIZE, nbytes - done);
+      if (!map_window(chunk))
+        break;
+      memcpy(out + done, (char *)window.get() + (position - window_offset), chunk);
+      position += chunk;
+      done += chunk;
+    }
+    nbytes = done;
+  } else {
+    // Skipping data does not touch the file
+    position += nbytes;
+  }
+
+  if ((position >= file_size) && (filenames.size() > 0))
+    open_next_file();
+  return nbytes;
+}
+
+const char *
+Data_reader_mmap::do_get_view(size_t nbytes, shared_ptr<void> &region) {
+  // A block that continues in the next file is not contiguous
+  if ((fd < 0) || (position + nbytes > file_size) || !map_window(nbytes))
+    return NULL;
+
+  const char *result = (char *)window.get() + (position - window_offset);
+  region = window;
+  position += nbytes;
+  if ((position >= file_size) && (filenames.size() > 0))
+    open_next_file();
+  return result;
+}
+
+bool
+Data_reader_mmap::eof() {
+  return (position >= file_size) && filenames.empty();
+}
+
+bool
+Data_reader_mmap::can_read() {
+  return true;
+}
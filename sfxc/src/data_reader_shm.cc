@@ -0,0 +1,32 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data_reader for a shared memory ring from a process on the same host
+ */
+#include "data_reader_shm.h"
+#include "utils.h"
+
+Data_reader_shm::Data_reader_shm(Shared_memory_ring::Ptr ring_)
+  : ring(ring_) {
+  SFXC_ASSERT(ring != Shared_memory_ring::Ptr());
+}
+
+Data_reader_shm::~Data_reader_shm() {
+  ring->close_reader();
+}
+
+size_t Data_reader_shm::do_get_bytes(size_t nBytes, char *out) {
+  return ring->read(out, nBytes);
+}
+
+bool Data_reader_shm::eof() {
+  return ring->eof();
+}
+
+bool Data_reader_shm::can_read() {
+  return ring->can_read();
+}
@@ -0,0 +1,610 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data reader for VDIF frames that are streamed over UDP (e-VLBI)
+ */
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "data_reader_vdif_udp.h"
+#include "cpu_affinity.h"
+#include "raiimutex.h"
+#include "utils.h"
+
+const int Data_reader_vdif_udp::NR_SLOTS;
+const int Data_reader_vdif_udp::BATCH_SIZE;
+const int Data_reader_vdif_udp::REORDER_WINDOW;
+const int Data_reader_vdif_udp::DEFAULT_RCVBUF;
+
+namespace {
+
+const size_t VDIF_HEADER_SIZE = 32;
+const size_t VDIF_LEGACY_HEADER_SIZE = 16;
+const size_t PSN_SIZE = 8;
+// Time after which a missing frame is considered lost, even if no
+// later frames arrive
+const int LOSS_TIMEOUT = 100; // ms
+// Timeout of the receive calls, to check whether the reader is stopped
+const int RECEIVE_TIMEOUT = 500; // ms
+// Time after which a read returns without data, such that the caller can
+// check for eof()
+const int NO_DATA_TIMEOUT = 1000; // ms
+
+int64_t now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint32_t header_word(const char *header, int i) {
+  uint32_t word;
+  memcpy(&word, header + 4 * i, sizeof(word));
+  return word;
+}
+void set_header_word(char *header, int i, uint32_t word) {
+  memcpy(header + 4 * i, &word, sizeof(word));
+}
+
+uint32_t vdif_seconds(const char *header) {
+  return header_word(header, 0) & 0x3fffffff;
+}
+uint32_t vdif_frame_nr(const char *header) {
+  return header_word(header, 1) & 0x00ffffff;
+}
+size_t vdif_frame_length(const char *header) {
+  return (size_t)(header_word(header, 2) & 0x00ffffff) * 8;
+}
+uint32_t vdif_thread_id(const char *header) {
+  return (header_word(header, 3) >> 16) & 0x3ff;
+}
+
+} // namespace
+
+Data_reader_vdif_udp::Capture_thread::Capture_thread(Data_reader_vdif_udp &reader)
+  : reader_(reader) {
+  set_affinity_role(CPU_ROLE_INPUT_READER);
+}
+
+void
+Data_reader_vdif_udp::Capture_thread::do_execute() {
+  reader_.capture();
+}
+
+Data_reader_vdif_udp::Data_reader_vdif_udp(const std::string &url)
+  : Data_reader(), socket_(-1), has_psn_(false), frame_size_(0),
+    started_(false), stopped_(false), read_seq_(0), max_seq_(0), out_of_window_(0),
+    multi_thread_(false), first_thread_(0), first_second_(0),
+    max_frame_nr_(0), frames_per_second_(0), arrival_seq_(0),
+    packets_received_(0), packets_lost_(0), packets_late_(0),
+    packets_duplicated_(0), packets_invalid_(0), reported_errors_(0),
+    frame_(NULL), frame_slot_(-1), frame_pos_(0), last_seq_(0),
+    last_logged_second_(0), capture_thread_(*this) {
+  if (!open_socket(url))
+    sfxc_abort(("Could not open " + url).c_str());
+  capture_thread_.start();
+}
+
+Data_reader_vdif_udp::~Data_reader_vdif_udp() {
+  {
+    RAIIMutex lock(condition_);
+    stopped_ = true;
+    condition_.broadcast();
+  }
+  capture_thread_.stop();
+  wait(capture_thread_);
+  if (socket_ >= 0)
+    ::close(socket_);
+}
+
+bool
+Data_reader_vdif_udp::open_socket(const std::string &url) {
+  // udp://[address]:port[?rcvbuf=bytes]
+  SFXC_ASSERT(url.compare(0, 6, "udp://") == 0);
+  std::string location = url.substr(6);
+  int rcvbuf = DEFAULT_RCVBUF;
+  size_t options = location.find('?');
+  if (options != std::string::npos) {
+    std::string option = location.substr(options + 1);
+    if (option.compare(0, 7, "rcvbuf=") == 0)
+      rcvbuf = atoi(option.substr(7).c_str());
+    location = location.substr(0, options);
+  }
+  size_t colon = location.rfind(':');
+  if (colon == std::string::npos)
+    return false;
+  std::string host = location.substr(0, colon);
+  int port = atoi(location.substr(colon + 1).c_str());
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (!host.empty()) {
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &res) != 0)
+      return false;
+    addr.sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+  }
+
+  socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0)
+    return false;
+  int one = 1;
+  setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  // SO_RCVBUFFORCE can exceed net.core.rmem_max, but needs CAP_NET_ADMIN
+  bool forced = false;
+#ifdef SO_RCVBUFFORCE
+  forced = (setsockopt(socket_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) == 0);
+#endif
+  if (!forced)
+    setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  int actual = 0;
+  socklen_t len = sizeof(actual);
+  getsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+  // Linux reports twice the size that is available for data
+  if (actual / 2 < rcvbuf) {
+    LOG_MSG("Warning: UDP receive buffer of " << url << " is " << actual / 2
+            << " bytes instead of " << rcvbuf << ", increase net.core.rmem_max");
+  }
+
+  struct timeval timeout;
+  timeout.tv_sec = RECEIVE_TIMEOUT / 1000;
+  timeout.tv_usec = (RECEIVE_TIMEOUT % 1000) * 1000;
+  setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  if (IN_MULTICAST(ntohl(addr.sin_addr.s_addr))) {
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = addr.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+      return false;
+  }
+  return (bind(socket_, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+}
+
+bool
+Data_reader_vdif_udp::detect_format() {
+  char peek[PSN_SIZE + VDIF_LEGACY_HEADER_SIZE];
+  ssize_t len = recv(socket_, peek, sizeof(peek), MSG_PEEK | MSG_TRUNC);
+  if (len <= 0)
+    return false;
+
+  if ((len >= (ssize_t)VDIF_LEGACY_HEADER_SIZE) &&
+      (vdif_frame_length(peek) == (size_t)len)) {
+    has_psn_ = false;
+    frame_size_ = len;
+    return true;
+  }
+  if ((len >= (ssize_t)(PSN_SIZE + VDIF_LEGACY_HEADER_SIZE)) &&
+      (vdif_frame_length(peek + PSN_SIZE) + PSN_SIZE == (size_t)len)) {
+    has_psn_ = true;
+    frame_size_ = len - PSN_SIZE;
+    return true;
+  }
+
+  // Not a VDIF frame, drop it
+  recv(socket_, peek, sizeof(peek), 0);
+  RAIIMutex lock(condition_);
+  packets_invalid_++;
+  return false;
+}
+
+void
+Data_reader_vdif_udp::capture() {
+  while (!detect_format()) {
+    if (!capture_thread_.isrunning())
+      return;
+  }
+  LOG_MSG("Receiving VDIF frames of " << frame_size_ << " bytes"
+          << (has_psn_ ? " with" : " without") << " packet sequence numbers");
+
+  {
+    RAIIMutex lock(condition_);
+    buffer_.resize((size_t)NR_SLOTS * frame_size_);
+    slot_of_seq_.resize(NR_SLOTS, -1);
+    free_slots_.resize(NR_SLOTS);
+    for (int i = 0; i < NR_SLOTS; i++)
+      free_slots_[i] = NR_SLOTS - 1 - i;
+  }
+
+  std::vector<struct mmsghdr> msgs(BATCH_SIZE);
+  std::vector<struct iovec> iov(2 * BATCH_SIZE);
+  std::vector<uint64_t> psn(BATCH_SIZE);
+  std::vector<int> slots;
+  while (capture_thread_.isrunning()) {
+    {
+      RAIIMutex lock(condition_);
+      while (free_slots_.empty() && capture_thread_.isrunning())
+        condition_.timed_wait(RECEIVE_TIMEOUT);
+      int n = std::min((int)free_slots_.size(), BATCH_SIZE);
+      slots.assign(free_slots_.end() - n, free_slots_.end());
+      free_slots_.resize(free_slots_.size() - n);
+    }
+
+    // The frames are received directly into the slots, only the sequence
+    // number goes elsewhere
+    memset(&msgs[0], 0, slots.size() * sizeof(struct mmsghdr));
+    for (size_t i = 0; i < slots.size(); i++) {
+      struct iovec *v = &iov[2 * i];
+      int nv = 0;
+      if (has_psn_) {
+        v[nv].iov_base = &psn[i];
+        v[nv].iov_len = PSN_SIZE;
+        nv++;
+      }
+      v[nv].iov_base = &buffer_[(size_t)slots[i] * frame_size_];
+      v[nv].iov_len = frame_size_;
+      nv++;
+      msgs[i].msg_hdr.msg_iov = v;
+      msgs[i].msg_hdr.msg_iovlen = nv;
+    }
+    int n = 0;
+    if (!slots.empty())
+      n = recvmmsg(socket_, &msgs[0], slots.size(), MSG_WAITFORONE, NULL);
+    if ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+      LOG_MSG("Error receiving UDP packets: " << strerror(errno));
+      RAIIMutex lock(condition_);
+      for (size_t i = 0; i < slots.size(); i++)
+        free_slots_.push_back(slots[i]);
+      stopped_ = true;
+      condition_.broadcast();
+      return;
+    }
+    n = std::max(n, 0);
+
+    RAIIMutex lock(condition_);
+    for (int i = 0; i < n; i++) {
+      const char *frame = &buffer_[(size_t)slots[i] * frame_size_];
+      uint64_t seq;
+      if ((msgs[i].msg_len != frame_size_ + (has_psn_ ? PSN_SIZE : 0)) ||
+          (vdif_frame_length(frame) != frame_size_) ||
+          !sequence_number(psn[i], frame, seq)) {
+        packets_invalid_++;
+        free_slots_.push_back(slots[i]);
+        continue;
+      }
+      place_packet(seq, slots[i]);
+    }
+    for (size_t i = n; i < slots.size(); i++)
+      free_slots_.push_back(slots[i]);
+    condition_.broadcast();
+  }
+}
+
+bool
+Data_reader_vdif_udp::sequence_number(uint64_t psn, const char *frame,
+                                      uint64_t &seq) {
+  uint32_t second = vdif_seconds(frame);
+  uint32_t frame_nr = vdif_frame_nr(frame);
+  uint32_t thread = vdif_thread_id(frame);
+  if (!started_) {
+    first_thread_ = thread;
+    first_second_ = second;
+  }
+  if (thread != first_thread_)
+    multi_thread_ = true;
+
+  // The number of frames per second follows from the highest frame
+  // number before the first second boundary
+  if (!multi_thread_ && (frames_per_second_ == 0)) {
+    if (second != first_second_)
+      frames_per_second_ = max_frame_nr_ + 1;
+    else
+      max_frame_nr_ = std::max(max_frame_nr_, frame_nr);
+  }
+
+  if (has_psn_) {
+    seq = psn;
+    return true;
+  }
+  if (multi_thread_) {
+    // Without a sequence number the frames of different threads can not
+    // be ordered, use the order of arrival
+    arrival_seq_ = std::max(arrival_seq_, max_seq_);
+    seq = arrival_seq_++;
+    return true;
+  }
+  if (frames_per_second_ == 0) {
+    seq = frame_nr;
+    return true;
+  }
+  if (second < first_second_)
+    return false;
+  seq = (uint64_t)(second - first_second_) * frames_per_second_ + frame_nr;
+  return true;
+}
+
+void
+Data_reader_vdif_udp::place_packet(uint64_t seq, int slot) {
+  if (!started_) {
+    read_seq_ = max_seq_ = seq;
+    started_ = true;
+  }
+
+  if ((seq < read_seq_) || (seq >= read_seq_ + NR_SLOTS)) {
+    // A sender that restarts its sequence numbers produces only packets
+    // outside of the window, start again at the new sequence number
+    if (++out_of_window_ <= REORDER_WINDOW) {
+      if (seq < read_seq_)
+        packets_late_++;
+      else
+        packets_lost_++;
+      free_slots_.push_back(slot);
+      return;
+    }
+    for (int i = 0; i < NR_SLOTS; i++) {
+      if (slot_of_seq_[i] >= 0) {
+        free_slots_.push_back(slot_of_seq_[i]);
+        slot_of_seq_[i] = -1;
+        packets_lost_++;
+      }
+    }
+    LOG_MSG("Warning: UDP stream jumped from packet " << read_seq_ << " to " << seq);
+    read_seq_ = max_seq_ = seq;
+  }
+  out_of_window_ = 0;
+
+  int &index = slot_of_seq_[seq % NR_SLOTS];
+  if (index >= 0) {
+    packets_duplicated_++;
+    free_slots_.push_back(slot);
+    return;
+  }
+  index = slot;
+  max_seq_ = std::max(max_seq_, seq + 1);
+  packets_received_++;
+}
+
+bool
+Data_reader_vdif_udp::next_frame() {
+  RAIIMutex lock(condition_);
+  int64_t start = now_ms();
+  for (;;) {
+    int64_t waited = now_ms() - start;
+    if (started_ && (read_seq_ < max_seq_)) {
+      int &slot = slot_of_seq_[read_seq_ % NR_SLOTS];
+      if (slot >= 0) {
+        frame_slot_ = slot;
+        slot = -1;
+        frame_ = &buffer_[(size_t)frame_slot_ * frame_size_];
+        frame_pos_ = 0;
+        last_header_.assign(frame_, frame_ + std::min(frame_size_, VDIF_HEADER_SIZE));
+        last_seq_ = read_seq_++;
+        log_statistics();
+        return true;
+      }
+
+      // The frame is lost when enough later frames arrived, when it did
+      // not arrive in time or when no more frames will arrive
+      if ((max_seq_ - read_seq_ > (uint64_t)REORDER_WINDOW) ||
+          (waited >= LOSS_TIMEOUT) || stopped_) {
+        packets_lost_++;
+        if (!multi_thread_ && !last_header_.empty() &&
+            (read_seq_ - last_seq_ < (uint64_t)NR_SLOTS)) {
+          make_invalid_frame(read_seq_++);
+          return true;
+        }
+        read_seq_++;
+        continue;
+      }
+    }
+    // Nothing arrived (yet), or the reader is stopped
+    if (stopped_ || (waited >= NO_DATA_TIMEOUT))
+      return false;
+    condition_.timed_wait(LOSS_TIMEOUT / 4);
+  }
+}
+
+void
+Data_reader_vdif_udp::make_invalid_frame(uint64_t seq) {
+  // A copy of the last header with the invalid bit set and the time of
+  // the missing frame, the data is not used
+  invalid_frame_.resize(frame_size_);
+  memcpy(&invalid_frame_[0], &last_header_[0], last_header_.size());
+  char *header = &invalid_frame_[0];
+  uint64_t frame_nr = vdif_frame_nr(header) + (seq - last_seq_);
+  uint64_t second = vdif_seconds(header);
+  if (frames_per_second_ > 0) {
+    second += frame_nr / frames_per_second_;
+    frame_nr %= frames_per_second_;
+  }
+  uint32_t word0 = header_word(header, 0);
+  word0 = (word0 & 0x40000000) | 0x80000000 | (uint32_t)(second & 0x3fffffff);
+  set_header_word(header, 0, word0);
+  uint32_t word1 = header_word(header, 1);
+  word1 = (word1 & 0xff000000) | (uint32_t)(frame_nr & 0x00ffffff);
+  set_header_word(header, 1, word1);
+
+  frame_ = header;
+  frame_slot_ = -1;
+  frame_pos_ = 0;
+}
+
+void
+Data_reader_vdif_udp::release_frame() {
+  RAIIMutex lock(condition_);
+  if (frame_slot_ >= 0) {
+    free_slots_.push_back(frame_slot_);
+    condition_.broadcast();
+  }
+  frame_slot_ = -1;
+  frame_ = NULL;
+}
+
+void
+Data_reader_vdif_udp::log_statistics() {
+  // Once per second of data, if packets were lost since the last report
+  uint32_t second = vdif_seconds(&last_header_[0]);
+  if (second == last_logged_second_)
+    return;
+  last_logged_second_ = second;
+  uint64_t errors = packets_lost_ + packets_late_ + packets_duplicated_ + packets_invalid_;
+  if (errors == reported_errors_)
+    return;
+  reported_errors_ = errors;
+  LOG_MSG("UDP stream: received = " << packets_received_
+          << ", lost = " << packets_lost_
+          << ", late = " << packets_late_
+          << ", duplicated = " << packets_duplicated_
+          << ", invalid = " << packets_invalid_);
+}
+
+size_t
+Data_reader_vdif_udp::do_get_bytes(size_t nbytes, char *out) {
+  size_t done = 0;
+  while (done < nbytes) {
+    if ((frame_ == NULL) && !next_frame())
+      break;
+    size_t chunk = std::min(nbytes - done, frame_size_ - frame_pos_);
+    if (out != NULL)
+      memcpy(out + done, frame_ + frame_pos_, chunk);
+    frame_pos_ += chunk;
+    done += chunk;
+    if (frame_pos_ == frame_size_)
+      release_frame();
+  }
+  return done;
+}
+
+bool
+Data_reader_vdif_udp::eof() {
+  // A live stream only ends when the reader is stopped or the socket
+  // fails, the frames that were received are read first
+  if (frame_ != NULL)
+    return false;
+  RAIIMutex lock(condition_);
+  return stopped_ && !(started_ && (read_seq_ < max_seq_));
+}
+
+bool
+Data_reader_vdif_udp::can_read() {
+  if (frame_ != NULL)
+    return true;
+  RAIIMutex lock(condition_);
+  return (started_ && (read_seq_ < max_seq_) &&
+          (slot_of_seq_[read_seq_ % NR_SLOTS] >= 0));
+}
+
+#ifdef ENABLE_TEST_UNIT
+#include <sstream>
+
+namespace {
+const size_t TEST_FRAME_SIZE = 1032;
+
+// Sends VDIF frames of one thread to a port on the loopback interface
+class Vdif_test_sender {
+public:
+  Vdif_test_sender(int port) {
+    socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr_, 0, sizeof(addr_));
+    addr_.sin_family = AF_INET;
+    addr_.sin_port = htons(port);
+    addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+  ~Vdif_test_sender() {
+    ::close(socket_);
+  }
+  // The payload of frame i consists of bytes with value i
+  bool send(uint32_t frame_nr) {
+    std::vector<char> frame(TEST_FRAME_SIZE, (char)frame_nr);
+    set_header_word(&frame[0], 0, 100);
+    set_header_word(&frame[0], 1, frame_nr);
+    set_header_word(&frame[0], 2, TEST_FRAME_SIZE / 8);
+    set_header_word(&frame[0], 3, 0);
+    ssize_t n = sendto(socket_, &frame[0], frame.size(), 0,
+                       (struct sockaddr *)&addr_, sizeof(addr_));
+    return (n == (ssize_t)frame.size());
+  }
+private:
+  int socket_;
+  struct sockaddr_in addr_;
+};
+
+// A port on the loopback interface that is not in use
+int free_udp_port() {
+  int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  bind(sock, (struct sockaddr *)&addr, len);
+  getsockname(sock, (struct sockaddr *)&addr, &len);
+  ::close(sock);
+  return ntohs(addr.sin_port);
+}
+}
+
+void Data_reader_vdif_udp::Test::tests() {
+  int port = free_udp_port();
+  std::stringstream url;
+  url << "udp://127.0.0.1:" << port << "?rcvbuf=1048576";
+  Data_reader_vdif_udp *reader = new Data_reader_vdif_udp(url.str());
+  std::vector<char> frame(TEST_FRAME_SIZE);
+
+  // Without data a read returns empty handed after a while, the stream
+  // has not ended
+  int64_t start = now_ms();
+  TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == 0 );
+  TEST_ASSERT( now_ms() - start < 2 * NO_DATA_TIMEOUT );
+  TEST_ASSERT( !reader->eof() );
+  TEST_ASSERT( !reader->can_read() );
+
+  // Frames that arrive out of order are put back in order
+  Vdif_test_sender sender(port);
+  const uint32_t order[] = {0, 1, 3, 2, 4, 5};
+  for (int i = 0; i < 6; i++)
+    TEST_ASSERT( sender.send(order[i]) );
+  for (uint32_t i = 0; i < 6; i++) {
+    TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == TEST_FRAME_SIZE );
+    TEST_ASSERT( vdif_frame_nr(&frame[0]) == i );
+    TEST_ASSERT( (header_word(&frame[0], 0) & 0x80000000) == 0 );
+    TEST_ASSERT( frame[TEST_FRAME_SIZE - 1] == (char)i );
+  }
+
+  // A lost frame is replaced by an invalid frame with the right frame
+  // number
+  TEST_ASSERT( sender.send(7) );
+  TEST_ASSERT( sender.send(8) );
+  TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == TEST_FRAME_SIZE );
+  TEST_ASSERT( vdif_frame_nr(&frame[0]) == 6 );
+  TEST_ASSERT( (header_word(&frame[0], 0) & 0x80000000) != 0 );
+  TEST_ASSERT( vdif_seconds(&frame[0]) == 100 );
+  for (uint32_t i = 7; i < 9; i++) {
+    TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == TEST_FRAME_SIZE );
+    TEST_ASSERT( vdif_frame_nr(&frame[0]) == i );
+  }
+  TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == 0 );
+
+  // A stopped reader does not wait
+  {
+    RAIIMutex lock(reader->condition_);
+    reader->stopped_ = true;
+  }
+  start = now_ms();
+  TEST_ASSERT( reader->eof() );
+  TEST_ASSERT( reader->get_bytes(TEST_FRAME_SIZE, &frame[0]) == 0 );
+  TEST_ASSERT( now_ms() - start < NO_DATA_TIMEOUT );
+  delete reader;
+}
+#endif // ENABLE_TEST_UNIT
@@ -11,6 +11,11 @@
 #include "utils.h"
 
 #include <netinet/in.h>
+#include <errno.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+#include <string.h>
 
 Data_writer::Data_writer() : _data_counter(0), data_slice(-1), active(false), stream_nr(-1) {}
 
@@ -25,6 +30,60 @@ Data_writer::put_bytes(size_t nBytes, const char *buff) {
   return result;
 }
 
+size_t
+Data_writer::put_iovec(const struct iovec *iov, int iovcnt) {
+  size_t result = do_put_iovec(iov, iovcnt);
+  _data_counter += (int64_t)result;
+  data_slice -= result;
+  return result;
+}
+
+size_t
+Data_writer::do_put_iovec(const struct iovec *iov, int iovcnt) {
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len == 0)
+      continue;
+    size_t result = do_put_bytes(iov[i].iov_len, (const char *)iov[i].iov_base);
+    total += result;
+    if (result != iov[i].iov_len)
+      break;
+  }
+  return total;
+}
+
+size_t
+Data_writer::writev_all(int fd, const struct iovec *iov, int iovcnt) {
+  size_t total = 0;
+  // Only copied when a buffer is written partially
+  std::vector<struct iovec> rest;
+  while (iovcnt > 0) {
+    ssize_t result = writev(fd, iov, std::min(iovcnt, IOV_MAX));
+    if ((result < 0) && (errno == EINTR))
+      continue;
+    if (result <= 0)
+      break;
+    total += result;
+    size_t left = result;
+    while ((iovcnt > 0) && (left >= iov->iov_len)) {
+      left -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (left > 0) {
+      // Skip the part of the first buffer that was written
+      if (rest.empty()) {
+        rest.assign(iov, iov + iovcnt);
+        iov = &rest[0];
+      }
+      struct iovec &first = rest[iov - &rest[0]];
+      first.iov_base = (char *)first.iov_base + left;
+      first.iov_len -= left;
+    }
+  }
+  return total;
+}
+
 void
 Data_writer::set_stream_nr(int nr) {
   stream_nr = nr;
@@ -94,3 +153,117 @@ Data_writer& operator<<(Data_writer& dr, int32_t value) {
   return  dr;
 }
 
+
+#ifdef ENABLE_TEST_UNIT
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "thread.h"
+
+namespace {
+int writev_test_interrupts = 0;
+void writev_test_signal_handler(int) {
+  __atomic_add_fetch(&writev_test_interrupts, 1, __ATOMIC_SEQ_CST);
+}
+
+// Writes the buffers with writev_all(), the only thread that accepts
+// SIGUSR1 such that every signal interrupts the write
+class Writev_test_writer : public Thread {
+public:
+  Writev_test_writer(int fd, const std::vector<struct iovec> &iov)
+    : fd(fd), iov(iov), written(0), done(0) {}
+  void do_execute() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+    written = Data_writer::Test::writev_all(fd, &iov[0], iov.size());
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    __atomic_store_n(&done, 1, __ATOMIC_SEQ_CST);
+  }
+  int fd;
+  const std::vector<struct iovec> &iov;
+  size_t written;
+  int done;
+};
+
+class Writev_test_reader : public Thread {
+public:
+  Writev_test_reader(int fd, size_t size) : fd(fd), data(size) {}
+  void do_execute() {
+    size_t received = 0;
+    while (received < data.size()) {
+      ssize_t result = read(fd, &data[received], std::min((size_t)4096, data.size() - received));
+      if (result <= 0)
+        break;
+      received += result;
+    }
+    data.resize(received);
+  }
+  int fd;
+  std::vector<char> data;
+};
+}
+
+void Data_writer::Test::tests() {
+  // More buffers than writev() accepts in one call, of different sizes
+  // including empty ones
+  const int n = 2 * IOV_MAX + 5;
+  std::vector<char> expected;
+  std::vector<size_t> offsets;
+  for (int i = 0; i < n; i++) {
+    offsets.push_back(expected.size());
+    size_t size = (i % 100 == 0 ? 0 : (i * 37) % 3000 + 1);
+    for (size_t j = 0; j < size; j++)
+      expected.push_back((char)(i + 7 * j));
+  }
+  offsets.push_back(expected.size());
+  std::vector<struct iovec> iov(n);
+  for (int i = 0; i < n; i++) {
+    iov[i].iov_base = &expected[0] + offsets[i];
+    iov[i].iov_len = offsets[i + 1] - offsets[i];
+  }
+
+  // A socket with a small send buffer blocks the writer often, a signal
+  // interrupts a blocked writev() which then returns a partial write or
+  // fails with EINTR
+  int fds[2];
+  TEST_ASSERT( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0 );
+  int sndbuf = 4096;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  struct sigaction action, old_action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = writev_test_signal_handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = 0; // no SA_RESTART
+  sigaction(SIGUSR1, &action, &old_action);
+  sigset_t set, old_set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, &old_set);
+
+  Writev_test_writer writer(fds[0], iov);
+  Writev_test_reader reader(fds[1], expected.size());
+  writer.start();
+  reader.start();
+  while (!__atomic_load_n(&writer.done, __ATOMIC_SEQ_CST)) {
+    kill(getpid(), SIGUSR1);
+    usleep(100);
+  }
+  ::wait(writer);
+  ::wait(reader);
+
+  // Signals that are still pending are discarded
+  signal(SIGUSR1, SIG_IGN);
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+  sigaction(SIGUSR1, &old_action, NULL);
+  close(fds[0]);
+  close(fds[1]);
+
+  std::cout << "Interrupted writes: " << writev_test_interrupts << std::endl;
+  TEST_ASSERT( writev_test_interrupts > 0 );
+  TEST_ASSERT( writer.written == expected.size() );
+  TEST_ASSERT( reader.data == expected );
+}
+#endif // ENABLE_TEST_UNIT
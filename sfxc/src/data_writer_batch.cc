@@ -0,0 +1,136 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Batches small headers and references to payload data, which are
+ *     written to a Data_writer in one go
+ */
+#include "data_writer_batch.h"
+#include "utils.h"
+
+Data_writer_batch::Data_writer_batch() : size_(0) {}
+
+void Data_writer_batch::put_bytes(size_t n, const void *buff) {
+  if (n == 0)
+    return;
+  const char *data = (const char *)buff;
+  // Extend the last segment if it holds copies as well
+  if (segments_.empty() || (segments_.back().data != NULL)) {
+    Segment segment = {NULL, copies_.size(), 0};
+    segments_.push_back(segment);
+  }
+  copies_.insert(copies_.end(), data, data + n);
+  segments_.back().size += n;
+  size_ += n;
+}
+
+void Data_writer_batch::put_reference(size_t n, const char *buff) {
+  if (n == 0)
+    return;
+  Segment segment = {buff, 0, n};
+  segments_.push_back(segment);
+  size_ += n;
+}
+
+size_t Data_writer_batch::flush(Data_writer &writer) {
+  if (segments_.empty())
+    return 0;
+  iov_.resize(segments_.size());
+  for (size_t i = 0; i < segments_.size(); i++) {
+    const Segment &segment = segments_[i];
+    const char *data =
+      (segment.data != NULL ? segment.data : &copies_[segment.offset]);
+    iov_[i].iov_base = (void *)data;
+    iov_[i].iov_len = segment.size;
+  }
+  size_t written = writer.put_iovec(&iov_[0], iov_.size());
+
+  copies_.clear();
+  segments_.clear();
+  size_ = 0;
+  return written;
+}
+
+#ifdef ENABLE_TEST_UNIT
+#include <string.h>
+
+namespace {
+// Records the buffers of every put_iovec() call
+class Batch_test_writer : public Data_writer {
+public:
+  bool can_write() {
+    return true;
+  }
+  std::vector< std::vector<struct iovec> > calls;
+  std::string data;
+private:
+  size_t do_put_bytes(size_t nBytes, const char *buff) {
+    data.append(buff, nBytes);
+    return nBytes;
+  }
+  size_t do_put_iovec(const struct iovec *iov, int iovcnt) {
+    calls.push_back(std::vector<struct iovec>(iov, iov + iovcnt));
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      data.append((const char *)iov[i].iov_base, iov[i].iov_len);
+      total += iov[i].iov_len;
+    }
+    return total;
+  }
+};
+}
+
+void Data_writer_batch::Test::tests() {
+  Data_writer_batch batch;
+  Batch_test_writer writer;
+  char payload[100];
+  for (int i = 0; i < 100; i++)
+    payload[i] = (char)i;
+
+  TEST_ASSERT( batch.empty() );
+  TEST_ASSERT( batch.flush(writer) == 0 );
+  TEST_ASSERT( writer.calls.empty() );
+
+  // Adjacent copies are merged, references are not copied and empty
+  // writes are dropped. Enough copies follow the payload to reallocate
+  // the copy buffer.
+  std::string expected;
+  batch.put_bytes(3, "abc");
+  batch.put_bytes(0, NULL);
+  batch.put_bytes(2, "de");
+  expected.append("abcde");
+  batch.put_reference(100, payload);
+  batch.put_reference(0, payload);
+  expected.append(payload, 100);
+  for (int32_t i = 0; i < 1000; i++) {
+    batch.put_bytes(sizeof(i), &i);
+    expected.append((const char *)&i, sizeof(i));
+  }
+  batch.put_reference(50, payload + 50);
+  expected.append(payload + 50, 50);
+  TEST_ASSERT( batch.size() == expected.size() );
+
+  TEST_ASSERT( batch.flush(writer) == expected.size() );
+  TEST_ASSERT( batch.empty() );
+  TEST_ASSERT( writer.calls.size() == 1 );
+  const std::vector<struct iovec> &iov = writer.calls[0];
+  TEST_ASSERT( iov.size() == 4 );
+  TEST_ASSERT( iov[0].iov_len == 5 );
+  TEST_ASSERT( (iov[1].iov_base == payload) && (iov[1].iov_len == 100) );
+  TEST_ASSERT( iov[2].iov_len == 4000 );
+  TEST_ASSERT( (iov[3].iov_base == payload + 50) && (iov[3].iov_len == 50) );
+  TEST_ASSERT( writer.data == expected );
+  TEST_ASSERT( writer.data_counter() == expected.size() );
+
+  // The batch is reusable after a flush
+  batch.put_reference(10, payload);
+  batch.put_bytes(2, "fg");
+  TEST_ASSERT( batch.flush(writer) == 12 );
+  TEST_ASSERT( writer.calls.size() == 2 );
+  TEST_ASSERT( writer.calls[1].size() == 2 );
+  TEST_ASSERT( writer.data == expected + std::string(payload, 10) + "fg" );
+}
+#endif // ENABLE_TEST_UNIT
@@ -0,0 +1,33 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - Data_writer to a shared memory ring for a process on the same host
+ */
+#include "data_writer_shm.h"
+#include "utils.h"
+
+Data_writer_shm::Data_writer_shm(Shared_memory_ring::Ptr ring_)
+  : ring(ring_) {
+  SFXC_ASSERT(ring != Shared_memory_ring::Ptr());
+}
+
+Data_writer_shm::~Data_writer_shm() {
+  ring->close_writer();
+}
+
+size_t Data_writer_shm::do_put_bytes(size_t nBytes, const char *buff) {
+  SFXC_ASSERT(nBytes > 0);
+  return ring->write(buff, nBytes);
+}
+
+size_t Data_writer_shm::do_put_iovec(const struct iovec *iov, int iovcnt) {
+  return ring->write(iov, iovcnt);
+}
+
+bool Data_writer_shm::can_write() {
+  return ring->can_write();
+}
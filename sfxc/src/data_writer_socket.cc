@@ -50,3 +50,7 @@ size_t Data_writer_socket::do_put_bytes(size_t nBytes, char const *buff) {
   return bytes_written;
 }
 
+size_t Data_writer_socket::do_put_iovec(const struct iovec *iov, int iovcnt) {
+  if (m_socket <= 0) return 0;
+  return writev_all(m_socket, iov, iovcnt);
+}
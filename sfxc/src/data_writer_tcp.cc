@@ -49,6 +49,12 @@ Data_writer_tcp::do_put_bytes(size_t nBytes, const char *buff) {
   return bytes_written;
 }
 
+size_t
+Data_writer_tcp::do_put_iovec(const struct iovec *iov, int iovcnt) {
+  if (socket <= 0) return 0;
+  return writev_all(socket, iov, iovcnt);
+}
+
 bool Data_writer_tcp::can_write() {
 //   struct pollfd {
 //     int fd;           /* file descriptor */
@@ -2,10 +2,15 @@
 #include "sfxc_math.h"
 #include "config.h"
 
+const double Delay_correction::MAX_FRINGE_DRIFT = 0.01;
+
 Delay_correction::Delay_correction(int stream_nr_)
     : output_buffer(Output_buffer_ptr(new Output_buffer())),
-      output_memory_pool(32),current_time(-1),
-      stream_nr(stream_nr_), stream_idx(-1)
+      output_placement(new Memory_placement(Correlator_node_types::delay_pool_pages)),
+      output_memory_pool(32, Placed_allocator<Correlator_node_types::Delay_memory_pool_data>::create(output_placement)),
+      current_time(-1),
+      stream_nr(stream_nr_), stream_idx(-1), frequency_domain(false),
+      n_ffts_per_integration(0), current_fft(0), total_ffts(0)
 {
 }
 
@@ -20,6 +25,8 @@ Delay_correction::~Delay_correction() {
 
 void Delay_correction::do_task() {
   SFXC_ASSERT(has_work());
+  if (input_placement != Memory_placement_ptr())
+    input_placement->follow_current_thread();
   Input_buffer_element input = input_buffer->front_and_pop();
   int nbuffer=input->nfft;
   current_fft+=nbuffer;
@@ -37,22 +44,75 @@ void Delay_correction::do_task() {
   // The windowing touches each block twice, so the last block needs to be preserved
   if ((window_func != SFXC_WINDOW_NONE) && (window_func != SFXC_WINDOW_PFB))
     nfft_cor -= 1;
-  if (cur_output->data.size() != nfft_cor * output_stride)
-    cur_output->data.resize(nfft_cor * output_stride);
+  // Also moves the buffer if the NUMA node of the consumer changed
+  cur_output->data.resize(nfft_cor * output_stride);
 #ifndef DUMMY_CORRELATION
   size_t tbuf_size = time_buffer.size();
+  SFXC_ASSERT(nbuffer * fft_size() <= frequency_buffer.size());
+  // All FFTs of the delay correction are done in batches of nbuffer
+  // transforms, at small fft_size_delaycor the per call overhead of
+  // separate transforms dominates.
+  fft_t2f.rfft_many(&input->data[0], &frequency_buffer[0], nbuffer,
+                    fft_size(), fft_size());
+  total_ffts += nbuffer;
+
+  // Evaluate the delay model for all FFTs of the buffer at once, at the
+  // edges of the FFTs for the fringe stopping and in the middle for the
+  // delay and amplitude that are constant over an FFT
+  edge_delays.resize(nbuffer + 1);
+  edge_phases.resize(nbuffer + 1);
+  mid_delays.resize(nbuffer);
+  mid_amplitudes.resize(nbuffer);
+  delay_table.delay(current_time, fft_length, nbuffer + 1, &edge_delays[0]);
+  delay_table.phase(current_time, fft_length, nbuffer + 1, &edge_phases[0]);
+  delay_table.delay(current_time + fft_length/2, fft_length, nbuffer, &mid_delays[0]);
+  delay_table.amplitude(current_time + fft_length/2, fft_length, nbuffer,
+                        &mid_amplitudes[0]);
+
+  if (frequency_domain) {
+    // Each block of fft_size() samples is zero padded to one correlation
+    // FFT, the delay and fringe corrections are applied to its spectrum
+    SFXC_ASSERT(nfft_cor == nbuffer);
+    SFXC_ASSERT(nbuffer * fft_rot_size() <= temp_buffer.size());
+    for (int buf = 0; buf < nbuffer; buf++) {
+      FLOAT *segment = &temp_buffer[buf * fft_rot_size()];
+      memcpy(segment, &input->data[buf * fft_size()], fft_size() * sizeof(FLOAT));
+      memset(&segment[fft_size()], 0, (fft_rot_size() - fft_size()) * sizeof(FLOAT));
+    }
+    fft_t2f_cor.rfft_many(&temp_buffer[0], &temp_fft_buffer[temp_fft_offset], nbuffer,
+                          fft_rot_size(), temp_fft_stride);
+    for (int buf = 0; buf < nbuffer; buf++) {
+      frequency_domain_correction(&temp_fft_buffer[buf * temp_fft_stride + temp_fft_offset],
+                                  buf);
+      current_time.inc_samples(fft_size());
+    }
+    total_ffts += nbuffer;
+    for (int i = 0; i < nfft_cor; i++) {
+      memcpy(&cur_output->data[i * output_stride],
+             &temp_fft_buffer[i * temp_fft_stride + output_offset],
+             output_stride * sizeof(std::complex<FLOAT>));
+    }
+    output_buffer->push(cur_output);
+    return;
+  }
+
   for(int buf=0;buf<nbuffer;buf++) {
-    double delay = get_delay(current_time + fft_length/2);
+    double delay = mid_delays[buf] + extra_delay;
     double delay_in_samples = delay*sample_rate();
     int integer_delay = (int)std::floor(delay_in_samples+.5);
 
-    // Output is in frequency_buffer
-    fractional_bit_shift(&input->data[buf * fft_size()],
+    fractional_bit_shift(&frequency_buffer[buf * fft_size()],
                          integer_delay,
                          delay_in_samples - integer_delay);
+  }
 
-    // Input is from frequency_buffer
-    fringe_stopping(&time_buffer[tbuf_end%tbuf_size]);
+  fft_f2t.ifft_many(&frequency_buffer[0], &frequency_buffer[0], nbuffer,
+                    fft_size(), fft_size());
+  total_ffts += nbuffer;
+
+  for(int buf=0;buf<nbuffer;buf++) {
+    fringe_stopping(&frequency_buffer[buf * fft_size()],
+                    &time_buffer[tbuf_end%tbuf_size], buf);
     tbuf_end += fft_size();
 
     current_time.inc_samples(fft_size());
@@ -68,30 +128,43 @@ void Delay_correction::do_task() {
   else
     nsamp_per_window = fft_rot_size();
 
+  // The windowed segments are stored consecutively in temp_buffer, such
+  // that all final FFTs can be done in one batch. A window (and the PFB
+  // taps) may extend into the next segment, it is overwritten only after
+  // the current segment is complete.
+  SFXC_ASSERT(nfft_cor <= 0 ||
+              (nfft_cor - 1) * fft_rot_size() + nsamp_per_window <= temp_buffer.size());
   for(int i=0; i<nfft_cor; i++){
+    FLOAT *segment = &temp_buffer[i * fft_rot_size()];
     // apply window function
     size_t eob = tbuf_size - tbuf_start%tbuf_size; // how many samples to end of buffer
     size_t nsamp = std::min(eob, nsamp_per_window);
-    SFXC_MUL_F(&time_buffer[tbuf_start%tbuf_size], &window[0], &temp_buffer[0], nsamp);
+    SFXC_MUL_F(&time_buffer[tbuf_start%tbuf_size], &window[0], &segment[0], nsamp);
     if(nsamp < nsamp_per_window)
-      SFXC_MUL_F(&time_buffer[0], &window[nsamp], &temp_buffer[nsamp], nsamp_per_window - nsamp);
+      SFXC_MUL_F(&time_buffer[0], &window[nsamp], &segment[nsamp], nsamp_per_window - nsamp);
     // Flip sideband if needed
     if (correlation_parameters.sideband != correlation_parameters.station_streams[stream_idx].sideband)
-      SFXC_MUL_F(&temp_buffer[0], &flip[0], &temp_buffer[0], nsamp_per_window);
+      SFXC_MUL_F(&segment[0], &flip[0], &segment[0], nsamp_per_window);
     // When SFXC_WINDOW_NONE is set we zeropad
     if (window_func == SFXC_WINDOW_NONE)
-      memset(&temp_buffer[nsamp_per_window], 0, nsamp_per_window*sizeof(FLOAT));
+      memset(&segment[nsamp_per_window], 0, nsamp_per_window*sizeof(FLOAT));
     else if (window_func == SFXC_WINDOW_PFB) {
       for (int j=1; j<SFXC_NTAPS; j++) {
-        SFXC_ADD_F_I(&temp_buffer[j * fft_rot_size()], &temp_buffer[0], fft_rot_size());
+        SFXC_ADD_F_I(&segment[j * fft_rot_size()], &segment[0], fft_rot_size());
       }
     }
 
     tbuf_start += fft_rot_size()/2;
     SFXC_ASSERT(tbuf_start <= tbuf_end);
-    // Do the final fft from time to frequency
-    fft_t2f_cor.rfft(&temp_buffer[0], &temp_fft_buffer[temp_fft_offset]);
-    memcpy(&cur_output->data[i * output_stride], &temp_fft_buffer[output_offset], output_stride * sizeof(std::complex<FLOAT>));
+  }
+
+  // Do the final ffts from time to frequency
+  fft_t2f_cor.rfft_many(&temp_buffer[0], &temp_fft_buffer[temp_fft_offset], nfft_cor,
+                        fft_rot_size(), temp_fft_stride);
+  for(int i=0; i<nfft_cor; i++){
+    memcpy(&cur_output->data[i * output_stride],
+           &temp_fft_buffer[i * temp_fft_stride + output_offset],
+           output_stride * sizeof(std::complex<FLOAT>));
   }
 #endif // DUMMY_CORRELATION
   if(nfft_cor > 0){
@@ -99,20 +172,17 @@ void Delay_correction::do_task() {
   }
 }
 
-void Delay_correction::fractional_bit_shift(FLOAT *input,
+void Delay_correction::fractional_bit_shift(std::complex<FLOAT> *spectrum,
     int integer_shift,
     double fractional_delay) {
-  // 3) execute the complex to complex FFT, from Time to Frequency domain
-  //    input: sls. output sls_freq
-  fft_t2f.rfft(&input[0], &frequency_buffer[0]);
-  total_ffts++;
+  // 3) The FFT from Time to Frequency domain is done by the caller
 
   // Element 0 and (fft_size() / 2) are real numbers
-  frequency_buffer[0] *= 0.5;
-  frequency_buffer[fft_size() / 2] *= 0.5; // Nyquist frequency
+  spectrum[0] *= 0.5;
+  spectrum[fft_size() / 2] *= 0.5; // Nyquist frequency
 
   // 4c) zero the unused subband (?)
-  SFXC_ZERO_FC(&frequency_buffer[(fft_size() / 2) + 1], (fft_size() / 2) - 1);
+  SFXC_ZERO_FC(&spectrum[(fft_size() / 2) + 1], (fft_size() / 2) - 1);
 
   // 5a)calculate the fract bit shift (=phase corrections in freq domain)
   // the following should be double
@@ -125,96 +195,123 @@ void Delay_correction::fractional_bit_shift(FLOAT *input,
   // 5b)apply phase correction in frequency range
   const int size = (fft_size() / 2) + 1;
 
-  double phi = constant_term;
-  // in the loop we calculate sin(phi) and cos(phi) with phi=contant_term + i*linear_term
-  // This we do efficiently using a recurrence relation
-  // sin(t+delta)=sin(t)-[a*sin(t)-b*cos(t)] ; cos(t+delta)=cos(t)-[a*cos(t)+b*sin(t)]
-  // a=2*sin^2(delta/2) ; b=sin(delta)
-  double temp=sin(linear_term/2);
-  double a=2*temp*temp,b=sin(linear_term);
-  double cos_phi, sin_phi;
-#ifdef HAVE_SINCOS
-  sincos(phi, &sin_phi, &cos_phi);
-#else
-  sin_phi = sin(phi);
-  cos_phi = cos(phi);
-#endif
-  for (int i = 0; i < size; i++) {
-    // the following should be double
-    exp_array[i] = std::complex<FLOAT>(cos_phi,-sin_phi);
-    // Compute sin_phi=sin(phi); cos_phi = cos(phi);
-    temp=sin_phi-(a*sin_phi-b*cos_phi);
-    cos_phi=cos_phi-(a*cos_phi+b*sin_phi);
-    sin_phi=temp;
-  }
-  SFXC_MUL_FC_I(&exp_array[0], &frequency_buffer[0], size);
-
-  // 6a)execute the complex to complex FFT, from Frequency to Time domain
-  //    input: sls_freq. output sls
-  fft_f2t.ifft(&frequency_buffer[0], &frequency_buffer[0]);
+  SFXC_ROTATE_FC(&spectrum[0], &spectrum[0], size,
+                 -constant_term, -linear_term, 1.0);
 
-  total_ffts++;
+  // 6a)The FFT from Frequency to Time domain is done by the caller
 }
 
-void Delay_correction::fringe_stopping(FLOAT output[]) {
+void Delay_correction::fringe_stopping(const std::complex<FLOAT> *spectrum,
+                                       FLOAT output[], int fft) {
   const double mult_factor_phi = -sideband() * 2.0 * M_PI;
   const double center_freq = channel_freq() + sideband() * (bandwidth() / 2) + LO_offset;
 
-  double phi, delta_phi, sin_phi, cos_phi;
+  double phi, delta_phi;
   double lo_phase = start_phase + LO_offset*current_time.diff(correlation_parameters.stream_start);
-  phi = center_freq * get_delay(current_time) + lo_phase + get_phase(current_time) / (2 * M_PI);
+  phi = center_freq * (edge_delays[fft] + extra_delay) + lo_phase +
+        edge_phases[fft] / (2 * M_PI);
   double floor_phi = std::floor(phi);
   phi = mult_factor_phi*(phi-floor_phi);
 
   { // compute delta_phi
     SFXC_ASSERT(((int64_t)fft_size() * 1000000) % sample_rate() == 0);
-    double phi_end = center_freq * get_delay(current_time + fft_length) + 
+    double phi_end = center_freq * (edge_delays[fft + 1] + extra_delay) +
                      lo_phase + fft_length.get_time()*LO_offset +
-                     get_phase(current_time + fft_length) / (2 * M_PI);
+                     edge_phases[fft + 1] / (2 * M_PI);
     phi_end = mult_factor_phi*(phi_end-floor_phi);
 
     delta_phi = (phi_end - phi) / fft_size();
   }
 
   // We use a constant amplitude factor over the fft
-  double amplitude = get_amplitude(current_time + fft_length/2);
-  // We perform a recursion for the (co)sines similar to what is done in the fractional bitshift
-  double temp=sin(delta_phi/2);
-  double a=2*temp*temp,b=sin(delta_phi);
-#ifdef HAVE_SINCOS
-  sincos(phi, &sin_phi, &cos_phi);
-  sin_phi *= amplitude;
-  cos_phi *= amplitude;
-#else
-  sin_phi = amplitude * sin(phi);
-  cos_phi = amplitude * cos(phi);
-#endif
+  double amplitude = mid_amplitudes[fft];
+  // 7)subtract dopplers and put real part in Bufs for the current segment
+  SFXC_ROTATE_REAL_FC(&spectrum[0], &output[0], fft_size(),
+                      -phi, -delta_phi, amplitude);
+}
 
-  for (size_t i = 0; i < fft_size(); i++) {
-    // Compute sin_phi=sin(phi); cos_phi = cos(phi);
-    // 7)subtract dopplers and put real part in Bufs for the current segment
-    output[i] =
-      frequency_buffer[i].real()*cos_phi + frequency_buffer[i].imag()*sin_phi;
+// Applies the fractional delay and the fringe phase in the middle of the
+// FFT to the spectrum of a zero padded block. This is the same correction
+// as fractional_bit_shift followed by fringe_stopping, except that the
+// fringe phase is constant over the FFT.
+void Delay_correction::frequency_domain_correction(std::complex<FLOAT> *spectrum,
+                                                   int fft) {
+  double delay_in_samples = (mid_delays[fft] + extra_delay) * sample_rate();
+  int integer_delay = (int)std::floor(delay_in_samples+.5);
+  double fractional_delay = delay_in_samples - integer_delay;
 
-    // Compute sin_phi=sin(phi); cos_phi = cos(phi);
-    temp=sin_phi-(a*sin_phi-b*cos_phi);
-    cos_phi=cos_phi-(a*cos_phi+b*sin_phi);
-    sin_phi=temp;
-  }
+  const double mult_factor_phi = -sideband() * 2.0 * M_PI;
+  const double center_freq = channel_freq() + sideband() * (bandwidth() / 2) + LO_offset;
+  double lo_phase = start_phase + LO_offset*current_time.diff(correlation_parameters.stream_start);
+  double phi_begin = center_freq * (edge_delays[fft] + extra_delay) + lo_phase +
+                     edge_phases[fft] / (2 * M_PI);
+  double phi_end = center_freq * (edge_delays[fft + 1] + extra_delay) +
+                   lo_phase + fft_length.get_time()*LO_offset +
+                   edge_phases[fft + 1] / (2 * M_PI);
+  double phi_mid = (phi_begin + phi_end) / 2;
+  double fringe_phase = mult_factor_phi * (phi_mid - std::floor(phi_mid));
+
+  // The spectrum has twice the resolution of the delay FFT
+  const double dfr  = (double)sample_rate() / fft_rot_size();
+  const double tmp1 = -2.0*M_PI*fractional_delay/sample_rate();
+  const double tmp2 = M_PI*(integer_delay & (4*oversamp - 1))/(2*oversamp);
+  const double constant_term = tmp2 - tmp1 * (bandwidth() / 2) + fringe_phase;
+  const double linear_term = tmp1*dfr;
+  // The unnormalised inverse and forward FFTs of the time domain
+  // correction scale the spectrum by fft_size() / 2
+  const double scale = mid_amplitudes[fft] * fft_size() / 2;
+  const int size = (fft_rot_size() / 2) + 1;
+
+  SFXC_ROTATE_FC(&spectrum[0], &spectrum[0], size,
+                 -constant_term, -linear_term, scale);
+  // The time domain correction yields a real DC and Nyquist component
+  spectrum[0] = spectrum[0].real();
+  spectrum[size - 1] = spectrum[size - 1].real();
+}
+
+bool Delay_correction::use_frequency_domain_correction() {
+  // A correlation FFT must contain exactly one zero padded block
+  if ((correlation_parameters.window != SFXC_WINDOW_NONE) ||
+      (2 * fft_size() != fft_cor_size()) || (fft_rot_size() != fft_cor_size()) ||
+      (correlation_parameters.sideband !=
+       correlation_parameters.station_streams[stream_idx].sideband))
+    return false;
+
+  // The change of the fringe phase over an FFT, the phase of the delay
+  // table itself is nearly constant
+  const double center_freq = channel_freq() + sideband() * (bandwidth() / 2) + LO_offset;
+  double rate = std::max(std::abs(delay_table.rate(current_time)),
+                         std::abs(delay_table.rate(delay_table.interval_end)));
+  double drift = (std::abs(center_freq) * rate + std::abs(LO_offset)) *
+                 fft_length.get_time();
+  return drift < MAX_FRINGE_DRIFT;
 }
 
 void
-Delay_correction::set_parameters(const Correlation_parameters &parameters, Delay_table_akima &delays) {
-  stream_idx = 0;
-  while ((stream_idx < parameters.station_streams.size()) &&
-         (parameters.station_streams[stream_idx].station_stream != stream_nr))
-    stream_idx++;
-  if (stream_idx == parameters.station_streams.size()) {
+Delay_correction::set_new_parameters(const Correlation_parameters &parameters, Delay_table_akima &delays) {
+  int idx = 0;
+  while ((idx < parameters.station_streams.size()) &&
+         (parameters.station_streams[idx].station_stream != stream_nr))
+    idx++;
+  if (idx == parameters.station_streams.size()) {
     // Data stream is not participating in current time slice
     return;
   }
 
-  delay_table = delays;
+  Delay_parameters new_parameters;
+  new_parameters.parameters = parameters;
+  new_parameters.delays = delays;
+  queue_.push(new_parameters);
+}
+
+void
+Delay_correction::set_parameters() {
+  const Correlation_parameters &parameters = queue_.front().parameters;
+  stream_idx = 0;
+  while (parameters.station_streams[stream_idx].station_stream != stream_nr)
+    stream_idx++;
+
+  delay_table = queue_.front().delays;
   bits_per_sample = parameters.station_streams[stream_idx].bits_per_sample;
   correlation_parameters = parameters;
   oversamp = sample_rate() / (2 * bandwidth());
@@ -230,22 +327,30 @@ Delay_correction::set_parameters(const Correlation_parameters &parameters, Delay
   // bit2float module.  The following calculation over-estimates the
   // size a little bit, but that is ok.
   size_t nfft_min = std::max(fft_rot_size() / fft_size(), (size_t)1);
-  size_t nfft_max = nfft_min * SFXC_NTAPS +
+  size_t nfft_buffer =
     (std::max(CORRELATOR_BUFFER_SIZE / fft_size(), nfft_min) *
      sample_rate()) / correlation_parameters.sample_rate;
+  size_t nfft_max = nfft_min * SFXC_NTAPS + nfft_buffer;
   time_buffer.resize(nfft_max * fft_size());
 
-  exp_array.resize(fft_size());
-  frequency_buffer.resize(fft_size());
+  // Holds all delay correction FFTs of one input buffer
+  frequency_buffer.resize(nfft_buffer * fft_size());
+
+  // Holds all windowed segments that are produced from one input buffer,
+  // the last window may extend beyond its segment
+  size_t nfft_cor_max = time_buffer.size() / (fft_rot_size() / 2);
   if (parameters.window == SFXC_WINDOW_PFB)
-    temp_buffer.resize(fft_rot_size() * SFXC_NTAPS);
+    temp_buffer.resize((nfft_cor_max - 1) * fft_rot_size() + fft_rot_size() * SFXC_NTAPS);
   else
-    temp_buffer.resize(fft_rot_size());
+    temp_buffer.resize(nfft_cor_max * fft_rot_size());
 
   if (fft_cor_size() > fft_rot_size())
-    temp_fft_buffer.resize(fft_cor_size()/2 + 4);
+    temp_fft_stride = fft_cor_size()/2 + 4;
   else
-    temp_fft_buffer.resize(fft_rot_size()/2 + 4);
+    temp_fft_stride = fft_rot_size()/2 + 4;
+  temp_fft_buffer.resize(nfft_cor_max * temp_fft_stride);
+  // Only the spectral points produced by the FFT are overwritten, the rest
+  // of each segment stays zero
   memset(&temp_fft_buffer[0], 0, temp_fft_buffer.size() * sizeof(temp_fft_buffer[0]));
 
   fft_t2f.resize(fft_size());
@@ -284,29 +389,29 @@ Delay_correction::set_parameters(const Correlation_parameters &parameters, Delay
 
   extra_delay = parameters.station_streams[stream_idx].extra_delay;
 
+  frequency_domain = use_frequency_domain_correction();
+
   current_fft = 0;
   tbuf_start = 0;
   tbuf_end = 0;
+  queue_.pop();
 }
 
-void Delay_correction::connect_to(Input_buffer_ptr new_input_buffer) {
+void Delay_correction::connect_to(Input_buffer_ptr new_input_buffer,
+                                  Memory_placement_ptr new_input_placement) {
   SFXC_ASSERT(input_buffer == Input_buffer_ptr());
   input_buffer = new_input_buffer;
+  input_placement = new_input_placement;
 }
 
-double Delay_correction::get_delay(Time time) {
-  return delay_table.delay(time) + extra_delay;
-}
-
-double Delay_correction::get_phase(Time time) {
-  return delay_table.phase(time);
-}
-
-double Delay_correction::get_amplitude(Time time) {
-  return delay_table.amplitude(time);
+void Delay_correction::set_notifier(Notifier *notifier) {
+  output_memory_pool.set_notifier(notifier);
 }
 
 bool Delay_correction::has_work() {
+  // Start on the next time slice, its input may already be waiting
+  if ((n_ffts_per_integration == current_fft) && !queue_.empty())
+    set_parameters();
   if (input_buffer->empty())
     return false;
   if (output_memory_pool.empty())
@@ -323,6 +428,11 @@ Delay_correction::get_output_buffer() {
   return output_buffer;
 }
 
+Memory_placement_ptr
+Delay_correction::get_output_placement() {
+  return output_placement;
+}
+
 int Delay_correction::sideband() {
   return (correlation_parameters.station_streams[stream_idx].sideband == 'L' ? -1 : 1);
 }
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 //c++ includes
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -39,6 +40,144 @@
 //function definitions
 //*****************************************************************************
 
+Delay_polynomial::Delay_polynomial()
+  : t_begin(0), inv_dt(0), uniform(true), n_segments(0) {}
+
+void
+Delay_polynomial::init(const gsl_spline *spline, double offset, double rate) {
+  const double *x = spline->x, *y = spline->y;
+  int n = spline->size;
+  SFXC_ASSERT(n >= 2);
+  n_segments = n - 1;
+  knots.assign(x, x + n);
+  c0.resize(n_segments);
+  c1.resize(n_segments);
+  c2.resize(n_segments);
+  c3.resize(n_segments);
+
+  // The delay tables are sampled once per second, the test for a uniform
+  // grid is only a safeguard
+  t_begin = x[0];
+  double dt = (x[n - 1] - x[0]) / n_segments;
+  inv_dt = 1. / dt;
+  uniform = true;
+  for (int i = 1; i < n; i++) {
+    if (std::abs(x[i] - (x[0] + i * dt)) > 1e-9 * dt)
+      uniform = false;
+  }
+
+  // Within a segment the Akima spline is a cubic polynomial. The first two
+  // derivatives at the start of the segment give the linear and quadratic
+  // terms, the cubic term follows from the value at the end. The
+  // derivative is not always continuous at the knots, hence the
+  // derivatives at the end of a segment are not used.
+  gsl_interp_accel *acc = gsl_interp_accel_alloc();
+  for (int i = 0; i < n_segments; i++) {
+    double h = x[i + 1] - x[i];
+    double m = (y[i + 1] - y[i]) / h;
+    double b = gsl_spline_eval_deriv(spline, x[i], acc);
+    double c = gsl_spline_eval_deriv2(spline, x[i], acc) / 2;
+    c0[i] = y[i] + offset + rate * x[i];
+    c1[i] = b + rate;
+    c2[i] = c;
+    c3[i] = (m - b - c * h) / (h * h);
+  }
+
+  // Validate against the spline in the middle of each segment
+  for (int i = 0; i < n_segments; i++) {
+    double t = 0.5 * (x[i] + x[i + 1]);
+    double ref = gsl_spline_eval(spline, t, acc) + offset + rate * t;
+    double scale = std::max(std::abs(y[i]), std::abs(y[i + 1])) +
+                   std::abs(offset) + std::abs(rate * t);
+    SFXC_ASSERT(std::abs(eval(t) - ref) <= 1e-10 * scale);
+  }
+  gsl_interp_accel_free(acc);
+}
+
+void
+Delay_polynomial::eval(double t0, double step, int n, double *result) const {
+  for (int i = 0; i < n; i++)
+    result[i] = eval(t0 + i * step);
+}
+
+#ifdef ENABLE_TEST_UNIT
+double
+Delay_polynomial::Test::max_error(const std::vector<double> &x, const std::vector<double> &y,
+                                  double offset, double rate) {
+  int n = x.size();
+  gsl_spline *spline = gsl_spline_alloc(gsl_interp_akima, n);
+  gsl_spline_init(spline, &x[0], &y[0], n);
+  gsl_interp_accel *acc = gsl_interp_accel_alloc();
+  Delay_polynomial poly;
+  poly.init(spline, offset, rate);
+
+  std::vector<double> t;
+  for (int i = 0; i < n - 1; i++) {
+    double h = x[i + 1] - x[i];
+    t.push_back(x[i]);
+    t.push_back(x[i] + 1e-9 * h);
+    t.push_back(x[i] + 0.25 * h);
+    t.push_back(x[i] + 0.5 * h);
+    t.push_back(x[i + 1] - 1e-9 * h);
+  }
+  t.push_back(x[n - 1]);
+
+  double scale = std::abs(offset) + std::abs(rate * x[n - 1]);
+  for (int i = 0; i < n; i++)
+    scale = std::max(scale, std::abs(y[i]));
+  double error = 0;
+  for (size_t i = 0; i < t.size(); i++) {
+    double ref = gsl_spline_eval(spline, t[i], acc) + offset + rate * t[i];
+    double ref_deriv = gsl_spline_eval_deriv(spline, t[i], acc) + rate;
+    double ref_deriv2 = gsl_spline_eval_deriv2(spline, t[i], acc);
+    error = std::max(error, std::abs(poly.eval(t[i]) - ref) / scale);
+    error = std::max(error, std::abs(poly.deriv(t[i]) - ref_deriv) / scale);
+    error = std::max(error, std::abs(poly.deriv2(t[i]) - ref_deriv2) / scale);
+  }
+
+  // The clock is folded into the coefficients at the knots
+  for (int i = 0; i < n - 1; i++)
+    error = std::max(error, std::abs(poly.c0[i] - (y[i] + offset + rate * x[i])) / scale);
+
+  // Batched evaluation gives the same results as single points
+  const int n_batch = 1000;
+  double step = (x[n - 1] - x[0]) / n_batch;
+  std::vector<double> batch(n_batch);
+  poly.eval(x[0], step, n_batch, &batch[0]);
+  for (int i = 0; i < n_batch; i++)
+    error = std::max(error, std::abs(batch[i] - poly.eval(x[0] + i * step)) / scale);
+
+  gsl_interp_accel_free(acc);
+  gsl_spline_free(spline);
+  return error;
+}
+
+void
+Delay_polynomial::Test::tests() {
+  // A delay of a few ms with a diurnal term and a kink, on the uniform
+  // grid of one point per second used by the delay tables and on a
+  // non-uniform grid
+  const int n = 21;
+  std::vector<double> uniform(n), nonuniform(n);
+  for (int i = 0; i < n; i++) {
+    uniform[i] = -2 + i;
+    nonuniform[i] = -2 + i + 0.3 * sin(1.7 * i);
+  }
+  std::vector<double> y_uniform(n), y_nonuniform(n);
+  for (int i = 0; i < n; i++) {
+    double t = uniform[i];
+    y_uniform[i] = 3e-3 + 2e-6 * t + 1e-3 * sin(7.27e-5 * t) + 1e-9 * std::abs(t - 7.5);
+    t = nonuniform[i];
+    y_nonuniform[i] = 3e-3 + 2e-6 * t + 1e-3 * sin(7.27e-5 * t) + 1e-9 * std::abs(t - 7.5);
+  }
+
+  TEST_ASSERT( max_error(uniform, y_uniform, 0, 0) < 1e-12 );
+  TEST_ASSERT( max_error(uniform, y_uniform, 1.5e-6, 2e-12) < 1e-12 );
+  TEST_ASSERT( max_error(nonuniform, y_nonuniform, 0, 0) < 1e-12 );
+  TEST_ASSERT( max_error(nonuniform, y_nonuniform, -1.5e-6, -3e-12) < 1e-12 );
+}
+#endif // ENABLE_TEST_UNIT
+
 Delay_table_akima::Delay_table_akima() {
   ref_count = new int(1);
   mutex = new pthread_mutex_t;
@@ -62,9 +201,6 @@ Delay_table_akima::free_reference() {
       gsl_spline_free(splineakima[i]);
       gsl_spline_free(splineakima_ph[i]);
       gsl_spline_free(splineakima_amp[i]);
-      gsl_interp_accel_free(acc[i]);
-      gsl_interp_accel_free(acc_ph[i]);
-      gsl_interp_accel_free(acc_amp[i]);
     }
     pthread_mutex_unlock(mutex);
     pthread_mutex_destroy (mutex);
@@ -77,9 +213,9 @@ Delay_table_akima::free_reference() {
   splineakima.resize(0);
   splineakima_ph.resize(0);
   splineakima_amp.resize(0);
-  acc.resize(0);
-  acc_ph.resize(0);
-  acc_amp.resize(0);
+  poly_delay.resize(0);
+  poly_phase.resize(0);
+  poly_amp.resize(0);
 }
 
 void
@@ -94,9 +230,9 @@ Delay_table_akima::copy(const Delay_table_akima &other) {
   splineakima = other.splineakima;
   splineakima_ph = other.splineakima_ph;
   splineakima_amp = other.splineakima_amp;
-  acc = other.acc;
-  acc_ph = other.acc_ph;
-  acc_amp = other.acc_amp;
+  poly_delay = other.poly_delay;
+  poly_phase = other.poly_phase;
+  poly_amp = other.poly_amp;
   interval_begin = other.interval_begin;
   interval_end = other.interval_end;
   scan_begin = other.scan_begin;
@@ -119,10 +255,17 @@ double Delay_table_akima::delay(const Time &time, int phase_center) {
   double sec = time.diff(scan_begin);
   //std::cerr << RANK_OF_NODE << ", t = " << time << ", interval = " << interval_begin << " - " << interval_end 
   //          << ", scan_begin = " << scan_begin << ", sec = " << sec << "\n";
-  double result = gsl_spline_eval(splineakima[phase_center], sec, acc[phase_center]);
-  sec = time.diff(clock_epoch);
-  double clock_drift = clock_offset + sec * clock_rate;
-  return result + clock_drift;
+  return poly_delay[phase_center].eval(sec);
+}
+
+void Delay_table_akima::delay(const Time &start, const Time &step, int n,
+                              double *result, int phase_center) {
+  if (n <= 0)
+    return;
+  SFXC_ASSERT(start >= interval_begin);
+  SFXC_ASSERT(start + step * (n - 1) <= interval_end);
+  SFXC_ASSERT((phase_center >= 0) && (poly_delay.size() > (size_t)phase_center));
+  poly_delay[phase_center].eval(start.diff(scan_begin), step.get_time(), n, result);
 }
 
 double Delay_table_akima::rate(const Time &time, int phase_center) {
@@ -131,8 +274,7 @@ double Delay_table_akima::rate(const Time &time, int phase_center) {
   SFXC_ASSERT(splineakima.size() > 0);
 
   double sec = time.diff(scan_begin);
-  double result = gsl_spline_eval_deriv(splineakima[phase_center], sec, acc[phase_center]);
-  return result + clock_rate;
+  return poly_delay[phase_center].deriv(sec);
 }
 
 double Delay_table_akima::accel(const Time &time, int phase_center) {
@@ -141,8 +283,7 @@ double Delay_table_akima::accel(const Time &time, int phase_center) {
   SFXC_ASSERT(splineakima.size() > 0);
 
   double sec = time.diff(scan_begin);
-  double result = gsl_spline_eval_deriv2(splineakima[phase_center], sec, acc[phase_center]);
-  return result;
+  return poly_delay[phase_center].deriv2(sec);
 }
 
 double Delay_table_akima::phase(const Time &time, int phase_center) {
@@ -151,8 +292,17 @@ double Delay_table_akima::phase(const Time &time, int phase_center) {
   SFXC_ASSERT(splineakima.size() > phase_center);
 
   double sec = time.diff(scan_begin);
-  double result = gsl_spline_eval(splineakima_ph[phase_center], sec, acc_ph[phase_center]);
-  return result;
+  return poly_phase[phase_center].eval(sec);
+}
+
+void Delay_table_akima::phase(const Time &start, const Time &step, int n,
+                              double *result, int phase_center) {
+  if (n <= 0)
+    return;
+  SFXC_ASSERT(start >= interval_begin);
+  SFXC_ASSERT(start + step * (n - 1) <= interval_end);
+  SFXC_ASSERT((phase_center >= 0) && (poly_phase.size() > (size_t)phase_center));
+  poly_phase[phase_center].eval(start.diff(scan_begin), step.get_time(), n, result);
 }
 
 double Delay_table_akima::amplitude(const Time &time, int phase_center) {
@@ -161,8 +311,17 @@ double Delay_table_akima::amplitude(const Time &time, int phase_center) {
   SFXC_ASSERT(splineakima.size() > phase_center);
 
   double sec = time.diff(scan_begin);
-  double result = gsl_spline_eval(splineakima_amp[phase_center], sec, acc_amp[phase_center]);
-  return result;
+  return poly_amp[phase_center].eval(sec);
+}
+
+void Delay_table_akima::amplitude(const Time &start, const Time &step, int n,
+                                  double *result, int phase_center) {
+  if (n <= 0)
+    return;
+  SFXC_ASSERT(start >= interval_begin);
+  SFXC_ASSERT(start + step * (n - 1) <= interval_end);
+  SFXC_ASSERT((phase_center >= 0) && (poly_amp.size() > (size_t)phase_center));
+  poly_amp[phase_center].eval(start.diff(scan_begin), step.get_time(), n, result);
 }
 
 // Default constructor
@@ -498,11 +657,15 @@ Delay_table::create_akima_spline(const Time start_, const Time duration) {
   result.splineakima.resize(n_sources_in_current_scan);
   result.splineakima_ph.resize(n_sources_in_current_scan);
   result.splineakima_amp.resize(n_sources_in_current_scan);
-  result.acc.resize(n_sources_in_current_scan);
-  result.acc_ph.resize(n_sources_in_current_scan);
-  result.acc_amp.resize(n_sources_in_current_scan);
   result.sources.resize(n_sources_in_current_scan);
+  result.poly_delay.resize(n_sources_in_current_scan);
+  result.poly_phase.resize(n_sources_in_current_scan);
+  result.poly_amp.resize(n_sources_in_current_scan);
   SFXC_ASSERT(n_sources_in_current_scan > 0);
+  // The clock model relative to the start of the scan
+  double clock_rate = clock_rates[clock_nr];
+  double clock_offset = clock_offsets[clock_nr] +
+    scans[scan_nr].begin.diff(clock_epochs[clock_nr]) * clock_rate;
   for (int i = 0; i < n_sources_in_current_scan; i++) {
     Scan &scan = scans[scan_nr + i];
     result.sources[i] = sources[scan.source];
@@ -513,9 +676,6 @@ Delay_table::create_akima_spline(const Time start_, const Time duration) {
     SFXC_ASSERT(n_pts > 4);
 
     // Initialise the Akima spline
-    result.acc[i] = gsl_interp_accel_alloc();
-    result.acc_ph[i] = gsl_interp_accel_alloc();
-    result.acc_amp[i] = gsl_interp_accel_alloc();
     result.splineakima[i] = gsl_spline_alloc(gsl_interp_akima, n_pts);
     result.splineakima_ph[i] = gsl_spline_alloc(gsl_interp_akima, n_pts);
     result.splineakima_amp[i] = gsl_spline_alloc(gsl_interp_akima, n_pts);
@@ -523,6 +683,10 @@ Delay_table::create_akima_spline(const Time start_, const Time duration) {
     gsl_spline_init(result.splineakima[i], &times[scan.times+idx], &delays[scan.delays+idx], n_pts);
     gsl_spline_init(result.splineakima_ph[i], &times[scan.times+idx], &phases[scan.phases+idx], n_pts);
     gsl_spline_init(result.splineakima_amp[i], &times[scan.times+idx], &amplitudes[scan.amplitudes+idx], n_pts);
+
+    result.poly_delay[i].init(result.splineakima[i], clock_offset, clock_rate);
+    result.poly_phase[i].init(result.splineakima_ph[i]);
+    result.poly_amp[i].init(result.splineakima_amp[i]);
   }
 
   result.scan_begin = scans[scan_nr].begin;
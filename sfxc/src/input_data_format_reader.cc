@@ -13,8 +13,8 @@ bool Input_data_format_reader::eof() {
 }
 
 void Input_data_format_reader::find_fill_pattern(Data_frame &data){
-  int buffer_size = data.buffer->data.size() / 4; // number of 32 bit words in buffer
-  uint32_t *buffer = (uint32_t *)&data.buffer->data[0];
+  int buffer_size = data.buffer->size() / 4; // number of 32 bit words in buffer
+  const uint32_t *buffer = (const uint32_t *)data.buffer->begin();
 
   // See if there is already a bit of invalid data (assumed to start at byte 0)
   int start = 0;
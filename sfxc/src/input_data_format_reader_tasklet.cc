@@ -1,4 +1,5 @@
 #include "input_data_format_reader_tasklet.h"
+#include "cpu_affinity.h"
 #define NSKIP  16  // Number of frames to skip if we can't find a new header
 #define NSKEW  128
 
@@ -20,6 +21,7 @@ Input_data_format_reader_tasklet(
 
   data_read_=0;
   allocate_element();
+  set_affinity_role(CPU_ROLE_INPUT_READER);
 }
 
 Input_data_format_reader_tasklet::~Input_data_format_reader_tasklet(){  
@@ -79,7 +81,7 @@ do_task() {
     nr_eof++;
     for (size_t i = 0; i < current_time.size(); i++) {
       if (current_time[i] < current_interval_.stop_time_)
-        push_random_blocks(1, i);
+        push_invalid_blocks(1, i);
     }
     return;
   }
@@ -91,7 +93,7 @@ do_task() {
       int nframes = (nframes_left[i] - min_frames_left) - skew;
       nr_skew += nframes;
       // Insert invalid blocks to prevent bad data streams to stall the correlation
-      push_random_blocks(nframes, i);
+      push_invalid_blocks(nframes, i);
       return;
     }
   }
@@ -101,7 +103,7 @@ do_task() {
     nr_read_error += nframes;
     // Insert invalid blocks to prevent bad data streams to stall the correlation
     for (size_t i = 0; i < current_time.size(); i++) 
-      push_random_blocks(nframes, i);
+      push_invalid_blocks(nframes, i);
     return;
   }
 
@@ -110,9 +112,9 @@ do_task() {
 
   if (current_time[channel] >= current_interval_.leave_time_) {
     int nframes = std::min(NSKIP, nframes_left[channel]);
-    push_random_blocks(nframes, channel);
+    push_invalid_blocks(nframes, channel);
     for (int i = 0; i < duplicate[channel].size(); i++) 
-      push_random_blocks(nframes, duplicate[channel][i]);
+      push_invalid_blocks(nframes, duplicate[channel][i]);
     return;
   }
 
@@ -134,17 +136,19 @@ do_task() {
       if (input_element_.start_time > now) {
 	// Data from the future; drop the frame, insert an invalid block and complain
 	LOG_MSG(": causality violation " << input_element_.start_time);
-	push_random_blocks(1, channel);
+	push_invalid_blocks(1, channel);
         for (int i = 0; i < duplicate[channel].size(); i++) 
-          push_random_blocks(1, duplicate[channel][i]);
+          push_invalid_blocks(1, duplicate[channel][i]);
 	return;
       }
 
       nr_missing += nframes_missing;
+      // The invalid blocks only carry metadata, the frame that was read
+      // is pushed after them
       Input_element old_input_element = input_element_;
-      push_random_blocks(nframes_missing, channel);
+      push_invalid_blocks(nframes_missing, channel);
       for (int i = 0; i < duplicate[channel].size(); i++) 
-        push_random_blocks(nframes_missing, duplicate[channel][i]);
+        push_invalid_blocks(nframes_missing, duplicate[channel][i]);
       input_element_ = old_input_element;
     } else if (nframes_missing < 0) {
       nr_past += 1;
@@ -168,7 +172,7 @@ do_task() {
   if(data_modulation)
     demodulate(input_element_);
 
-  data_read_ += input_element_.buffer->data.size();
+  data_read_ += input_element_.buffer->size();
   push_element();
   for (int i = 0; i < duplicate[channel].size(); i++) {
     input_element_.channel = duplicate[channel][i];
@@ -183,7 +187,14 @@ Input_data_format_reader_tasklet::fetch_next_time_interval() {
   if (current_interval_.empty())
     return;
 
-  if (!reader_->is_open() && !reader_->open_input_stream(input_element_)) {
+  bool is_open = reader_->is_open();
+  if (!is_open) {
+    // The frame that is read replaces a block that may have been invalidated
+    input_element_.invalid.resize(0);
+    input_element_.all_invalid = false;
+    is_open = reader_->open_input_stream(input_element_);
+  }
+  if (!is_open) {
     if (reader_->eof() && exit_on_empty_datastream)
       sfxc_abort("Could not find header before eof()");
     for (size_t i = 0; i < current_time.size(); i++) {
@@ -202,6 +213,8 @@ Input_data_format_reader_tasklet::fetch_next_time_interval() {
     int64_t nframes = (int64_t)round((input_element_.start_time - current_interval_.start_time_) / reader_->time_between_headers());
     time = current_interval_.start_time_ + reader_->time_between_headers() * nframes;
   } else {
+    input_element_.invalid.resize(0);
+    input_element_.all_invalid = false;
     time = goto_time(current_interval_.start_time_);
     int64_t nframes = (int64_t)round((time - current_interval_.start_time_)/ reader_->time_between_headers());
     time = current_interval_.start_time_ + reader_->time_between_headers() * nframes;
@@ -211,7 +224,7 @@ Input_data_format_reader_tasklet::fetch_next_time_interval() {
 
   if (time > current_interval_.stop_time_) {
     time = current_interval_.stop_time_ - reader_->time_between_headers();
-    randomize_block();
+    invalidate_block();
     input_element_.start_time = time;
     input_element_.channel = 0;
   }
@@ -222,7 +235,7 @@ Input_data_format_reader_tasklet::fetch_next_time_interval() {
   }
   min_frames_left = nframes_left[0];
 
-  data_read_ += input_element_.buffer->data.size();
+  data_read_ += input_element_.buffer->size();
   push_element();
   for (int i = 0, ch = input_element_.channel; i < duplicate[ch].size(); i++) {
     input_element_.channel = duplicate[ch][i];
@@ -231,13 +244,13 @@ Input_data_format_reader_tasklet::fetch_next_time_interval() {
 }
 
 void
-Input_data_format_reader_tasklet::push_random_blocks(int nblocks, int channel)
+Input_data_format_reader_tasklet::push_invalid_blocks(int nblocks, int channel)
 {
   for (int i = 0; i < nblocks; i++) {
-    randomize_block();
+    invalidate_block();
     input_element_.start_time = current_time[channel];
     input_element_.channel = channel;
-    data_read_ += input_element_.buffer->data.size();
+    data_read_ += reader_->size_data_block();
     push_element();
   }
 }
@@ -264,6 +277,7 @@ void
 Input_data_format_reader_tasklet::set_parameters(const Input_node_parameters &params){
   data_modulation = params.data_modulation;
   reader_->set_parameters(params);
+  reader_->set_read_ahead(params.read_ahead_depth, params.read_ahead_block_size);
 
   if (reader_->get_transport_type() == VDIF && params.n_tracks == 0) {
     current_time.resize(params.channels.size());
@@ -298,9 +312,12 @@ void
 Input_data_format_reader_tasklet::
 allocate_element() {
   input_element_.buffer = memory_pool_->allocate();
+  // Release the view of the previous user of the buffer
+  input_element_.buffer->clear_view();
   input_element_.invalid.resize(0);
   input_element_.channel=0;
   input_element_.start_time=Time();
+  input_element_.all_invalid = false;
 }
 
 Time
@@ -336,7 +353,8 @@ push_element() {
     SFXC_ASSERT(input_element_.invalid[i].invalid_begin >= 0);
     SFXC_ASSERT(input_element_.invalid[i].nr_invalid >= 0);
   }
-  SFXC_ASSERT(input_element_.buffer->data.size() == reader_->size_data_block());
+  SFXC_ASSERT(input_element_.all_invalid ||
+              (input_element_.buffer->size() == reader_->size_data_block()));
   input_element_.seqno = seqno++;
   current_time[input_element_.channel] += reader_->time_between_headers();
   nframes_left[input_element_.channel]--;
@@ -353,33 +371,10 @@ get_output_buffer() {
 
 void
 Input_data_format_reader_tasklet::
-randomize_block() {
-  // Randomize/invalidate the data in the current block
-  // Make sure the data has the right size
-  size_t size = reader_->size_data_block();
-  if (input_element_.buffer->data.size() != size) {
-    input_element_.buffer->data.resize(size);
-  }
-#ifdef SFXC_INVALIDATE_SAMPLES
-  input_element_.invalid.resize(1);
-  input_element_.invalid[0].invalid_begin = 0;
-  input_element_.invalid[0].nr_invalid = size;
-#ifdef SFXC_CHECK_INVALID_SAMPLES
-  value_type *buffer = input_element_.buffer->data[0];
-  for (size_t i=0; i<size; i++) {
-    buffer[i] = value_type(0);
-  }
-#endif // SFXC_CHECK_INVALID_SAMPLES
-
-#else // !SFXC_INVALIDATE_SAMPLES
-  value_type *buffer = &input_element_.buffer->data[0];
-  for (size_t i=0; i<size; i++) {
-    // Randomize data
-    // park_miller_random generates 31 random bits
-    buffer[i] = (value_type)park_miller_random();
-  }
-
-#endif // SFXC_INVALIDATE_SAMPLES
+invalidate_block() {
+  // Flag the whole block as invalid. Only the metadata is passed on: the
+  // channel extractor, the data writer and bit2float skip the data
+  input_element_.invalidate(reader_->size_data_block());
 }
 
 void 
@@ -388,6 +383,7 @@ Input_data_format_reader_tasklet::demodulate(Input_element &data)
 {
   const size_t n_bytes_per_input_word = reader_->bytes_per_input_word();
           
+  data.buffer->copy_view();
   std::vector<value_type> &buffer=data.buffer->data;
   int frame_size=buffer.size()/n_bytes_per_input_word;
   // The factor frame_size/8 is there because the sequence also advances at parity bits
@@ -13,6 +13,7 @@
 #include "data_reader_buffer.h"
 #include "mpi_transfer.h"
 #include "data_writer_file.h"
+#include "cpu_affinity.h"
 
 #include <iostream>
 #include <time.h>
@@ -87,10 +88,7 @@ void Input_node::start() {
 
 void Input_node::main_loop() {
   while ( status != END_NODE )
-	{
-    if (check_and_process_waiting_message() == NO_MESSAGE)
-      usleep(100);
-  }
+    poll_messages();
 }
 
 void Input_node::terminate() {
@@ -156,7 +154,8 @@ void Input_node::get_state(std::ostream &out) {
       << "  \"rank\": " << RANK_OF_NODE << ",\n"
       << "  \"host\": \"" << HOSTNAME_OF_NODE << "\",\n"
       << "  \"id\": \"" << ID_OF_NODE << "\",\n"
-      << "  \"now\": \"" << Time::now() << "\"";
+      << "  \"now\": \"" << Time::now() << "\",\n";
+  Cpu_affinity::get_state(out, "  ");
   if (input_node_tasklet != NULL) {
     out << ",\n";
     input_node_tasklet->get_state(out);
@@ -4,17 +4,17 @@
 
 #include "sfxc_mpi.h"
 #include "input_node_data_writer.h"
+#include "cpu_affinity.h"
 
 Input_node_data_writer::Input_node_data_writer() {
-  last_duration_ = 0;
-  total_data_written_ = 0;
-  delay_index=0;
+  set_affinity_role(CPU_ROLE_DATA_WRITER);
+  pending_slices_.set_notifier(&notifier_);
+  intervals_.set_notifier(&notifier_);
+  delays_.set_notifier(&notifier_);
+  min_delay_bytes_ = 0;
   _current_time=0;
   interval=0;
   phasecal_count=0;
-  frames_to_buffer = 0;
-  input_index = 0;
-  sync_stream=false;
 }
 
 Input_node_data_writer::~Input_node_data_writer() {
@@ -24,42 +24,28 @@ Input_node_data_writer::~Input_node_data_writer() {
                     << input_buffer_->size());
         }
     }
-  while  (!data_writers_.empty()) {
-      if ((data_writers_.front().active) &&
-          (data_writers_.front().slice_size <= 0)) {
-          data_writers_.pop();
-        } else {
-          break;
-        }
-    }
-  if (!data_writers_.empty()) {
+  if (!slices_.empty() || !pending_slices_.empty()) {
       DEBUG_MSG("Data_writers are still waiting to produce output.");
     }
-
-  double wait_duration = (timer_waiting_.measured_time()+timer_other_.measured_time());
-  double total_duration = wait_duration+timer_writing_.measured_time();
-  //double ratio1 = ((100.0*timer_waiting_.measured_time())/total_duration);
-  //double ratio2 = ((100.0*timer_other_.measured_time())/total_duration);
-  //double ratio3 = ((100.0*timer_writing_.measured_time())/total_duration);
-
-  last_duration_ = total_duration;
-  DEBUG_MSG( "data_writer byte sent:" << toMB(total_data_written_) << "MB" );
 }
 
 void Input_node_data_writer::do_execute()
 {
   bool did_work = false;
 
-  total_data_written_ = 0;
-
   while( true ){
-    did_work = false;
+    // Read the event count before looking for work, such that an event
+    // in between is not missed
+    uint64_t events = notifier_.count();
+    did_work = retire_slices();
+    while (open_next_slice())
+      did_work = true;
     if (has_work()){
-      total_data_written_ += do_task();
+      do_task();
       did_work=true;
     }
     if( !did_work )
-      usleep(1000);
+      notifier_.wait(events);
   }
 }
 
@@ -67,188 +53,140 @@ void
 Input_node_data_writer::
 connect_to(Input_buffer_ptr new_input_buffer) {
   input_buffer_ = new_input_buffer;
+  input_buffer_->set_notifier(&notifier_);
 }
 
 bool
 Input_node_data_writer::
 has_work() {
-  // No data writers to send the data to
-  if (data_writers_.empty())
+  // Not sufficient input data
+  if (input_buffer_->empty())
     return false;
 
-  // Check for new time interval
-  if (!data_writers_.front().active){
-    if ( _current_time >= current_interval_.stop_time_ ) {
-      if (( intervals_.empty() ) || ( delays_.empty() )){
+  Input_buffer_element &block = input_buffer_->front();
+  bool wanted = false, all_full = true;
+  for (size_t i = 0; i < slices_.size(); i++) {
+    if (slices_[i]->wants(block)) {
+      // The correlator node of this slice has a full queue, the block
+      // can not be skipped for it
+      if (slices_[i]->full() && slices_[i]->active())
         return false;
-      }
-      interval++;
-      fetch_next_time_interval();
+      all_full = all_full && slices_[i]->full();
+      wanted = true;
     }
-    // The data writer in the front of the queue is still being used
-    // to send data from another channel
-    if (data_writers_.front().writer->is_active())
-      return false;
   }
-
- // Not sufficient input data
-  if (input_index >= input_buffer_->size())
-    return false;
-
-#if 0
-  // Check whether we can send data to the active writer
-  if (!data_writers_.front().writer->can_write())
+  // Slices that wait for their turn stop taking blocks once they are
+  // full, unless another slice still needs the block to make progress
+  if (wanted && all_full)
     return false;
-#endif
-
-  return true;
+  // If no open slice wants the block, we can only release it when no
+  // slice that is still to be assigned needs it
+  return wanted || !needed_later(block);
 }
 
-uint64_t
+void
 Input_node_data_writer::
 do_task() {
-  // Acquire the input data
-  Input_buffer_element &input_element = (*input_buffer_)[input_index];
-  struct Writer_struct& data_writer = data_writers_.front();
-
-  do_phasecal();
-
-  int64_t byte_offset=0;
-  int samples_per_byte = 8/bits_per_sample;
+  Input_buffer_element &block = input_buffer_->front();
 
-  // Check whether we have to start a new timeslice
-  if(!data_writer.active){
-    // Initialise the size of the data slice
-    SFXC_ASSERT(data_writer.slice_size>0);
-    data_writer.writer->set_size_dataslice(-1);
-    data_writer.writer->activate();
-    data_writer.active = true;
-    // Determine how many frames should be buffered because of the dedispersion filter
-    block_size = input_element.channel_data.data().data.size();
-    frames_to_buffer = std::max(1., ceil(3*overlap_time.get_time_usec() * (sample_rate/1000000) *
-                                         bits_per_sample / (8.*block_size)));
- 
-    DEBUG_MSG("FETCHING FOR A NEW WRITER......");
-    delay_index = 0;
-    sync_stream = true;
+  // Send the phasecal of the intervals that ended before this block
+  while ((!phasecal_flush_times_.empty()) &&
+         (block.start_time >= phasecal_flush_times_.front())) {
+    write_phasecal(phasecal_flush_times_.front());
+    phasecal_flush_times_.pop_front();
   }
-  if(sync_stream){
-    // Move to the next integer delay change
-    int delay_size = cur_delay.size();
-    while((delay_index < delay_size - 1) && (cur_delay[delay_index+1].time <= _current_time+byte_length))
-       delay_index++;
-    int64_t dsamples = _current_time.diff_samples(input_element.start_time);
-    byte_offset = dsamples*bits_per_sample/8 + cur_delay[delay_index].bytes;
-    if(byte_offset < 0){
-      // The requested output lies (partly) before the input data, send invalid data
-      int initial_delay = cur_delay[delay_index].remaining_samples;
-      int64_t invalid_samples = write_initial_invalid_data(data_writer, byte_offset);
-      data_writer.slice_size -= invalid_samples;
-      _current_time.inc_samples(invalid_samples-initial_delay);
+  do_phasecal(block);
 
-      sync_stream = false;
-      return 0;
-    }else if (byte_offset >= block_size){
-      // This can happen if there is still a bit of old data left in the input queue
-      input_buffer_->pop();
-      return 0;
-    }else{
-      data_writer.slice_size += cur_delay[delay_index].remaining_samples;
-      write_delay(data_writer.writer, cur_delay[delay_index].remaining_samples);
-      // decrease the sample count because we always send entire bytes
-      _current_time.inc_samples(-cur_delay[delay_index].remaining_samples);
-      sync_stream = false;
-    }
+  for (size_t i = 0; i < slices_.size(); i++) {
+    if (slices_[i]->wants(block))
+      slices_[i]->push(block);
   }
-  Data_writer_sptr writer = data_writer.writer;
-
-  int index=byte_offset;
-  int invalid_index = 0;
-  int next_invalid_pos = input_element.invalid.size() > 0 ? input_element.invalid[0].invalid_begin :
-                                                            block_size + 1;
-  int next_delay_pos = get_next_delay_pos(_current_time) + byte_offset;
-  int total_to_write = std::min(block_size-byte_offset,
-                       (int64_t)(data_writer.slice_size + samples_per_byte-1) / samples_per_byte);
-  int end_index = total_to_write+byte_offset;
-  while(index<end_index){
-    if(index>=next_delay_pos){
-      delay_index++;
+  if (needed_later(block))
+    history_.push_back(block);
+  input_buffer_->pop();
+  trim_history();
+}
 
-      write_delay(writer, cur_delay[delay_index].remaining_samples);
-      // at delay change adjust the amount of samples to be sent
-      int d_delay = cur_delay[delay_index].remaining_samples-cur_delay[delay_index-1].remaining_samples;
-      if((d_delay>1)||(d_delay==-1))
-        data_writer.slice_size -= 1;
-      else 
-        data_writer.slice_size += 1;
-      next_delay_pos=get_next_delay_pos(_current_time) + byte_offset;
-      total_to_write = std::min(block_size-byte_offset,
-                       (int64_t)(data_writer.slice_size+samples_per_byte-1)/samples_per_byte);
-      end_index = total_to_write+byte_offset;
-    }else if(index>=next_invalid_pos){
-      int n = input_element.invalid[invalid_index].nr_invalid;
-      int end_pos = std::min(next_invalid_pos + n, next_delay_pos);
-      int nr_invalid = std::max(0, end_pos - index);
-      nr_invalid = std::min(nr_invalid, end_index - index);
-      if(nr_invalid > 0){
-        write_invalid(writer, nr_invalid * samples_per_byte);
-        index += nr_invalid;
-      }
-      if(end_pos == (next_invalid_pos + n)){
-        invalid_index++;
-        if(input_element.invalid.size() > invalid_index)
-          next_invalid_pos = input_element.invalid[invalid_index].invalid_begin;
-        else
-          next_invalid_pos = block_size + 1;
-      }
-    }else{
-      int data_to_write = std::min(next_delay_pos-index, end_index-index);
-      data_to_write = std::min(next_invalid_pos-index, data_to_write);
+bool
+Input_node_data_writer::
+open_next_slice() {
+  if (pending_slices_.empty())
+    return false;
 
-      write_data(writer, data_to_write, index);
-      index += data_to_write;
-    }
+  // Check for new time interval
+  if ( _current_time >= current_interval_.stop_time_ ) {
+    if (( intervals_.empty() ) || ( delays_.empty() ))
+      return false;
+    interval++;
+    fetch_next_time_interval();
   }
-  data_writer.slice_size -= total_to_write*samples_per_byte;
-  _current_time.inc_samples(total_to_write*samples_per_byte);
-  // If we are at the end of the input buffer remove it from the queue
-  if (index >= block_size) {
-    // Buffer the current frame if necessary
-    if (input_index >= frames_to_buffer)
-      input_buffer_->pop();
-    else
-      input_index++;
+
+  Input_node_data_slice_sptr slice = pending_slices_.front_and_pop();
+  bool last_in_interval = (slice->slice_stop() >= current_interval_.stop_time_);
+  slice->open(_current_time, cur_delay, sample_rate, bits_per_sample,
+              last_in_interval);
+  if (last_in_interval)
+    phasecal_flush_times_.push_back(slice->end_time());
+
+  // Hand it the buffered blocks it needs
+  for (size_t i = 0; i < history_.size(); i++) {
+    if (slice->wants(history_[i]))
+      slice->push(history_[i]);
   }
+  slices_.push_back(slice);
+  DEBUG_MSG("OPENED A NEW SLICE, " << slices_.size() << " slices are open");
 
-  // Check whether we have written all data to the data_writer
-  if (data_writer.slice_size <= 0) {
-    if (data_writer.slice_stop >= current_interval_.stop_time_) {
-      write_phasecal(_current_time);
+  // The next slice starts at the end of this one (which includes overlap)
+  _current_time = slice->slice_stop() - overlap_time;
+  _current_time.set_sample_rate(sample_rate);
+  trim_history();
+  return true;
+}
+
+bool
+Input_node_data_writer::
+retire_slices() {
+  bool retired = false;
+  while ((!slices_.empty()) && slices_.front()->finished()) {
+    Input_node_data_slice_sptr slice = slices_.front();
+    // The input ended before the end of the interval was reached
+    if (slice->last_in_interval() && (!phasecal_flush_times_.empty()) &&
+        (phasecal_flush_times_.front() <= slice->end_time())) {
+      write_phasecal(phasecal_flush_times_.front());
+      phasecal_flush_times_.pop_front();
     }
-    write_end_of_stream(data_writer.writer);
-    // resync clock to end of slice (which should be the start of the next slice)
-    _current_time = data_writer.slice_stop - overlap_time;
-    _current_time.set_sample_rate(sample_rate);
-    input_index = 0;
-    data_writer.writer->deactivate();
-    data_writers_.pop();
-    DEBUG_MSG("POPPING FOR A NEW WRITER......");
+    slices_.pop_front();
+    retired = true;
+    DEBUG_MSG("RETIRED A SLICE......");
   }
+  return retired;
+}
 
-  return total_to_write;
+bool
+Input_node_data_writer::
+needed_later(const Input_buffer_element &block) {
+  // The next slice to open starts at _current_time, keep a block of
+  // margin for the delay changes within a block
+  Time length = block_length(block);
+  Time first_needed = _current_time + byte_length * (double)min_delay_bytes_;
+  return block.start_time + length * 2 > first_needed;
+}
+
+void
+Input_node_data_writer::
+trim_history() {
+  while ((!history_.empty()) && !needed_later(history_.front()))
+    history_.pop_front();
 }
 
 const int8_t sample_value_2[] = { -7, -2, 2, 7 };
 const int8_t sample_value_1[] = { -5, 5 };
 
 void
-Input_node_data_writer::do_phasecal() {
-  if (input_index < frames_to_buffer - 1)
-    return;
-  Input_buffer_element &input_element = (*input_buffer_)[input_index];
+Input_node_data_writer::do_phasecal(Input_buffer_element &input_element) {
   int samples_per_byte = 8 / bits_per_sample;
-  size_t size = input_element.channel_data.data().data.size();
-  uint8_t *data = (uint8_t *)&input_element.channel_data.data().data[0];
+  size_t size = input_element.channel_data.data().size();
+  const uint8_t *data = input_element.channel_data.data().begin();
 
   if (phasecal_integration_time.get_clock_ticks() == 0)
     return;
@@ -336,17 +274,18 @@ Input_node_data_writer::write_phasecal(Time last_time)
 
 void
 Input_node_data_writer::
-add_timeslice(Data_writer_sptr data_writer, Time slice_start, Time slice_stop,
-	      int64_t slice_samples) {
-  Writer_struct writer;
-  writer.writer = data_writer;
-  writer.slice_start = slice_start;
-  writer.slice_stop = slice_stop;
-  writer.slice_size = slice_samples;
-
-  data_writers_.push(writer);
-  DEBUG_MSG(": This data writer has a waiting queue of " << data_writers_.size() 
-            << " writers, slice_size = " << writer.slice_size );
+add_timeslice(Input_node_data_sender_sptr sender, Data_writer_sptr data_writer,
+              Time slice_start, Time slice_stop, int64_t slice_samples) {
+  SFXC_ASSERT(slice_samples > 0);
+  Input_node_data_slice_sptr slice(
+    new Input_node_data_slice(data_writer, slice_start, slice_stop,
+                              slice_samples, &notifier_));
+  // The sender sends the slices in the order they are assigned, it has to
+  // know about the slice before we open it
+  sender->add_slice(slice);
+  pending_slices_.push(slice);
+  DEBUG_MSG(": This data writer has a waiting queue of " << pending_slices_.size() 
+            << " slices, slice_size = " << slice_samples );
 }
 
 void
@@ -405,67 +344,290 @@ Input_node_data_writer::fetch_next_time_interval() {
   // We retreive the current interval
   current_interval_ = intervals_.front_and_pop();
   SFXC_ASSERT( !current_interval_.empty() );
-  delay_index = 0;
-  cur_delay = delays_.front_and_pop().data();
+  // The slices of the previous interval still refer to their own table
+  cur_delay = Delay_table_ptr(new std::vector<Delay>(delays_.front_and_pop().data()));
+  std::vector<Delay> &delay = *cur_delay;
+  SFXC_ASSERT(delay.size() > 0);
   if (extra_delay_in_samples != 0) {
     int samples_per_byte = 8 / bits_per_sample;
-    for (int i = 0; i < cur_delay.size(); i++) {
-      cur_delay[i].remaining_samples += extra_delay_in_samples;
-      cur_delay[i].bytes += cur_delay[i].remaining_samples / samples_per_byte;
-      cur_delay[i].remaining_samples %= samples_per_byte;
-      if (cur_delay[i].remaining_samples < 0) {
-	cur_delay[i].remaining_samples += samples_per_byte;
-	cur_delay[i].bytes--;
+    for (int i = 0; i < delay.size(); i++) {
+      delay[i].remaining_samples += extra_delay_in_samples;
+      delay[i].bytes += delay[i].remaining_samples / samples_per_byte;
+      delay[i].remaining_samples %= samples_per_byte;
+      if (delay[i].remaining_samples < 0) {
+	delay[i].remaining_samples += samples_per_byte;
+	delay[i].bytes--;
       }
     }
   }
-
+  min_delay_bytes_ = delay[0].bytes;
+  for (size_t i = 1; i < delay.size(); i++)
+    min_delay_bytes_ = std::min(min_delay_bytes_, delay[i].bytes);
 
   _current_time = current_interval_.start_time_ - overlap_time;
   _current_time.set_sample_rate(sample_rate);
-  input_index = 0;
+}
+
+void Input_node_data_writer::get_state(std::ostream &out) {
+  char pol = (polarisation == 0) ? 'R' : 'L';
+  char sb = (sideband == 0) ? 'L' : 'U';
+  out << "\t\t{\n"
+      << "\t\t\"stream\": " << stream_nr << ",\n"
+      << "\t\t\"station\": " << (int)station_number << ",\n"
+      << "\t\t\"frequency\": " << (int)frequency_number << ",\n"
+      << "\t\t\"sideband\": \"" << sb << "\",\n"
+      << "\t\t\"polarization\": \"" << pol << "\",\n"
+      << "\t\t\"n_input_buffer\": " << input_buffer_->size() << ",\n"   
+      << "\t\t\"n_history\": " << history_.size() << ",\n"
+      << "\t\t\"n_pending_slices\": " << pending_slices_.size() << ",\n"
+      << "\t\t\"n_open_slices\": " << slices_.size() << ",\n";
+  if (slices_.size() > 0) {
+    out << "\t\t\"slice_blocks\": " << slices_.front()->queued_blocks() << ",\n"
+        << "\t\t\"slice_stream\": " << slices_.front()->writer()->get_stream_nr() << ",\n";
+  }
+  out << "\t\t\"time\": \"" << _current_time.date_string(6) << "\",\n"
+      << "\t\t\"interval\" : [\"" << current_interval_.start_time_.date_string(6) 
+                        << "\", \"" << current_interval_.stop_time_.date_string(6) 
+                        << "\"],\n"
+      << "\t\t\"n_interval\": "<< intervals_.size() << ",\n"
+      << "\t\t\"n_delays\": " << delays_.size() << "\n"
+      << "\t\t}";
+}
+
+/*****************************************************************************
+ * Input_node_data_slice
+ *****************************************************************************/
+const int Input_node_data_slice::MAX_BLOCKS;
+
+Input_node_data_slice::
+Input_node_data_slice(Data_writer_sptr writer, Time slice_start,
+                      Time slice_stop, int64_t slice_samples,
+                      Notifier *channel_notifier)
+  : writer_(writer), slice_start_(slice_start), slice_stop_(slice_stop),
+    slice_size_(slice_samples), channel_notifier_(channel_notifier),
+    bits_per_sample_(0), last_in_interval_(false),
+    active_(false), sync_stream_(false), delay_index_(0), finished_(false) {
+}
+
+void
+Input_node_data_slice::
+open(Time start_time, Delay_table_ptr delays, uint64_t sample_rate,
+     int bits_per_sample, bool last_in_interval) {
+  SFXC_ASSERT(delays->size() > 0);
+  delays_ = delays;
+  bits_per_sample_ = bits_per_sample;
+  byte_length_ = Time( 8 * 1000000. / (sample_rate * bits_per_sample));
+  last_in_interval_ = last_in_interval;
+  current_time_ = start_time;
+  current_time_.set_sample_rate(sample_rate);
+  end_time_ = current_time_;
+  end_time_.inc_samples(slice_size_);
+
+  // The range of input the slice reads from, given the delays
+  const std::vector<Delay> &cur_delay = *delays_;
+  int32_t min_bytes = cur_delay[0].bytes, max_bytes = cur_delay[0].bytes;
+  for (size_t i = 1; i < cur_delay.size(); i++) {
+    min_bytes = std::min(min_bytes, cur_delay[i].bytes);
+    max_bytes = std::max(max_bytes, cur_delay[i].bytes);
+  }
+  first_needed_ = current_time_ + byte_length_ * (double)min_bytes;
+  last_needed_ = end_time_ + byte_length_ * (double)(max_bytes + 1);
+}
+
+bool
+Input_node_data_slice::
+wants(const Input_buffer_element &block) const {
+  if (finished())
+    return false;
+  // Keep a block of margin, the slice size changes a little with every
+  // delay change
+  Time length = byte_length_ * (double)block.channel_data.data().size();
+  return (block.start_time + length * 2 > first_needed_) &&
+         (block.start_time < last_needed_ + length);
+}
+
+bool
+Input_node_data_slice::
+has_work() {
+  return (!finished()) && (!blocks_.empty());
 }
 
 void
-Input_node_data_writer::write_invalid(Data_writer_sptr writer, int nInvalid){
+Input_node_data_slice::
+pop_block() {
+  blocks_.pop();
+  channel_notifier_->notify();
+}
+
+uint64_t
+Input_node_data_slice::
+do_task() {
+  // Acquire the input data
+  Input_buffer_element &input_element = blocks_.front();
+  const std::vector<Delay> &cur_delay = *delays_;
+  int block_size = input_element.channel_data.data().size();
+
+  int64_t byte_offset=0;
+  int samples_per_byte = 8/bits_per_sample_;
+
+  // Check whether we have to start the timeslice
+  if(!active_){
+    // Initialise the size of the data slice
+    SFXC_ASSERT(slice_size_>0);
+    writer_->set_size_dataslice(-1);
+    writer_->activate();
+    __atomic_store_n(&active_, true, __ATOMIC_RELEASE);
+    DEBUG_MSG("STARTING A NEW SLICE......");
+    delay_index_ = 0;
+    sync_stream_ = true;
+  }
+  if(sync_stream_){
+    // Move to the next integer delay change
+    int delay_size = cur_delay.size();
+    while((delay_index_ < delay_size - 1) && (cur_delay[delay_index_+1].time <= current_time_+byte_length_))
+       delay_index_++;
+    int64_t dsamples = current_time_.diff_samples(input_element.start_time);
+    byte_offset = dsamples*bits_per_sample_/8 + cur_delay[delay_index_].bytes;
+    if(byte_offset < 0){
+      // The requested output lies (partly) before the input data, send invalid data
+      int initial_delay = cur_delay[delay_index_].remaining_samples;
+      int64_t invalid_samples = write_initial_invalid_data(byte_offset);
+      slice_size_ -= invalid_samples;
+      current_time_.inc_samples(invalid_samples-initial_delay);
+      flush();
+
+      sync_stream_ = false;
+      return 0;
+    }else if (byte_offset >= block_size){
+      // The block lies before the start of the slice
+      pop_block();
+      return 0;
+    }else{
+      slice_size_ += cur_delay[delay_index_].remaining_samples;
+      write_delay(cur_delay[delay_index_].remaining_samples);
+      // decrease the sample count because we always send entire bytes
+      current_time_.inc_samples(-cur_delay[delay_index_].remaining_samples);
+      sync_stream_ = false;
+    }
+  }
+
+  int index=byte_offset;
+  int invalid_index = 0;
+  int next_invalid_pos = input_element.invalid.size() > 0 ? input_element.invalid[0].invalid_begin :
+                                                            block_size + 1;
+  int next_delay_pos = get_next_delay_pos(current_time_) + byte_offset;
+  int total_to_write = std::min(block_size-byte_offset,
+                       (int64_t)(slice_size_ + samples_per_byte-1) / samples_per_byte);
+  int end_index = total_to_write+byte_offset;
+  while(index<end_index){
+    if(index>=next_delay_pos){
+      delay_index_++;
+
+      write_delay(cur_delay[delay_index_].remaining_samples);
+      // at delay change adjust the amount of samples to be sent
+      int d_delay = cur_delay[delay_index_].remaining_samples-cur_delay[delay_index_-1].remaining_samples;
+      if((d_delay>1)||(d_delay==-1))
+        slice_size_ -= 1;
+      else 
+        slice_size_ += 1;
+      next_delay_pos=get_next_delay_pos(current_time_) + byte_offset;
+      total_to_write = std::min(block_size-byte_offset,
+                       (int64_t)(slice_size_+samples_per_byte-1)/samples_per_byte);
+      end_index = total_to_write+byte_offset;
+    }else if(index>=next_invalid_pos){
+      int n = input_element.invalid[invalid_index].nr_invalid;
+      int end_pos = std::min(next_invalid_pos + n, next_delay_pos);
+      int nr_invalid = std::max(0, end_pos - index);
+      nr_invalid = std::min(nr_invalid, end_index - index);
+      if(nr_invalid > 0){
+        write_invalid(nr_invalid * samples_per_byte);
+        index += nr_invalid;
+      }
+      if(end_pos == (next_invalid_pos + n)){
+        invalid_index++;
+        if(input_element.invalid.size() > invalid_index)
+          next_invalid_pos = input_element.invalid[invalid_index].invalid_begin;
+        else
+          next_invalid_pos = block_size + 1;
+      }
+    }else{
+      int data_to_write = std::min(next_delay_pos-index, end_index-index);
+      data_to_write = std::min(next_invalid_pos-index, data_to_write);
+
+      write_data(input_element, data_to_write, index);
+      index += data_to_write;
+    }
+  }
+  // The batch refers to the input element, send it before it is released
+  flush();
+  slice_size_ -= total_to_write*samples_per_byte;
+  current_time_.inc_samples(total_to_write*samples_per_byte);
+  // If we are at the end of the input block remove it from the queue
+  if (index >= block_size)
+    pop_block();
+
+  // Check whether we have written all data to the data_writer
+  if (slice_size_ <= 0) {
+    write_end_of_stream();
+    flush();
+    writer_->deactivate();
+    // Release the blocks that were pushed beyond the end of the slice
+    while (!blocks_.empty())
+      blocks_.pop();
+    __atomic_store_n(&finished_, true, __ATOMIC_RELEASE);
+    channel_notifier_->notify();
+    DEBUG_MSG("FINISHED A SLICE......");
+  }
+
+  return total_to_write;
+}
+
+void
+Input_node_data_slice::write_invalid(int nInvalid){
   int8_t header = HEADER_INVALID;
   int invalid_written=0;
   while(invalid_written < nInvalid){
     // first write a header containing the number of bytes to be send
     int16_t invalid_to_write = (int16_t) std::min(nInvalid-invalid_written, SHRT_MAX);
-    writer->put_bytes(sizeof(header), (char *)&header);
-    writer->put_bytes(sizeof(invalid_to_write), (char *)&invalid_to_write);
+    batch_.put_bytes(sizeof(header), &header);
+    batch_.put_bytes(sizeof(invalid_to_write), &invalid_to_write);
     invalid_written += invalid_to_write;
   }
 }
 
 void
-Input_node_data_writer::write_end_of_stream(Data_writer_sptr writer){
+Input_node_data_slice::write_end_of_stream(){
   int8_t header = HEADER_ENDSTREAM;
-  writer->put_bytes(sizeof(header), (char *)&header);
+  batch_.put_bytes(sizeof(header), &header);
 }
 
 
 void
-Input_node_data_writer::write_delay(Data_writer_sptr writer, int8_t delay){
+Input_node_data_slice::write_delay(int8_t delay){
   // The header
   int8_t header_type = HEADER_DELAY;
-  int nbytes = writer->put_bytes(sizeof(header_type), (char*)&header_type);
-  SFXC_ASSERT(nbytes == sizeof(header_type));
+  batch_.put_bytes(sizeof(header_type), &header_type);
 
   //The number delay in samples
-  nbytes = writer->put_bytes(sizeof(delay), (char*)&delay);
-  SFXC_ASSERT(nbytes == sizeof(delay));
+  batch_.put_bytes(sizeof(delay), &delay);
+}
+
+void
+Input_node_data_slice::flush(){
+  size_t size = batch_.size();
+  size_t nbytes = batch_.flush(*writer_);
+  SFXC_ASSERT(nbytes == size);
 }
 
 
 int 
-Input_node_data_writer::get_next_delay_pos(Time start_time){
+Input_node_data_slice::get_next_delay_pos(Time start_time){
+  const std::vector<Delay> &cur_delay = *delays_;
   int delay_pos;
   int delay_size=cur_delay.size();
-  if(delay_index < delay_size-1){
-    Time dtime = cur_delay[delay_index+1].time - start_time;
-    delay_pos = (int) (dtime / byte_length);
+  if(delay_index_ < delay_size-1){
+    Time dtime = cur_delay[delay_index_+1].time - start_time;
+    delay_pos = (int) (dtime / byte_length_);
   }
   else
     delay_pos = INT_MAX/2; 
@@ -474,7 +636,8 @@ Input_node_data_writer::get_next_delay_pos(Time start_time){
 }
 
 void
-Input_node_data_writer::write_data(Data_writer_sptr writer, int ndata, int byte_offset)
+Input_node_data_slice::write_data(const Input_buffer_element &input_element,
+                                  int ndata, int byte_offset)
 {
   if(ndata==0)
     return;
@@ -487,80 +650,212 @@ Input_node_data_writer::write_data(Data_writer_sptr writer, int ndata, int byte_
   while(bytes_written < ndata){
     // first write a header containing the number of bytes to be send
     int16_t data_to_write = (int16_t) std::min(ndata-bytes_written, SHRT_MAX);
-    writer->put_bytes(sizeof(header), (char *)&header);
-    writer->put_bytes(sizeof(data_to_write), (char *)&data_to_write);
-    Input_buffer_element &input_element = (*input_buffer_)[input_index];
-    char *data =(char*)&input_element.channel_data.data().data[start];
-    int written = 0;
-
-    while(written < data_to_write){
-      int result = writer->put_bytes((int)data_to_write - written, &data[written]);
-      written += result;
-      bytes_written+=result;
-    }
+    batch_.put_bytes(sizeof(header), &header);
+    batch_.put_bytes(sizeof(data_to_write), &data_to_write);
+    const char *data = (const char *)input_element.channel_data.data().begin() + start;
+    batch_.put_reference(data_to_write, data);
+    bytes_written += data_to_write;
     start += data_to_write;
   }
 }
 
 int64_t 
-Input_node_data_writer::write_initial_invalid_data(Writer_struct &data_writer, int64_t byte_offset){
-  int samples_per_byte = 8/bits_per_sample;
+Input_node_data_slice::write_initial_invalid_data(int64_t byte_offset){
+  const std::vector<Delay> &cur_delay = *delays_;
+  int samples_per_byte = 8/bits_per_sample_;
   int delay_size = cur_delay.size();
 
   // The initial delay
-  write_delay(data_writer.writer, cur_delay[delay_index].remaining_samples);
-  data_writer.slice_size += cur_delay[delay_index].remaining_samples;
-  int64_t invalid_samples=std::min((int64_t)-byte_offset * samples_per_byte, data_writer.slice_size);
+  write_delay(cur_delay[delay_index_].remaining_samples);
+  slice_size_ += cur_delay[delay_index_].remaining_samples;
+  int64_t invalid_samples=std::min((int64_t)-byte_offset * samples_per_byte, slice_size_);
   int64_t written=0;
   while(written<invalid_samples){
     int64_t next_delay_pos;
-    if(delay_index<delay_size-1){
-      Time dt = cur_delay[delay_index+1].time - _current_time;
-      next_delay_pos = (int64_t) (samples_per_byte * (dt / byte_length));
+    if(delay_index_<delay_size-1){
+      Time dt = cur_delay[delay_index_+1].time - current_time_;
+      next_delay_pos = (int64_t) (samples_per_byte * (dt / byte_length_));
     }else{
-      next_delay_pos = data_writer.slice_size * 2;
+      next_delay_pos = slice_size_ * 2;
     }
     if(written==next_delay_pos){
-      delay_index++;
-      write_delay(data_writer.writer, cur_delay[delay_index].remaining_samples);
+      delay_index_++;
+      write_delay(cur_delay[delay_index_].remaining_samples);
       // at delay change adjust the amount of samples to be sent
-      int d_delay = cur_delay[delay_index].remaining_samples-cur_delay[delay_index-1].remaining_samples;
+      int d_delay = cur_delay[delay_index_].remaining_samples-cur_delay[delay_index_-1].remaining_samples;
       if((d_delay>1)||(d_delay==-1))
-        data_writer.slice_size -= 1;
+        slice_size_ -= 1;
       else
-        data_writer.slice_size += 1;
-      invalid_samples=std::min((int64_t)-byte_offset*samples_per_byte, data_writer.slice_size);
+        slice_size_ += 1;
+      invalid_samples=std::min((int64_t)-byte_offset*samples_per_byte, slice_size_);
     }else{
       int data_to_write = std::min(next_delay_pos-written, invalid_samples-written);
-      write_invalid(data_writer.writer, data_to_write);
+      write_invalid(data_to_write);
       written += data_to_write;
     }
   }
   return invalid_samples;
 }
 
-void Input_node_data_writer::get_state(std::ostream &out) {
-  char pol = (polarisation == 0) ? 'R' : 'L';
-  char sb = (sideband == 0) ? 'L' : 'U';
-  out << "\t\t{\n"
-      << "\t\t\"stream\": " << stream_nr << ",\n"
-      << "\t\t\"station\": " << (int)station_number << ",\n"
-      << "\t\t\"frequency\": " << (int)frequency_number << ",\n"
-      << "\t\t\"sideband\": \"" << sb << "\",\n"
-      << "\t\t\"polarization\": \"" << pol << "\",\n"
-      << "\t\t\"input_index\": " << input_index << ",\n"
-      << "\t\t\"n_input_buffer\": " << input_buffer_->size() << ",\n"   
-      << "\t\t\"n_data_writers\": " << data_writers_.size() << ",\n";
-  if (data_writers_.size() > 0) {
-    out << "\t\t\"data_writer_active\": " << data_writers_.front().active << ",\n"
-        << "\t\t\"data_writer_inuse\": " << data_writers_.front().writer->is_active() << ",\n"
-        << "\t\t\"data_writer_stream\": " << data_writers_.front().writer->get_stream_nr() << ",\n";
+/*****************************************************************************
+ * Input_node_data_sender
+ *****************************************************************************/
+Input_node_data_sender::Input_node_data_sender(Data_writer_sptr writer)
+  : writer_(writer), total_data_written_(0) {
+  set_affinity_role(CPU_ROLE_DATA_WRITER);
+  slices_.set_notifier(&notifier_);
+}
+
+Input_node_data_sender::~Input_node_data_sender() {
+  if (!slices_.empty()) {
+      DEBUG_MSG("Slices are still waiting to be sent.");
+    }
+  DEBUG_MSG( "data_writer byte sent:" << toMB(total_data_written_) << "MB" );
+}
+
+void
+Input_node_data_sender::add_slice(Input_node_data_slice_sptr slice) {
+  slice->set_notifier(&notifier_);
+  slices_.push(slice);
+}
+
+void Input_node_data_sender::do_execute()
+{
+  while( true ){
+    uint64_t events = notifier_.count();
+    bool did_work = false;
+    if (!slices_.empty()) {
+      Input_node_data_slice_sptr slice = slices_.front();
+      if (slice->has_work()) {
+        total_data_written_ += slice->do_task();
+        did_work = true;
+      }
+      if (slice->finished()) {
+        slices_.pop();
+        did_work = true;
+      }
+    }
+    if( !did_work )
+      notifier_.wait(events);
   }
-  out << "\t\t\"time\": \"" << _current_time.date_string(6) << "\",\n"
-      << "\t\t\"interval\" : [\"" << current_interval_.start_time_.date_string(6) 
-                        << "\", \"" << current_interval_.stop_time_.date_string(6) 
-                        << "\"],\n"
-      << "\t\t\"n_interval\": "<< intervals_.size() << ",\n"
-      << "\t\t\"n_delays\": " << delays_.size() << "\n"
+}
+
+void Input_node_data_sender::get_state(std::ostream &out) {
+  out << "\t\t{\n"
+      << "\t\t\"stream\": " << writer_->get_stream_nr() << ",\n"
+      << "\t\t\"n_slices\": " << slices_.size() << ",\n"
+      << "\t\t\"active\": " << writer_->is_active() << "\n"
       << "\t\t}";
 }
+
+#ifdef ENABLE_TEST_UNIT
+#include <string.h>
+
+namespace {
+// Keeps everything that is written
+class Slice_test_writer : public Data_writer {
+public:
+  bool can_write() {
+    return true;
+  }
+  std::string data;
+private:
+  size_t do_put_bytes(size_t nBytes, const char *buff) {
+    data.append(buff, nBytes);
+    return nBytes;
+  }
+};
+}
+
+void Input_node_data_slice::Test::tests() {
+  typedef Input_node_types::Data_memory_pool Data_memory_pool;
+  const int block_size = 1000, bits_per_sample = 2, samples_per_byte = 4;
+  const uint64_t sample_rate = 4000000;
+  const Time block_length(1000.);
+  Data_memory_pool pool(4);
+  Time start(56000, 10.);
+  start.set_sample_rate(sample_rate);
+
+  // A frame that is missing from a memory mapped file: the buffer of the
+  // reader has no data, it lost the view of the previous frame
+  Input_node_types::Input_data_frame frame;
+  frame.buffer = pool.allocate();
+  frame.buffer->clear_view();
+  frame.buffer->data.clear();
+  frame.invalidate(block_size);
+  TEST_ASSERT( frame.all_invalid );
+  TEST_ASSERT( frame.buffer->size() == block_size );
+
+  // A view of the right size is kept, it is not read
+  const Input_node_types::value_type view[block_size] = {0};
+  Input_node_types::Input_data_frame view_frame;
+  view_frame.buffer = pool.allocate();
+  view_frame.buffer->set_view(view, block_size, shared_ptr<void>());
+  view_frame.invalidate(block_size);
+  TEST_ASSERT( view_frame.buffer->begin() == view );
+
+  // The VDIF channel extractor passes the frame on as it is, followed by
+  // a frame with data
+  Input_buffer_element invalid_block;
+  invalid_block.channel_data = frame.buffer;
+  invalid_block.invalid = frame.invalid;
+  invalid_block.start_time = start;
+  Input_buffer_element data_block;
+  data_block.channel_data = pool.allocate();
+  data_block.channel_data->clear_view();
+  data_block.channel_data->data.assign(block_size, 0x5a);
+  data_block.start_time = start + block_length;
+
+  Slice_test_writer *writer = new Slice_test_writer();
+  Data_writer_sptr writer_sptr(writer);
+  Notifier notifier;
+  Input_node_data_slice slice(writer_sptr, start, start + block_length * 2.,
+                              2 * block_size * samples_per_byte, &notifier);
+  Delay_table_ptr delays(new std::vector<Delay>(1));
+  (*delays)[0].time = start;
+  (*delays)[0].bytes = 0;
+  (*delays)[0].remaining_samples = 0;
+  slice.open(start, delays, sample_rate, bits_per_sample, false);
+  TEST_ASSERT( slice.wants(invalid_block) );
+  TEST_ASSERT( slice.wants(data_block) );
+  slice.push(invalid_block);
+  slice.push(data_block);
+  while (slice.has_work())
+    slice.do_task();
+  TEST_ASSERT( slice.finished() );
+
+  // The invalid samples come first, the data is not shifted in time
+  int64_t n_invalid = 0, n_data = 0;
+  bool data_before_invalid = false, data_ok = true, end_of_stream = false;
+  const std::string &out = writer->data;
+  size_t pos = 0;
+  while (pos < out.size()) {
+    int8_t header = out[pos++];
+    if (header == HEADER_DELAY) {
+      pos++;
+    } else if (header == HEADER_INVALID) {
+      int16_t n;
+      memcpy(&n, &out[pos], sizeof(n));
+      pos += sizeof(n);
+      n_invalid += n;
+      data_before_invalid |= (n_data > 0);
+    } else if (header == HEADER_DATA) {
+      int16_t n;
+      memcpy(&n, &out[pos], sizeof(n));
+      pos += sizeof(n);
+      for (int i = 0; i < n; i++)
+        data_ok &= (out[pos + i] == 0x5a);
+      pos += n;
+      n_data += n;
+    } else {
+      end_of_stream = (header == HEADER_ENDSTREAM) && (pos == out.size());
+      break;
+    }
+  }
+  TEST_ASSERT( n_invalid == block_size * samples_per_byte );
+  TEST_ASSERT( n_data == block_size );
+  TEST_ASSERT( !data_before_invalid );
+  TEST_ASSERT( data_ok );
+  TEST_ASSERT( end_of_stream );
+}
+#endif // ENABLE_TEST_UNIT
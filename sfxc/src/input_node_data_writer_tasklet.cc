@@ -103,7 +103,12 @@ void Input_node_data_writer_tasklet::add_timeslice_to_stream(int nr_stream,
                                                      int64_t slice_samples)
 {
   SFXC_ASSERT( nr_stream < data_writers_.size() );
-  data_writers_[nr_stream]->add_timeslice(wr, slice_start, slice_stop,
+  Input_node_data_sender_sptr &sender = senders_[wr.get()];
+  if (sender == Input_node_data_sender_sptr()) {
+    sender = Input_node_data_sender_sptr(new Input_node_data_sender(wr));
+    data_writer_thread_pool.register_thread(sender->start());
+  }
+  data_writers_[nr_stream]->add_timeslice(sender, wr, slice_start, slice_stop,
 					  slice_samples);
 }
 
@@ -164,6 +169,14 @@ void Input_node_data_writer_tasklet::get_state(std::ostream &out) {
        out << "\n";
    }
    out << "\t],\n"
+       << "\t\"Input_node_data_sender\": [\n";
+   std::map<Data_writer *, Input_node_data_sender_sptr>::iterator it;
+   for (it = senders_.begin(); it != senders_.end(); it++) {
+     if (it != senders_.begin())
+       out << ",\n";
+     it->second->get_state(out);
+   }
+   out << "\n\t],\n"
        << "\t\t\"still_running\": " << std::boolalpha << data_writer_thread_pool.still_running()
        << "\n\t}\n";
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <cstring>
 #include <set>
+#include <algorithm>
 
 Manager_node::
 Manager_node(int rank, int numtasks,
@@ -73,11 +74,13 @@ Manager_node(int rank, int numtasks,
   }
   SFXC_ASSERT(n_inputs > 0);
 
-  // correlator nodes:
-  int mintasks = 3 + n_inputs + control_parameters.number_correlation_cores_per_timeslice(get_current_mode());
+  // correlator nodes, every correlator node (MPI rank) correlates
+  // n_lanes channels of a time slice concurrently:
+  int n_lanes = control_parameters.correlator_node_channels();
+  int mintasks = 3 + n_inputs + control_parameters.number_correlator_nodes(get_current_mode());
   SFXC_ASSERT (numtasks >= mintasks);
 
-  n_corr_nodes = numtasks - (n_inputs + 3);
+  n_corr_nodes = (numtasks - (n_inputs + 3)) * n_lanes;
   std::vector<MPI_Request> pending_requests;
   int numrequest;
 
@@ -89,19 +92,22 @@ Manager_node(int rank, int numtasks,
   pending_requests.resize(numrequest);
   int currreq = 0;
   for (int correlator_nr = 0; correlator_nr < n_corr_nodes; correlator_nr++) {
-    int correlator_rank = correlator_nr + n_inputs + 3;
+    int correlator_rank = correlator_nr / n_lanes + n_inputs + 3;
+    int lane = correlator_nr % n_lanes;
     SFXC_ASSERT(correlator_rank != RANK_MANAGER_NODE);
     SFXC_ASSERT(correlator_rank != RANK_LOG_NODE);
     SFXC_ASSERT(correlator_rank != RANK_OUTPUT_NODE);
 
-    start_correlator_node(correlator_rank);
+    if (lane == 0)
+      start_correlator_node(correlator_rank, n_lanes);
 
-    // Set up the connection to the input nodes:
+    // Set up the connection to the input nodes, the streams of the lanes
+    // are interleaved at the correlator node:
     for (int input_node = 0; input_node < n_inputs; input_node++) {
       int input_rank = input_node + 3;
       connect_to(input_rank,
 		 correlator_nr,
-		 correlator_rank, input_node,
+		 correlator_rank, input_node * n_lanes + lane,
 		 input_node_cnx_params_[input_node],
 		 correlator_rank, &pending_requests[currreq++]);
     }
@@ -113,14 +119,14 @@ Manager_node(int rank, int numtasks,
 	connect_to(input_rank,
 		   correlator_nr + n_corr_nodes,
 		   correlator_rank,
-		   input_node + n_inputs,
+		   (input_node + n_inputs) * n_lanes + lane,
 		   input_node_cnx_params_[input_node],
 		   correlator_rank, &pending_requests[currreq++]);
       }
     }
 
     // Set up the connection to the output node:
-    connect_writer_to(correlator_rank, 0,
+    connect_writer_to(correlator_rank, lane,
 		      RANK_OUTPUT_NODE, correlator_nr,
 		      output_node_cnx_params_[0],
 		      correlator_rank, &pending_requests[currreq++]);
@@ -230,16 +236,27 @@ void Manager_node::start() {
         bool added_correlator_node = false;
 #ifdef SFXC_DETERMINISTIC
 
-        if (correlator_node_ready[current_correlator_node]) {
+        if (correlator_node_ready[current_correlator_node] > 0) {
           set_correlator_node_ready(current_correlator_node, false);
           start_next_timeslice_on_node(current_correlator_node);
 
           added_correlator_node = true;
         }
 #else
-        if (!ready_correlator_nodes.empty()) {
-          start_next_timeslice_on_node(ready_correlator_nodes.front());
-          ready_correlator_nodes.pop();
+        // The work of a slice is taken proportional to its number of
+        // input streams
+        int channel = channels_in_scan[channel_idx];
+        std::vector<int> inputs;
+        for (size_t input_node = 0; input_node < control_parameters.number_inputs();
+             input_node++) {
+          if (station_ch_number[channel][input_node] >= 0)
+            inputs.push_back(input_node);
+        }
+        int correlator_node =
+          correlator_node_scheduler.select(channel, inputs, inputs.size());
+        if (correlator_node >= 0) {
+          correlator_node_scheduler.assign(correlator_node, channel, inputs.size());
+          start_next_timeslice_on_node(correlator_node);
           added_correlator_node = true;
         }
 #endif
@@ -248,6 +265,12 @@ void Manager_node::start() {
           if (channel_idx == channels_in_scan.size()) {
             status = GOTO_NEXT_TIMESLICE;
           }
+#ifndef SFXC_DETERMINISTIC
+        } else if (correlator_node_scheduler.number_requests() > 0) {
+          // The slice is held back for a faster node, poll such that the
+          // decision is revisited if that node does not ask in time
+          poll_messages();
+#endif
         } else {
           // No correlator node added, wait for the next message
           check_and_process_message();
@@ -452,6 +475,19 @@ Manager_node::initialise() {
 		    control_parameters.data_sources(station, datastream));
   }
 
+  // Generate the missing delay tables of all stations at once, instead of
+  // one by one when the stations first appear in a scan
+  {
+    std::vector<std::string> stations;
+    for (size_t input_node = 0; input_node < control_parameters.number_inputs();
+         input_node++) {
+      const std::string &station = control_parameters.station(station_map[input_node]);
+      if (std::find(stations.begin(), stations.end(), station) == stations.end())
+        stations.push_back(station);
+    }
+    control_parameters.generate_delay_tables(stations);
+  }
+
   start_time = control_parameters.get_start_time();
   stop_time = control_parameters.get_stop_time();
 
@@ -838,11 +874,12 @@ void Manager_node::get_state(std::ostream &out) {
 #ifdef SFXC_DETERMINISTIC
   int nfree = 0;
   for (int i = 0; i < correlator_node_ready.size(); i++) {
-    if (correlator_node_ready[i])
+    if (correlator_node_ready[i] > 0)
       nfree++;
   }
 #else
-  int nfree = ready_correlator_nodes.size();
+  int nfree = correlator_node_scheduler.number_requests();
+  correlator_node_scheduler.get_state(out);
 #endif
   out << "\t\"current_time\": \"" << start_time + integration_time() * integration_nr << "\",\n"
       << "\t\"integration_nr\": " << integration_nr << ",\n"
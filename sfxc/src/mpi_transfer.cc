@@ -29,7 +29,9 @@ void MPI_Transfer::send_ip_address(std::vector<uint64_t>& params, const int rank
   int position = 0;
   CHECK_MPI(MPI_Pack(&len, 1, MPI_UINT32, buffer, size, &position, MPI_COMM_WORLD));
   CHECK_MPI(MPI_Pack(hostname, len, MPI_CHAR, buffer, size, &position, MPI_COMM_WORLD));
-  CHECK_MPI(MPI_Pack(&params[0], params.size(), MPI_INT64, buffer, size, &position, MPI_COMM_WORLD));
+  if (!params.empty()) {
+    CHECK_MPI(MPI_Pack(&params[0], params.size(), MPI_INT64, buffer, size, &position, MPI_COMM_WORLD));
+  }
   SFXC_ASSERT(position == size);
 
   CHECK_MPI(MPI_Send(buffer, size, MPI_CHAR, rank, MPI_TAG_CONNEXION_INFO, MPI_COMM_WORLD));
@@ -54,7 +56,9 @@ void MPI_Transfer::receive_ip_address(std::vector<uint64_t>& params, std::string
   hostname = str;
   int num_params = (size - position) / sizeof(uint64_t);
   params.resize(num_params);
-  CHECK_MPI(MPI_Unpack(buffer, size, &position, &params[0], num_params, MPI_INT64, MPI_COMM_WORLD));
+  if (num_params > 0) {
+    CHECK_MPI(MPI_Unpack(buffer, size, &position, &params[0], num_params, MPI_INT64, MPI_COMM_WORLD));
+  }
   SFXC_ASSERT(position == size);
 }
 
@@ -156,6 +160,43 @@ recv_connect_writer_to_msg(uint32_t info[4], std::vector<uint64_t>& params, std:
   SFXC_ASSERT(position == size);
 }
 
+void
+MPI_Transfer::
+send_connect_shm_msg(const uint32_t info[4], const std::string& name, const int rank, const int tag) {
+  int size = 4 * sizeof(uint32_t) + name.size();
+  int position = 0;
+  char buffer[size];
+
+  CHECK_MPI(MPI_Pack(const_cast<void*>((void*)info), 4, MPI_UINT32, buffer, size, &position, MPI_COMM_WORLD));
+  CHECK_MPI(MPI_Pack(const_cast<void*>((void *)name.c_str()), name.size(), MPI_CHAR, buffer, size, &position, MPI_COMM_WORLD));
+  SFXC_ASSERT(position == size);
+
+  CHECK_MPI(MPI_Send(buffer, size, MPI_CHAR, rank, tag, MPI_COMM_WORLD));
+}
+
+void
+MPI_Transfer::
+recv_connect_shm_msg(uint32_t info[4], std::string& name, const int rank, const int tag) {
+  MPI_Status status;
+  int size;
+
+  CHECK_MPI(MPI_Probe(rank, tag, MPI_COMM_WORLD, &status));
+  CHECK_MPI(MPI_Get_elements(&status, MPI_CHAR, &size));
+  SFXC_ASSERT(size > (int)(4 * sizeof(uint32_t)));
+
+  char buffer[size];
+  CHECK_MPI(MPI_Recv(buffer, size, MPI_CHAR, rank, tag, MPI_COMM_WORLD, &status));
+
+  int position = 0;
+  CHECK_MPI(MPI_Unpack(buffer, size, &position, info, 4, MPI_UINT32, MPI_COMM_WORLD));
+  int len = size - position;
+  char str[len + 1];
+  CHECK_MPI(MPI_Unpack(buffer, size, &position, str, len, MPI_CHAR, MPI_COMM_WORLD));
+  str[len] = 0;
+  name = str;
+  SFXC_ASSERT(position == size);
+}
+
 void
 MPI_Transfer::
 pack(std::vector<char> &buffer, Delay_table &table, int sn[2]) {
@@ -706,7 +747,7 @@ MPI_Transfer::receive(MPI_Status &status, std::map<std::string, int> &sources){
 void
 MPI_Transfer::send(Input_node_parameters &input_node_param, int rank) {
   int size = 0;
-  size = 5 * sizeof(int32_t) + 4 * sizeof(int64_t);
+  size = 7 * sizeof(int32_t) + 4 * sizeof(int64_t);
   for (Input_node_parameters::Channel_iterator channel =
          input_node_param.channels.begin();
        channel != input_node_param.channels.end(); channel++) {
@@ -738,6 +779,10 @@ MPI_Transfer::send(Input_node_parameters &input_node_param, int rank) {
   int exit_on_empty_datastream = input_node_param.exit_on_empty_datastream ? 1 : 0;
   MPI_Pack(&exit_on_empty_datastream, 1, MPI_INT32, 
            message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&input_node_param.read_ahead_depth, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&input_node_param.read_ahead_block_size, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
 
   length = (int32_t)input_node_param.channels.size();
   MPI_Pack(&length, 1, MPI_INT32,
@@ -811,6 +856,12 @@ MPI_Transfer::receive(MPI_Status &status, Input_node_parameters &input_node_para
   MPI_Unpack(buffer, size, &position, &exit_on_empty_datastream, 
              1, MPI_INT32, MPI_COMM_WORLD);
   input_node_param.exit_on_empty_datastream = (exit_on_empty_datastream == 1);
+  MPI_Unpack(buffer, size, &position,
+             &input_node_param.read_ahead_depth, 1, MPI_INT32,
+             MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &input_node_param.read_ahead_block_size, 1, MPI_INT32,
+             MPI_COMM_WORLD);
   int32_t n_channels;
   MPI_Unpack(buffer, size, &position,
              &n_channels, 1, MPI_INT32,
@@ -855,7 +906,8 @@ MPI_Transfer::receive(MPI_Status &status, Input_node_parameters &input_node_para
 void
 MPI_Transfer::send(Correlation_parameters &corr_param, int rank) {
   int size = 0;
-  size = 11 * sizeof(int64_t) + 13 * sizeof(int32_t) + 20 * sizeof(char) +
+  size = 11 * sizeof(int64_t) + 20 * sizeof(int32_t) + 20 * sizeof(char) +
+    corr_param.fft_wisdom_file.size() +
     corr_param.station_streams.size() * (3 * sizeof(int64_t) + 4 * sizeof(int32_t) + 2 * sizeof(char) + 2 * sizeof(double));
   int position = 0;
   char message_buffer[size];
@@ -934,6 +986,23 @@ MPI_Transfer::send(Correlation_parameters &corr_param, int rank) {
            message_buffer, size, &position, MPI_COMM_WORLD);
   MPI_Pack(&corr_param.pulsar_binning, 1, MPI_INT32,
            message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.correlation_threads, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.delay_threads, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.bit2float_threads, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.pipeline_depth, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.lane, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(&corr_param.fft_planning, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  int32_t wisdom_len = corr_param.fft_wisdom_file.size();
+  MPI_Pack(&wisdom_len, 1, MPI_INT32,
+           message_buffer, size, &position, MPI_COMM_WORLD);
+  MPI_Pack(const_cast<char *>(corr_param.fft_wisdom_file.c_str()), wisdom_len, MPI_CHAR,
+           message_buffer, size, &position, MPI_COMM_WORLD);
   MPI_Pack(&corr_param.source[0], 17, MPI_CHAR,
            message_buffer, size, &position, MPI_COMM_WORLD);
 
@@ -1082,6 +1151,25 @@ MPI_Transfer::receive(MPI_Status &status, Correlation_parameters &corr_param) {
              &corr_param.multi_phase_center, 1, MPI_INT32, MPI_COMM_WORLD);
   MPI_Unpack(buffer, size, &position,
              &corr_param.pulsar_binning, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.correlation_threads, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.delay_threads, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.bit2float_threads, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.pipeline_depth, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.lane, 1, MPI_INT32, MPI_COMM_WORLD);
+  MPI_Unpack(buffer, size, &position,
+             &corr_param.fft_planning, 1, MPI_INT32, MPI_COMM_WORLD);
+  int32_t wisdom_len;
+  MPI_Unpack(buffer, size, &position,
+             &wisdom_len, 1, MPI_INT32, MPI_COMM_WORLD);
+  char wisdom_file[wisdom_len + 1];
+  MPI_Unpack(buffer, size, &position,
+             wisdom_file, wisdom_len, MPI_CHAR, MPI_COMM_WORLD);
+  corr_param.fft_wisdom_file = std::string(wisdom_file, wisdom_len);
   MPI_Unpack(buffer, size, &position,
                &corr_param.source[0], 17, MPI_CHAR, MPI_COMM_WORLD);
 
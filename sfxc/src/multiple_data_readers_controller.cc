@@ -13,6 +13,7 @@
 #include "data_reader_file.h"
 #include "data_reader_tcp.h"
 #include "data_reader_socket.h"
+#include "data_reader_shm.h"
 
 #include "data_reader_buffer.h"
 #include "tcp_connection.h"
@@ -58,6 +59,14 @@ Multiple_data_readers_controller::process_event(MPI_Status &status) {
       std::string hostname;
       MPI_Transfer::recv_connect_to_msg(info, ip_ports, hostname, status.MPI_SOURCE);
 
+      // A data writer on the same host writes into shared memory
+      if ((hostname == HOSTNAME_OF_NODE) && connect_shared_memory(info)) {
+        CHECK_MPI(MPI_Send(NULL, 0, MPI_UINT32,
+                           status.MPI_SOURCE, MPI_TAG_CONNECTION_ESTABLISHED,
+                           MPI_COMM_WORLD));
+        return PROCESS_EVENT_STATUS_SUCCEEDED;
+      }
+
       CHECK_MPI(MPI_Ssend(&info, 4, MPI_UINT32,
 			  info[0], MPI_TAG_ADD_TCP_WRITER_CONNECTED_FROM,
 			  MPI_COMM_WORLD));
@@ -123,6 +132,26 @@ Multiple_data_readers_controller::process_event(MPI_Status &status) {
       add_data_reader(params[3], reader);
       //DEBUG_MSG("A data reader is created from: "<< params[0] << " to:" << params[2]);
 
+      return PROCESS_EVENT_STATUS_SUCCEEDED;
+    }
+  case MPI_TAG_ADD_SHM_READER_CONNECTED_FROM: {
+      get_log_writer()(3) << print_MPI_TAG(status.MPI_TAG) << std::endl;
+
+      uint32_t info[4];
+      std::string name;
+      MPI_Transfer::recv_connect_shm_msg(info, name, status.MPI_SOURCE, status.MPI_TAG);
+
+      // If the ring can not be opened the writer falls back to tcp
+      Shared_memory_ring::Ptr ring = Shared_memory_ring::open(name);
+      int32_t attached = (ring != Shared_memory_ring::Ptr());
+      CHECK_MPI(MPI_Send(&attached, 1, MPI_INT32,
+                         status.MPI_SOURCE, MPI_TAG_SHM_CONNECTION_ACK,
+                         MPI_COMM_WORLD));
+      if (attached) {
+        shared_ptr<Data_reader> reader(new Data_reader_shm(ring));
+        add_data_reader(info[3], reader);
+      }
+
       return PROCESS_EVENT_STATUS_SUCCEEDED;
     }
   case MPI_TAG_ADD_DATA_READER_TCP2: {
@@ -195,6 +224,27 @@ Multiple_data_readers_controller::process_event(MPI_Status &status) {
   return PROCESS_EVENT_STATUS_UNKNOWN;
 }
 
+bool
+Multiple_data_readers_controller::connect_shared_memory(const uint32_t info[4]) {
+  Shared_memory_ring::Ptr ring = Shared_memory_ring::create();
+  if (ring == Shared_memory_ring::Ptr())
+    return false;
+
+  MPI_Transfer::send_connect_shm_msg(info, ring->name(), info[0],
+                                     MPI_TAG_ADD_SHM_WRITER_CONNECTED_FROM);
+  int32_t attached;
+  MPI_Status status;
+  CHECK_MPI(MPI_Recv(&attached, 1, MPI_INT32,
+                     info[0], MPI_TAG_SHM_CONNECTION_ACK,
+                     MPI_COMM_WORLD, &status));
+  if (!attached)
+    return false;
+
+  shared_ptr<Data_reader> reader(new Data_reader_shm(ring));
+  add_data_reader(info[3], reader);
+  return true;
+}
+
 void
 Multiple_data_readers_controller::stop() {
   for (unsigned int i = 0; i < readers.size(); i++) {
@@ -13,6 +13,7 @@
 #include "data_writer_file.h"
 #include "data_writer_tcp.h"
 #include "data_writer_socket.h"
+#include "data_writer_shm.h"
 
 //#include "sfxc_mpi.h"
 #include "tcp_connection.h"
@@ -68,8 +69,16 @@ Multiple_data_writers_controller::process_event(MPI_Status &status) {
       std::string hostname;
       MPI_Transfer::recv_connect_writer_to_msg(info, ip_ports, hostname, status.MPI_SOURCE);
 
+      // A data reader on the same host reads from shared memory
+      if ((hostname == HOSTNAME_OF_NODE) && connect_shared_memory(info)) {
+        CHECK_MPI(MPI_Send(NULL, 0, MPI_UINT32,
+                           status.MPI_SOURCE, MPI_TAG_CONNECTION_ESTABLISHED,
+                           MPI_COMM_WORLD));
+        return PROCESS_EVENT_STATUS_SUCCEEDED;
+      }
+
       CHECK_MPI(MPI_Ssend(&info, 4, MPI_UINT32,
-			  info[0], MPI_TAG_ADD_TCP_READER_CONNECTED_FROM,
+			  info[2], MPI_TAG_ADD_TCP_READER_CONNECTED_FROM,
 			  MPI_COMM_WORLD));
 
       // Connect to the given host
@@ -133,6 +142,26 @@ Multiple_data_writers_controller::process_event(MPI_Status &status) {
       add_data_writer(params[1], writer);
       //DEBUG_MSG("A data writer is created from: "<< params[0] << " to:" << params[2]);
 
+      return PROCESS_EVENT_STATUS_SUCCEEDED;
+    }
+  case MPI_TAG_ADD_SHM_WRITER_CONNECTED_FROM: {
+      get_log_writer()(3) << print_MPI_TAG(status.MPI_TAG) << std::endl;
+
+      uint32_t info[4];
+      std::string name;
+      MPI_Transfer::recv_connect_shm_msg(info, name, status.MPI_SOURCE, status.MPI_TAG);
+
+      // If the ring can not be opened the reader falls back to tcp
+      Shared_memory_ring::Ptr ring = Shared_memory_ring::open(name);
+      int32_t attached = (ring != Shared_memory_ring::Ptr());
+      CHECK_MPI(MPI_Send(&attached, 1, MPI_INT32,
+                         status.MPI_SOURCE, MPI_TAG_SHM_CONNECTION_ACK,
+                         MPI_COMM_WORLD));
+      if (attached) {
+        shared_ptr<Data_writer> writer(new Data_writer_shm(ring));
+        add_data_writer(info[1], writer);
+      }
+
       return PROCESS_EVENT_STATUS_SUCCEEDED;
     }
   case MPI_TAG_ADD_TCP: {
@@ -211,6 +240,27 @@ Multiple_data_writers_controller::process_event(MPI_Status &status) {
   return PROCESS_EVENT_STATUS_UNKNOWN;
 }
 
+bool
+Multiple_data_writers_controller::connect_shared_memory(const uint32_t info[4]) {
+  Shared_memory_ring::Ptr ring = Shared_memory_ring::create();
+  if (ring == Shared_memory_ring::Ptr())
+    return false;
+
+  MPI_Transfer::send_connect_shm_msg(info, ring->name(), info[2],
+                                     MPI_TAG_ADD_SHM_READER_CONNECTED_FROM);
+  int32_t attached;
+  MPI_Status status;
+  CHECK_MPI(MPI_Recv(&attached, 1, MPI_INT32,
+                     info[2], MPI_TAG_SHM_CONNECTION_ACK,
+                     MPI_COMM_WORLD, &status));
+  if (!attached)
+    return false;
+
+  shared_ptr<Data_writer> writer(new Data_writer_shm(ring));
+  add_data_writer(info[1], writer);
+  return true;
+}
+
 bool
 Multiple_data_writers_controller::ready() {
   return true;
@@ -14,15 +14,19 @@
 #include "utils.h"
 
 Node *Node::theNode = NULL;
+const int Node::MIN_POLL_INTERVAL;
+const int Node::MAX_POLL_INTERVAL;
 
 Node::Node(int rank)
-    : rank(rank), log_writer(new Log_writer_mpi(rank, 0)), assertion_raised(false) {
+    : rank(rank), log_writer(new Log_writer_mpi(rank, 0)), assertion_raised(false),
+      poll_interval(MIN_POLL_INTERVAL) {
   theNode = this;
   signal(SIGUSR1, Node::sighandler);
 }
 
 Node::Node(int rank, Log_writer *writer)
-    : rank(rank), log_writer(writer), assertion_raised(false) {
+    : rank(rank), log_writer(writer), assertion_raised(false),
+      poll_interval(MIN_POLL_INTERVAL) {
   theNode = this;
   signal(SIGUSR1, Node::sighandler);
 }
@@ -106,6 +110,16 @@ Node::check_and_process_message() {
   return result;
 }
 
+void
+Node::poll_messages() {
+  if (check_and_process_waiting_message() != NO_MESSAGE) {
+    poll_interval = MIN_POLL_INTERVAL;
+    return;
+  }
+  usleep(poll_interval);
+  poll_interval = std::min(2 * poll_interval, (int)MAX_POLL_INTERVAL);
+}
+
 Node::MESSAGE_RESULT
 Node::process_event(MPI_Status &status) {
   if (status.MPI_TAG == MPI_TAG_END_NODE) {
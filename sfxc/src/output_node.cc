@@ -115,11 +115,14 @@ void Output_node::start() {
         break;
       }
     case READ_INPUT: {
+        uint64_t events = input_notifier.count();
         process_all_waiting_messages();
 
         int bytes_read = input_streams[curr_stream]->read_bytes(input_buffer);
         if (bytes_read <= 0) {
-          usleep(100);
+          // Wait for data, but not longer than a polling node would
+          // leave the MPI messages waiting
+          input_notifier.wait(events, MAX_POLL_INTERVAL);
 	} else {
 	  total_bytes_read += bytes_read;
 	}
@@ -314,6 +317,7 @@ bool Output_node::write_output(int nBytes) {
 void Output_node::hook_added_data_reader(size_t reader) {
   // Create an output buffer:
   data_readers_ctrl.enable_buffering(reader, buffer_size);
+  data_readers_ctrl.get_queue(reader)->set_notifier(&input_notifier);
 
   // Create the data_stream:
   if (input_streams.size() <= reader) {
@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
 
 #include "types.h"
 #include "input_node.h"
@@ -33,6 +35,7 @@
 #include "data_reader_file.h"
 #include "data_reader_tcp.h"
 #include "utils.h"
+#include "cpu_affinity.h"
 
 #include "manager_node.h"
 
@@ -42,6 +45,25 @@
 #include "monitor.h"
 #endif //RUNTIME_STATISTIC
 
+// Distribute the cpu_map of the ctrl-file to all nodes, the environment
+// variable SFXC_CPU_MAP takes precedence on the nodes where it is set
+void set_cpu_map(const std::string &ctrl_map) {
+  int32_t len = ctrl_map.size();
+  MPI_Bcast(&len, 1, MPI_INT32, RANK_MANAGER_NODE, MPI_COMM_WORLD);
+  std::vector<char> buffer(len + 1, 0);
+  if (RANK_OF_NODE == RANK_MANAGER_NODE)
+    memcpy(&buffer[0], ctrl_map.c_str(), len);
+  MPI_Bcast(&buffer[0], len, MPI_CHAR, RANK_MANAGER_NODE, MPI_COMM_WORLD);
+
+  std::string map(&buffer[0]);
+  const char *env = getenv("SFXC_CPU_MAP");
+  if (env != NULL)
+    map = env;
+  std::string error;
+  if (!Cpu_affinity::set_map(map, RANK_OF_NODE, error))
+    std::cerr << RANK_OF_NODE << " : Not pinning threads, invalid cpu map: " << error << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   //initialisation
   int provided;
@@ -148,6 +170,7 @@ int main(int argc, char *argv[]) {
       // Determine number of correlator nodes and broadcast to all nodes
       int nr_corr_nodes = numtasks - control_parameters.number_inputs() - 3;
       MPI_Bcast(&nr_corr_nodes, 1, MPI_INT32, RANK_MANAGER_NODE, MPI_COMM_WORLD);
+      set_cpu_map(control_parameters.cpu_map());
       // Create a communicator for all correlator nodes which can be used for 
       // collective communications. Note that ALL mpi processes must create 
       // the communicator not only the correlator nodes.
@@ -168,6 +191,7 @@ int main(int argc, char *argv[]) {
     MPI_Bcast(&nr_corr_nodes, 1, MPI_INT32, RANK_MANAGER_NODE, MPI_COMM_WORLD);
     // nr_corr_nodes is negative in case of error
     if (nr_corr_nodes > 0){
+      set_cpu_map(std::string());
       // Create a communicator for all correlator nodes which can be used for 
       // collective communications. Note that ALL mpi processes must create 
       // the communicator not only the correlator nodes.
@@ -1,5 +1,6 @@
 #include "sfxc_fft.h"
 #include "utils.h"
+#include "raiimutex.h"
 
 #ifdef USE_IPP
 #include <ippcore.h>
@@ -125,7 +126,177 @@ sfxc_fft_ipp::irfft(const std::complex<double> *in, double *out){
     alloc_r2c();
   ippsFFTInv_CCSToR_64f((Ipp64f *)in, (Ipp64f *)out, ippspec_r2c, buffer_r2c);
 }
+
+void
+sfxc_fft_ipp::rfft_many(const double *in, std::complex<double> *out, int howmany, int idist, int odist){
+  // IPP has no batched transforms
+  for (int i = 0; i < howmany; i++)
+    rfft(in + i * idist, out + i * odist);
+}
+
+void
+sfxc_fft_ipp::ifft_many(const std::complex<double> *in, std::complex<double> *out, int howmany, int idist, int odist){
+  for (int i = 0; i < howmany; i++)
+    ifft(in + i * idist, out + i * odist);
+}
 #else // USE FFTW
+#include <map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+// Plans are shared between all sfxc_fft_fftw objects, FFTW allows the same plan
+// to be executed concurrently on different arrays. They are kept until
+// the end of the program, such that a new time slice with the same
+// parameters does not need to plan again.
+enum Plan_type {
+  PLAN_FORWARD = 0, PLAN_BACKWARD, PLAN_FORWARD_I, PLAN_BACKWARD_I,
+  PLAN_FORWARD_R2C, PLAN_BACKWARD_C2R, PLAN_FORWARD_R2C_MANY,
+  PLAN_BACKWARD_MANY, PLAN_BACKWARD_MANY_I
+};
+
+struct Plan_key {
+  Plan_key(int size, int type, int rigor,
+           int howmany = 1, int idist = 0, int odist = 0)
+    : size(size), type(type), rigor(rigor),
+      howmany(howmany), idist(idist), odist(odist) {}
+  bool operator<(const Plan_key &other) const {
+    if (size != other.size)
+      return size < other.size;
+    if (type != other.type)
+      return type < other.type;
+    if (rigor != other.rigor)
+      return rigor < other.rigor;
+    if (howmany != other.howmany)
+      return howmany < other.howmany;
+    if (idist != other.idist)
+      return idist < other.idist;
+    return odist < other.odist;
+  }
+  int size, type, rigor;
+  // Layout of batched transforms
+  int howmany, idist, odist;
+};
+
+std::map<Plan_key, fftw_plan> plan_cache;
+
+// Batched transforms always use plans of FFT_BATCH transforms, the rest
+// of a batch is done one transform at a time. The number of transforms
+// changes from call to call, a plan for every count would be planned
+// anew at the full rigor and stay in plan_cache.
+const int FFT_BATCH = 16;
+
+// The FFTW planner is not thread safe and plans are created from several
+// threads in the correlator node; protects the planner and the variables
+// in this namespace.
+Mutex planner_mutex;
+int planning_rigor = SFXC_FFT_ESTIMATE;
+// Set when plans were measured since the wisdom was last exported
+bool wisdom_changed = false;
+
+unsigned int planner_flags(int rigor) {
+  switch (rigor) {
+  case SFXC_FFT_MEASURE:
+    return FFTW_MEASURE;
+  case SFXC_FFT_PATIENT:
+    return FFTW_PATIENT;
+  default:
+    return FFTW_ESTIMATE;
+  }
+}
+
+// Reads the complete wisdom file into wisdom
+bool read_wisdom_file(const std::string &filename, std::string &wisdom) {
+  FILE *file = fopen(filename.c_str(), "r");
+  if (file == NULL)
+    return false;
+  wisdom.clear();
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    wisdom.append(buffer, n);
+  bool ok = (ferror(file) == 0);
+  fclose(file);
+  return ok;
+}
+
+// Writes to a temporary file in the same directory and renames it, such
+// that readers never see a partially written file
+bool write_wisdom_file(const std::string &filename, const std::string &wisdom) {
+  std::string tmp_name = filename + ".XXXXXX";
+  std::vector<char> tmp(tmp_name.begin(), tmp_name.end());
+  tmp.push_back('\0');
+  int fd = mkstemp(&tmp[0]);
+  if (fd < 0)
+    return false;
+  fchmod(fd, 0644);
+  FILE *file = fdopen(fd, "w");
+  if (file == NULL) {
+    close(fd);
+    unlink(&tmp[0]);
+    return false;
+  }
+  bool ok = (fwrite(wisdom.data(), 1, wisdom.size(), file) == wisdom.size());
+  if ((fclose(file) != 0) || !ok || (rename(&tmp[0], filename.c_str()) != 0)) {
+    unlink(&tmp[0]);
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+void
+sfxc_fft_fftw::set_planning_rigor(int rigor){
+  RAIIMutex lock(planner_mutex);
+  planning_rigor = rigor;
+}
+
+bool
+sfxc_fft_fftw::import_wisdom(const std::string &filename){
+  std::string wisdom;
+  if (!read_wisdom_file(filename, wisdom))
+    return false;
+  RAIIMutex lock(planner_mutex);
+  return fftw_import_wisdom_from_string(wisdom.c_str()) != 0;
+}
+
+bool
+sfxc_fft_fftw::export_wisdom(const std::string &filename){
+  {
+    RAIIMutex lock(planner_mutex);
+    if (!wisdom_changed)
+      return true;
+  }
+
+  // The file I/O is done without the planner lock, such that the other
+  // threads can keep on planning in the mean time. The wisdom other
+  // processes have written is merged in.
+  std::string wisdom;
+  bool merge = read_wisdom_file(filename, wisdom);
+  char *merged;
+  {
+    RAIIMutex lock(planner_mutex);
+    if (merge)
+      fftw_import_wisdom_from_string(wisdom.c_str());
+    merged = fftw_export_wisdom_to_string();
+    wisdom_changed = false;
+  }
+  if (merged == NULL)
+    return false;
+  wisdom = merged;
+  free(merged);
+
+  if (!write_wisdom_file(filename, wisdom)) {
+    RAIIMutex lock(planner_mutex);
+    wisdom_changed = true;
+    return false;
+  }
+  return true;
+}
+
 sfxc_fft_fftw::sfxc_fft_fftw(){
   plan_forward_set = false;
   plan_backward_set = false;
@@ -133,6 +304,8 @@ sfxc_fft_fftw::sfxc_fft_fftw(){
   plan_backward_I_set = false;
   plan_forward_r2c_set = false;
   plan_backward_r2c_set = false;
+  plan_forward_r2c_many.set = false;
+  plan_backward_many.set = false;
 }
 
 sfxc_fft_fftw::~sfxc_fft_fftw(){
@@ -141,30 +314,15 @@ sfxc_fft_fftw::~sfxc_fft_fftw(){
 
 void
 sfxc_fft_fftw::free_buffers(){
-  if(plan_forward_set){
-    fftw_destroy_plan(plan_forward);
-    plan_forward_set = false;
-  }
-  if(plan_backward_set){
-    fftw_destroy_plan(plan_backward);
-    plan_backward_set = false;
-  }
-  if(plan_forward_I_set){
-    fftw_destroy_plan(plan_forward_I);
-    plan_forward_I_set = false;
-  }
-  if(plan_backward_I_set){
-    fftw_destroy_plan(plan_backward_I);
-    plan_backward_I_set = false;
-  }
-  if(plan_forward_r2c_set){
-    fftw_destroy_plan(plan_forward_r2c);
-    plan_forward_r2c_set = false;
-  }
-  if(plan_backward_r2c_set){
-    fftw_destroy_plan(plan_backward_r2c);
-    plan_backward_r2c_set = false;
-  }
+  // The plans themselves are owned by plan_cache
+  plan_forward_set = false;
+  plan_backward_set = false;
+  plan_forward_I_set = false;
+  plan_backward_I_set = false;
+  plan_forward_r2c_set = false;
+  plan_backward_r2c_set = false;
+  plan_forward_r2c_many.set = false;
+  plan_backward_many.set = false;
 }
 
 void
@@ -175,6 +333,16 @@ sfxc_fft_fftw::resize(int size_){
 
 fftw_plan
 sfxc_fft_fftw::alloc(int sign, bool inplace){
+  RAIIMutex lock(planner_mutex);
+  Plan_type type;
+  if (sign == FFTW_FORWARD)
+    type = (inplace ? PLAN_FORWARD_I : PLAN_FORWARD);
+  else
+    type = (inplace ? PLAN_BACKWARD_I : PLAN_BACKWARD);
+  Plan_key key(size, type, planning_rigor);
+  if (plan_cache.count(key) > 0)
+    return plan_cache[key];
+
   fftw_complex *temp_in = (fftw_complex *) fftw_malloc(size * sizeof(fftw_complex));
   fftw_complex *temp_out;
   if(inplace)
@@ -183,33 +351,40 @@ sfxc_fft_fftw::alloc(int sign, bool inplace){
     temp_out = (fftw_complex *) fftw_malloc(size * sizeof(fftw_complex));
   if((temp_in == NULL) || (temp_out == NULL))
     sfxc_abort("Unable to allocate buffer for fft\n");
-//  fftw_plan plan = fftw_plan_dft_1d(size, temp_in, temp_out, sign, FFTW_MEASURE);
-  fftw_plan plan = fftw_plan_dft_1d(size, temp_in, temp_out, sign, FFTW_ESTIMATE);
+  fftw_plan plan = fftw_plan_dft_1d(size, temp_in, temp_out, sign, planner_flags(planning_rigor));
   fftw_free(temp_in);
   if(!inplace)
     fftw_free(temp_out);
+  plan_cache[key] = plan;
+  if (planning_rigor != SFXC_FFT_ESTIMATE)
+    wisdom_changed = true;
   return plan;
 }
 
 fftw_plan
 sfxc_fft_fftw::
 alloc_r2c(int sign){
+  RAIIMutex lock(planner_mutex);
+  Plan_key key(size, (sign == FFTW_FORWARD ? PLAN_FORWARD_R2C : PLAN_BACKWARD_C2R),
+               planning_rigor);
+  if (plan_cache.count(key) > 0)
+    return plan_cache[key];
+
   double *temp_real = (double *) fftw_malloc(size * sizeof(double));
   fftw_complex *temp_complex = (fftw_complex *)fftw_malloc(size * sizeof(fftw_complex));
   if((temp_real == NULL) || (temp_complex == NULL))
     sfxc_abort("Unable to allocate buffer for fft\n");
   fftw_plan plan;
-//  if(sign == FFTW_FORWARD)
-//    plan = fftw_plan_dft_r2c_1d(size, temp_real, temp_complex, FFTW_MEASURE);
-//  else
-//    plan = fftw_plan_dft_c2r_1d(size, temp_complex, temp_real, FFTW_MEASURE);
   if(sign == FFTW_FORWARD)
-    plan = fftw_plan_dft_r2c_1d(size, temp_real, temp_complex, FFTW_ESTIMATE);
+    plan = fftw_plan_dft_r2c_1d(size, temp_real, temp_complex, planner_flags(planning_rigor));
   else
-    plan = fftw_plan_dft_c2r_1d(size, temp_complex, temp_real, FFTW_ESTIMATE);
+    plan = fftw_plan_dft_c2r_1d(size, temp_complex, temp_real, planner_flags(planning_rigor));
 
   fftw_free(temp_real);
   fftw_free(temp_complex);
+  plan_cache[key] = plan;
+  if (planning_rigor != SFXC_FFT_ESTIMATE)
+    wisdom_changed = true;
   return plan;
 }
 
@@ -267,4 +442,89 @@ sfxc_fft_fftw::irfft(const std::complex<double> *in, double *out){
   fftw_execute_dft_c2r(plan_backward_r2c, (fftw_complex *)in, (double *)out);
 }
 
+// Create a plan for howmany transforms of length size, with distance idist
+// between the inputs and odist between the outputs
+fftw_plan
+sfxc_fft_fftw::alloc_many(int type, int howmany, int idist, int odist){
+  RAIIMutex lock(planner_mutex);
+  Plan_key key(size, type, planning_rigor, howmany, idist, odist);
+  if (plan_cache.count(key) > 0)
+    return plan_cache[key];
+
+  const bool r2c = (type == PLAN_FORWARD_R2C_MANY);
+  const bool inplace = (type == PLAN_BACKWARD_MANY_I);
+  const int out_size = (r2c ? size / 2 + 1 : size);
+  const size_t in_len = (size_t)(howmany - 1) * idist + size;
+  const size_t out_len = (size_t)(howmany - 1) * odist + out_size;
+  void *temp_in = fftw_malloc(in_len * (r2c ? sizeof(double) : sizeof(fftw_complex)));
+  fftw_complex *temp_out;
+  if (inplace)
+    temp_out = (fftw_complex *)temp_in;
+  else
+    temp_out = (fftw_complex *)fftw_malloc(out_len * sizeof(fftw_complex));
+  if((temp_in == NULL) || (temp_out == NULL))
+    sfxc_abort("Unable to allocate buffer for fft\n");
+  fftw_plan plan;
+  if (r2c)
+    plan = fftw_plan_many_dft_r2c(1, &size, howmany, (double *)temp_in, NULL, 1, idist,
+                                  temp_out, NULL, 1, odist, planner_flags(planning_rigor));
+  else
+    plan = fftw_plan_many_dft(1, &size, howmany, (fftw_complex *)temp_in, NULL, 1, idist,
+                              temp_out, NULL, 1, odist, FFTW_BACKWARD,
+                              planner_flags(planning_rigor));
+  fftw_free(temp_in);
+  if(!inplace)
+    fftw_free(temp_out);
+  if (plan == NULL)
+    sfxc_abort("Unable to create batched fft plan\n");
+  plan_cache[key] = plan;
+  if (planning_rigor != SFXC_FFT_ESTIMATE)
+    wisdom_changed = true;
+  return plan;
+}
+
+void
+sfxc_fft_fftw::rfft_many(const double *in, std::complex<double> *out, int howmany, int idist, int odist){
+  SFXC_ASSERT((void *)in != (void *)out);
+  int i = 0;
+  if (howmany >= FFT_BATCH) {
+    if (!plan_forward_r2c_many.matches(FFT_BATCH, idist, odist, false)) {
+      plan_forward_r2c_many.plan = alloc_many(PLAN_FORWARD_R2C_MANY, FFT_BATCH, idist, odist);
+      plan_forward_r2c_many.howmany = FFT_BATCH;
+      plan_forward_r2c_many.idist = idist;
+      plan_forward_r2c_many.odist = odist;
+      plan_forward_r2c_many.inplace = false;
+      plan_forward_r2c_many.set = true;
+    }
+    for (; i + FFT_BATCH <= howmany; i += FFT_BATCH)
+      fftw_execute_dft_r2c(plan_forward_r2c_many.plan, (double *)(in + i * idist),
+                           (fftw_complex *)(out + i * odist));
+  }
+  for (; i < howmany; i++)
+    rfft(in + i * idist, out + i * odist);
+}
+
+void
+sfxc_fft_fftw::ifft_many(const std::complex<double> *in, std::complex<double> *out, int howmany, int idist, int odist){
+  bool inplace = (in == out);
+  SFXC_ASSERT((!inplace) || (idist == odist));
+  int i = 0;
+  if (howmany >= FFT_BATCH) {
+    if (!plan_backward_many.matches(FFT_BATCH, idist, odist, inplace)) {
+      plan_backward_many.plan =
+        alloc_many(inplace ? PLAN_BACKWARD_MANY_I : PLAN_BACKWARD_MANY, FFT_BATCH, idist, odist);
+      plan_backward_many.howmany = FFT_BATCH;
+      plan_backward_many.idist = idist;
+      plan_backward_many.odist = odist;
+      plan_backward_many.inplace = inplace;
+      plan_backward_many.set = true;
+    }
+    for (; i + FFT_BATCH <= howmany; i += FFT_BATCH)
+      fftw_execute_dft(plan_backward_many.plan, (fftw_complex *)(in + i * idist),
+                       (fftw_complex *)(out + i * odist));
+  }
+  for (; i < howmany; i++)
+    ifft(in + i * idist, out + i * odist);
+}
+
 #endif // USE_IPP
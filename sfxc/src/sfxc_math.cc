@@ -0,0 +1,255 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the scalar implementation of the vector functions in sfxc_math.h
+ *   - the run time selection of the SIMD implementations
+ */
+#include "sfxc_math.h"
+#include "sfxc_math_rotate.h"
+
+#ifdef USE_IPP
+void sfxc_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+}
+
+void sfxc_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+}
+
+void sfxc_add_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ADD_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+}
+
+void sfxc_add_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ADD_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+}
+
+void sfxc_rotate_real_c(const std::complex<double> *src, double *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ROTATE_REAL>((const double *)src, dest, len, phi, delta, scale);
+}
+
+void sfxc_rotate_real_fc(const std::complex<float> *src, float *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ROTATE_REAL>((const float *)src, dest, len, phi, delta, scale);
+}
+#else
+#include <stdlib.h>
+
+#include "utils.h"
+
+// Implemented in sfxc_math_sse4.cc, sfxc_math_avx2.cc and sfxc_math_avx512.cc
+#if defined(__x86_64__) || defined(__i386__)
+#define SFXC_MATH_HAVE_X86
+void sfxc_math_init_sse4(Sfxc_math_kernels &kernels);
+void sfxc_math_init_avx2(Sfxc_math_kernels &kernels);
+void sfxc_math_init_avx512(Sfxc_math_kernels &kernels);
+#endif
+
+namespace {
+
+void mul_c(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = s1[i] * s2[i];
+  }
+}
+
+void mul_fc(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = s1[i] * s2[i];
+  }
+}
+
+void mul(const double *s1, const double *s2, double *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = s1[i] * s2[i];
+  }
+}
+
+void mul_f(const float *s1, const float *s2, float *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = s1[i] * s2[i];
+  }
+}
+
+void mul_c_I(const std::complex<double> *s1, std::complex<double>  *s2dest, int len){
+  for(int i = 0; i < len; i++){
+    s2dest[i] = s1[i] * s2dest[i];
+  }
+}
+
+void mul_fc_I(const std::complex<float> *s1, std::complex<float> *s2dest, int len){
+  for(int i = 0; i < len; i++){
+    s2dest[i] = s1[i] * s2dest[i];
+  }
+}
+
+void mul_f_c_I(const double *s1, std::complex<double>  *s2dest, int len){
+  for(int i = 0; i < len; i++){
+    s2dest[i] = s1[i] * s2dest[i];
+  }
+}
+
+void mul_f_fc_I(const float *s1, std::complex<float> *s2dest, int len){
+  for(int i = 0; i < len; i++){
+    s2dest[i] = s1[i] * s2dest[i];
+  }
+}
+
+void conj_fc(const std::complex<float> *s1, std::complex<float> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = conj(s1[i]);
+  }
+}
+
+void conj_c(const std::complex<double> *s1, std::complex<double> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = conj(s1[i]);
+  }
+}
+
+void add_f(const float *src1, const float *src2, float *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = src1[i] + src2[i];
+  }
+}
+
+void add_f_I(const float *src1, float *srcdest, int len){
+  for(int i = 0; i < len; i++){
+    srcdest[i] += src1[i];
+  }
+}
+
+void add(const double *src1, const double *src2, double *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] = src1[i] + src2[i];
+  }
+}
+
+void add_I(const double *src1, double *srcdest, int len){
+  for(int i = 0; i < len; i++){
+    srcdest[i] += src1[i];
+  }
+}
+
+void add_product_fc(const std::complex<float> *s1, const std::complex<float> *s2, std::complex<float> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] += s1[i] * s2[i];
+  }
+}
+
+void add_product_c(const std::complex<double> *s1, const std::complex<double> *s2, std::complex<double> *dest, int len){
+  for(int i = 0; i < len; i++){
+    dest[i] += s1[i] * s2[i];
+  }
+}
+
+void rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+}
+
+void rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+}
+
+void add_rotate_c(const std::complex<double> *src, std::complex<double> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ADD_ROTATE>((const double *)src, (double *)dest, len, phi, delta, scale);
+}
+
+void add_rotate_fc(const std::complex<float> *src, std::complex<float> *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ADD_ROTATE>((const float *)src, (float *)dest, len, phi, delta, scale);
+}
+
+void rotate_real_c(const std::complex<double> *src, double *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<double>, SFXC_ROTATE_REAL>((const double *)src, dest, len, phi, delta, scale);
+}
+
+void rotate_real_fc(const std::complex<float> *src, float *dest, int len, double phi, double delta, double scale){
+  simd_rotate<Scalar_traits<float>, SFXC_ROTATE_REAL>((const float *)src, dest, len, phi, delta, scale);
+}
+
+const Sfxc_math_kernels scalar_kernels = {
+  mul, mul_f, mul_c, mul_fc, mul_c_I, mul_fc_I, mul_f_c_I, mul_f_fc_I,
+  conj_c, conj_fc, add, add_f, add_I, add_f_I, add_product_c, add_product_fc,
+  rotate_c, rotate_fc, add_rotate_c, add_rotate_fc, rotate_real_c, rotate_real_fc
+};
+
+Sfxc_math_isa current_isa = SFXC_MATH_SCALAR;
+
+const char *isa_names[SFXC_MATH_N_ISA] = {"scalar", "sse4", "avx2", "avx512"};
+
+} // namespace
+
+// Statically initialised, so the scalar kernels can be used even before
+// the initialiser below has run
+Sfxc_math_kernels sfxc_math_kernels = {
+  mul, mul_f, mul_c, mul_fc, mul_c_I, mul_fc_I, mul_f_c_I, mul_f_fc_I,
+  conj_c, conj_fc, add, add_f, add_I, add_f_I, add_product_c, add_product_fc,
+  rotate_c, rotate_fc, add_rotate_c, add_rotate_fc, rotate_real_c, rotate_real_fc
+};
+
+Sfxc_math_isa sfxc_math_best_isa() {
+#ifdef SFXC_MATH_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return SFXC_MATH_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SFXC_MATH_AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SFXC_MATH_SSE4;
+#endif
+  return SFXC_MATH_SCALAR;
+}
+
+bool sfxc_math_select(Sfxc_math_isa isa) {
+  if (isa > sfxc_math_best_isa())
+    return false;
+
+  Sfxc_math_kernels kernels = scalar_kernels;
+  switch (isa) {
+#ifdef SFXC_MATH_HAVE_X86
+  case SFXC_MATH_SSE4:
+    sfxc_math_init_sse4(kernels);
+    break;
+  case SFXC_MATH_AVX2:
+    sfxc_math_init_avx2(kernels);
+    break;
+  case SFXC_MATH_AVX512:
+    sfxc_math_init_avx512(kernels);
+    break;
+#endif
+  default:
+    break;
+  }
+  sfxc_math_kernels = kernels;
+  current_isa = isa;
+  return true;
+}
+
+Sfxc_math_isa sfxc_math_current_isa() {
+  return current_isa;
+}
+
+const char *sfxc_math_isa_name(Sfxc_math_isa isa) {
+  SFXC_ASSERT((isa >= 0) && (isa < SFXC_MATH_N_ISA));
+  return isa_names[isa];
+}
+
+namespace {
+// Select the kernels before main() is entered
+class Sfxc_math_initialiser {
+public:
+  Sfxc_math_initialiser() {
+    Sfxc_math_isa isa = sfxc_math_best_isa();
+    const char *env = getenv("SFXC_MATH_ISA");
+    if (env != NULL) {
+      for (int i = 0; i < SFXC_MATH_N_ISA; i++) {
+        if (strcmp(env, isa_names[i]) == 0 && i < isa)
+          isa = (Sfxc_math_isa)i;
+      }
+    }
+    sfxc_math_select(isa);
+  }
+} initialiser;
+
+} // namespace
+#endif // USE_IPP
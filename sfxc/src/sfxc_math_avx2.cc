@@ -0,0 +1,79 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the AVX2 implementation of the vector functions in sfxc_math.h
+ */
+#include "sfxc_math.h"
+
+#if !defined(USE_IPP) && (defined(__x86_64__) || defined(__i386__))
+// Everything below is compiled for AVX2 and FMA, it is only called after
+// sfxc_math_best_isa() has verified that the CPU supports them.
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2_float {
+  typedef __m256 reg;
+  static const int width = 8;
+
+  static reg load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, reg a) { _mm256_storeu_ps(p, a); }
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm256_moveldup_ps(b);
+    reg b_im = _mm256_movehdup_ps(b);
+    reg a_swap = _mm256_permute_ps(a, 0xB1);
+    return _mm256_fmaddsub_ps(a, b_re, _mm256_mul_ps(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    const __m256i sign = _mm256_set_epi32(0x80000000, 0, 0x80000000, 0,
+                                          0x80000000, 0, 0x80000000, 0);
+    return _mm256_xor_ps(a, _mm256_castsi256_ps(sign));
+  }
+  static reg dup(const float *p) {
+    __m128 a = _mm_loadu_ps(p);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(a, a)),
+                                _mm_unpackhi_ps(a, a), 1);
+  }
+};
+
+struct Avx2_double {
+  typedef __m256d reg;
+  static const int width = 4;
+
+  static reg load(const double *p) { return _mm256_loadu_pd(p); }
+  static void store(double *p, reg a) { _mm256_storeu_pd(p, a); }
+  static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm256_movedup_pd(b);
+    reg b_im = _mm256_permute_pd(b, 0xF);
+    reg a_swap = _mm256_permute_pd(a, 0x5);
+    return _mm256_fmaddsub_pd(a, b_re, _mm256_mul_pd(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    const __m256i sign = _mm256_set_epi32(0x80000000, 0, 0, 0,
+                                          0x80000000, 0, 0, 0);
+    return _mm256_xor_pd(a, _mm256_castsi256_pd(sign));
+  }
+  static reg dup(const double *p) {
+    __m128d a = _mm_loadu_pd(p);
+    return _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_unpacklo_pd(a, a)),
+                                _mm_unpackhi_pd(a, a), 1);
+  }
+};
+
+#include "sfxc_math_simd.h"
+
+} // namespace
+
+void sfxc_math_init_avx2(Sfxc_math_kernels &kernels) {
+  Simd_kernels<Avx2_float, Avx2_double>::fill(kernels);
+}
+
+#pragma GCC pop_options
+#endif
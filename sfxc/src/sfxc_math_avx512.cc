@@ -0,0 +1,78 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the AVX-512 implementation of the vector functions in sfxc_math.h
+ */
+#include "sfxc_math.h"
+
+#if !defined(USE_IPP) && (defined(__x86_64__) || defined(__i386__))
+// Everything below is compiled for AVX-512F, it is only called after
+// sfxc_math_best_isa() has verified that the CPU supports it.
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512_float {
+  typedef __m512 reg;
+  static const int width = 16;
+
+  static reg load(const float *p) { return _mm512_loadu_ps(p); }
+  static void store(float *p, reg a) { _mm512_storeu_ps(p, a); }
+  static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm512_moveldup_ps(b);
+    reg b_im = _mm512_movehdup_ps(b);
+    reg a_swap = _mm512_permute_ps(a, 0xB1);
+    return _mm512_fmaddsub_ps(a, b_re, _mm512_mul_ps(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    // _mm512_xor_ps needs AVX512DQ, use the integer version instead
+    const __m512i sign = _mm512_set1_epi64(0x8000000000000000LL);
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), sign));
+  }
+  static reg dup(const float *p) {
+    const __m512i idx = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4,
+                                         3, 3, 2, 2, 1, 1, 0, 0);
+    return _mm512_permutexvar_ps(idx, _mm512_castps256_ps512(_mm256_loadu_ps(p)));
+  }
+};
+
+struct Avx512_double {
+  typedef __m512d reg;
+  static const int width = 8;
+
+  static reg load(const double *p) { return _mm512_loadu_pd(p); }
+  static void store(double *p, reg a) { _mm512_storeu_pd(p, a); }
+  static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm512_movedup_pd(b);
+    reg b_im = _mm512_permute_pd(b, 0xFF);
+    reg a_swap = _mm512_permute_pd(a, 0x55);
+    return _mm512_fmaddsub_pd(a, b_re, _mm512_mul_pd(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    const __m512i sign = _mm512_set_epi64(0x8000000000000000LL, 0, 0x8000000000000000LL, 0,
+                                          0x8000000000000000LL, 0, 0x8000000000000000LL, 0);
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), sign));
+  }
+  static reg dup(const double *p) {
+    const __m512i idx = _mm512_set_epi64(3, 3, 2, 2, 1, 1, 0, 0);
+    return _mm512_permutexvar_pd(idx, _mm512_castpd256_pd512(_mm256_loadu_pd(p)));
+  }
+};
+
+#include "sfxc_math_simd.h"
+
+} // namespace
+
+void sfxc_math_init_avx512(Sfxc_math_kernels &kernels) {
+  Simd_kernels<Avx512_float, Avx512_double>::fill(kernels);
+}
+
+#pragma GCC pop_options
+#endif
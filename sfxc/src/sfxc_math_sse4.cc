@@ -0,0 +1,72 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * This file contains:
+ *   - the SSE4 implementation of the vector functions in sfxc_math.h
+ */
+#include "sfxc_math.h"
+
+#if !defined(USE_IPP) && (defined(__x86_64__) || defined(__i386__))
+// Everything below is compiled for SSE4, it is only called after
+// sfxc_math_best_isa() has verified that the CPU supports it.
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#include <immintrin.h>
+
+namespace {
+
+struct Sse4_float {
+  typedef __m128 reg;
+  static const int width = 4;
+
+  static reg load(const float *p) { return _mm_loadu_ps(p); }
+  static void store(float *p, reg a) { _mm_storeu_ps(p, a); }
+  static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm_moveldup_ps(b);
+    reg b_im = _mm_movehdup_ps(b);
+    reg a_swap = _mm_shuffle_ps(a, a, 0xB1);
+    return _mm_addsub_ps(_mm_mul_ps(a, b_re), _mm_mul_ps(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    const __m128i sign = _mm_set_epi32(0x80000000, 0, 0x80000000, 0);
+    return _mm_xor_ps(a, _mm_castsi128_ps(sign));
+  }
+  static reg dup(const float *p) {
+    reg a = _mm_castpd_ps(_mm_load_sd((const double *)p));
+    return _mm_unpacklo_ps(a, a);
+  }
+};
+
+struct Sse4_double {
+  typedef __m128d reg;
+  static const int width = 2;
+
+  static reg load(const double *p) { return _mm_loadu_pd(p); }
+  static void store(double *p, reg a) { _mm_storeu_pd(p, a); }
+  static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+  static reg cmul(reg a, reg b) {
+    reg b_re = _mm_movedup_pd(b);
+    reg b_im = _mm_unpackhi_pd(b, b);
+    reg a_swap = _mm_shuffle_pd(a, a, 1);
+    return _mm_addsub_pd(_mm_mul_pd(a, b_re), _mm_mul_pd(a_swap, b_im));
+  }
+  static reg conj(reg a) {
+    const __m128i sign = _mm_set_epi32(0x80000000, 0, 0, 0);
+    return _mm_xor_pd(a, _mm_castsi128_pd(sign));
+  }
+  static reg dup(const double *p) { return _mm_load1_pd(p); }
+};
+
+#include "sfxc_math_simd.h"
+
+} // namespace
+
+void sfxc_math_init_sse4(Sfxc_math_kernels &kernels) {
+  Simd_kernels<Sse4_float, Sse4_double>::fill(kernels);
+}
+
+#pragma GCC pop_options
+#endif
@@ -112,9 +112,11 @@ void start_node() {
   case MPI_TAG_SET_CORRELATOR_NODE_PHASED:
   case MPI_TAG_SET_CORRELATOR_NODE_PSR_BINNING:
   case MPI_TAG_SET_CORRELATOR_NODE: {
-      int32_t corr_nr;
-      MPI_Recv(&corr_nr, 1, MPI_INT32,
+      // The number of the first correlator node and the number of lanes
+      int32_t msg[2];
+      MPI_Recv(msg, 2, MPI_INT32,
                RANK_MANAGER_NODE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+      int32_t corr_nr = msg[0], n_lanes = msg[1];
       int size = 25; 
       char buffer[size];
       snprintf(buffer, size, "Cnode-%d", corr_nr);
@@ -130,7 +132,7 @@ void start_node() {
       // Start correlator node
       bool binning = status.MPI_TAG == MPI_TAG_SET_CORRELATOR_NODE_PSR_BINNING;
       bool phased = status.MPI_TAG == MPI_TAG_SET_CORRELATOR_NODE_PHASED;
-      Correlator_node node(rank, corr_nr, binning, phased);
+      Correlator_node node(rank, corr_nr, n_lanes, binning, phased);
       node.start();
       break;
     }
@@ -0,0 +1,407 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ *
+ * This file is part of:
+ *   - sfxc/SCARIe
+ * This file contains:
+ *   - A byte ring buffer in shared memory between two processes on the
+ *     same host
+ */
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "shared_memory_ring.h"
+#include "utils.h"
+
+#define SHM_RING_CACHE_LINE 64
+
+// The header occupies the first page of the mapping, the read and write
+// positions are on separate cache lines
+struct Shared_memory_ring_header {
+  uint32_t magic;
+  uint32_t header_size;
+  uint64_t size;
+  char pad0[SHM_RING_CACHE_LINE - 16];
+
+  // Written by the writer
+  uint64_t write_pos;
+  int32_t writer_closed;
+  // Set by the reader when it waits for data
+  int32_t reader_waiting;
+  char pad1[SHM_RING_CACHE_LINE - 16];
+
+  // Written by the reader
+  uint64_t read_pos;
+  int32_t reader_closed;
+  // Set by the writer when it waits for space
+  int32_t writer_waiting;
+  char pad2[SHM_RING_CACHE_LINE - 16];
+};
+
+namespace {
+
+const uint32_t SHM_RING_MAGIC = 0x5fc05a11;
+const size_t SHM_RING_HEADER_SIZE = 4096;
+// Timeout of a wait, after which the closed flag of the other side is
+// checked again
+const int SHM_RING_POLL_TIMEOUT = 1000; // ms
+
+uint64_t load(const uint64_t &pos) {
+  return __atomic_load_n(&pos, __ATOMIC_ACQUIRE);
+}
+void store(uint64_t &pos, uint64_t value) {
+  __atomic_store_n(&pos, value, __ATOMIC_RELEASE);
+}
+int32_t load_flag(const int32_t &flag) {
+  return __atomic_load_n(&flag, __ATOMIC_ACQUIRE);
+}
+void set_flag(int32_t &flag) {
+  __atomic_store_n(&flag, 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+// Clears the flag, returns true if it was set
+bool clear_flag(int32_t &flag) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  return (__atomic_load_n(&flag, __ATOMIC_RELAXED) &&
+          __atomic_exchange_n(&flag, 0, __ATOMIC_ACQ_REL));
+}
+
+void ring_doorbell(int fd) {
+  // If the fifo is full the other side is woken up already
+  char c = 0;
+  ssize_t result = ::write(fd, &c, 1);
+  (void)result;
+}
+
+void drain_doorbell(int fd) {
+  char buffer[64];
+  while (::read(fd, buffer, sizeof(buffer)) > 0) {}
+}
+
+void wait_for_doorbell(int fd) {
+  pollfd fds[1];
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  poll(fds, 1, SHM_RING_POLL_TIMEOUT);
+}
+
+std::string shm_directory() {
+  struct stat st;
+  if ((stat("/dev/shm", &st) == 0) && S_ISDIR(st.st_mode))
+    return "/dev/shm";
+  return "/tmp";
+}
+
+void remove_files(const std::string &name) {
+  unlink((name + ".ring").c_str());
+  unlink((name + ".data").c_str());
+  unlink((name + ".space").c_str());
+}
+
+} // namespace
+
+Shared_memory_ring::Shared_memory_ring()
+  : owner_(false), header_(NULL), data_(NULL), length_(0), mask_(0),
+    position_(0), data_fd_(-1), space_fd_(-1) {}
+
+Shared_memory_ring::~Shared_memory_ring() {
+  if (header_ != NULL)
+    munmap(header_, length_);
+  if (data_fd_ >= 0)
+    ::close(data_fd_);
+  if (space_fd_ >= 0)
+    ::close(space_fd_);
+  // The other side normally removed the files already
+  if (owner_)
+    remove_files(name_);
+}
+
+Shared_memory_ring::Ptr
+Shared_memory_ring::create(size_t size) {
+  static int32_t counter = 0;
+  size_t n = 4096;
+  while (n < size)
+    n *= 2;
+
+  Ptr ring(new Shared_memory_ring());
+  std::stringstream name;
+  name << shm_directory() << "/sfxc-" << getpid() << "-"
+       << __sync_fetch_and_add(&counter, 1);
+  ring->name_ = name.str();
+
+  int fd = ::open((ring->name_ + ".ring").c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    return Ptr();
+  ring->owner_ = true;
+  size_t length = SHM_RING_HEADER_SIZE + n;
+  bool ok = ((ftruncate(fd, length) == 0) && ring->map(fd, length, true));
+  ::close(fd);
+  if (!ok)
+    return Ptr();
+
+  // The fifos are opened read-write, such that the open never blocks
+  if ((mkfifo((ring->name_ + ".data").c_str(), 0600) != 0) ||
+      (mkfifo((ring->name_ + ".space").c_str(), 0600) != 0))
+    return Ptr();
+  ring->data_fd_ = ::open((ring->name_ + ".data").c_str(), O_RDWR | O_NONBLOCK);
+  ring->space_fd_ = ::open((ring->name_ + ".space").c_str(), O_RDWR | O_NONBLOCK);
+  if ((ring->data_fd_ < 0) || (ring->space_fd_ < 0))
+    return Ptr();
+  return ring;
+}
+
+Shared_memory_ring::Ptr
+Shared_memory_ring::open(const std::string &name) {
+  Ptr ring(new Shared_memory_ring());
+  ring->name_ = name;
+
+  int fd = ::open((name + ".ring").c_str(), O_RDWR);
+  if (fd < 0)
+    return Ptr();
+  struct stat st;
+  bool ok = ((fstat(fd, &st) == 0) && (st.st_size > (off_t)SHM_RING_HEADER_SIZE) &&
+             ring->map(fd, st.st_size, false));
+  ::close(fd);
+  if (!ok)
+    return Ptr();
+
+  ring->data_fd_ = ::open((name + ".data").c_str(), O_RDWR | O_NONBLOCK);
+  ring->space_fd_ = ::open((name + ".space").c_str(), O_RDWR | O_NONBLOCK);
+  if ((ring->data_fd_ < 0) || (ring->space_fd_ < 0))
+    return Ptr();
+
+  // Both sides are attached, the files are no longer needed
+  remove_files(name);
+  return ring;
+}
+
+bool Shared_memory_ring::map(int fd, size_t length, bool initialise) {
+  void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    return false;
+  header_ = (Shared_memory_ring_header *)p;
+  length_ = length;
+  if (initialise) {
+    memset(header_, 0, sizeof(Shared_memory_ring_header));
+    header_->header_size = SHM_RING_HEADER_SIZE;
+    header_->size = length - SHM_RING_HEADER_SIZE;
+    // The ring is empty, the reader waits for the first data
+    header_->reader_waiting = 1;
+    __atomic_store_n(&header_->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+  } else {
+    if ((__atomic_load_n(&header_->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) ||
+        (header_->header_size != SHM_RING_HEADER_SIZE) ||
+        (header_->size + SHM_RING_HEADER_SIZE != length))
+      return false;
+  }
+  data_ = (char *)p + SHM_RING_HEADER_SIZE;
+  mask_ = header_->size - 1;
+  return true;
+}
+
+size_t Shared_memory_ring::available() {
+  return load(header_->write_pos) - position_;
+}
+
+size_t Shared_memory_ring::space() {
+  return header_->size - (position_ - load(header_->read_pos));
+}
+
+size_t Shared_memory_ring::write(const char *buff, size_t n) {
+  struct iovec iov;
+  iov.iov_base = (void *)buff;
+  iov.iov_len = n;
+  return write(&iov, 1);
+}
+
+size_t Shared_memory_ring::write(const struct iovec *iov, int iovcnt) {
+  SFXC_ASSERT(header_ != NULL);
+  size_t written = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const char *buff = (const char *)iov[i].iov_base;
+    size_t n = iov[i].iov_len, done = 0;
+    while (done < n) {
+      size_t free = space();
+      if (free == 0) {
+        // The reader needs to see the data before it can make room
+        publish();
+        if (!wait_for_space())
+          return written;
+        continue;
+      }
+      size_t offset = position_ & mask_;
+      size_t nbytes = std::min(std::min(free, n - done),
+                               (size_t)(header_->size - offset));
+      memcpy(data_ + offset, buff + done, nbytes);
+      position_ += nbytes;
+      done += nbytes;
+      written += nbytes;
+    }
+  }
+  publish();
+  return written;
+}
+
+void Shared_memory_ring::publish() {
+  store(header_->write_pos, position_);
+  if (clear_flag(header_->reader_waiting))
+    ring_doorbell(data_fd_);
+}
+
+bool Shared_memory_ring::wait_for_space() {
+  for (;;) {
+    drain_doorbell(space_fd_);
+    set_flag(header_->writer_waiting);
+    if (space() > 0) {
+      clear_flag(header_->writer_waiting);
+      return true;
+    }
+    if (load_flag(header_->reader_closed))
+      return false;
+    wait_for_doorbell(space_fd_);
+  }
+}
+
+bool Shared_memory_ring::can_write() {
+  return (space() > 0) || load_flag(header_->reader_closed);
+}
+
+void Shared_memory_ring::close_writer() {
+  if (header_ == NULL)
+    return;
+  __atomic_store_n(&header_->writer_closed, 1, __ATOMIC_RELEASE);
+  if (clear_flag(header_->reader_waiting))
+    ring_doorbell(data_fd_);
+}
+
+bool Shared_memory_ring::can_read() {
+  // The data doorbell is only drained when the ring is empty, it stays
+  // readable while there is data
+  if ((available() > 0) || load_flag(header_->writer_closed))
+    return true;
+  drain_doorbell(data_fd_);
+  set_flag(header_->reader_waiting);
+  if ((available() > 0) || load_flag(header_->writer_closed)) {
+    // The writer did not see the flag, make the doorbell readable
+    if (clear_flag(header_->reader_waiting))
+      ring_doorbell(data_fd_);
+    return true;
+  }
+  return false;
+}
+
+size_t Shared_memory_ring::read(char *buff, size_t n) {
+  SFXC_ASSERT(header_ != NULL);
+  while (!can_read())
+    wait_for_doorbell(data_fd_);
+
+  size_t nbytes = std::min(available(), n);
+  size_t done = 0;
+  while (done < nbytes) {
+    size_t offset = (position_ + done) & mask_;
+    size_t chunk = std::min(nbytes - done, (size_t)(header_->size - offset));
+    if (buff != NULL)
+      memcpy(buff + done, data_ + offset, chunk);
+    done += chunk;
+  }
+  position_ += nbytes;
+  store(header_->read_pos, position_);
+
+  if (clear_flag(header_->writer_waiting))
+    ring_doorbell(space_fd_);
+  return nbytes;
+}
+
+bool Shared_memory_ring::eof() {
+  return load_flag(header_->writer_closed) && (available() == 0);
+}
+
+void Shared_memory_ring::close_reader() {
+  if (header_ == NULL)
+    return;
+  __atomic_store_n(&header_->reader_closed, 1, __ATOMIC_RELEASE);
+  if (clear_flag(header_->writer_waiting))
+    ring_doorbell(space_fd_);
+}
+
+#ifdef ENABLE_TEST_UNIT
+#include <vector>
+#include "thread.h"
+
+namespace {
+class Ring_test_writer : public Thread {
+public:
+  Ring_test_writer(Shared_memory_ring &ring, const std::vector<struct iovec> &iov)
+    : ring(ring), iov(iov), written(0) {}
+  void do_execute() {
+    written = ring.write(&iov[0], iov.size());
+    ring.close_writer();
+  }
+  Shared_memory_ring &ring;
+  const std::vector<struct iovec> &iov;
+  size_t written;
+};
+}
+
+void Shared_memory_ring::Test::tests() {
+  Ptr writer = Shared_memory_ring::create(4096);
+  TEST_ASSERT( writer != Ptr() );
+  if (writer == Ptr())
+    return;
+  Ptr reader = Shared_memory_ring::open(writer->name());
+  TEST_ASSERT( reader != Ptr() );
+  if (reader == Ptr())
+    return;
+  TEST_ASSERT( writer->can_write() );
+  TEST_ASSERT( !reader->can_read() );
+
+  // Buffers that wrap around the ring, some larger than the ring and
+  // some empty, are read back in order
+  std::vector<char> expected;
+  std::vector<size_t> offsets;
+  for (int i = 0; i < 200; i++) {
+    offsets.push_back(expected.size());
+    size_t size = (i % 10 == 0 ? 0 : (i * 997) % 10000);
+    for (size_t j = 0; j < size; j++)
+      expected.push_back((char)(i + 3 * j));
+  }
+  offsets.push_back(expected.size());
+  std::vector<struct iovec> iov(200);
+  for (size_t i = 0; i < iov.size(); i++) {
+    iov[i].iov_base = &expected[0] + offsets[i];
+    iov[i].iov_len = offsets[i + 1] - offsets[i];
+  }
+
+  Ring_test_writer writer_thread(*writer, iov);
+  writer_thread.start();
+  std::vector<char> received(expected.size() + 1);
+  size_t total = 0, result;
+  while ((result = reader->read(&received[total], std::min((size_t)1000, received.size() - total))) > 0)
+    total += result;
+  ::wait(writer_thread);
+  received.resize(total);
+  TEST_ASSERT( writer_thread.written == expected.size() );
+  TEST_ASSERT( received == expected );
+  TEST_ASSERT( reader->eof() );
+
+  // A writer stops when the reader closed the ring
+  writer = Shared_memory_ring::create(4096);
+  reader = Shared_memory_ring::open(writer->name());
+  TEST_ASSERT( (writer != Ptr()) && (reader != Ptr()) );
+  if ((writer == Ptr()) || (reader == Ptr()))
+    return;
+  reader->close_reader();
+  TEST_ASSERT( writer->can_write() );
+  TEST_ASSERT( writer->write(&expected[0], 10000) == 4096 );
+}
+#endif // ENABLE_TEST_UNIT
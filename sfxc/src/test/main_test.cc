@@ -0,0 +1,24 @@
+#include <iostream>
+
+#include "Test_unit.h"
+#include "data_writer.h"
+#include "data_writer_batch.h"
+#include "shared_memory_ring.h"
+#include "delay_table_akima.h"
+#include "input_node_data_writer.h"
+#include "data_reader_vdif_udp.h"
+
+int main(int argc, char** argv) {
+  std::cout << "Starting tests" << std::endl;
+
+#ifdef ENABLE_TEST_UNIT
+  Test_manager manager;
+  manager.add_test( new Data_writer::Test() );
+  manager.add_test( new Data_writer_batch::Test() );
+  manager.add_test( new Shared_memory_ring::Test() );
+  manager.add_test( new Delay_polynomial::Test() );
+  manager.add_test( new Input_node_data_slice::Test() );
+  manager.add_test( new Data_reader_vdif_udp::Test() );
+  manager.do_test();
+#endif // ENABLE_TEST_UNIT
+}
@@ -159,15 +159,27 @@ VDIF_reader::read_new_block(Data_frame &data) {
     goto restart;
   }
 
-  Data_reader_blocking::get_bytes_s( data_reader_.get(), frame_size, (char *)&buffer[0]);
-  if (data_reader_->eof())
-    return false;
+  // A block of a single frame is passed on in place if the data reader
+  // supports it, only the headers are copied
+  shared_ptr<void> region;
+  const char *view = NULL;
+  if (vdif_frames_per_block == 1)
+    view = data_reader_->get_view(frame_size, region);
+  if (view != NULL) {
+    data.buffer->set_view((const value_type *)view, frame_size, region);
+  } else {
+    data.buffer->clear_view();
+    Data_reader_blocking::get_bytes_s( data_reader_.get(), frame_size, (char *)&buffer[0]);
+    if (data_reader_->eof())
+      return false;
+  }
 
   if (current_header.invalid > 0) {
     struct Input_node_types::Invalid_block invalid;
     invalid.invalid_begin = 0;
     invalid.nr_invalid = frame_size;
     data.invalid.push_back(invalid);
+    data.all_invalid = (vdif_frames_per_block == 1);
     if (thread_map.count(current_header.thread_id) > 0)
       data.channel = thread_map[current_header.thread_id];
     else
@@ -0,0 +1,146 @@
+/* Copyright (c) 2007 Joint Institute for VLBI in Europe (Netherlands)
+ * All rights reserved.
+ *
+ * Micro benchmark for the vector functions in sfxc_math.h. Every kernel
+ * is timed for all instruction sets supported by the CPU and the result
+ * is compared against the scalar implementation.
+ *
+ * Usage: sfxc_math_bench [length] [iterations]
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include "sfxc_math.h"
+
+#ifdef USE_IPP
+int main(int argc, char *argv[]) {
+  std::cout << "sfxc was configured to use IPP, there are no SIMD kernels to benchmark" << std::endl;
+  return 0;
+}
+#else
+typedef std::complex<float> fc;
+
+double wall_time() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct Buffers {
+  std::vector<float> f1, f2, f3;
+  std::vector<fc> c1, c2, c3;
+};
+
+void fill(Buffers &b, int n) {
+  b.f1.resize(n); b.f2.resize(n); b.f3.resize(n);
+  b.c1.resize(n); b.c2.resize(n); b.c3.resize(n);
+  srand(1);
+  // f1 and c1 have unit magnitude, such that repeatedly multiplying with
+  // them does not lead to denormals
+  for (int i = 0; i < n; i++) {
+    b.f1[i] = (rand() % 2 == 0 ? 1 : -1);
+    b.f2[i] = rand() / (float)RAND_MAX - 0.5;
+    b.f3[i] = 0;
+    b.c1[i] = std::polar(1.f, (float)(2 * M_PI * rand() / RAND_MAX));
+    b.c2[i] = fc(rand() / (float)RAND_MAX - 0.5, rand() / (float)RAND_MAX - 0.5);
+    b.c3[i] = 0;
+  }
+}
+
+enum Kernel {
+  ADD_PRODUCT_FC = 0, MUL_FC_I, MUL_FC, MUL_F_FC_I, CONJ_FC, ADD_FC_I, ADD_F, MUL_F,
+  ROTATE_FC, ADD_ROTATE_FC, ROTATE_REAL_FC,
+  N_KERNELS
+};
+
+const char *kernel_names[N_KERNELS] = {
+  "add_product_fc", "mul_fc_I", "mul_fc", "mul_f_fc_I", "conj_fc", "add_fc_I", "add_f", "mul_f",
+  "rotate_fc", "add_rotate_fc", "rotate_real_fc"
+};
+
+void run(Kernel k, Buffers &b, int n) {
+  switch (k) {
+  case ADD_PRODUCT_FC: sfxc_add_product_fc(&b.c1[0], &b.c2[0], &b.c3[0], n); break;
+  case MUL_FC_I:       sfxc_mul_fc_I(&b.c1[0], &b.c3[0], n); break;
+  case MUL_FC:         sfxc_mul_fc(&b.c1[0], &b.c2[0], &b.c3[0], n); break;
+  case MUL_F_FC_I:     sfxc_mul_f_fc_I(&b.f1[0], &b.c3[0], n); break;
+  case CONJ_FC:        sfxc_conj_fc(&b.c1[0], &b.c3[0], n); break;
+  case ADD_FC_I:       sfxc_add_fc_I(&b.c1[0], &b.c3[0], n); break;
+  case ADD_F:          sfxc_add_f(&b.f1[0], &b.f2[0], &b.f3[0], n); break;
+  case MUL_F:          sfxc_mul_f(&b.f1[0], &b.f2[0], &b.f3[0], n); break;
+  case ROTATE_FC:      sfxc_rotate_fc(&b.c2[0], &b.c3[0], n, 0.3, 0.001, 1); break;
+  case ADD_ROTATE_FC:  sfxc_add_rotate_fc(&b.c2[0], &b.c3[0], n, 0.3, 0.001, 1); break;
+  case ROTATE_REAL_FC: sfxc_rotate_real_fc(&b.c2[0], &b.f3[0], n, 0.3, 0.001, 1); break;
+  default: break;
+  }
+}
+
+// Largest relative difference between the output of the current and the
+// scalar kernels after a few calls
+double check(Kernel k, int n) {
+  Buffers ref, out;
+  Sfxc_math_isa isa = sfxc_math_current_isa();
+  fill(ref, n);
+  fill(out, n);
+  for (int i = 0; i < 3; i++)
+    run(k, out, n);
+  sfxc_math_select(SFXC_MATH_SCALAR);
+  for (int i = 0; i < 3; i++)
+    run(k, ref, n);
+  sfxc_math_select(isa);
+
+  double err = 0;
+  for (int i = 0; i < n; i++) {
+    double scale = std::max(std::abs(ref.c3[i]), (float)1e-3);
+    err = std::max(err, std::abs(out.c3[i] - ref.c3[i]) / scale);
+    scale = std::max(std::abs(ref.f3[i]), (float)1e-3);
+    err = std::max(err, std::abs(out.f3[i] - ref.f3[i]) / scale);
+  }
+  return err;
+}
+
+int main(int argc, char *argv[]) {
+  int n = (argc > 1 ? atoi(argv[1]) : 4097);
+  int iter = (argc > 2 ? atoi(argv[2]) : 20000);
+  if ((n <= 0) || (iter <= 0)) {
+    std::cerr << "Usage: " << argv[0] << " [length] [iterations]" << std::endl;
+    return 1;
+  }
+
+  Sfxc_math_isa best = sfxc_math_best_isa();
+  std::cout << "length " << n << ", " << iter << " iterations, best instruction set: "
+            << sfxc_math_isa_name(best) << std::endl;
+  std::cout << std::setw(16) << "kernel" << std::setw(10) << "isa"
+            << std::setw(12) << "ns/call" << std::setw(10) << "speedup"
+            << std::setw(12) << "max error" << std::endl;
+
+  Buffers b;
+  fill(b, n);
+  for (int k = 0; k < N_KERNELS; k++) {
+    double scalar_time = 0;
+    for (int isa = SFXC_MATH_SCALAR; isa <= best; isa++) {
+      sfxc_math_select((Sfxc_math_isa)isa);
+      double err = check((Kernel)k, n);
+      double start = wall_time();
+      for (int i = 0; i < iter; i++)
+        run((Kernel)k, b, n);
+      double t = (wall_time() - start) / iter;
+      if (isa == SFXC_MATH_SCALAR)
+        scalar_time = t;
+      std::cout << std::setw(16) << kernel_names[k]
+                << std::setw(10) << sfxc_math_isa_name((Sfxc_math_isa)isa)
+                << std::setw(12) << std::fixed << std::setprecision(1) << t * 1e9
+                << std::setw(10) << std::setprecision(2) << scalar_time / t
+                << std::setw(12) << std::scientific << std::setprecision(1) << err
+                << std::endl;
+    }
+  }
+  sfxc_math_select(best);
+  return 0;
+}
+#endif // USE_IPP